@@ -168,7 +168,10 @@ void MI_CALL OsConfigResource_Load(
         CallMpiClose(g_mpiHandle, GetLog());
         g_mpiHandle = NULL;
     }
-    
+
+    // Spawn the commands from the command helper when installed, otherwise they are spawned from this host process
+    StartCommandHelper(GetLog());
+
     AsbInitialize(GetLog());
 
     LogInfo(context, GetLog(), "[OsConfigResource] Load (PID: %d)", getpid());
@@ -198,6 +201,8 @@ void MI_CALL OsConfigResource_Unload(
         RestartDaemon(IsDaemonActive(g_osconfig, GetLog()) ? g_osconfig : g_mpiServer, NULL);
     }
 
+    StopCommandHelper(GetLog());
+
     MI_Context_PostResult(context, MI_RESULT_OK);
 }
 
@@ -7,6 +7,10 @@
 #include "inc/AisUtils.h"
 #include "inc/Watcher.h"
 
+#ifdef COLOCATED_PLATFORM
+#include <MpiServer.h>
+#endif
+
 // 100 milliseconds
 #define DOWORK_SLEEP 100
 
@@ -17,6 +21,10 @@
 // The configuration file for OSConfig
 #define CONFIG_FILE "/etc/osconfig/osconfig.json"
 
+// The log file for the platform when running in-process (colocated) with the agent
+#define PLATFORM_LOG_FILE "/var/log/osconfig_platform.log"
+#define PLATFORM_ROLLED_LOG_FILE "/var/log/osconfig_platform.bak"
+
 // The optional second command line argument that when present instructs the agent to run as a traditional daemon
 #define FORK_ARG "fork"
 
@@ -85,6 +93,12 @@ static HTTP_PROXY_OPTIONS g_proxyOptions = {0};
 MPI_HANDLE g_mpiHandle = NULL;
 static unsigned int g_maxPayloadSizeBytes = OSCONFIG_MAX_PAYLOAD;
 
+static bool g_isPlatformColocated = false;
+
+#ifdef COLOCATED_PLATFORM
+extern OSCONFIG_LOG_HANDLE g_platformLog;
+#endif
+
 static OSCONFIG_LOG_HANDLE g_agentLog = NULL;
 
 static int g_modelVersion = DEFAULT_DEVICE_MODEL_ID;
@@ -322,10 +336,66 @@ static void ForkDaemon()
     }
 }
 
+static bool StartColocatedPlatform(void)
+{
+    bool status = true;
+
+#ifdef COLOCATED_PLATFORM
+    MPI_CALLS mpiCalls = GetInProcessMpiCalls();
+
+    // Only one platform can serve the MPI socket
+    if (IsDaemonActive(OSCONFIG_PLATFORM, GetLog()))
+    {
+        StopAndDisableDaemon(OSCONFIG_PLATFORM, GetLog());
+    }
+
+    g_platformLog = OpenLog(PLATFORM_LOG_FILE, PLATFORM_ROLLED_LOG_FILE);
+
+    // The MPI socket server remains available for other local clients
+    MpiInitialize();
+
+    SetMpiClientInProcessCalls(&mpiCalls);
+
+    OsConfigLogInfo(GetLog(), "The OSConfig Platform is running in-process (colocated) with the OSConfig Agent");
+#else
+    OsConfigLogError(GetLog(), "This OSConfig Agent was built without support for running the OSConfig Platform in-process");
+    status = false;
+#endif
+
+    return status;
+}
+
+static void StopColocatedPlatform(void)
+{
+#ifdef COLOCATED_PLATFORM
+    SetMpiClientInProcessCalls(NULL);
+    MpiShutdown();
+    CloseLog(&g_platformLog);
+#endif
+}
+
 bool RefreshMpiClientSession(bool* platformAlreadyRunning)
 {
     bool status = true;
 
+    if (g_isPlatformColocated)
+    {
+        // The platform runs in-process, it cannot be stopped separately from the agent
+        if (NULL != platformAlreadyRunning)
+        {
+            *platformAlreadyRunning = true;
+        }
+
+        if ((NULL == g_mpiHandle) && (NULL == (g_mpiHandle = CallMpiOpen(g_productName, g_maxPayloadSizeBytes, GetLog()))))
+        {
+            OsConfigLogError(GetLog(), "MpiOpen failed");
+            g_exitState = PlatformInitializationFailure;
+            status = false;
+        }
+
+        return status;
+    }
+
     if (g_mpiHandle && IsDaemonActive(OSCONFIG_PLATFORM, GetLog()))
     {
         // Platform is already running
@@ -369,6 +439,12 @@ static bool InitializeAgent(void)
 
     g_lastTime = (unsigned int)time(NULL);
 
+    if (g_isPlatformColocated && (false == StartColocatedPlatform()))
+    {
+        OsConfigLogInfo(GetLog(), "Falling back to the separate OSConfig Platform process");
+        g_isPlatformColocated = false;
+    }
+
     if (0 == (status = RefreshMpiClientSession(NULL)))
     {
         if (g_isIotHubEnabled && g_iotHubConnectionString)
@@ -410,6 +486,11 @@ void CloseAgent(void)
         g_mpiHandle = NULL;
     }
 
+    if (g_isPlatformColocated)
+    {
+        StopColocatedPlatform();
+    }
+
     FREE_MEMORY(g_reportedProperties);
     
     OsConfigLogInfo(GetLog(), "The OSConfig Agent session is closed");
@@ -478,9 +559,15 @@ static void AgentDoWork(void)
 
         g_lastTime = (unsigned int)time(NULL);
     }
-    else if (g_isIotHubEnabled)
+    else
     {
-        IotHubDoWork();
+        // Between reporting intervals apply local DC file changes as soon as the Watcher is notified of them
+        WatcherCheckForChanges(GetLog());
+
+        if (g_isIotHubEnabled)
+        {
+            IotHubDoWork();
+        }
     }
 }
 
@@ -551,6 +638,7 @@ int main(int argc, char *argv[])
         g_reportingInterval = GetReportingIntervalFromJsonConfig(jsonConfiguration, GetLog());
         g_isIotHubEnabled = IsIotHubManagementEnabledInJsonConfig(jsonConfiguration);
         g_iotHubProtocol = GetIotHubProtocolFromJsonConfig(jsonConfiguration, GetLog());
+        g_isPlatformColocated = IsColocatedPlatformEnabledInJsonConfig(jsonConfiguration);
     }
 
     RestrictFileAccessToCurrentAccountOnly(CONFIG_FILE);
@@ -720,7 +808,10 @@ done:
     
     CloseAgent();
     
-    StopAndDisableDaemon(OSCONFIG_PLATFORM, GetLog());
+    if (false == g_isPlatformColocated)
+    {
+        StopAndDisableDaemon(OSCONFIG_PLATFORM, GetLog());
+    }
 
     CloseLog(&g_agentLog);
 
@@ -4,17 +4,32 @@
 #include "inc/AgentCommon.h"
 #include "inc/PnpAgent.h"
 #include "inc/AisUtils.h"
+#include "inc/Watcher.h"
+
+#include <limits.h>
+#include <sys/inotify.h>
 
 #define MPI_CLIENT_NAME "OSConfig Watcher"
 #define MAX_PAYLOAD_LENGTH 0
 
 // The local Desired Configuration (DC) and Reported Configuration (RC) files
-#define DC_FILE "/etc/osconfig/osconfig_desired.json"
-#define RC_FILE "/etc/osconfig/osconfig_reported.json"
+#define DC_DIRECTORY "/etc/osconfig/"
+#define DC_FILE_NAME "osconfig_desired.json"
+#define DC_FILE DC_DIRECTORY DC_FILE_NAME
+#define RC_FILE DC_DIRECTORY "osconfig_reported.json"
 
 // The local clone for Git Desired Configuration (DC) 
-#define GIT_DC_CLONE "/etc/osconfig/gitops/"
-#define GIT_DC_FILE GIT_DC_CLONE "osconfig_desired.json"
+#define GIT_DC_CLONE DC_DIRECTORY "gitops/"
+#define GIT_DC_FILE GIT_DC_CLONE DC_FILE_NAME
+
+// File change notifications we act on: a writer closing the DC file, or a new DC file renamed in place
+#define DC_FILE_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO)
+
+// Wait for the DC file to be quiet for this long before processing it, to coalesce multiple writes (in milliseconds)
+#define DC_FILE_DEBOUNCE 250
+
+// Room for a batch of events including file names (aligned as required by inotify)
+#define DC_EVENTS_BUFFER_SIZE (16 * (sizeof(struct inotify_event) + NAME_MAX + 1))
 
 static int g_localManagement = 0;
 static size_t g_reportedHash = 0;
@@ -27,6 +42,103 @@ static size_t g_gitDesiredHash = 0;
 
 static bool g_gitCloneInitialized = false;
 
+// Writes the RC file atomically and only re-serializes the components that changed
+static REPORTED_WRITER_HANDLE g_reportedWriter = NULL;
+
+// Notifications for the local DC file, when inotify is not available we fall back to polling at each reporting interval
+static int g_notifyDescriptor = -1;
+static int g_dcWatch = -1;
+
+// When set, the respective DC file must be (re)processed
+static bool g_desiredPending = true;
+static bool g_gitDesiredPending = true;
+
+// The commit currently checked out in the Git clone
+static char g_gitCommitId[GIT_COMMIT_ID_MAX_LENGTH + 1] = {0};
+
+// Time of the latest not yet processed change notification for the local DC file, 0 when none
+static long long g_desiredEventTime = 0;
+
+static long long GetMonotonicMilliseconds(void)
+{
+    struct timespec now = {0};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((long long)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+static void InitializeDcFileNotifications(void* log)
+{
+    if (g_notifyDescriptor < 0)
+    {
+        if (0 > (g_notifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)))
+        {
+            OsConfigLogError(log, "Watcher: inotify_init1 failed with %d, DC files are going to be polled", errno);
+        }
+    }
+}
+
+static int WatchDcDirectory(const char* directory, void* log)
+{
+    int watch = -1;
+
+    if ((g_notifyDescriptor >= 0) && (NULL != directory))
+    {
+        // Watch the directory and not the file itself, as a watch on the file is lost when the file is replaced
+        if (0 > (watch = inotify_add_watch(g_notifyDescriptor, directory, DC_FILE_EVENTS)))
+        {
+            OsConfigLogError(log, "Watcher: cannot watch '%s' (%d), DC file in there is going to be polled", directory, errno);
+        }
+        else if (IsFullLoggingEnabled())
+        {
+            OsConfigLogInfo(log, "Watcher: watching '%s' for DC file changes", directory);
+        }
+    }
+
+    return watch;
+}
+
+static void ReadDcFileNotifications(void* log)
+{
+    char buffer[DC_EVENTS_BUFFER_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event* event = NULL;
+    ssize_t length = 0;
+    char* next = NULL;
+
+    if (g_notifyDescriptor < 0)
+    {
+        return;
+    }
+
+    while (0 < (length = read(g_notifyDescriptor, buffer, sizeof(buffer))))
+    {
+        for (next = buffer; next < (buffer + length); next += sizeof(struct inotify_event) + event->len)
+        {
+            event = (const struct inotify_event*)next;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                // Events were lost, reprocess the DC file
+                g_desiredEventTime = GetMonotonicMilliseconds();
+            }
+            else if ((event->mask & IN_IGNORED) && (event->wd == g_dcWatch))
+            {
+                // The watched directory was removed
+                g_dcWatch = -1;
+            }
+            else if ((event->wd == g_dcWatch) && (event->len > 0) && (0 == strcmp(event->name, DC_FILE_NAME)))
+            {
+                // Restart the debounce window with every new write
+                g_desiredEventTime = GetMonotonicMilliseconds();
+            }
+        }
+    }
+
+    if ((length < 0) && (EAGAIN != errno) && (EINTR != errno))
+    {
+        OsConfigLogError(log, "Watcher: reading DC file notifications failed with %d", errno);
+    }
+}
+
 static void SaveReportedConfigurationToFile(const char* fileName, size_t* hash)
 {
     char* payload = NULL;
@@ -49,7 +161,11 @@ static void SaveReportedConfigurationToFile(const char* fileName, size_t* hash)
         {
             if ((*hash != (payloadHash = HashString(payload))) && payloadHash)
             {
-                if (SavePayloadToFile(fileName, payload, payloadSizeBytes, GetLog()))
+                if ((NULL == g_reportedWriter) && (NULL == (g_reportedWriter = OpenReportedWriter(fileName, true, GetLog()))))
+                {
+                    OsConfigLogError(GetLog(), "Watcher: cannot open a writer for '%s'", fileName);
+                }
+                else if ((0 == UpdateReportedPayload(g_reportedWriter, payload, GetLog())) && (0 == SaveReportedFile(g_reportedWriter, GetLog())))
                 {
                     RestrictFileAccessToCurrentAccountOnly(fileName);
                     *hash = payloadHash;
@@ -61,7 +177,8 @@ static void SaveReportedConfigurationToFile(const char* fileName, size_t* hash)
     }
 }
 
-static void ProcessDesiredConfigurationFromFile(const char* fileName, size_t* hash, void* log)
+// Returns false when the DC file needs to be processed again later
+static bool ProcessDesiredConfigurationFromFile(const char* fileName, size_t* hash, void* log)
 {
     size_t payloadHash = 0;
     int payloadSizeBytes = 0;
@@ -96,25 +213,8 @@ static void ProcessDesiredConfigurationFromFile(const char* fileName, size_t* ha
 
         FREE_MEMORY(payload);
     }
-}
-
-static int DeleteGitClone(const char* gitClonePath, void* log)
-{
-    const char* g_gitCloneCleanUpTemplate = "rm -r %s";
-    char* cleanUpCommand = NULL;
-    int result = 0;
-
-    if (NULL == gitClonePath)
-    {
-        OsConfigLogError(log, "DeleteGitClone: invalid argument");
-        return EINVAL;
-    }
 
-    cleanUpCommand = FormatAllocateString(g_gitCloneCleanUpTemplate, gitClonePath);
-    result = ExecuteCommand(NULL, cleanUpCommand, false, false, 0, 0, NULL, NULL, log);
-    FREE_MEMORY(cleanUpCommand);
-
-    return result;
+    return (MPI_OK == mpiResult) ? true : false;
 }
 
 static int ProtectDcFile(const char* gitClonedDcFile, void* log)
@@ -141,108 +241,40 @@ static int ProtectDcFile(const char* gitClonedDcFile, void* log)
 
 static int InitializeGitClone(const char* gitRepositoryUrl, const char* gitBranch, const char* gitClonePath, const char* gitClonedDcFile, void* log)
 {
-    const char* g_gitCloneTemplate = "git clone -q --branch %s --single-branch %s %s";
-    const char* g_gitConfigTemplate = "git config --global --add safe.directory %s";
-    
-    char* configCommand = NULL;
-    char* cloneCommand = NULL;
     int error = 0;
 
-    // Do not log gitRepositoryUrl as it may contain Git account credentials
-
-    if ((NULL == gitRepositoryUrl) || (NULL == gitBranch) || (NULL == gitClonePath) || (NULL == gitClonedDcFile) || 
-        (0 == strcmp("", gitClonePath)) || (0 == strcmp("", gitClonedDcFile)))
-    {
-        OsConfigLogError(log, "InitializeGitClone: invalid arguments");
-        return EINVAL;
-    }
-    else if ((0 == strcmp("", gitRepositoryUrl)) || (0 == strcmp("", gitBranch)))
-    {
-        OsConfigLogError(log, "InitializeGitClone: invoked with no Git repository or branch");
-        return ENOENT;
-    }
-
-    cloneCommand = FormatAllocateString(g_gitCloneTemplate, gitBranch, gitRepositoryUrl, gitClonePath);
-    configCommand = FormatAllocateString(g_gitConfigTemplate, gitClonePath);
-    
-    DeleteGitClone(gitClonePath, log);
-
-    if (0 != (error = ExecuteCommand(NULL, cloneCommand, false, false, 0, 0, NULL, NULL, GetLog())))
+    if (0 != (error = CloneGitBranch(gitRepositoryUrl, gitBranch, gitClonePath, DC_FILE_NAME, g_gitCommitId, log)))
     {
         OsConfigLogError(log, "Watcher: failed making a new Git clone at %s (%d)", gitClonePath, error);
     }
-    else if (0 != (error = ExecuteCommand(NULL, configCommand, false, false, 0, 0, NULL, NULL, GetLog())))
-    {
-        OsConfigLogError(log, "Watcher: failed configuring the new Git clone at %s (%d)", gitClonePath, error);
-    }
     else if (0 != (error = ProtectDcFile(gitClonedDcFile, log)))
     {
         OsConfigLogError(log, "Watcher: failed initializing Git clone at %s (%d)", gitClonePath, error);
     }
-
-    FREE_MEMORY(cloneCommand);
-    FREE_MEMORY(configCommand);
-
-    if (0 == error)
+    else
     {
-        OsConfigLogInfo(log, "Watcher: successfully initialized Git clone at %s", gitClonePath);
+        OsConfigLogInfo(log, "Watcher: successfully initialized Git clone at %s (commit %s)", gitClonePath, g_gitCommitId);
     }
 
     return error;
 }
 
-static int RefreshGitClone(const char* gitBranch, const char* gitClonePath, const char* gitClonedDcFile, void* log)
+static int RefreshGitClone(const char* gitBranch, const char* gitClonePath, const char* gitClonedDcFile, bool* refreshed, void* log)
 {
-    const char* g_gitCheckoutTemplate = "git checkout %s";
-    const char* g_gitPullCommand = "git pull";
-    
-    char* checkoutBranchCommand = NULL;
-    char* checkoutFileCommand = NULL;
-    char* currentDirectory = NULL;
     int error = 0;
 
-    if ((NULL == gitClonePath) || (NULL == gitClonedDcFile) || (NULL == gitBranch))
+    if (0 != (error = UpdateGitClone(gitBranch, gitClonePath, g_gitCommitId, refreshed, log)))
     {
-        OsConfigLogError(log, "RefreshGitClone: invalid arguments");
-        return EINVAL;
+        OsConfigLogError(log, "Watcher: failed refreshing the Git clone at %s for branch %s (%d)", gitClonePath, gitBranch, error);
     }
-
-    checkoutBranchCommand = FormatAllocateString(g_gitCheckoutTemplate, gitBranch);
-    checkoutFileCommand = FormatAllocateString(g_gitCheckoutTemplate, gitClonedDcFile);
-    currentDirectory = getcwd(NULL, 0);
-
-    if (0 != (error = chdir(gitClonePath)))
-    {
-        OsConfigLogError(log, "Watcher: failed changing current directory to %s (%d)", gitClonePath, error);
-    }
-    else if (0 != (error = ExecuteCommand(NULL, checkoutFileCommand, false, false, 0, 0, NULL, NULL, GetLog())))
-    {
-        OsConfigLogError(log, "Watcher: failed checking out Git file %s (%d)", gitBranch, error);
-    }
-    else if (0 != (error = ExecuteCommand(NULL, checkoutBranchCommand, false, false, 0, 0, NULL, NULL, GetLog())))
-    {
-        OsConfigLogError(log, "Watcher: failed checking out Git branch %s (%d)", gitBranch, error);
-    }
-    else if (0 != (error = ExecuteCommand(NULL, g_gitPullCommand, false, false, 0, 0, NULL, NULL, GetLog())))
-    {
-        OsConfigLogError(log, "Watcher: failed Git pull from branch %s to local clone %s (%d)", gitBranch, gitClonePath, error);
-    }
-    else if (0 != (error = chdir(currentDirectory)))
-    {
-        OsConfigLogError(log, "Watcher: failed restoring current directory to %s (%d)", currentDirectory, error);
-    }
-    else if (0 != (error = ProtectDcFile(gitClonedDcFile, log)))
+    else if (*refreshed && (0 != (error = ProtectDcFile(gitClonedDcFile, log))))
     {
+        *refreshed = false;
         OsConfigLogError(log, "Watcher: failed refreshing Git clone at %s (%d)", gitClonePath, error);
     }
-
-    FREE_MEMORY(checkoutBranchCommand);
-    FREE_MEMORY(checkoutFileCommand);
-    FREE_MEMORY(currentDirectory);
-
-    if ((0 == error) && (IsFullLoggingEnabled()))
+    else if (*refreshed)
     {
-        OsConfigLogInfo(log, "Watcher: successfully refreshed the Git clone at %s for branch %s", gitClonePath, gitBranch);
+        OsConfigLogInfo(log, "Watcher: successfully refreshed the Git clone at %s for branch %s to commit %s", gitClonePath, gitBranch, g_gitCommitId);
     }
 
     return error;
@@ -259,17 +291,45 @@ void InitializeWatcher(const char* jsonConfiguration, void* log)
     }
 
     g_gitCloneInitialized = false;
+    g_desiredPending = true;
+    g_gitDesiredPending = true;
+    g_desiredEventTime = 0;
+    memset(g_gitCommitId, 0, sizeof(g_gitCommitId));
 
     RestrictFileAccessToCurrentAccountOnly(DC_FILE);
     RestrictFileAccessToCurrentAccountOnly(RC_FILE);
     RestrictFileAccessToCurrentAccountOnly(GIT_DC_FILE);
+
+    if (g_localManagement || g_gitManagement)
+    {
+        InitializeDcFileNotifications(log);
+    }
+
+    if (g_localManagement)
+    {
+        g_dcWatch = WatchDcDirectory(DC_DIRECTORY, log);
+    }
 }
 
 void WatcherDoWork(void* log)
 {
+    bool gitCloneRefreshed = false;
+
+    ReadDcFileNotifications(log);
+
     if (g_localManagement)
     {
-        ProcessDesiredConfigurationFromFile(DC_FILE, &g_desiredHash, log);
+        // Retry to watch in case the DC directory did not exist before, and process once to catch up
+        if ((g_dcWatch < 0) && (0 <= (g_dcWatch = WatchDcDirectory(DC_DIRECTORY, log))))
+        {
+            g_desiredPending = true;
+        }
+
+        // Without a watch, poll the DC file as before
+        if (g_desiredPending || (g_dcWatch < 0))
+        {
+            g_desiredPending = !ProcessDesiredConfigurationFromFile(DC_FILE, &g_desiredHash, log);
+        }
     }
 
     if (g_gitManagement)
@@ -277,11 +337,16 @@ void WatcherDoWork(void* log)
         if ((false == g_gitCloneInitialized) && (0 == InitializeGitClone(g_gitRepositoryUrl, g_gitBranch, GIT_DC_CLONE, GIT_DC_FILE, log)))
         {
             g_gitCloneInitialized = true;
+            g_gitDesiredPending = true;
         }
 
-        if ((true == g_gitCloneInitialized) && (0 == RefreshGitClone(g_gitBranch, GIT_DC_CLONE, GIT_DC_FILE, log)))
+        if ((true == g_gitCloneInitialized) && (0 == RefreshGitClone(g_gitBranch, GIT_DC_CLONE, GIT_DC_FILE, &gitCloneRefreshed, log)))
         {
-            ProcessDesiredConfigurationFromFile(GIT_DC_FILE, &g_gitDesiredHash, log);
+            // Read the cloned DC file only when the branch moved to a new commit, or to retry after a failure
+            if (gitCloneRefreshed || g_gitDesiredPending)
+            {
+                g_gitDesiredPending = !ProcessDesiredConfigurationFromFile(GIT_DC_FILE, &g_gitDesiredHash, log);
+            }
         }
     }
 
@@ -291,12 +356,39 @@ void WatcherDoWork(void* log)
     }
 }
 
+void WatcherCheckForChanges(void* log)
+{
+    if (false == g_localManagement)
+    {
+        return;
+    }
+
+    ReadDcFileNotifications(log);
+
+    // Process the local DC file as soon as writers are done with it, without waiting for the next reporting interval
+    if ((g_desiredEventTime > 0) && ((GetMonotonicMilliseconds() - g_desiredEventTime) >= DC_FILE_DEBOUNCE))
+    {
+        g_desiredEventTime = 0;
+        g_desiredPending = !ProcessDesiredConfigurationFromFile(DC_FILE, &g_desiredHash, log);
+    }
+}
+
 void WatcherCleanup(void* log)
 {
     OsConfigLogInfo(log, "Watcher shutting down");
 
+    if (g_notifyDescriptor >= 0)
+    {
+        close(g_notifyDescriptor);
+        g_notifyDescriptor = -1;
+        g_dcWatch = -1;
+    }
+
     DeleteGitClone(GIT_DC_CLONE, log);
 
+    CloseReportedWriter(g_reportedWriter);
+    g_reportedWriter = NULL;
+
     FREE_MEMORY(g_gitRepositoryUrl);
     FREE_MEMORY(g_gitBranch);
 }
@@ -11,6 +11,7 @@ extern "C"
 
 void InitializeWatcher(const char* jsonConfiguration, void* log);
 void WatcherDoWork(void* log);
+void WatcherCheckForChanges(void* log);
 void WatcherCleanup(void* log);
 bool IsWatcherActive(void);
 
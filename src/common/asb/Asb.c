@@ -464,6 +464,10 @@ static const char* g_defaultEnsureDefaultDenyFirewallPolicyIsSet = "0"; //zero:
 
 static const char* g_etcIssue = "/etc/issue";
 static const char* g_etcIssueNet = "/etc/issue.net";
+
+// Escape sequences that reveal the OS in login banners
+static const char* g_loginBannerEscapes[] = {"\\m", "\\r", "\\s", "\\v"};
+
 static const char* g_etcHostsAllow = "/etc/hosts.allow";
 static const char* g_etcHostsDeny = "/etc/hosts.deny";
 static const char* g_etcCronAllow = "/etc/cron.allow";
@@ -498,13 +502,13 @@ static const char* g_etcRsyslogConf = "/etc/rsyslog.conf";
 static const char* g_etcSyslogNgSyslogNgConf = "/etc/syslog-ng/syslog-ng.conf";
 static const char* g_etcNetworkInterfaces = "/etc/network/interfaces";
 static const char* g_etcSysconfigNetwork = "/etc/sysconfig/network";
-static const char* g_etcSysctlConf = "/etc/sysctl.conf";
 static const char* g_etcRcLocal = "/etc/rc.local";
 static const char* g_etcSambaConf = "/etc/samba/smb.conf";
 static const char* g_etcPostfixMainCf = "/etc/postfix/main.cf";
 static const char* g_etcCronDailyLogRotate = "/etc/cron.daily/logrotate";
 static const char* g_etcSecurityLimitsConf = "/etc/security/limits.conf";
 static const char* g_sysCtlConf = "/etc/sysctl.d/99-sysctl.conf";
+static const char* g_osConfigSysctlConf = "/etc/sysctl.d/99-osconfig.conf";
 
 static const char* g_home = "/home";
 static const char* g_devShm = "/dev/shm";
@@ -573,7 +577,6 @@ static const char* g_needSvcgssd = "NEED_SVCGSSD = yes";
 static const char* g_inetInterfacesLocalhost = "inet_interfaces localhost";
 static const char* g_autofs = "autofs";
 static const char* g_ipv4ll = "ipv4ll";
-static const char* g_sysCtlA = "sysctl -a";
 static const char* g_fileCreateMode = "$FileCreateMode";
 static const char* g_logrotate = "logrotate";
 static const char* g_logrotateTimer = "logrotate.timer";
@@ -1568,10 +1571,7 @@ static char* AuditEnsureRemoteLoginWarningBannerIsConfigured(void* log)
     char* reason = NULL;
     if (0 == CheckFileExists(g_etcIssueNet, &reason, log))
     {
-        RETURN_REASON_IF_NOT_ZERO(CheckTextIsNotFoundInFile(g_etcIssueNet, "\\m", &reason, log));
-        RETURN_REASON_IF_NOT_ZERO(CheckTextIsNotFoundInFile(g_etcIssueNet, "\\r", &reason, log));
-        RETURN_REASON_IF_NOT_ZERO(CheckTextIsNotFoundInFile(g_etcIssueNet, "\\s", &reason, log));
-        CheckTextIsNotFoundInFile(g_etcIssueNet, "\\v", &reason, log);
+        CheckTextsAreNotFoundInFile(g_etcIssueNet, g_loginBannerEscapes, ARRAY_SIZE(g_loginBannerEscapes), &reason, log);
     }
     else if (IsCurrentOs(PRETTY_NAME_SLES_15, log))
     {
@@ -1584,10 +1584,7 @@ static char* AuditEnsureRemoteLoginWarningBannerIsConfigured(void* log)
 static char* AuditEnsureLocalLoginWarningBannerIsConfigured(void* log)
 {
     char* reason = NULL;
-    RETURN_REASON_IF_NOT_ZERO(CheckTextIsNotFoundInFile(g_etcIssue, "\\m", &reason, log));
-    RETURN_REASON_IF_NOT_ZERO(CheckTextIsNotFoundInFile(g_etcIssue, "\\r", &reason, log));
-    RETURN_REASON_IF_NOT_ZERO(CheckTextIsNotFoundInFile(g_etcIssue, "\\s", &reason, log));
-    CheckTextIsNotFoundInFile(g_etcIssue, "\\v", &reason, log);
+    CheckTextsAreNotFoundInFile(g_etcIssue, g_loginBannerEscapes, ARRAY_SIZE(g_loginBannerEscapes), &reason, log);
     return reason;
 }
 
@@ -1634,9 +1631,9 @@ static char* AuditEnsureDefaultDenyFirewallPolicyIsSet(void* log)
     int forceDrop = atoi(g_desiredEnsureDefaultDenyFirewallPolicyIsSet ? 
         g_desiredEnsureDefaultDenyFirewallPolicyIsSet : g_defaultEnsureDefaultDenyFirewallPolicyIsSet);
     
-    if ((0 != CheckTextFoundInCommandOutput(readIpTables, "-P INPUT DROP", &reason, log)) ||
-        (0 != CheckTextFoundInCommandOutput(readIpTables, "-P FORWARD DROP", &reason, log)) ||
-        (0 != CheckTextFoundInCommandOutput(readIpTables, "-P OUTPUT DROP", &reason, log)))
+    if ((0 != CheckTextFoundInCachedCommandOutput(readIpTables, "-P INPUT DROP", &reason, log)) ||
+        (0 != CheckTextFoundInCachedCommandOutput(readIpTables, "-P FORWARD DROP", &reason, log)) ||
+        (0 != CheckTextFoundInCachedCommandOutput(readIpTables, "-P OUTPUT DROP", &reason, log)))
     {
         FREE_MEMORY(reason);
         reason = FormatAllocateString("Ensure that all necessary communication channels have explicit "
@@ -1650,73 +1647,73 @@ static char* AuditEnsureDefaultDenyFirewallPolicyIsSet(void* log)
 static char* AuditEnsurePacketRedirectSendingIsDisabled(void* log)
 {
     char* reason = NULL;
-    RETURN_REASON_IF_NOT_ZERO(CheckTextFoundInCommandOutput(g_sysCtlA, "net.ipv4.conf.all.send_redirects = 0", &reason, log));
-    CheckTextFoundInCommandOutput(g_sysCtlA, "net.ipv4.conf.default.send_redirects = 0", &reason, log);
+    RETURN_REASON_IF_NOT_ZERO(CheckSysctlValue(NULL, "net.ipv4.conf.all.send_redirects", "0", &reason, log));
+    CheckSysctlValue(NULL, "net.ipv4.conf.default.send_redirects", "0", &reason, log);
     return reason;
 }
 
 static char* AuditEnsureIcmpRedirectsIsDisabled(void* log)
 {
     char* reason = NULL;
-    RETURN_REASON_IF_NOT_ZERO(CheckTextFoundInCommandOutput(g_sysCtlA, "net.ipv4.conf.default.accept_redirects = 0", &reason, log));
-    RETURN_REASON_IF_NOT_ZERO(CheckTextFoundInCommandOutput(g_sysCtlA, "net.ipv6.conf.default.accept_redirects = 0", &reason, log));
-    RETURN_REASON_IF_NOT_ZERO(CheckTextFoundInCommandOutput(g_sysCtlA, "net.ipv4.conf.all.accept_redirects = 0", &reason, log));
-    RETURN_REASON_IF_NOT_ZERO(CheckTextFoundInCommandOutput(g_sysCtlA, "net.ipv6.conf.all.accept_redirects = 0", &reason, log));
-    RETURN_REASON_IF_NOT_ZERO(CheckTextFoundInCommandOutput(g_sysCtlA, "net.ipv4.conf.default.secure_redirects = 0", &reason, log));
-    CheckTextFoundInCommandOutput(g_sysCtlA, "net.ipv4.conf.all.secure_redirects = 0", &reason, log);
+    RETURN_REASON_IF_NOT_ZERO(CheckSysctlValue(NULL, "net.ipv4.conf.default.accept_redirects", "0", &reason, log));
+    RETURN_REASON_IF_NOT_ZERO(CheckSysctlValue(NULL, "net.ipv6.conf.default.accept_redirects", "0", &reason, log));
+    RETURN_REASON_IF_NOT_ZERO(CheckSysctlValue(NULL, "net.ipv4.conf.all.accept_redirects", "0", &reason, log));
+    RETURN_REASON_IF_NOT_ZERO(CheckSysctlValue(NULL, "net.ipv6.conf.all.accept_redirects", "0", &reason, log));
+    RETURN_REASON_IF_NOT_ZERO(CheckSysctlValue(NULL, "net.ipv4.conf.default.secure_redirects", "0", &reason, log));
+    CheckSysctlValue(NULL, "net.ipv4.conf.all.secure_redirects", "0", &reason, log);
     return reason;
 }
 
 static char* AuditEnsureSourceRoutedPacketsIsDisabled(void* log)
 {
     char* reason = NULL;
-    RETURN_REASON_IF_NOT_ZERO(CheckLineFoundNotCommentedOut("/proc/sys/net/ipv4/conf/all/accept_source_route", '#', "0", &reason, log));
-    CheckLineFoundNotCommentedOut("/proc/sys/net/ipv6/conf/all/accept_source_route", '#', "0", &reason, log);
+    RETURN_REASON_IF_NOT_ZERO(CheckSysctlValue(NULL, "net.ipv4.conf.all.accept_source_route", "0", &reason, log));
+    CheckSysctlValue(NULL, "net.ipv6.conf.all.accept_source_route", "0", &reason, log);
     return reason;
 }
 
 static char* AuditEnsureAcceptingSourceRoutedPacketsIsDisabled(void* log)
 {
     char* reason = 0;
-    RETURN_REASON_IF_NOT_ZERO(CheckLineFoundNotCommentedOut("/proc/sys/net/ipv4/conf/all/accept_source_route", '#', "0", &reason, log));
-    CheckLineFoundNotCommentedOut("/proc/sys/net/ipv6/conf/default/accept_source_route", '#', "0", &reason, log);
+    RETURN_REASON_IF_NOT_ZERO(CheckSysctlValue(NULL, "net.ipv4.conf.all.accept_source_route", "0", &reason, log));
+    CheckSysctlValue(NULL, "net.ipv6.conf.default.accept_source_route", "0", &reason, log);
     return reason;
 }
 
 static char* AuditEnsureIgnoringBogusIcmpBroadcastResponses(void* log)
 {
     char* reason = NULL;
-    CheckLineFoundNotCommentedOut("/proc/sys/net/ipv4/icmp_ignore_bogus_error_responses", '#', "1", &reason, log);
+    CheckSysctlValue(NULL, "net.ipv4.icmp_ignore_bogus_error_responses", "1", &reason, log);
     return reason;
 }
 
 static char* AuditEnsureIgnoringIcmpEchoPingsToMulticast(void* log)
 {
     char* reason = NULL;
-    CheckLineFoundNotCommentedOut("/proc/sys/net/ipv4/icmp_echo_ignore_broadcasts", '#', "1", &reason, log);
+    CheckSysctlValue(NULL, "net.ipv4.icmp_echo_ignore_broadcasts", "1", &reason, log);
     return reason;
 }
 
 static char* AuditEnsureMartianPacketLoggingIsEnabled(void* log)
 {
     char* reason = NULL;
-    RETURN_REASON_IF_NOT_ZERO(CheckTextFoundInCommandOutput(g_sysCtlA, "net.ipv4.conf.all.log_martians = 1", &reason, log));
-    CheckTextFoundInCommandOutput(g_sysCtlA, "net.ipv4.conf.default.log_martians = 1", &reason, log);
+    RETURN_REASON_IF_NOT_ZERO(CheckSysctlValue(NULL, "net.ipv4.conf.all.log_martians", "1", &reason, log));
+    CheckSysctlValue(NULL, "net.ipv4.conf.default.log_martians", "1", &reason, log);
     return reason;
 }
 
 static char* AuditEnsureReversePathSourceValidationIsEnabled(void* log)
 {
     char* reason = NULL;
-    RETURN_REASON_IF_NOT_ZERO(CheckLineFoundNotCommentedOut("/proc/sys/net/ipv4/conf/all/rp_filter", '#', "2", &reason, log));
-    CheckLineFoundNotCommentedOut("/proc/sys/net/ipv4/conf/default/rp_filter", '#', "2", &reason, log);
+    RETURN_REASON_IF_NOT_ZERO(CheckSysctlValue(NULL, "net.ipv4.conf.all.rp_filter", "2", &reason, log));
+    CheckSysctlValue(NULL, "net.ipv4.conf.default.rp_filter", "2", &reason, log);
     return reason;
 }
 
 static char* AuditEnsureTcpSynCookiesAreEnabled(void* log)
 {
     char* reason = NULL;
-    CheckLineFoundNotCommentedOut("/proc/sys/net/ipv4/tcp_syncookies", '#', "1", &reason, log);
+    CheckSysctlValue(NULL, "net.ipv4.tcp_syncookies", "1", &reason, log);
     return reason;
 }
 
@@ -1741,8 +1738,8 @@ static char* AuditEnsureAllWirelessInterfacesAreDisabled(void* log)
 static char* AuditEnsureIpv6ProtocolIsEnabled(void* log)
 {
     char* reason = NULL;
-    RETURN_REASON_IF_NOT_ZERO(CheckTextFoundInCommandOutput(g_sysCtlA, "net.ipv6.conf.all.disable_ipv6 = 0", &reason, log));
-    CheckTextFoundInCommandOutput(g_sysCtlA, "net.ipv6.conf.default.disable_ipv6 = 0", &reason, log);
+    RETURN_REASON_IF_NOT_ZERO(CheckSysctlValue(NULL, "net.ipv6.conf.all.disable_ipv6", "0", &reason, log));
+    CheckSysctlValue(NULL, "net.ipv6.conf.default.disable_ipv6", "0", &reason, log);
     return reason;
 }
 
@@ -2015,8 +2012,8 @@ static char* AuditEnsureAllRsyslogLogFilesAreOwnedBySyslogUser(void* log)
 static char* AuditEnsureRsyslogNotAcceptingRemoteMessages(void* log)
 {
     char* reason = NULL;
-    RETURN_REASON_IF_NOT_ZERO(CheckLineNotFoundOrCommentedOut(g_etcRsyslogConf, '#', "$ModLoad imudp", &reason, log));
-    CheckLineNotFoundOrCommentedOut(g_etcRsyslogConf, '#', "$ModLoad imtcp", &reason, log);
+    const char* modules[] = {"$ModLoad imudp", "$ModLoad imtcp"};
+    CheckLinesNotFoundOrCommentedOut(g_etcRsyslogConf, '#', modules, ARRAY_SIZE(modules), &reason, log);
     return reason;
 }
 
@@ -3236,76 +3233,81 @@ static int RemediateEnsureDefaultDenyFirewallPolicyIsSet(char* value, void* log)
 
 static int RemediateEnsurePacketRedirectSendingIsDisabled(char* value, void* log)
 {
+    SYSCTL_SETTING settings[] = {
+        {"net.ipv4.conf.all.send_redirects", "0", 0},
+        {"net.ipv4.conf.default.send_redirects", "0", 0}};
     UNUSED(value);
-    return ((0 == ExecuteCommand(NULL, "sysctl -w net.ipv4.conf.all.send_redirects=0", true, false, 0, 0, NULL, NULL, log)) &&
-        (0 == ExecuteCommand(NULL, "sysctl -w net.ipv4.conf.default.send_redirects=0", true, false, 0, 0, NULL, NULL, log)) &&
-        (0 == ReplaceMarkedLinesInFile(g_etcSysctlConf, "net.ipv4.conf.all.send_redirects", "net.ipv4.conf.all.send_redirects = 0\n", '#', true, log)) &&
-        (0 == ReplaceMarkedLinesInFile(g_etcSysctlConf, "net.ipv4.conf.default.send_redirects", "net.ipv4.conf.default.send_redirects = 0\n", '#', true, log))) ? 0 : ENOENT;
+    return SetSysctlValues(NULL, settings, ARRAY_SIZE(settings), g_osConfigSysctlConf, log);
 }
 
 static int RemediateEnsureIcmpRedirectsIsDisabled(char* value, void* log)
 {
+    SYSCTL_SETTING settings[] = {
+        {"net.ipv4.conf.default.accept_redirects", "0", 0},
+        {"net.ipv6.conf.default.accept_redirects", "0", 0},
+        {"net.ipv4.conf.all.accept_redirects", "0", 0},
+        {"net.ipv6.conf.all.accept_redirects", "0", 0},
+        {"net.ipv4.conf.default.secure_redirects", "0", 0},
+        {"net.ipv4.conf.all.secure_redirects", "0", 0}};
     UNUSED(value);
-    return ((0 == ExecuteCommand(NULL, "sysctl -w net.ipv4.conf.default.accept_redirects=0", true, false, 0, 0, NULL, NULL, log)) &&
-        (0 == ExecuteCommand(NULL, "sysctl -w net.ipv6.conf.default.accept_redirects=0", true, false, 0, 0, NULL, NULL, log)) &&
-        (0 == ExecuteCommand(NULL, "sysctl -w net.ipv4.conf.all.accept_redirects=0", true, false, 0, 0, NULL, NULL, log)) &&
-        (0 == ExecuteCommand(NULL, "sysctl -w net.ipv6.conf.all.accept_redirects=0", true, false, 0, 0, NULL, NULL, log)) &&
-        (0 == ExecuteCommand(NULL, "sysctl -w net.ipv4.conf.default.secure_redirects=0", true, false, 0, 0, NULL, NULL, log)) &&
-        (0 == ExecuteCommand(NULL, "sysctl -w net.ipv4.conf.all.secure_redirects=0", true, false, 0, 0, NULL, NULL, log)) &&
-        (0 == ReplaceMarkedLinesInFile(g_etcSysctlConf, "net.ipv4.conf.default.accept_redirects", "net.ipv4.conf.default.accept_redirects = 0\n", '#', true, log)) &&
-        (0 == ReplaceMarkedLinesInFile(g_etcSysctlConf, "net.ipv6.conf.default.accept_redirects", "net.ipv6.conf.default.accept_redirects = 0\n", '#', true, log)) &&
-        (0 == ReplaceMarkedLinesInFile(g_etcSysctlConf, "net.ipv4.conf.all.accept_redirects", "net.ipv4.conf.all.accept_redirects = 0\n", '#', true, log)) &&
-        (0 == ReplaceMarkedLinesInFile(g_etcSysctlConf, "net.ipv6.conf.all.accept_redirects", "net.ipv6.conf.all.accept_redirects = 0\n", '#', true, log)) &&
-        (0 == ReplaceMarkedLinesInFile(g_etcSysctlConf, "net.ipv4.conf.default.secure_redirects", "net.ipv4.conf.default.secure_redirects = 0\n", true, '#', log)) &&
-        (0 == ReplaceMarkedLinesInFile(g_etcSysctlConf, "net.ipv4.conf.all.secure_redirects", "net.ipv4.conf.all.secure_redirects = 0\n", '#', true, log))) ? 0 : ENOENT;
+    return SetSysctlValues(NULL, settings, ARRAY_SIZE(settings), g_osConfigSysctlConf, log);
 }
 
 static int RemediateEnsureSourceRoutedPacketsIsDisabled(char* value, void* log)
 {
+    SYSCTL_SETTING settings[] = {
+        {"net.ipv4.conf.all.accept_source_route", "0", 0},
+        {"net.ipv6.conf.all.accept_source_route", "0", 0}};
     UNUSED(value);
-    return (SavePayloadToFile("/proc/sys/net/ipv4/conf/all/accept_source_route", "0", 1, log) &&
-        SavePayloadToFile("/proc/sys/net/ipv6/conf/all/accept_source_route", "0", 1, log)) ? 0 : ENOENT;
+    return SetSysctlValues(NULL, settings, ARRAY_SIZE(settings), g_osConfigSysctlConf, log);
 }
 
 static int RemediateEnsureAcceptingSourceRoutedPacketsIsDisabled(char* value, void* log)
 {
+    SYSCTL_SETTING settings[] = {
+        {"net.ipv4.conf.all.accept_source_route", "0", 0},
+        {"net.ipv6.conf.default.accept_source_route", "0", 0}};
     UNUSED(value);
-    return (SavePayloadToFile("/proc/sys/net/ipv4/conf/all/accept_source_route", "0", 1, log) &&
-        SavePayloadToFile("/proc/sys/net/ipv6/conf/default/accept_source_route", "0", 1, log)) ? 0 : ENOENT;
+    return SetSysctlValues(NULL, settings, ARRAY_SIZE(settings), g_osConfigSysctlConf, log);
 }
 
 static int RemediateEnsureIgnoringBogusIcmpBroadcastResponses(char* value, void* log)
 {
+    SYSCTL_SETTING settings[] = {{"net.ipv4.icmp_ignore_bogus_error_responses", "1", 0}};
     UNUSED(value);
-    return SavePayloadToFile("/proc/sys/net/ipv4/icmp_ignore_bogus_error_responses", "1", 1, log) ? 0 : ENOENT;
+    return SetSysctlValues(NULL, settings, ARRAY_SIZE(settings), g_osConfigSysctlConf, log);
 }
 
 static int RemediateEnsureIgnoringIcmpEchoPingsToMulticast(char* value, void* log)
 {
+    SYSCTL_SETTING settings[] = {{"net.ipv4.icmp_echo_ignore_broadcasts", "1", 0}};
     UNUSED(value);
-    return SavePayloadToFile("/proc/sys/net/ipv4/icmp_echo_ignore_broadcasts", "1", 1, log) ? 0 : ENOENT;
+    return SetSysctlValues(NULL, settings, ARRAY_SIZE(settings), g_osConfigSysctlConf, log);
 }
 
 static int RemediateEnsureMartianPacketLoggingIsEnabled(char* value, void* log)
 {
+    SYSCTL_SETTING settings[] = {
+        {"net.ipv4.conf.all.log_martians", "1", 0},
+        {"net.ipv4.conf.default.log_martians", "1", 0}};
     UNUSED(value);
-    return ((0 == ExecuteCommand(NULL, "sysctl -w net.ipv4.conf.all.log_martians=1", true, false, 0, 0, NULL, NULL, log)) &&
-        (0 == ExecuteCommand(NULL, "sysctl -w net.ipv4.conf.default.log_martians=1", true, false, 0, 0, NULL, NULL, log)) &&
-        (0 == ReplaceMarkedLinesInFile(g_etcSysctlConf, "net.ipv4.conf.all.log_martians", "net.ipv4.conf.all.log_martians = 1\n", '#', true, log)) &&
-        (0 == ReplaceMarkedLinesInFile(g_etcSysctlConf, "net.ipv4.conf.default.log_martians", "net.ipv4.conf.default.log_martians = 1\n", '#', true, log))) ? 0 : ENOENT;
+    return SetSysctlValues(NULL, settings, ARRAY_SIZE(settings), g_osConfigSysctlConf, log);
 }
 
 static int RemediateEnsureReversePathSourceValidationIsEnabled(char* value, void* log)
 {
+    SYSCTL_SETTING settings[] = {
+        {"net.ipv4.conf.all.rp_filter", "2", 0},
+        {"net.ipv4.conf.default.rp_filter", "2", 0}};
     UNUSED(value);
-    return (SavePayloadToFile("/proc/sys/net/ipv4/conf/all/rp_filter", "2", 1, log) &&
-        SavePayloadToFile("/proc/sys/net/ipv4/conf/default/rp_filter", "2", 1, log)) ? 0 : ENOENT;
+    return SetSysctlValues(NULL, settings, ARRAY_SIZE(settings), g_osConfigSysctlConf, log);
 }
 
 static int RemediateEnsureTcpSynCookiesAreEnabled(char* value, void* log)
 {
+    SYSCTL_SETTING settings[] = {{"net.ipv4.tcp_syncookies", "1", 0}};
     UNUSED(value);
-    return SavePayloadToFile("/proc/sys/net/ipv4/tcp_syncookies", "1", 1, log) ? 0 : ENOENT;
+    return SetSysctlValues(NULL, settings, ARRAY_SIZE(settings), g_osConfigSysctlConf, log);
 }
 
 static int RemediateEnsureSystemNotActingAsNetworkSniffer(char* value, void* log)
@@ -3323,11 +3325,11 @@ static int RemediateEnsureAllWirelessInterfacesAreDisabled(char* value, void* lo
 
 static int RemediateEnsureIpv6ProtocolIsEnabled(char* value, void* log)
 {
+    SYSCTL_SETTING settings[] = {
+        {"net.ipv6.conf.default.disable_ipv6", "0", 0},
+        {"net.ipv6.conf.all.disable_ipv6", "0", 0}};
     UNUSED(value);
-    return ((0 == ExecuteCommand(NULL, "sysctl -w net.ipv6.conf.default.disable_ipv6=0", true, false, 0, 0, NULL, NULL, log)) &&
-        (0 == ExecuteCommand(NULL, "sysctl -w net.ipv6.conf.all.disable_ipv6=0", true, false, 0, 0, NULL, NULL, log)) &&
-        (0 == ReplaceMarkedLinesInFile(g_etcSysctlConf, "net.ipv6.conf.default.disable_ipv6", "net.ipv6.conf.default.disable_ipv6 = 0\n", '#', true, log)) &&
-        (0 == ReplaceMarkedLinesInFile(g_etcSysctlConf, "net.ipv6.conf.all.disable_ipv6", "net.ipv6.conf.all.disable_ipv6 = 0\n", '#', true, log))) ? 0 : ENOENT;
+    return SetSysctlValues(NULL, settings, ARRAY_SIZE(settings), g_osConfigSysctlConf, log);
 }
 
 static int RemediateEnsureDccpIsDisabled(char* value, void* log)
@@ -5672,6 +5674,12 @@ int AsbMmiSet(const char* componentName, const char* objectName, const char* pay
         }
     }
     
+    // Command outputs cached by the audits may be stale after a remediation
+    if (0 == strncmp(objectName, "remediate", strlen("remediate")))
+    {
+        InvalidateCommandCache();
+    }
+
     OsConfigLogInfo(log, "AsbMmiSet(%s, %s, %.*s, %d) returning %d", componentName, objectName, payloadSizeBytes, payload, payloadSizeBytes, status);
 
     if (NULL != jsonValue)
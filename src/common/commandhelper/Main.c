@@ -0,0 +1,14 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include <unistd.h>
+#include <CommonUtils.h>
+
+// Spawned by StartCommandHelper with its end of the command socket as standard input
+int main(int argc, char* argv[])
+{
+    UNUSED(argc);
+    UNUSED(argv);
+
+    return RunCommandHelper(STDIN_FILENO);
+}
@@ -3,6 +3,14 @@
 
 #include "Internal.h"
 
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
 static bool g_commandLoggingEnabled = false;
 
 void SetCommandLogging(bool commandLogging)
@@ -15,12 +23,131 @@ bool IsCommandLoggingEnabled(void)
     return g_commandLoggingEnabled;
 }
 
+// Polling interval for the command output and completion
+#define COMMAND_POLL_MILLISECONDS 100
+
+// Size of the chunks read from the command output pipe
+#define COMMAND_READ_CHUNK 4096
+
+extern char** environ;
+
+typedef struct COMMAND_OUTPUT
+{
+    char* buffer;
+    size_t size;
+    size_t capacity;
+
+    // Maximum number of characters kept
+    size_t limit;
+
+    // Total number of bytes produced by the command, including the ones dropped over the limit
+    size_t total;
+
+    // Set when the command was spawned and exited on its own, so the status is its exit code and the output is complete
+    bool exited;
+
+    bool replaceEol;
+    bool forJson;
+
+    // When valid (running inside the command helper) the raw output is forwarded over this descriptor instead of being kept
+    int forwardDescriptor;
+
+    // When set the raw output is hashed as it arrives instead of being kept
+    SHA256_CONTEXT* hash;
+} COMMAND_OUTPUT;
+
+// Frames exchanged with the command helper process over its socket pair
+#define COMMAND_FRAME_RUN 1
+#define COMMAND_FRAME_CANCEL 2
+#define COMMAND_FRAME_OUTPUT 3
+#define COMMAND_FRAME_DONE 4
+
+typedef struct COMMAND_FRAME
+{
+    unsigned int type;
+
+    // RUN: timeout in seconds, DONE: command status
+    int value;
+
+    // RUN: command length, OUTPUT: output length, DONE: total output length
+    unsigned long long length;
+
+    // RUN: maximum number of output bytes to forward, DONE: 1 when the command exited on its own
+    unsigned long long limit;
+} COMMAND_FRAME;
+
+// Extra time given to the command helper to report a command it already timed out
+#define COMMAND_HELPER_GRACE_MILLISECONDS 5000
+
+// Number of command outputs kept by the command cache
+#define COMMAND_CACHE_SIZE 16
+
+typedef struct COMMAND_CACHE_ENTRY
+{
+    char* key;
+    char* textResult;
+    int status;
+    bool replaceEol;
+    bool forJson;
+    unsigned int maxTextResultBytes;
+    long long expiration;
+    long long lastUsed;
+} COMMAND_CACHE_ENTRY;
+
+static COMMAND_CACHE_ENTRY g_commandCache[COMMAND_CACHE_SIZE] = {{0}};
+static pthread_mutex_t g_commandCacheLock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long long g_commandCacheHits = 0;
+static unsigned long long g_commandCacheMisses = 0;
+
+// Process wide limit of commands run at the same time by ExecuteCommandBatch, across all batches
+#define MAX_BATCH_COMMANDS_RUNNING 8
+
+typedef struct COMMAND_BATCH
+{
+    const char** commands;
+    unsigned int numberOfCommands;
+    unsigned int next;
+    bool replaceEol;
+    bool forJson;
+    unsigned int maxTextResultBytes;
+    unsigned int timeoutSeconds;
+    int* statuses;
+    char** textResults;
+    void* log;
+    pthread_mutex_t lock;
+} COMMAND_BATCH;
+
+static pthread_mutex_t g_batchCommandsLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_batchCommandsCondition = PTHREAD_COND_INITIALIZER;
+static unsigned int g_batchCommandsRunning = 0;
+
+static pthread_mutex_t g_commandHelperLock = PTHREAD_MUTEX_INITIALIZER;
+static bool g_commandHelperEnabled = false;
+static pid_t g_commandHelperProcess = -1;
+static int g_commandHelperDescriptor = -1;
+static char* g_commandHelperPath = NULL;
+
+// Where the osconfig-commandhelper executable gets installed, unless SetCommandHelperPath says otherwise
+#ifndef COMMAND_HELPER_PATH
+#define COMMAND_HELPER_PATH "/usr/bin/osconfig-commandhelper"
+#endif
+
+static long long GetCommandTimeMilliseconds(void)
+{
+    struct timespec now = {0};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((long long)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
 static void KillProcess(pid_t processId)
 {
-    fflush(NULL);
     if (processId > 0)
     {
-        kill(processId, SIGKILL);
+        // The command runs in its own process group, kill the shell together with everything it started
+        if (0 != kill(-processId, SIGKILL))
+        {
+            kill(processId, SIGKILL);
+        }
     }
 }
 
@@ -41,204 +168,624 @@ static int NormalizeStatus(int status)
     return newStatus;
 }
 
-static int SystemCommand(void* context, const char* command, int timeoutSeconds, CommandCallback callback, void* log)
+static bool SendCommandBytes(int descriptor, const void* data, size_t length)
 {
-    const int callbackIntervalSeconds = 5; //seconds
-    const int defaultCommandTimeout = 60; //seconds
+    const char* next = (const char*)data;
+    ssize_t bytes = 0;
 
-    pid_t intermediateProcess = -1;
+    while (length > 0)
+    {
+        if (0 < (bytes = send(descriptor, next, length, MSG_NOSIGNAL)))
+        {
+            next += bytes;
+            length -= (size_t)bytes;
+        }
+        else if ((0 > bytes) && (EINTR == errno))
+        {
+            continue;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool ReceiveCommandBytes(int descriptor, void* data, size_t length)
+{
+    char* next = (char*)data;
+    ssize_t bytes = 0;
+
+    while (length > 0)
+    {
+        if (0 < (bytes = read(descriptor, next, length)))
+        {
+            next += bytes;
+            length -= (size_t)bytes;
+        }
+        else if ((0 > bytes) && (EINTR == errno))
+        {
+            continue;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool SendCommandFrame(int descriptor, unsigned int type, int value, unsigned long long length, unsigned long long limit, const char* payload)
+{
+    COMMAND_FRAME frame;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.type = type;
+    frame.value = value;
+    frame.length = length;
+    frame.limit = limit;
+
+    return SendCommandBytes(descriptor, &frame, sizeof(frame)) && ((NULL == payload) || SendCommandBytes(descriptor, payload, (size_t)length));
+}
+
+static void AppendCommandOutput(COMMAND_OUTPUT* output, const char* data, size_t length)
+{
+    size_t keep = length;
+    size_t capacity = 0;
+    char* buffer = NULL;
+    char next = 0;
+    size_t i = 0;
+
+    output->total += length;
+
+    if ((NULL != output->hash) && (output->forwardDescriptor < 0))
+    {
+        Sha256Update(output->hash, data, length);
+        return;
+    }
+
+    keep = (output->size >= output->limit) ? 0 : (((output->limit - output->size) < length) ? (output->limit - output->size) : length);
+
+    if (0 == keep)
+    {
+        return;
+    }
+
+    if (output->forwardDescriptor >= 0)
+    {
+        // Inside the command helper the raw bytes go to the caller, which sanitizes them as they arrive
+        SendCommandFrame(output->forwardDescriptor, COMMAND_FRAME_OUTPUT, 0, keep, 0, data);
+        output->size += keep;
+        return;
+    }
+
+    if ((output->size + keep + 1) > output->capacity)
+    {
+        capacity = (output->capacity > 0) ? output->capacity : COMMAND_READ_CHUNK;
+        while ((output->size + keep + 1) > capacity)
+        {
+            capacity *= 2;
+        }
+
+        if (NULL == (buffer = (char*)realloc(output->buffer, capacity)))
+        {
+            // Out of memory, keep the output collected so far
+            output->limit = output->size;
+            return;
+        }
+
+        output->buffer = buffer;
+        output->capacity = capacity;
+    }
+
+    for (i = 0; i < keep; i++)
+    {
+        next = data[i];
+
+        // Copy the data. Following characters are replaced with spaces:
+        // all special characters from 0x00 to 0x1F except 0x0A (LF) when replaceEol is false
+        // plus 0x22 (") and 0x5C (\) characters that break the JSON envelope when forJson is true
+        if ((output->replaceEol && (EOL == next)) || ((next >= 0) && (next < 0x20) && (EOL != next)) || (0x7F == next) || (output->forJson && (('"' == next) || ('\\' == next))))
+        {
+            output->buffer[output->size + i] = ' ';
+        }
+        else
+        {
+            output->buffer[output->size + i] = next;
+        }
+    }
+
+    output->size += keep;
+    output->buffer[output->size] = 0;
+}
+
+static ssize_t ReadCommandOutput(int descriptor, COMMAND_OUTPUT* output, bool* endOfOutput)
+{
+    char chunk[COMMAND_READ_CHUNK] = {0};
+    ssize_t bytes = 0;
+
+    if (0 < (bytes = read(descriptor, chunk, sizeof(chunk))))
+    {
+        AppendCommandOutput(output, chunk, (size_t)bytes);
+    }
+    else if ((0 == bytes) || ((EINTR != errno) && (EAGAIN != errno)))
+    {
+        *endOfOutput = true;
+    }
+
+    return bytes;
+}
+
+static int SpawnCommand(void* context, const char* command, int timeout, CommandCallback callback, COMMAND_OUTPUT* output, void* log)
+{
+    const int callbackIntervalSeconds = 1; //seconds
+
+    char* arguments[] = { "sh", "-c", (char*)command, NULL };
+    posix_spawn_file_actions_t fileActions;
+    posix_spawnattr_t attributes;
+    sigset_t signalMask;
+    struct pollfd pollDescriptor = {0};
     pid_t workerProcess = -1;
-    pid_t timerProcess = -1;
-    pid_t childProcess = -1;
+    int pipeDescriptors[2] = { -1, -1 };
     int status = -1;
-    int intermediateStatus = -1;
-    int totalWaitSeconds = 0;
-    int timeout = (timeoutSeconds > 0) ? timeoutSeconds : defaultCommandTimeout;
-    
+    int waitStatus = 0;
+    long long deadline = 0;
+    long long nextCallback = 0;
+    long long now = 0;
+    bool endOfOutput = false;
+    bool exited = false;
+
     bool mainProcessThread = (bool)(getpid() == gettid());
 
-    fflush(NULL);
+    if (IsCommandLoggingEnabled())
+    {
+        OsConfigLogInfo(log, "SpawnCommand: executing command '%s' with timeout of %d seconds and%scancelation on %s thread",
+            command, timeout, (NULL == callback) ? " no " : " ", mainProcessThread ? "main process" : "worker");
+    }
 
-    if ((timeoutSeconds > 0) || (NULL != callback))
+    // The command writes both stdout and stderr into a pipe that we read while waiting for it, with nothing staged in temporary files
+    if (0 != pipe2(pipeDescriptors, O_CLOEXEC))
     {
+        status = errno ? errno : EPIPE;
         if (IsCommandLoggingEnabled())
         {
-            OsConfigLogInfo(log, "SystemCommand: executing command '%s' with timeout of %d seconds and%scancelation on %s thread", 
-                command, timeout, (NULL == callback) ? " no " : " ", mainProcessThread ? "main process" : "worker");
+            OsConfigLogError(log, "SpawnCommand: failed to create the output pipe (%d)", status);
         }
+        return status;
+    }
 
-        // Fork an intermediate process to act as the parent for two more forked processes:
-        // one to actually execute the system command and the other to sleep and act as a timer.
-        // Whichever of these two children processes finishes first, that causes the other to be killed.
-        // The intermediate process exists as a parent for these (instead of the current process being
-        // the parent) to avoid collision with any other children processes.
+    posix_spawn_file_actions_init(&fileActions);
+    posix_spawn_file_actions_addopen(&fileActions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&fileActions, pipeDescriptors[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&fileActions, pipeDescriptors[1], STDERR_FILENO);
 
-        if (0 == (intermediateProcess = fork()))
+    // Run in a new process group so a timeout or cancelation can kill the whole command, with no signals blocked
+    sigemptyset(&signalMask);
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+    posix_spawnattr_setpgroup(&attributes, 0);
+    posix_spawnattr_setsigmask(&attributes, &signalMask);
+
+    if (0 != (status = posix_spawn(&workerProcess, "/bin/sh", &fileActions, &attributes, arguments, environ)))
+    {
+        if (IsCommandLoggingEnabled())
         {
-            // Intermediate process
+            OsConfigLogError(log, "SpawnCommand: failed to spawn process to execute command (%d)", status);
+        }
+        workerProcess = -1;
+    }
 
-            if (0 == (workerProcess = fork()))
-            {
-                // Worker process
-                status = execl("/bin/sh", "sh", "-c", command, (char*)NULL);
-                _exit(status);
-            }
-            else if (workerProcess < 0)
-            {
-                // Intermediate process
-                if (IsCommandLoggingEnabled())
-                {
-                    OsConfigLogError(log, "Failed forking process to execute command");
-                }
-                status = -1;
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&fileActions);
 
-                // Kill the timer process if created and wait on it before exiting otherwise timer becomes a zombie process
-                if (timerProcess > 0)
-                {
-                    KillProcess(timerProcess);
-                    waitpid(timerProcess, &intermediateStatus, 0);
-                }
-                _exit(status);
-            }
+    // Only the command holds the write end of the pipe now, so we see the end of the output when it is done
+    close(pipeDescriptors[1]);
 
-            if (0 == (timerProcess = fork()))
+    if (workerProcess > 0)
+    {
+        now = GetCommandTimeMilliseconds();
+        deadline = (timeout > 0) ? (now + ((long long)timeout * 1000)) : 0;
+        nextCallback = now + ((long long)callbackIntervalSeconds * 1000);
+
+        pollDescriptor.fd = pipeDescriptors[0];
+        pollDescriptor.events = POLLIN;
+
+        while (false == exited)
+        {
+            if (false == endOfOutput)
             {
-                // Timer process
-                status = ETIME;
-                if (NULL == callback)
+                if ((0 < poll(&pollDescriptor, 1, COMMAND_POLL_MILLISECONDS)) && (0 != (pollDescriptor.revents & (POLLIN | POLLHUP | POLLERR))))
                 {
-                    sleep(timeout);
+                    ReadCommandOutput(pipeDescriptors[0], output, &endOfOutput);
                 }
-                else
-                {
-                    while (totalWaitSeconds < timeout)
-                    {
-                        // If the callback returns non zero, cancel the command
-                        if (0 != callback(context))
-                        {
-                            status = ECANCELED;
-                            break;
-                        }
-                        sleep(callbackIntervalSeconds);
-                        totalWaitSeconds += callbackIntervalSeconds;
-                    }
-                }
-                _exit(status);
             }
-            else if (timerProcess < 0)
+            else
             {
-                // Intermediate process
-                if (IsCommandLoggingEnabled())
-                {
-                    OsConfigLogError(log, "Failed forking timer process");
-                }
-                status = -1;
-
-                // Kill the worker process if created and wait on it before exiting otherwise worker becomes a zombie process
-                if (workerProcess > 0)
-                {
-                    KillProcess(workerProcess);
-                    waitpid(workerProcess, &intermediateStatus, 0);
-                }
-                _exit(status);
+                SleepMilliseconds(COMMAND_POLL_MILLISECONDS / 10);
             }
 
-            // Wait on the child process (worker or timer) that finishes first
-            childProcess = waitpid(0, &status, 0);
-            status = NormalizeStatus(status);
-            if (childProcess == workerProcess)
+            if (workerProcess == waitpid(workerProcess, &waitStatus, WNOHANG))
             {
-                if (IsCommandLoggingEnabled())
+                status = waitStatus;
+                exited = true;
+            }
+            else if ((deadline > 0) && ((now = GetCommandTimeMilliseconds()) >= deadline))
+            {
+                status = ETIME;
+            }
+            else if ((NULL != callback) && ((now = GetCommandTimeMilliseconds()) >= nextCallback))
+            {
+                // If the callback returns non zero, cancel the command
+                if (0 != callback(context))
                 {
-                    OsConfigLogInfo(log, "Command execution complete with status %d", status);
+                    status = ECANCELED;
                 }
-                KillProcess(timerProcess);
+                nextCallback = now + ((long long)callbackIntervalSeconds * 1000);
             }
-            else
+
+            if ((ETIME == status) || (ECANCELED == status))
             {
-                // Timer process is done, kill the timed out worker process
                 if (IsCommandLoggingEnabled())
                 {
                     OsConfigLogError(log, "Command timed out or it was canceled, command process killed (%d)", status);
                 }
                 KillProcess(workerProcess);
+                waitpid(workerProcess, &waitStatus, 0);
+                exited = true;
             }
+        }
 
-            // Wait on the remaining child (either worker or timer) and exit (the intermediate process)
-            waitpid(0, &intermediateStatus, 0);
-            _exit(status);
+        // Collect what the command wrote right before exiting, without waiting on anything it may have left running in background
+        if ((false == endOfOutput) && (ETIME != status) && (ECANCELED != status) && (0 == fcntl(pipeDescriptors[0], F_SETFL, O_NONBLOCK)))
+        {
+            while ((false == endOfOutput) && (0 < ReadCommandOutput(pipeDescriptors[0], output, &endOfOutput)))
+            {
+                // Keep reading until nothing is left
+            }
         }
-        else if (intermediateProcess > 0)
+
+        output->exited = (ETIME != status) && (ECANCELED != status) && WIFEXITED(status);
+        status = NormalizeStatus(status);
+
+        if (IsCommandLoggingEnabled())
         {
-            // Wait on the intermediate process to finish
-            waitpid(intermediateProcess, &status, 0);
+            OsConfigLogInfo(log, "Command execution complete with status %d", status);
         }
-        else
+    }
+
+    close(pipeDescriptors[0]);
+
+    return status;
+}
+
+static int CheckCommandHelperCancelation(void* context)
+{
+    int descriptor = *(int*)context;
+    struct pollfd pollDescriptor = {0};
+    COMMAND_FRAME frame;
+
+    pollDescriptor.fd = descriptor;
+    pollDescriptor.events = POLLIN;
+
+    // Cancel the command when the caller asks for it or when the caller went away
+    while (0 < poll(&pollDescriptor, 1, 0))
+    {
+        if ((false == ReceiveCommandBytes(descriptor, &frame, sizeof(frame))) || (COMMAND_FRAME_CANCEL == frame.type))
         {
-            status = -1;
-            if (IsCommandLoggingEnabled())
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void CloseInheritedDescriptors(int keepDescriptor)
+{
+    DIR* directory = NULL;
+    struct dirent* entry = NULL;
+    int descriptor = -1;
+
+    if (NULL != (directory = opendir("/proc/self/fd")))
+    {
+        while (NULL != (entry = readdir(directory)))
+        {
+            descriptor = atoi(entry->d_name);
+            if ((descriptor > STDERR_FILENO) && (descriptor != keepDescriptor) && (descriptor != dirfd(directory)))
             {
-                OsConfigLogError(log, "Failed forking intermediate process");
+                close(descriptor);
             }
         }
+        closedir(directory);
+    }
+}
+
+int RunCommandHelper(int descriptor)
+{
+    COMMAND_FRAME frame;
+    COMMAND_OUTPUT output;
+    char* command = NULL;
+    int status = 0;
+
+    // Keep nothing else the caller may have leaked to us besides the socket and the standard descriptors
+    CloseInheritedDescriptors(descriptor);
+
+    // Serve commands until the caller closes its end of the socket or goes away
+    while (ReceiveCommandBytes(descriptor, &frame, sizeof(frame)))
+    {
+        if (COMMAND_FRAME_RUN != frame.type)
+        {
+            // A cancelation that arrived after its command was already done
+            continue;
+        }
+
+        if ((NULL == (command = (char*)malloc((size_t)frame.length + 1))) || (false == ReceiveCommandBytes(descriptor, command, (size_t)frame.length)))
+        {
+            break;
+        }
+        command[frame.length] = 0;
+
+        memset(&output, 0, sizeof(output));
+        output.limit = (size_t)frame.limit;
+        output.forwardDescriptor = descriptor;
+
+        status = SpawnCommand(&descriptor, command, frame.value, CheckCommandHelperCancelation, &output, NULL);
+        FREE_MEMORY(command);
+
+        if (false == SendCommandFrame(descriptor, COMMAND_FRAME_DONE, status, output.total, output.exited ? 1 : 0, NULL))
+        {
+            break;
+        }
+    }
+
+    FREE_MEMORY(command);
+
+    return 0;
+}
+
+void SetCommandHelperPath(const char* helperPath)
+{
+    pthread_mutex_lock(&g_commandHelperLock);
+
+    FREE_MEMORY(g_commandHelperPath);
+    if (NULL != helperPath)
+    {
+        g_commandHelperPath = DuplicateString(helperPath);
+    }
+
+    pthread_mutex_unlock(&g_commandHelperLock);
+}
+
+static int LaunchCommandHelper(void* log)
+{
+    const char* helperPath = (NULL != g_commandHelperPath) ? g_commandHelperPath : COMMAND_HELPER_PATH;
+    char* arguments[] = { (char*)helperPath, NULL };
+    int socketDescriptors[2] = { -1, -1 };
+    posix_spawn_file_actions_t fileActions;
+    posix_spawnattr_t attributes;
+    sigset_t signalMask;
+    sigset_t defaultSignals;
+    pid_t helperProcess = -1;
+    int status = 0;
+
+    if (0 != access(helperPath, X_OK))
+    {
+        status = errno ? errno : ENOENT;
+        OsConfigLogError(log, "LaunchCommandHelper: cannot execute the command helper '%s' (%d)", helperPath, status);
+        return status;
+    }
+
+    if (0 != socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, socketDescriptors))
+    {
+        status = errno ? errno : ENOTCONN;
+        OsConfigLogError(log, "LaunchCommandHelper: failed to create the command helper socket pair (%d)", status);
+        return status;
+    }
+
+    // The helper is a separate executable that gets its end of the socket as standard input, with default signal handling and nothing blocked.
+    // Like the commands it is spawned and not forked, which is safe from any thread of this process
+    posix_spawn_file_actions_init(&fileActions);
+    posix_spawn_file_actions_adddup2(&fileActions, socketDescriptors[1], STDIN_FILENO);
+
+    sigemptyset(&signalMask);
+    sigfillset(&defaultSignals);
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+    posix_spawnattr_setsigmask(&attributes, &signalMask);
+    posix_spawnattr_setsigdefault(&attributes, &defaultSignals);
+
+    if (0 != (status = posix_spawn(&helperProcess, helperPath, &fileActions, &attributes, arguments, environ)))
+    {
+        OsConfigLogError(log, "LaunchCommandHelper: failed to spawn the command helper '%s' (%d)", helperPath, status);
+        helperProcess = -1;
+    }
+
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&fileActions);
+
+    close(socketDescriptors[1]);
+
+    if (0 != status)
+    {
+        close(socketDescriptors[0]);
     }
     else
     {
-        if (IsCommandLoggingEnabled())
+        g_commandHelperProcess = helperProcess;
+        g_commandHelperDescriptor = socketDescriptors[0];
+        OsConfigLogInfo(log, "LaunchCommandHelper: command helper process %d started", (int)helperProcess);
+    }
+
+    return status;
+}
+
+static void TerminateCommandHelper(void)
+{
+    if (g_commandHelperDescriptor >= 0)
+    {
+        close(g_commandHelperDescriptor);
+        g_commandHelperDescriptor = -1;
+    }
+
+    if (g_commandHelperProcess > 0)
+    {
+        kill(g_commandHelperProcess, SIGKILL);
+        waitpid(g_commandHelperProcess, NULL, 0);
+        g_commandHelperProcess = -1;
+    }
+}
+
+int StartCommandHelper(void* log)
+{
+    int status = 0;
+
+    pthread_mutex_lock(&g_commandHelperLock);
+
+    if (g_commandHelperProcess <= 0)
+    {
+        status = LaunchCommandHelper(log);
+    }
+    g_commandHelperEnabled = (0 == status);
+
+    pthread_mutex_unlock(&g_commandHelperLock);
+
+    return status;
+}
+
+void StopCommandHelper(void* log)
+{
+    pthread_mutex_lock(&g_commandHelperLock);
+
+    if (g_commandHelperEnabled)
+    {
+        g_commandHelperEnabled = false;
+        TerminateCommandHelper();
+        OsConfigLogInfo(log, "StopCommandHelper: command helper process stopped");
+    }
+
+    pthread_mutex_unlock(&g_commandHelperLock);
+}
+
+bool IsCommandHelperActive(void)
+{
+    return g_commandHelperEnabled;
+}
+
+static bool RunCommandInHelper(void* context, const char* command, int timeout, CommandCallback callback, COMMAND_OUTPUT* output, int* status, void* log)
+{
+    const int callbackIntervalSeconds = 1; //seconds
+
+    char chunk[COMMAND_READ_CHUNK] = {0};
+    struct pollfd pollDescriptor = {0};
+    COMMAND_FRAME frame;
+    long long deadline = 0;
+    long long nextCallback = 0;
+    long long now = 0;
+    bool canceled = false;
+    bool done = false;
+
+    // Commands run on concurrent threads while the helper is busy fall back to being spawned from this process
+    if ((false == g_commandHelperEnabled) || (0 != pthread_mutex_trylock(&g_commandHelperLock)))
+    {
+        return false;
+    }
+
+    // Restart the helper if it went away
+    if ((false == g_commandHelperEnabled) || ((g_commandHelperProcess <= 0) && (0 != LaunchCommandHelper(log))) ||
+        (false == SendCommandFrame(g_commandHelperDescriptor, COMMAND_FRAME_RUN, timeout, strlen(command), output->limit, command)))
+    {
+        TerminateCommandHelper();
+        pthread_mutex_unlock(&g_commandHelperLock);
+        return false;
+    }
+
+    if (IsCommandLoggingEnabled())
+    {
+        OsConfigLogInfo(log, "RunCommandInHelper: executing command '%s' in helper process %d with timeout of %d seconds and%scancelation",
+            command, (int)g_commandHelperProcess, timeout, (NULL == callback) ? " no " : " ");
+    }
+
+    now = GetCommandTimeMilliseconds();
+    deadline = (timeout > 0) ? (now + ((long long)timeout * 1000) + COMMAND_HELPER_GRACE_MILLISECONDS) : 0;
+    nextCallback = now + ((long long)callbackIntervalSeconds * 1000);
+
+    pollDescriptor.fd = g_commandHelperDescriptor;
+    pollDescriptor.events = POLLIN;
+
+    while (false == done)
+    {
+        if ((0 < poll(&pollDescriptor, 1, COMMAND_POLL_MILLISECONDS)) && (0 != (pollDescriptor.revents & (POLLIN | POLLHUP | POLLERR))))
         {
-            OsConfigLogInfo(log, "SystemCommand: executing command '%s' without timeout or cancelation on %s thread", 
-                command, mainProcessThread ? "main process" : "worker");
+            if ((false == ReceiveCommandBytes(g_commandHelperDescriptor, &frame, sizeof(frame))) ||
+                ((COMMAND_FRAME_OUTPUT == frame.type) && ((frame.length > sizeof(chunk)) || (false == ReceiveCommandBytes(g_commandHelperDescriptor, chunk, (size_t)frame.length)))))
+            {
+                OsConfigLogError(log, "RunCommandInHelper: command helper process %d went away while executing '%s'", (int)g_commandHelperProcess, command);
+                TerminateCommandHelper();
+                *status = EPIPE;
+                done = true;
+            }
+            else if (COMMAND_FRAME_OUTPUT == frame.type)
+            {
+                AppendCommandOutput(output, chunk, (size_t)frame.length);
+            }
+            else if (COMMAND_FRAME_DONE == frame.type)
+            {
+                *status = frame.value;
+                output->total = (size_t)frame.length;
+                output->exited = (0 != frame.limit);
+                done = true;
+            }
         }
-        if (0 == (workerProcess = fork()))
+
+        now = GetCommandTimeMilliseconds();
+
+        if (done)
         {
-            // Worker process
-            status = execl("/bin/sh", "sh", "-c", command, (char*)NULL);
-            _exit(status);
+            break;
         }
-        else if (workerProcess > 0)
+        else if ((deadline > 0) && (now >= deadline))
         {
-            // Wait on the worker process to terminate
-            waitpid(workerProcess, &status, 0);
+            // The helper did not report the command back in time, replace it
+            OsConfigLogError(log, "RunCommandInHelper: command helper process %d is not responding, restarting it", (int)g_commandHelperProcess);
+            TerminateCommandHelper();
+            *status = ETIME;
+            done = true;
         }
-        else
+        else if ((NULL != callback) && (false == canceled) && (now >= nextCallback))
         {
-            // If our fork fails, try system(), if that also fails then the call fails
-            if (IsCommandLoggingEnabled())
+            // If the callback returns non zero, ask the helper to cancel the command
+            if (0 != callback(context))
             {
-                OsConfigLogError(log, "Failed forking process to execute command, attempting system");
+                canceled = SendCommandFrame(g_commandHelperDescriptor, COMMAND_FRAME_CANCEL, 0, 0, 0, NULL);
             }
-            status = system(command);
+            nextCallback = now + ((long long)callbackIntervalSeconds * 1000);
         }
     }
 
-    status = NormalizeStatus(status);
     if (IsCommandLoggingEnabled())
     {
-        OsConfigLogInfo(log, "SystemCommand: command '%s' completed with %d", command, status);
+        OsConfigLogInfo(log, "Command execution complete with status %d", *status);
     }
-    return status;
-}
 
-#define MAX_COMMAND_RESULT_FILE_NAME 100
+    pthread_mutex_unlock(&g_commandHelperLock);
 
-int ExecuteCommand(void* context, const char* command, bool replaceEol, bool forJson, unsigned int maxTextResultBytes, unsigned int timeoutSeconds, char** textResult, CommandCallback callback, void* log)
+    return true;
+}
+
+// Runs the command with the requested timeout, its output going to the specified collector. Error ETIME (62) means the command timed out.
+// The collector tells whether the status is the exit code of the command or an error that kept the command from running to completion
+static int RunCommand(void* context, const char* command, unsigned int timeoutSeconds, CommandCallback callback, COMMAND_OUTPUT* output, void* log)
 {
-    const char commandTextResultFileTemplate[] = "/tmp/~OSConfig.TextResult%u";
-    const char commandSeparator[] = " > ";
-    const char commandTerminator[] = " 2>&1";
-    
-    int status = -1;
-    FILE* resultsFile = NULL;
-    int fileSize = 0;
-    int next = 0;
-    int i = 0;
-    char* commandLine = NULL;
+    const int defaultCommandTimeout = 60; //seconds
+
+    int timeout = (timeoutSeconds > 0) ? (int)timeoutSeconds : ((NULL != callback) ? defaultCommandTimeout : 0);
     size_t commandLineLength = 0;
     size_t maximumCommandLine = 0;
-    char commandTextResultFile[MAX_COMMAND_RESULT_FILE_NAME] = {0};
-    bool wrappedCommand = false;
+    int status = -1;
 
-    if ((NULL == command) || (0 == system(NULL)))
+    if ((NULL == command) || (0 != access("/bin/sh", X_OK)))
     {
         if (IsCommandLoggingEnabled())
         {
@@ -247,14 +794,7 @@ int ExecuteCommand(void* context, const char* command, bool replaceEol, bool for
         return -1;
     }
 
-    commandLineLength = strlen(command);
-    wrappedCommand = (('(' == command[0]) || (')' == command[commandLineLength]));
-
-    // Append a random number to the results file to prevent parallel commands overwriting each other results
-    snprintf(commandTextResultFile, sizeof(commandTextResultFile), commandTextResultFileTemplate, rand());
-
-    commandLineLength += strlen(commandSeparator) + strlen(commandTextResultFile) + strlen(commandTerminator) + (wrappedCommand ? 0 : 2) + 1;
-
+    commandLineLength = strlen(command) + 1;
     maximumCommandLine = (size_t)sysconf(_SC_ARG_MAX);
     if (commandLineLength > maximumCommandLine)
     {
@@ -265,94 +805,332 @@ int ExecuteCommand(void* context, const char* command, bool replaceEol, bool for
         return E2BIG;
     }
 
-    commandLine = (char*)malloc(commandLineLength);
-    if (NULL == commandLine)
+    // When the command helper is active it spawns the command for us
+    if (false == RunCommandInHelper(context, command, timeout, callback, output, &status, log))
     {
-        if (IsCommandLoggingEnabled())
+        status = SpawnCommand(context, command, timeout, callback, output, log);
+    }
+
+    return status;
+}
+
+int ExecuteCommand(void* context, const char* command, bool replaceEol, bool forJson, unsigned int maxTextResultBytes, unsigned int timeoutSeconds, char** textResult, CommandCallback callback, void* log)
+{
+    COMMAND_OUTPUT output = {0};
+    int status = -1;
+
+    if (NULL != textResult)
+    {
+        *textResult = NULL;
+    }
+
+    // Truncate to desired maximum, if any, leaving room for the null terminator. Without a text result the output is only drained
+    output.limit = (NULL == textResult) ? 0 : ((maxTextResultBytes > 0) ? (maxTextResultBytes - 1) : SIZE_MAX);
+    output.replaceEol = replaceEol;
+    output.forJson = forJson;
+    output.forwardDescriptor = -1;
+
+    status = RunCommand(context, command, timeoutSeconds, callback, &output, log);
+
+    // Return the text result from the output of the command, if any, whether command succeeded or failed
+    if ((NULL != textResult) && (output.total > 0))
+    {
+        if (NULL == output.buffer)
         {
-            OsConfigLogError(log, "Cannot run command '%s', cannot allocate %u bytes for command, out of memory", command, (unsigned)commandLineLength);
+            output.buffer = DuplicateString("");
         }
-        return ENOMEM;
+        *textResult = output.buffer;
+        output.buffer = NULL;
     }
 
-    snprintf(commandLine, commandLineLength, wrappedCommand ? "%s%s%s%s" : "(%s)%s%s%s", command, commandSeparator, commandTextResultFile, commandTerminator);
- 
-    // Execute the command with the requested timeout: error ETIME (62) means the command timed out
-    status = SystemCommand(context, commandLine, timeoutSeconds, callback, log);
+    FREE_MEMORY(output.buffer);
 
-    free(commandLine);
+    if (IsCommandLoggingEnabled())
+    {
+        OsConfigLogInfo(log, "Context: '%p'", context);
+        OsConfigLogInfo(log, "Command: '%s'", command);
+        OsConfigLogInfo(log, "Status: %d (errno: %d)", status, errno);
+        OsConfigLogInfo(log, "Text result: '%s'", (NULL != textResult && NULL != *textResult) ? (*textResult) : "");
+    }
+
+    return status;
+}
+
+static void* RunCommandBatchWorker(void* context)
+{
+    COMMAND_BATCH* batch = (COMMAND_BATCH*)context;
+    unsigned int index = 0;
+
+    while (true)
+    {
+        pthread_mutex_lock(&batch->lock);
+        index = batch->next;
+        batch->next += 1;
+        pthread_mutex_unlock(&batch->lock);
+
+        if (index >= batch->numberOfCommands)
+        {
+            break;
+        }
+
+        // Wait for room in the process wide budget of running commands
+        pthread_mutex_lock(&g_batchCommandsLock);
+        while (g_batchCommandsRunning >= MAX_BATCH_COMMANDS_RUNNING)
+        {
+            pthread_cond_wait(&g_batchCommandsCondition, &g_batchCommandsLock);
+        }
+        g_batchCommandsRunning += 1;
+        pthread_mutex_unlock(&g_batchCommandsLock);
+
+        batch->statuses[index] = ExecuteCommand(NULL, batch->commands[index], batch->replaceEol, batch->forJson, batch->maxTextResultBytes,
+            batch->timeoutSeconds, (NULL != batch->textResults) ? &batch->textResults[index] : NULL, NULL, batch->log);
+
+        pthread_mutex_lock(&g_batchCommandsLock);
+        g_batchCommandsRunning -= 1;
+        pthread_cond_signal(&g_batchCommandsCondition);
+        pthread_mutex_unlock(&g_batchCommandsLock);
+    }
+
+    return NULL;
+}
+
+int ExecuteCommandBatch(const char** commands, unsigned int numberOfCommands, bool replaceEol, bool forJson, unsigned int maxTextResultBytes, unsigned int timeoutSeconds,
+    unsigned int maxParallelCommands, int* statuses, char** textResults, void* log)
+{
+    COMMAND_BATCH batch;
+    pthread_t* workers = NULL;
+    unsigned int numberOfWorkers = 0;
+    unsigned int started = 0;
+    unsigned int i = 0;
+
+    if ((NULL == commands) || (NULL == statuses) || (0 == numberOfCommands))
+    {
+        OsConfigLogError(log, "ExecuteCommandBatch called with invalid arguments");
+        return EINVAL;
+    }
+
+    for (i = 0; i < numberOfCommands; i++)
+    {
+        statuses[i] = -1;
+        if (NULL != textResults)
+        {
+            textResults[i] = NULL;
+        }
+    }
+
+    memset(&batch, 0, sizeof(batch));
+    batch.commands = commands;
+    batch.numberOfCommands = numberOfCommands;
+    batch.replaceEol = replaceEol;
+    batch.forJson = forJson;
+    batch.maxTextResultBytes = maxTextResultBytes;
+    batch.timeoutSeconds = timeoutSeconds;
+    batch.statuses = statuses;
+    batch.textResults = textResults;
+    batch.log = log;
+    pthread_mutex_init(&batch.lock, NULL);
+
+    // The calling thread is one of the workers
+    numberOfWorkers = ((maxParallelCommands > 0) && (maxParallelCommands < numberOfCommands)) ? maxParallelCommands : numberOfCommands;
+    numberOfWorkers = (numberOfWorkers < MAX_BATCH_COMMANDS_RUNNING) ? numberOfWorkers : MAX_BATCH_COMMANDS_RUNNING;
+
+    if ((numberOfWorkers > 1) && (NULL != (workers = (pthread_t*)malloc(sizeof(pthread_t) * (numberOfWorkers - 1)))))
+    {
+        for (started = 0; started < (numberOfWorkers - 1); started++)
+        {
+            if (0 != pthread_create(&workers[started], NULL, RunCommandBatchWorker, &batch))
+            {
+                // Run with the workers we have
+                break;
+            }
+        }
+    }
+
+    if (IsCommandLoggingEnabled())
+    {
+        OsConfigLogInfo(log, "ExecuteCommandBatch: executing %u commands on %u threads", numberOfCommands, started + 1);
+    }
+
+    RunCommandBatchWorker(&batch);
+
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+
+    FREE_MEMORY(workers);
+    pthread_mutex_destroy(&batch.lock);
+
+    return 0;
+}
+
+static void ClearCommandCacheEntry(COMMAND_CACHE_ENTRY* entry)
+{
+    FREE_MEMORY(entry->key);
+    FREE_MEMORY(entry->textResult);
+    memset(entry, 0, sizeof(COMMAND_CACHE_ENTRY));
+}
+
+// An entry serves only the runs with the same key and the same flags, which shape the text result
+static bool IsCommandCacheEntryFor(const COMMAND_CACHE_ENTRY* entry, const char* key, bool replaceEol, bool forJson, unsigned int maxTextResultBytes)
+{
+    return (NULL != entry->key) && (0 == strcmp(entry->key, key)) && (entry->replaceEol == replaceEol) && (entry->forJson == forJson) && (entry->maxTextResultBytes == maxTextResultBytes);
+}
+
+int ExecuteCachedCommand(const char* cacheKey, const char* command, bool replaceEol, bool forJson, unsigned int maxTextResultBytes, unsigned int timeoutSeconds, unsigned int ttlSeconds, char** textResult, void* log)
+{
+    const char* key = (NULL != cacheKey) ? cacheKey : command;
+    COMMAND_CACHE_ENTRY* entry = NULL;
+    char* result = NULL;
+    long long now = GetCommandTimeMilliseconds();
+    bool hit = false;
+    int status = -1;
+    int i = 0;
 
-    // Read the text result from the output of the command, if any, whether command succeeded or failed
     if (NULL != textResult)
     {
         *textResult = NULL;
-        resultsFile = fopen(commandTextResultFile, "r");
-        if (resultsFile)
+    }
+
+    if (NULL == key)
+    {
+        return ExecuteCommand(NULL, command, replaceEol, forJson, maxTextResultBytes, timeoutSeconds, textResult, NULL, log);
+    }
+
+    pthread_mutex_lock(&g_commandCacheLock);
+
+    for (i = 0; i < COMMAND_CACHE_SIZE; i++)
+    {
+        entry = &g_commandCache[i];
+        if (IsCommandCacheEntryFor(entry, key, replaceEol, forJson, maxTextResultBytes))
+        {
+            if (entry->expiration > now)
+            {
+                status = entry->status;
+                result = (NULL != entry->textResult) ? DuplicateString(entry->textResult) : NULL;
+                hit = (NULL == entry->textResult) || (NULL != result);
+                entry->lastUsed = now;
+            }
+            else
+            {
+                ClearCommandCacheEntry(entry);
+            }
+            break;
+        }
+    }
+
+    if (hit)
+    {
+        g_commandCacheHits += 1;
+    }
+
+    pthread_mutex_unlock(&g_commandCacheLock);
+
+    if (hit)
+    {
+        if (IsCommandLoggingEnabled())
         {
-            fseek(resultsFile, 0, SEEK_END);
-            fileSize = ftell(resultsFile);
-            fseek(resultsFile, 0, SEEK_SET);
+            OsConfigLogInfo(log, "ExecuteCachedCommand: '%s' served from cache with status %d", key, status);
+        }
+    }
+    else
+    {
+        // Run the command outside of the lock so a slow command does not hold up the other lookups
+        status = ExecuteCommand(NULL, command, replaceEol, forJson, maxTextResultBytes, timeoutSeconds, &result, NULL, log);
 
-            if (fileSize > 0)
+        pthread_mutex_lock(&g_commandCacheLock);
+
+        g_commandCacheMisses += 1;
+
+        if ((ttlSeconds > 0) && (ETIME != status))
+        {
+            // Reuse the entry for this key and flags if another thread added it meanwhile, else a free or the least recently used one
+            entry = &g_commandCache[0];
+            for (i = 0; i < COMMAND_CACHE_SIZE; i++)
             {
-                // Truncate to desired maximum, if any
-                if ((maxTextResultBytes > 0) && (((size_t)fileSize + 1) > maxTextResultBytes))
+                if (IsCommandCacheEntryFor(&g_commandCache[i], key, replaceEol, forJson, maxTextResultBytes))
                 {
-                    fileSize = (maxTextResultBytes > 1) ? (maxTextResultBytes - 1) : 0;
+                    entry = &g_commandCache[i];
+                    break;
                 }
-
-                *textResult = (char*)malloc(fileSize + 1);
-                if (NULL != *textResult)
+                else if ((NULL != entry->key) && ((NULL == g_commandCache[i].key) || (g_commandCache[i].lastUsed < entry->lastUsed)))
                 {
-                    memset(*textResult, 0, fileSize + 1);
-                    for (i = 0; i < fileSize; i++)
-                    {
-                        next = fgetc(resultsFile);
-
-                        if (EOF == next)
-                        {
-                            break;
-                        }
-
-                        // Copy the data. Following characters are replaced with spaces:
-                        // all special characters from 0x00 to 0x1F except 0x0A (LF) when replaceEol is false
-                        // plus 0x22 (") and 0x5C (\) characters that break the JSON envelope when forJson is true
-                        if ((replaceEol && (EOL == next)) || ((next < 0x20) && (EOL != next)) || (0x7F == next) || (forJson && (('"' == next) || ('\\' == next))))
-                        {
-                            (*textResult)[i] = ' ';
-                        }
-                        else
-                        {
-                            (*textResult)[i] = (char)next;
-                        }
-                    }
+                    entry = &g_commandCache[i];
                 }
             }
 
-            fclose(resultsFile);
+            ClearCommandCacheEntry(entry);
+
+            if ((NULL != (entry->key = DuplicateString(key))) && ((NULL == result) || (NULL != (entry->textResult = DuplicateString(result)))))
+            {
+                entry->status = status;
+                entry->replaceEol = replaceEol;
+                entry->forJson = forJson;
+                entry->maxTextResultBytes = maxTextResultBytes;
+                entry->expiration = now + ((long long)ttlSeconds * 1000);
+                entry->lastUsed = now;
+            }
+            else
+            {
+                ClearCommandCacheEntry(entry);
+            }
         }
-    }
 
-    remove(commandTextResultFile);
+        pthread_mutex_unlock(&g_commandCacheLock);
+    }
 
-    if (IsCommandLoggingEnabled())
+    if (NULL != textResult)
     {
-        OsConfigLogInfo(log, "Context: '%p'", context);
-        OsConfigLogInfo(log, "Command: '%s'", command);
-        OsConfigLogInfo(log, "Status: %d (errno: %d)", status, errno);
-        OsConfigLogInfo(log, "Text result: '%s'", (NULL != textResult && NULL != *textResult) ? (*textResult) : "");
+        *textResult = result;
+    }
+    else
+    {
+        FREE_MEMORY(result);
     }
 
     return status;
 }
 
+void InvalidateCommandCache(void)
+{
+    int i = 0;
+
+    pthread_mutex_lock(&g_commandCacheLock);
+
+    for (i = 0; i < COMMAND_CACHE_SIZE; i++)
+    {
+        ClearCommandCacheEntry(&g_commandCache[i]);
+    }
+
+    pthread_mutex_unlock(&g_commandCacheLock);
+}
+
+void GetCommandCacheStatistics(unsigned long long* hits, unsigned long long* misses)
+{
+    pthread_mutex_lock(&g_commandCacheLock);
+
+    if (NULL != hits)
+    {
+        *hits = g_commandCacheHits;
+    }
+
+    if (NULL != misses)
+    {
+        *misses = g_commandCacheMisses;
+    }
+
+    pthread_mutex_unlock(&g_commandCacheLock);
+}
+
 char* HashCommand(const char* source, void* log)
 {
-    static const char hashCommandTemplate[] = "%s | sha256sum | head -c 64";
-    
+    // Only the standard output is hashed, same as when it was piped to sha256sum
+    static const char hashCommandTemplate[] = "exec 2>/dev/null; %s";
+
+    COMMAND_OUTPUT output = {0};
+    SHA256_CONTEXT context;
     char* command = NULL;
     char* hash = NULL;
-    int length = 0;
     int status = -1;
 
     if (NULL == source)
@@ -360,24 +1138,35 @@ char* HashCommand(const char* source, void* log)
         return NULL;
     }
 
-    length = (int)(strlen(source) + strlen(hashCommandTemplate));
-    command = (char*)malloc(length);
-    if (NULL != command)
+    if ((NULL == (command = FormatAllocateString(hashCommandTemplate, source))) || (NULL == (hash = (char*)malloc(SHA256_DIGEST_LENGTH + 1))))
     {
-        memset(command, 0, length);
-        snprintf(command, length, hashCommandTemplate, source);
-        
-        status = ExecuteCommand(NULL, command, false, false, 0, 0, &hash, NULL, log);
-        if (0 != status)
-        {
-            FREE_MEMORY(hash);
-        }
+        OsConfigLogError(log, "HashCommand: out of memory");
+        FREE_MEMORY(command);
+        return NULL;
+    }
+
+    // The output is hashed as it streams from the command, with all of it forwarded by the command helper and none of it kept
+    Sha256Initialize(&context);
+    output.limit = SIZE_MAX;
+    output.forwardDescriptor = -1;
+    output.hash = &context;
+
+    status = RunCommand(NULL, command, 0, NULL, &output, log);
+
+    // Like sha256sum at the end of the pipeline, the output is hashed whatever the exit status, unless the command could not be spawned
+    // or did not run to completion: such errors are not told apart from the exit status of the command by the value alone
+    if (false == output.exited)
+    {
+        OsConfigLogError(log, "HashCommand: failed to run '%s' (%d)", source, status);
+        FREE_MEMORY(hash);
     }
     else
     {
-        OsConfigLogError(log, "HashCommand: out of memory");
+        Sha256Finalize(&context, hash);
     }
 
+    FREE_MEMORY(output.buffer);
     FREE_MEMORY(command);
-    return (0 == status) ? hash : NULL;
-}
\ No newline at end of file
+
+    return hash;
+}
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
 
@@ -43,6 +44,65 @@ extern "C"
 #endif
 
 char* LoadStringFromFile(const char* fileName, bool stopAtEol, void* log);
+
+// Read-only view of the contents of a file for callers that only search it. Not null terminated, large files are mapped
+// and stay open and locked until the span is closed
+typedef struct FILE_SPAN
+{
+    const char* data;
+    size_t size;
+    bool mapped;
+    int descriptor;
+} FILE_SPAN;
+
+int OpenFileSpan(const char* fileName, FILE_SPAN* span, void* log);
+void CloseFileSpan(FILE_SPAN* span);
+
+// Compiled set of texts searched for together in one pass over a buffer
+typedef struct TEXT_SEARCH TEXT_SEARCH;
+
+typedef struct TEXT_MATCH
+{
+    // Index of the matching text, its offset in the buffer, 1-based line where it starts and whether the comment mark precedes it on that line
+    unsigned int pattern;
+    size_t offset;
+    unsigned int line;
+    bool commented;
+} TEXT_MATCH;
+
+// Called for every match in buffer order, a non-zero return stops the scan and is returned by ScanWithTextSearch
+typedef int(*TextMatchCallback)(const TEXT_MATCH* match, void* context);
+
+TEXT_SEARCH* CompileTextSearch(const char** patterns, unsigned int numberOfPatterns, char commentMark, void* log);
+int ScanWithTextSearch(const TEXT_SEARCH* search, const char* buffer, size_t size, TextMatchCallback callback, void* context);
+void FreeTextSearch(TEXT_SEARCH* search);
+
+typedef struct TEXT_SEARCH_RESULT
+{
+    unsigned int found;
+    unsigned int foundUncommented;
+    unsigned int firstLine;
+} TEXT_SEARCH_RESULT;
+
+int SearchTextsInFile(const char* fileName, const char** texts, unsigned int numberOfTexts, char commentMark, TEXT_SEARCH_RESULT* results, void* log);
+
+// Kernel parameters read and written directly under /proc/sys (or under a different root when one is given, for tests)
+typedef struct SYSCTL_SETTING
+{
+    const char* name;
+    const char* value;
+    int result;
+} SYSCTL_SETTING;
+
+char* GetSysctlValue(const char* procSysRoot, const char* name, void* log);
+int CheckSysctlValue(const char* procSysRoot, const char* name, const char* expectedValue, char** reason, void* log);
+// Applies all settings (each gets its own result) and then persists them with one rewrite of the drop-in file
+int SetSysctlValues(const char* procSysRoot, SYSCTL_SETTING* settings, unsigned int numberOfSettings, const char* dropInFile, void* log);
+
+// Same as LoadStringFromFile, served from a process wide cache while the file stays unchanged
+char* LoadCachedStringFromFile(const char* fileName, void* log);
+void InvalidateFileCache(const char* fileName);
+void GetFileCacheStatistics(unsigned long long* hits, unsigned long long* misses);
 bool SavePayloadToFile(const char* fileName, const char* payload, const int payloadSizeBytes, void* log);
 bool FileEndsInEol(const char* fileName, void* log);
 bool AppendPayloadToFile(const char* fileName, const char* payload, const int payloadSizeBytes, void* log);
@@ -59,6 +119,29 @@ typedef int(*CommandCallback)(void* context);
 // If called from the main process thread the timeoutSeconds and callback arguments are ignored
 int ExecuteCommand(void* context, const char* command, bool replaceEol, bool forJson, unsigned int maxTextResultBytes, unsigned int timeoutSeconds, char** textResult, CommandCallback callback, void* log);
 
+// Optional long lived helper process (the osconfig-commandhelper executable) that spawns the commands run by ExecuteCommand
+void SetCommandHelperPath(const char* helperPath);
+int StartCommandHelper(void* log);
+void StopCommandHelper(void* log);
+bool IsCommandHelperActive(void);
+
+// Main loop of the command helper executable, serving the commands received over the descriptor
+int RunCommandHelper(int descriptor);
+
+// For read-only commands: reuses the result of an earlier run with the same cache key (the command when NULL) and flags for up to ttlSeconds.
+// Suggested ttlSeconds: short for state that remediation changes (firewall rules), default for configuration, long for hardware properties
+#define COMMAND_CACHE_SHORT_SECONDS 10
+#define COMMAND_CACHE_SECONDS 60
+#define COMMAND_CACHE_LONG_SECONDS 300
+int ExecuteCachedCommand(const char* cacheKey, const char* command, bool replaceEol, bool forJson, unsigned int maxTextResultBytes, unsigned int timeoutSeconds, unsigned int ttlSeconds, char** textResult, void* log);
+void InvalidateCommandCache(void);
+void GetCommandCacheStatistics(unsigned long long* hits, unsigned long long* misses);
+
+// Runs independent commands concurrently, up to maxParallelCommands (0 for no limit other than the process wide one) at a time.
+// Fills in statuses and, when not NULL, textResults for each command; the caller frees each text result
+int ExecuteCommandBatch(const char** commands, unsigned int numberOfCommands, bool replaceEol, bool forJson, unsigned int maxTextResultBytes, unsigned int timeoutSeconds,
+    unsigned int maxParallelCommands, int* statuses, char** textResults, void* log);
+
 int RestrictFileAccessToCurrentAccountOnly(const char* fileName);
 
 bool IsAFile(const char* fileName, void* log);
@@ -77,6 +160,7 @@ int RenameFileWithOwnerAndAccess(const char* original, const char* target, void*
 
 int CheckDirectoryAccess(const char* directoryName, int desiredOwnerId, int desiredGroupId, unsigned int desiredAccess, bool rootCanOverwriteOwnership, char** reason, void* log);
 int SetDirectoryAccess(const char* directoryName, unsigned int desiredOwnerId, unsigned int desiredGroupId, unsigned int desiredAccess, void* log);
+int CheckStatAccess(const struct stat* statStruct, bool directory, const char* name, int desiredOwnerId, int desiredGroupId, unsigned int desiredAccess, bool rootCanOverwriteOwnership, char** reason, void* log);
 int GetDirectoryAccess(const char* name, unsigned int* ownerId, unsigned int* groupId, unsigned int* mode, void* log);
 
 int CheckFileSystemMountingOption(const char* mountFileName, const char* mountDirectory, const char* mountType, const char* desiredOption, char** reason, void* log);
@@ -86,6 +170,9 @@ int IsPresent(const char* what, void* log);
 int IsPackageInstalled(const char* packageName, void* log);
 int CheckPackageInstalled(const char* packageName, char** reason, void* log);
 int CheckPackageNotInstalled(const char* packageName, char** reason, void* log);
+// Looks the package up in the index parsed from a dpkg status file, ENODATA when the file cannot be read
+int IsPackageInDpkgStatus(const char* statusFile, const char* packageName, void* log);
+void InvalidatePackageIndex(void);
 int InstallOrUpdatePackage(const char* packageName, void* log);
 int InstallPackage(const char* packageName, void* log);
 int UninstallPackage(const char* packageName, void* log);
@@ -105,7 +192,10 @@ int CheckTextNotFoundInFolder(const char* directory, const char* text, char** re
 int CheckTextFoundInFolder(const char* directory, const char* text, char** reason, void* log);
 int CheckLineNotFoundOrCommentedOut(const char* fileName, char commentMark, const char* text, char** reason, void* log);
 int CheckLineFoundNotCommentedOut(const char* fileName, char commentMark, const char* text, char** reason, void* log);
+int CheckTextsAreNotFoundInFile(const char* fileName, const char** texts, unsigned int numberOfTexts, char** reason, void* log);
+int CheckLinesNotFoundOrCommentedOut(const char* fileName, char commentMark, const char** texts, unsigned int numberOfTexts, char** reason, void* log);
 int CheckTextFoundInCommandOutput(const char* command, const char* text, char** reason, void* log);
+int CheckTextFoundInCachedCommandOutput(const char* command, const char* text, char** reason, void* log);
 char* GetStringOptionFromBuffer(const char* buffer, const char* option, char separator, void* log);
 int GetIntegerOptionFromBuffer(const char* buffer, const char* option, char separator, void* log);
 int CheckTextNotFoundInCommandOutput(const char* command, const char* text, char** reason, void* log);
@@ -138,6 +228,7 @@ int DisablePostfixNetworkListening(void* log);
 
 size_t HashString(const char* source);
 char* HashCommand(const char* source, void* log);
+char* HashFile(const char* fileName, void* log);
 
 bool ParseHttpProxyData(const char* proxyData, char** hostAddress, int* port, char**username, char** password, void* log);
 
@@ -208,6 +299,13 @@ void StopAndDisableDaemon(const char* daemonName, void* log);
 bool RestartDaemon(const char* daemonName, void* log);
 bool MaskDaemon(const char* daemonName, void* log);
 
+// Returns allocated listings in the formats of 'systemctl list-units --all --plain --full --no-legend' and 'systemctl list-unit-files --full --no-legend'
+typedef int(*DaemonStateProvider)(char** units, char** unitFiles, void* log);
+
+// Daemon states are answered from one listing of all units, SetDaemonStateProvider(NULL) goes back to systemctl
+void SetDaemonStateProvider(DaemonStateProvider provider);
+void InvalidateDaemonState(void);
+
 char* GetHttpProxyData(void* log);
 
 char* RepairBrokenEolCharactersIfAny(const char* value);
@@ -226,6 +324,7 @@ typedef struct REPORTED_PROPERTY
 bool IsCommandLoggingEnabledInJsonConfig(const char* jsonString);
 bool IsFullLoggingEnabledInJsonConfig(const char* jsonString);
 bool IsIotHubManagementEnabledInJsonConfig(const char* jsonString);
+bool IsColocatedPlatformEnabledInJsonConfig(const char* jsonString);
 int GetReportingIntervalFromJsonConfig(const char* jsonString, void* log);
 int GetModelVersionFromJsonConfig(const char* jsonString, void* log);
 int GetLocalManagementFromJsonConfig(const char* jsonString, void* log);
@@ -236,6 +335,25 @@ int GetGitManagementFromJsonConfig(const char* jsonString, void* log);
 char* GetGitRepositoryUrlFromJsonConfig(const char* jsonString, void* log);
 char* GetGitBranchFromJsonConfig(const char* jsonString, void* log);
 
+typedef void* REPORTED_WRITER_HANDLE;
+
+// Writes the reported configuration (RC) file in compact JSON, atomically (via temporary file and rename), re-serializing only
+// the components that changed and optionally saving next to it an index ('<file>.index') with the offset of each component
+REPORTED_WRITER_HANDLE OpenReportedWriter(const char* fileName, bool indexed, void* log);
+void CloseReportedWriter(REPORTED_WRITER_HANDLE writer);
+int UpdateReportedComponent(REPORTED_WRITER_HANDLE writer, const char* componentName, const char* componentValue, void* log);
+int UpdateReportedPayload(REPORTED_WRITER_HANDLE writer, const char* payload, void* log);
+int SaveReportedFile(REPORTED_WRITER_HANDLE writer, void* log);
+char* LoadReportedComponentFromFile(const char* fileName, const char* componentName, void* log);
+
+// Git commit ids are 40 or 64 hexadecimal characters, commitId buffers hold GIT_COMMIT_ID_MAX_LENGTH + 1 characters
+#define GIT_COMMIT_ID_MAX_LENGTH 64
+
+// Shallow clone of the tip of a branch where only sparsePath is checked out, updated only when the remote branch moves
+int CloneGitBranch(const char* repositoryUrl, const char* branch, const char* clonePath, const char* sparsePath, char* commitId, void* log);
+int UpdateGitClone(const char* branch, const char* clonePath, char* commitId, bool* updated, void* log);
+int DeleteGitClone(const char* clonePath, void* log);
+
 #ifdef __cplusplus
 }
 #endif
@@ -17,6 +17,7 @@
 
 #define IOT_HUB_MANAGEMENT "IotHubManagement"
 #define LOCAL_MANAGEMENT "LocalManagement"
+#define COLOCATED_PLATFORM "ColocatedPlatform"
 
 #define COMMAND_LOGGING "CommandLogging"
 #define FULL_LOGGING "FullLogging"
@@ -66,6 +67,11 @@ bool IsIotHubManagementEnabledInJsonConfig(const char* jsonString)
     return IsOptionEnabledInJsonConfig(jsonString, IOT_HUB_MANAGEMENT);
 }
 
+bool IsColocatedPlatformEnabledInJsonConfig(const char* jsonString)
+{
+    return IsOptionEnabledInJsonConfig(jsonString, COLOCATED_PLATFORM);
+}
+
 static int GetIntegerFromJsonConfig(const char* valueName, const char* jsonString, int defaultValue, int minValue, int maxValue, void* log)
 {
     JSON_Value* rootValue = NULL;
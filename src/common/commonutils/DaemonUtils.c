@@ -3,6 +3,8 @@
 
 #include "Internal.h"
 
+#include <pthread.h>
+
 #define MAX_DAEMON_NAME_LENGTH 256
 
 // Valid systemd deamon name characters for us, not universal, add more here if necessary in the future
@@ -61,9 +63,282 @@ static int ExecuteSystemctlCommand(const char* command, const char* daemonName,
     return result;
 }
 
+// How long a unit state snapshot answers queries before systemd is asked again, changes made here refresh it right away
+#define DAEMON_STATE_CACHE_SECONDS 10
+
+typedef struct UNIT_STATE
+{
+    // Unit name, and its ACTIVE column from list-units and STATE column from list-unit-files, NULL when not listed there
+    const char* name;
+    const char* activeState;
+    const char* fileState;
+} UNIT_STATE;
+
+typedef struct UNIT_STATE_SNAPSHOT
+{
+    // The two listings, the states point into them
+    char* units;
+    char* unitFiles;
+    // Sorted by name
+    UNIT_STATE* states;
+    unsigned int numberOfStates;
+    time_t taken;
+} UNIT_STATE_SNAPSHOT;
+
+static UNIT_STATE_SNAPSHOT g_unitStateSnapshot = {0};
+static pthread_mutex_t g_unitStateSnapshotLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Unit files in these states that are not loaded are inactive, for others (such as aliases) systemctl is asked about the unit
+static const char* g_inactiveUnitFileStates[] = {"disabled", "masked", "static", "indirect"};
+
+static int ListUnitStatesWithSystemctl(char** units, char** unitFiles, void* log)
+{
+    const char* listUnits = "systemctl list-units --all --plain --full --no-legend --no-pager";
+    const char* listUnitFiles = "systemctl list-unit-files --full --no-legend --no-pager";
+    int status = 0;
+
+    if (0 != (status = ExecuteCommand(NULL, listUnits, false, false, 0, 0, units, NULL, NULL)))
+    {
+        OsConfigLogError(log, "ListUnitStatesWithSystemctl: '%s' failed with %d", listUnits, status);
+    }
+    else if (0 != (status = ExecuteCommand(NULL, listUnitFiles, false, false, 0, 0, unitFiles, NULL, NULL)))
+    {
+        OsConfigLogError(log, "ListUnitStatesWithSystemctl: '%s' failed with %d", listUnitFiles, status);
+    }
+
+    return status;
+}
+
+static DaemonStateProvider g_daemonStateProvider = ListUnitStatesWithSystemctl;
+
+static void ClearUnitStateSnapshot(UNIT_STATE_SNAPSHOT* snapshot)
+{
+    FREE_MEMORY(snapshot->units);
+    FREE_MEMORY(snapshot->unitFiles);
+    FREE_MEMORY(snapshot->states);
+    memset(snapshot, 0, sizeof(UNIT_STATE_SNAPSHOT));
+}
+
+static int CompareUnitStates(const void* left, const void* right)
+{
+    return strcmp(((const UNIT_STATE*)left)->name, ((const UNIT_STATE*)right)->name);
+}
+
+// Adds one UNIT_STATE for each 'name state ...' line of a listing, the state being either the activeState (second column after
+// the LOAD column for list-units) or the fileState (first column after the name for list-unit-files)
+static void ParseUnitListing(UNIT_STATE_SNAPSHOT* snapshot, char* listing, bool unitFiles)
+{
+    UNIT_STATE* state = NULL;
+    char* line = NULL;
+    char* next = NULL;
+    char* columns[3] = {NULL, NULL, NULL};
+    char* token = NULL;
+    char* saveptr = NULL;
+    unsigned int numberOfColumns = 0;
+    unsigned int wanted = unitFiles ? 2 : 3;
+
+    for (line = listing; NULL != line; line = next)
+    {
+        if (NULL != (next = strchr(line, EOL)))
+        {
+            *next = 0;
+            next += 1;
+        }
+
+        // Skip the marker systemctl may put in front of failed units
+        if ((NULL != (token = strtok_r(line, " \t", &saveptr))) && (false == IsValidDaemonName(token)) && (NULL == strchr(token, '@')))
+        {
+            token = strtok_r(NULL, " \t", &saveptr);
+        }
+
+        for (numberOfColumns = 0; (NULL != token) && (numberOfColumns < wanted); numberOfColumns++)
+        {
+            columns[numberOfColumns] = token;
+            token = (numberOfColumns + 1 < wanted) ? strtok_r(NULL, " \t", &saveptr) : NULL;
+        }
+
+        if (numberOfColumns == wanted)
+        {
+            state = &snapshot->states[snapshot->numberOfStates++];
+            state->name = columns[0];
+            state->activeState = unitFiles ? NULL : columns[2];
+            state->fileState = unitFiles ? columns[1] : NULL;
+        }
+    }
+}
+
+// Makes sure g_unitStateSnapshot is recent, called with g_unitStateSnapshotLock held
+static int RefreshUnitStateSnapshot(void* log)
+{
+    UNIT_STATE_SNAPSHOT snapshot = {0};
+    const char* text = NULL;
+    time_t now = time(NULL);
+    unsigned int numberOfLines = 2;
+    unsigned int i = 0, j = 0;
+    int status = 0;
+
+    if ((NULL != g_unitStateSnapshot.states) && (now >= g_unitStateSnapshot.taken) && ((now - g_unitStateSnapshot.taken) < DAEMON_STATE_CACHE_SECONDS))
+    {
+        return 0;
+    }
+
+    snapshot.taken = now;
+
+    if (0 != (status = g_daemonStateProvider(&snapshot.units, &snapshot.unitFiles, log)))
+    {
+        OsConfigLogError(log, "RefreshUnitStateSnapshot: cannot list the units (%d)", status);
+    }
+    else if ((NULL == snapshot.units) || (NULL == snapshot.unitFiles))
+    {
+        OsConfigLogError(log, "RefreshUnitStateSnapshot: the unit listing is empty");
+        status = ENOENT;
+    }
+    else
+    {
+        for (text = snapshot.units; 0 != *text; text++)
+        {
+            numberOfLines += (EOL == *text) ? 1 : 0;
+        }
+
+        for (text = snapshot.unitFiles; 0 != *text; text++)
+        {
+            numberOfLines += (EOL == *text) ? 1 : 0;
+        }
+
+        if (NULL == (snapshot.states = (UNIT_STATE*)calloc(numberOfLines, sizeof(UNIT_STATE))))
+        {
+            OsConfigLogError(log, "RefreshUnitStateSnapshot: out of memory");
+            status = ENOMEM;
+        }
+        else
+        {
+            ParseUnitListing(&snapshot, snapshot.units, false);
+            ParseUnitListing(&snapshot, snapshot.unitFiles, true);
+
+            // Units present in both listings are merged into one state
+            qsort(snapshot.states, snapshot.numberOfStates, sizeof(UNIT_STATE), CompareUnitStates);
+
+            for (i = 0, j = 0; i < snapshot.numberOfStates; i++)
+            {
+                if ((0 < j) && (0 == strcmp(snapshot.states[j - 1].name, snapshot.states[i].name)))
+                {
+                    if (NULL != snapshot.states[i].activeState)
+                    {
+                        snapshot.states[j - 1].activeState = snapshot.states[i].activeState;
+                    }
+
+                    if (NULL != snapshot.states[i].fileState)
+                    {
+                        snapshot.states[j - 1].fileState = snapshot.states[i].fileState;
+                    }
+                }
+                else
+                {
+                    snapshot.states[j++] = snapshot.states[i];
+                }
+            }
+
+            snapshot.numberOfStates = j;
+        }
+    }
+
+    if (0 == status)
+    {
+        ClearUnitStateSnapshot(&g_unitStateSnapshot);
+        memcpy(&g_unitStateSnapshot, &snapshot, sizeof(UNIT_STATE_SNAPSHOT));
+        OsConfigLogInfo(log, "RefreshUnitStateSnapshot: %u units listed", g_unitStateSnapshot.numberOfStates);
+    }
+    else
+    {
+        ClearUnitStateSnapshot(&snapshot);
+    }
+
+    return status;
+}
+
+static const UNIT_STATE* FindUnitState(const char* daemonName)
+{
+    UNIT_STATE key = {NULL, NULL, NULL};
+    const UNIT_STATE* state = NULL;
+    char* serviceName = NULL;
+
+    if (0 == g_unitStateSnapshot.numberOfStates)
+    {
+        return NULL;
+    }
+
+    key.name = daemonName;
+
+    // Like systemctl, a name without a unit type suffix is a service
+    if ((NULL == (state = (const UNIT_STATE*)bsearch(&key, g_unitStateSnapshot.states, g_unitStateSnapshot.numberOfStates, sizeof(UNIT_STATE), CompareUnitStates))) &&
+        (NULL != (serviceName = FormatAllocateString("%s.service", daemonName))))
+    {
+        key.name = serviceName;
+        state = (const UNIT_STATE*)bsearch(&key, g_unitStateSnapshot.states, g_unitStateSnapshot.numberOfStates, sizeof(UNIT_STATE), CompareUnitStates);
+        FREE_MEMORY(serviceName);
+    }
+
+    return state;
+}
+
+void InvalidateDaemonState(void)
+{
+    pthread_mutex_lock(&g_unitStateSnapshotLock);
+    ClearUnitStateSnapshot(&g_unitStateSnapshot);
+    pthread_mutex_unlock(&g_unitStateSnapshotLock);
+}
+
+void SetDaemonStateProvider(DaemonStateProvider provider)
+{
+    pthread_mutex_lock(&g_unitStateSnapshotLock);
+    g_daemonStateProvider = provider ? provider : ListUnitStatesWithSystemctl;
+    ClearUnitStateSnapshot(&g_unitStateSnapshot);
+    pthread_mutex_unlock(&g_unitStateSnapshotLock);
+}
+
 bool IsDaemonActive(const char* daemonName, void* log)
 {
-    return (IsValidDaemonName(daemonName) && (0 == ExecuteSystemctlCommand("is-active", daemonName, log))) ? true : false;
+    const UNIT_STATE* state = NULL;
+    bool askSystemctl = false;
+    bool result = false;
+    unsigned int i = 0;
+
+    if (false == IsValidDaemonName(daemonName))
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&g_unitStateSnapshotLock);
+
+    if (0 != RefreshUnitStateSnapshot(log))
+    {
+        askSystemctl = true;
+    }
+    else if (NULL == (state = FindUnitState(daemonName)))
+    {
+        // Not known to systemd
+        result = false;
+    }
+    else if (NULL != state->activeState)
+    {
+        result = ((0 == strcmp(state->activeState, "active")) || (0 == strcmp(state->activeState, "reloading"))) ? true : false;
+    }
+    else if (NULL != state->fileState)
+    {
+        for (askSystemctl = true, i = 0; (i < ARRAY_SIZE(g_inactiveUnitFileStates)) && askSystemctl; i++)
+        {
+            askSystemctl = (0 == strcmp(state->fileState, g_inactiveUnitFileStates[i])) ? false : true;
+        }
+    }
+
+    pthread_mutex_unlock(&g_unitStateSnapshotLock);
+
+    if (askSystemctl)
+    {
+        result = (0 == ExecuteSystemctlCommand("is-active", daemonName, log)) ? true : false;
+    }
+
+    return result;
 }
 
 bool CheckDaemonActive(const char* daemonName, char** reason, void* log)
@@ -115,7 +390,10 @@ static bool CommandDaemon(const char* command, const char* daemonName, void* log
         return false;
     }
 
-    if (0 == (result = ExecuteSystemctlCommand(command, daemonName, log)))
+    result = ExecuteSystemctlCommand(command, daemonName, log);
+    InvalidateDaemonState();
+
+    if (0 == result)
     {
         OsConfigLogInfo(log, "Succeeded to %s service '%s'", command, daemonName);
     }
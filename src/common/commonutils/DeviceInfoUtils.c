@@ -269,10 +269,51 @@ char* GetOsKernelVersion(void* log)
     return textResult;
 }
 
+static char* GetCpuProperty(const char* name, void* log)
+{
+    const char* lscpuCommand = "lscpu";
+    char* output = NULL;
+    char* line = NULL;
+    char* next = NULL;
+    char* textResult = NULL;
+    size_t nameLength = 0;
+
+    if ((NULL == name) || (0 == (nameLength = strlen(name))))
+    {
+        return NULL;
+    }
+
+    if ((0 == ExecuteCachedCommand(NULL, lscpuCommand, false, true, 0, 0, COMMAND_CACHE_LONG_SECONDS, &output, log)) && output)
+    {
+        for (line = output; (NULL != line) && (NULL == textResult); line = (NULL != next) ? (next + 1) : NULL)
+        {
+            next = strchr(line, EOL);
+
+            // Newer lscpu versions indent the properties that belong to a group
+            while ((' ' == line[0]) || ('\t' == line[0]))
+            {
+                line += 1;
+            }
+
+            if ((0 == strncmp(line, name, nameLength)) && (NULL != (textResult = DuplicateString(line))))
+            {
+                TruncateAtFirst(textResult, EOL);
+                RemovePrefixUpTo(textResult, ':');
+                RemovePrefix(textResult, ':');
+                RemovePrefixBlanks(textResult);
+                RemoveTrailingBlanks(textResult);
+            }
+        }
+    }
+
+    FREE_MEMORY(output);
+
+    return textResult;
+}
+
 char* GetCpuType(void* log)
 {
-    const char* osCpuTypeCommand = "lscpu | grep Architecture:";
-    char* textResult = GetHardwareProperty(osCpuTypeCommand, false, log);
+    char* textResult = GetCpuProperty("Architecture:", log);
     
     if (IsFullLoggingEnabled())
     {
@@ -284,8 +325,7 @@ char* GetCpuType(void* log)
 
 char* GetCpuVendor(void* log)
 {
-    const char* osCpuVendorCommand = "lscpu | grep \"Vendor ID:\"";
-    char* textResult = GetHardwareProperty(osCpuVendorCommand, false, log);
+    char* textResult = GetCpuProperty("Vendor ID:", log);
     
     if (IsFullLoggingEnabled())
     {
@@ -297,8 +337,7 @@ char* GetCpuVendor(void* log)
 
 char* GetCpuModel(void* log)
 {
-    const char* osCpuModelCommand = "lscpu | grep \"Model name:\"";
-    char* textResult = GetHardwareProperty(osCpuModelCommand, false, log);
+    char* textResult = GetCpuProperty("Model name:", log);
     
     if (IsFullLoggingEnabled())
     {
@@ -310,8 +349,7 @@ char* GetCpuModel(void* log)
 
 char* GetCpuFlags(void* log)
 {
-    const char* osCpuFlagsCommand = "lscpu | grep \"Flags:\"";
-    char* textResult = GetHardwareProperty(osCpuFlagsCommand, false, log);
+    char* textResult = GetCpuProperty("Flags:", log);
 
     if (IsFullLoggingEnabled())
     {
@@ -3,81 +3,454 @@
 
 #include "Internal.h"
 
-char* LoadStringFromFile(const char* fileName, bool stopAtEol, void* log)
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+// Files at least this large are mapped instead of read when opened as spans
+#define FILE_SPAN_MAP_THRESHOLD (256 * 1024)
+
+// Initial buffer size for files that do not report their size, such as the ones in /proc
+#define FILE_READ_CHUNK 4096
+
+// Process wide cache of small file contents, validated against the file identity, size and modification time on each use.
+// Larger files are opened as mapped spans instead
+#define FILE_CACHE_MAX_BYTES (8 * 1024 * 1024)
+#define FILE_CACHE_MAX_ENTRIES 128
+#define FILE_CACHE_MAX_FILE_BYTES FILE_SPAN_MAP_THRESHOLD
+
+typedef struct FILE_CACHE_ENTRY
+{
+    char* fileName;
+    char* contents;
+    size_t size;
+    dev_t device;
+    ino_t inode;
+    off_t fileSize;
+    struct timespec modified;
+    unsigned long long lastUsed;
+} FILE_CACHE_ENTRY;
+
+static FILE_CACHE_ENTRY g_fileCache[FILE_CACHE_MAX_ENTRIES] = {{0}};
+static pthread_mutex_t g_fileCacheLock = PTHREAD_MUTEX_INITIALIZER;
+static size_t g_fileCacheBytes = 0;
+static unsigned long long g_fileCacheUses = 0;
+static unsigned long long g_fileCacheHits = 0;
+static unsigned long long g_fileCacheMisses = 0;
+
+static bool LockUnlockDescriptor(int fileDescriptor, bool lock, void* log)
 {
-    const int initialSize = 1024;
-    int currentSize = 0;
-    FILE* file = NULL;
-    int i = 0;
-    int next = 0;
-    char* string = NULL;
+    int lockResult = -1;
+    int lockOperation = lock ? (LOCK_EX | LOCK_NB) : LOCK_UN;
+
+    if (0 != (lockResult = flock(fileDescriptor, lockOperation)))
+    {
+        OsConfigLogError(log, "LockFile: flock(%d) failed with %d", lockOperation, errno);
+    }
+
+    return (0 == lockResult) ? true : false;
+}
+
+static int OpenAndLockFile(const char* fileName, struct stat* statStruct, void* log)
+{
+    int fileDescriptor = -1;
+
+    if (0 <= (fileDescriptor = open(fileName, O_RDONLY | O_CLOEXEC)))
+    {
+        if ((0 != fstat(fileDescriptor, statStruct)) || (false == LockUnlockDescriptor(fileDescriptor, true, log)))
+        {
+            close(fileDescriptor);
+            fileDescriptor = -1;
+        }
+    }
+
+    return fileDescriptor;
+}
+
+static char* ReadFromDescriptor(int fileDescriptor, size_t sizeHint, bool stopAtEol, size_t* size)
+{
+    // With the size known, one read gets the contents and a second one confirms the end of the file
+    size_t capacity = (sizeHint > 0) ? (sizeHint + 2) : FILE_READ_CHUNK;
+    size_t length = 0;
+    ssize_t bytes = 0;
+    char* buffer = NULL;
     char* temp = NULL;
+    char* eol = NULL;
+
+    if (NULL == (buffer = (char*)malloc(capacity)))
+    {
+        return NULL;
+    }
+
+    while (true)
+    {
+        if ((length + 1) >= capacity)
+        {
+            if (NULL == (temp = (char*)realloc(buffer, capacity * 2)))
+            {
+                FREE_MEMORY(buffer);
+                break;
+            }
+            buffer = temp;
+            capacity *= 2;
+        }
+
+        if (0 > (bytes = read(fileDescriptor, buffer + length, capacity - 1 - length)))
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            FREE_MEMORY(buffer);
+            break;
+        }
+        else if (0 == bytes)
+        {
+            break;
+        }
+        else if (stopAtEol && (NULL != (eol = (char*)memchr(buffer + length, EOL, (size_t)bytes))))
+        {
+            length = (size_t)(eol - buffer);
+            break;
+        }
+
+        length += (size_t)bytes;
+    }
+
+    if (NULL != buffer)
+    {
+        buffer[length] = 0;
+        if (NULL != size)
+        {
+            *size = length;
+        }
+    }
+
+    return buffer;
+}
+
+static char* LoadFile(const char* fileName, bool stopAtEol, size_t* size, struct stat* statStruct, void* log)
+{
+    int fileDescriptor = -1;
+    char* string = NULL;
 
     if (false == FileExists(fileName))
     {
         return string;
     }
 
-    if (NULL != (file = fopen(fileName, "r")))
+    if (0 <= (fileDescriptor = OpenAndLockFile(fileName, statStruct, log)))
+    {
+        string = ReadFromDescriptor(fileDescriptor, S_ISREG(statStruct->st_mode) ? (size_t)statStruct->st_size : 0, stopAtEol, size);
+
+        LockUnlockDescriptor(fileDescriptor, false, log);
+        close(fileDescriptor);
+    }
+
+    return string;
+}
+
+char* LoadStringFromFile(const char* fileName, bool stopAtEol, void* log)
+{
+    struct stat statStruct = {0};
+    return LoadFile(fileName, stopAtEol, NULL, &statStruct, log);
+}
+
+static bool IsSameFileVersion(const FILE_CACHE_ENTRY* entry, const struct stat* statStruct)
+{
+    return (entry->device == statStruct->st_dev) && (entry->inode == statStruct->st_ino) && (entry->fileSize == statStruct->st_size) &&
+        (entry->modified.tv_sec == statStruct->st_mtim.tv_sec) && (entry->modified.tv_nsec == statStruct->st_mtim.tv_nsec);
+}
+
+static void ClearFileCacheEntry(FILE_CACHE_ENTRY* entry)
+{
+    g_fileCacheBytes -= entry->size;
+    FREE_MEMORY(entry->fileName);
+    FREE_MEMORY(entry->contents);
+    memset(entry, 0, sizeof(FILE_CACHE_ENTRY));
+}
+
+static char* CopyFileContents(const char* contents, size_t size)
+{
+    char* copy = NULL;
+
+    if (NULL != (copy = (char*)malloc(size + 1)))
     {
-        if (LockFile(file, log))
+        memcpy(copy, contents, size);
+        copy[size] = 0;
+    }
+
+    return copy;
+}
+
+static void AddToFileCache(const char* fileName, const char* contents, size_t size, const struct stat* statStruct)
+{
+    FILE_CACHE_ENTRY* entry = NULL;
+    int i = 0;
+
+    // Make room, evicting the least recently used files
+    while (true)
+    {
+        entry = NULL;
+        for (i = 0; i < FILE_CACHE_MAX_ENTRIES; i++)
         {
-            if (NULL != (string = (char*)malloc(initialSize)))
+            if (NULL == g_fileCache[i].fileName)
             {
-                currentSize = initialSize;
-                memset(&string[0], 0, currentSize);
-                
-                while (1)
-                {
-                    next = fgetc(file);
-                    if ((EOF == next) || (stopAtEol && (EOL == next)))
-                    {
-                        string[i] = 0;
-                        break;
-                    }
+                entry = &g_fileCache[i];
+                break;
+            }
+        }
 
-                    string[i] = (char)next;
-                    i += 1;
+        if ((NULL != entry) && ((g_fileCacheBytes + size) <= FILE_CACHE_MAX_BYTES))
+        {
+            break;
+        }
 
-                    if (i >= currentSize)
-                    {
-                        currentSize += initialSize;
-                        if (NULL != (temp = (char*)realloc(string, currentSize)))
-                        {
-                            string = temp;
-                            memset(&string[i], 0, currentSize - i);
-                        }
-                        else
-                        {
-                            FREE_MEMORY(string);
-                            break;
-                        }
-                    }
-                }
+        entry = NULL;
+        for (i = 0; i < FILE_CACHE_MAX_ENTRIES; i++)
+        {
+            if ((NULL != g_fileCache[i].fileName) && ((NULL == entry) || (g_fileCache[i].lastUsed < entry->lastUsed)))
+            {
+                entry = &g_fileCache[i];
             }
+        }
 
-            UnlockFile(file, log);
+        if (NULL == entry)
+        {
+            return;
         }
 
-        fclose(file);
+        ClearFileCacheEntry(entry);
     }
 
-    return string;
+    if ((NULL != (entry->fileName = DuplicateString(fileName))) && (NULL != (entry->contents = CopyFileContents(contents, size))))
+    {
+        entry->size = size;
+        entry->device = statStruct->st_dev;
+        entry->inode = statStruct->st_ino;
+        entry->fileSize = statStruct->st_size;
+        entry->modified = statStruct->st_mtim;
+        entry->lastUsed = g_fileCacheUses;
+        g_fileCacheBytes += size;
+    }
+    else
+    {
+        ClearFileCacheEntry(entry);
+    }
+}
+
+static char* LoadFileThroughCache(const char* fileName, size_t* size, void* log)
+{
+    struct stat statStruct = {0};
+    FILE_CACHE_ENTRY* entry = NULL;
+    char* contents = NULL;
+    size_t length = 0;
+    int i = 0;
+
+    if ((NULL == fileName) || (0 != stat(fileName, &statStruct)) || (false == S_ISREG(statStruct.st_mode)) ||
+        (0 == statStruct.st_size) || (statStruct.st_size >= FILE_CACHE_MAX_FILE_BYTES))
+    {
+        return LoadFile(fileName, false, size, &statStruct, log);
+    }
+
+    pthread_mutex_lock(&g_fileCacheLock);
+
+    g_fileCacheUses += 1;
+
+    for (i = 0; i < FILE_CACHE_MAX_ENTRIES; i++)
+    {
+        entry = &g_fileCache[i];
+        if ((NULL != entry->fileName) && (0 == strcmp(entry->fileName, fileName)))
+        {
+            if (IsSameFileVersion(entry, &statStruct) && (NULL != (contents = CopyFileContents(entry->contents, entry->size))))
+            {
+                entry->lastUsed = g_fileCacheUses;
+                g_fileCacheHits += 1;
+                length = entry->size;
+            }
+            else
+            {
+                ClearFileCacheEntry(entry);
+            }
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&g_fileCacheLock);
+
+    if (NULL == contents)
+    {
+        if (NULL != (contents = LoadFile(fileName, false, &length, &statStruct, log)))
+        {
+            pthread_mutex_lock(&g_fileCacheLock);
+
+            g_fileCacheMisses += 1;
+
+            // A file modified within the last couple of seconds could change again without its modification time moving, do not keep it yet
+            if (S_ISREG(statStruct.st_mode) && (length < FILE_CACHE_MAX_FILE_BYTES) && ((statStruct.st_mtim.tv_sec + 2) < time(NULL)))
+            {
+                AddToFileCache(fileName, contents, length, &statStruct);
+            }
+
+            pthread_mutex_unlock(&g_fileCacheLock);
+        }
+    }
+
+    if ((NULL != contents) && (NULL != size))
+    {
+        *size = length;
+    }
+
+    return contents;
+}
+
+char* LoadCachedStringFromFile(const char* fileName, void* log)
+{
+    return LoadFileThroughCache(fileName, NULL, log);
+}
+
+void InvalidateFileCache(const char* fileName)
+{
+    int i = 0;
+
+    pthread_mutex_lock(&g_fileCacheLock);
+
+    for (i = 0; i < FILE_CACHE_MAX_ENTRIES; i++)
+    {
+        if ((NULL != g_fileCache[i].fileName) && ((NULL == fileName) || (0 == strcmp(g_fileCache[i].fileName, fileName))))
+        {
+            ClearFileCacheEntry(&g_fileCache[i]);
+        }
+    }
+
+    pthread_mutex_unlock(&g_fileCacheLock);
+}
+
+void GetFileCacheStatistics(unsigned long long* hits, unsigned long long* misses)
+{
+    pthread_mutex_lock(&g_fileCacheLock);
+
+    if (NULL != hits)
+    {
+        *hits = g_fileCacheHits;
+    }
+
+    if (NULL != misses)
+    {
+        *misses = g_fileCacheMisses;
+    }
+
+    pthread_mutex_unlock(&g_fileCacheLock);
+}
+
+int OpenFileSpan(const char* fileName, FILE_SPAN* span, void* log)
+{
+    struct stat statStruct = {0};
+    void* mapping = MAP_FAILED;
+    char* buffer = NULL;
+    int fileDescriptor = -1;
+    int status = 0;
+
+    if ((NULL == fileName) || (NULL == span))
+    {
+        OsConfigLogError(log, "OpenFileSpan called with invalid arguments");
+        return EINVAL;
+    }
+
+    memset(span, 0, sizeof(FILE_SPAN));
+    span->descriptor = -1;
+
+    if (0 != stat(fileName, &statStruct))
+    {
+        return errno ? errno : ENOENT;
+    }
+
+    // Large regular files are mapped, the rest comes through the file content cache
+    if (S_ISREG(statStruct.st_mode) && (statStruct.st_size >= FILE_SPAN_MAP_THRESHOLD))
+    {
+        if (0 > (fileDescriptor = OpenAndLockFile(fileName, &statStruct, log)))
+        {
+            return errno ? errno : ENOENT;
+        }
+
+        // The mapping keeps the descriptor and its lock so that writers that lock the file cannot truncate it under the caller
+        if ((statStruct.st_size > 0) && (MAP_FAILED != (mapping = mmap(NULL, (size_t)statStruct.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0))))
+        {
+            madvise(mapping, (size_t)statStruct.st_size, MADV_SEQUENTIAL);
+            span->data = (const char*)mapping;
+            span->size = (size_t)statStruct.st_size;
+            span->mapped = true;
+            span->descriptor = fileDescriptor;
+        }
+        else
+        {
+            if (NULL != (buffer = ReadFromDescriptor(fileDescriptor, (size_t)statStruct.st_size, false, &span->size)))
+            {
+                span->data = buffer;
+            }
+
+            LockUnlockDescriptor(fileDescriptor, false, log);
+            close(fileDescriptor);
+        }
+    }
+    else if (NULL != (buffer = LoadFileThroughCache(fileName, &span->size, log)))
+    {
+        span->data = buffer;
+    }
+
+    if (NULL == span->data)
+    {
+        OsConfigLogError(log, "OpenFileSpan: cannot read from '%s'", fileName);
+        status = errno ? errno : ENOENT;
+    }
+
+    return status;
+}
+
+void CloseFileSpan(FILE_SPAN* span)
+{
+    if ((NULL != span) && (NULL != span->data))
+    {
+        if (span->mapped)
+        {
+            munmap((void*)span->data, span->size);
+            LockUnlockDescriptor(span->descriptor, false, NULL);
+            close(span->descriptor);
+        }
+        else
+        {
+            free((void*)span->data);
+        }
+
+        memset(span, 0, sizeof(FILE_SPAN));
+        span->descriptor = -1;
+    }
 }
 
 static bool SaveToFile(const char* fileName, const char* mode, const char* payload, const int payloadSizeBytes, void* log)
 {
     FILE* file = NULL;
+    bool truncate = false;
     int i = 0;
     bool result = true;
 
     if (fileName && mode && payload && (0 < payloadSizeBytes))
     {
+        InvalidateFileCache(fileName);
         RestrictFileAccessToCurrentAccountOnly(fileName);
 
-        if (NULL != (file = fopen(fileName, mode)))
+        // The file is truncated only once locked, so readers holding the lock such as mapped file spans keep their contents
+        truncate = (0 == strcmp(mode, "w")) ? true : false;
+
+        if (NULL != (file = fopen(fileName, truncate ? "a" : mode)))
         {
-            if (true == (result = LockFile(file, log)))
+            if ((true == (result = LockFile(file, log))) && truncate && (0 != ftruncate(fileno(file), 0)))
+            {
+                result = false;
+                OsConfigLogError(log, "SaveToFile: cannot truncate '%s' (%d)", fileName, errno);
+                UnlockFile(file, log);
+            }
+            else if (true == result)
             {
                 for (i = 0; i < payloadSizeBytes; i++)
                 {
@@ -210,6 +583,8 @@ static bool InternalSecureSaveToFile(const char* fileName, const char* mode, con
         return false;
     }
 
+    InvalidateFileCache(fileName);
+
     if (NULL == (fileDirectory = dirname(fileNameCopy)))
     {
         OsConfigLogInfo(log, "InternalSecureSaveToFile: no directory name for '%s' (%d)", fileNameCopy, errno);
@@ -530,8 +905,6 @@ int CheckFileNotFound(const char* fileName, char** reason, void* log)
 static bool LockUnlockFile(FILE* file, bool lock, void* log)
 {
     int fileDescriptor = -1;
-    int lockResult = -1;
-    int lockOperation = lock ? (LOCK_EX | LOCK_NB) : LOCK_UN;
 
     if (NULL == file)
     {
@@ -541,13 +914,10 @@ static bool LockUnlockFile(FILE* file, bool lock, void* log)
     if (-1 == (fileDescriptor = fileno(file)))
     {
         OsConfigLogError(log, "LockFile: fileno failed with %d", errno);
-    }
-    else if (0 != (lockResult = flock(fileDescriptor, lockOperation)))
-    {
-        OsConfigLogError(log, "LockFile: flock(%d) failed with %d", lockOperation, errno);
+        return false;
     }
 
-    return (0 == lockResult) ? true : false;
+    return LockUnlockDescriptor(fileDescriptor, lock, log);
 }
 
 bool LockFile(FILE* file, void* log)
@@ -582,13 +952,97 @@ static int OctalToDecimal(int octal)
     return decimal;
 }
 
-static int CheckAccess(bool directory, const char* name, int desiredOwnerId, int desiredGroupId, unsigned int desiredAccess, bool rootCanOverwriteOwnership, char** reason, void* log)
+int CheckStatAccess(const struct stat* statStruct, bool directory, const char* name, int desiredOwnerId, int desiredGroupId, unsigned int desiredAccess, bool rootCanOverwriteOwnership, char** reason, void* log)
 {
-    struct stat statStruct = {0};
     mode_t currentMode = 0;
     mode_t desiredMode = 0;
     int result = ENOENT;
 
+    if ((NULL == statStruct) || (NULL == name))
+    {
+        OsConfigLogError(log, "CheckStatAccess called with invalid arguments");
+        return EINVAL;
+    }
+
+    if (((-1 != desiredOwnerId) && (((uid_t)desiredOwnerId != statStruct->st_uid) && (directory && rootCanOverwriteOwnership && ((0 != statStruct->st_uid))))) ||
+        ((-1 != desiredGroupId) && (((gid_t)desiredGroupId != statStruct->st_gid) && (directory && rootCanOverwriteOwnership && ((0 != statStruct->st_gid))))))
+    {
+        OsConfigLogError(log, "CheckAccess: ownership of '%s' (%d, %d) does not match expected (%d, %d)",
+            name, statStruct->st_uid, statStruct->st_gid, desiredOwnerId, desiredGroupId);
+        OsConfigCaptureReason(reason, "Ownership of '%s' (%d, %d) does not match expected (%d, %d)",
+            name, statStruct->st_uid, statStruct->st_gid, desiredOwnerId, desiredGroupId);
+        result = ENOENT;
+    }
+    else
+    {
+        // Special case for the MPI Client
+        if (NULL != log)
+        {
+            OsConfigLogInfo(log, "CheckAccess: ownership of '%s' (%d, %d) matches expected (%d, %d)", 
+                name, statStruct->st_uid, statStruct->st_gid, desiredOwnerId, desiredGroupId);
+        }
+
+        // S_IXOTH (00001): Execute/search permission, others
+        // S_IWOTH (00002): Write permission, others
+        // S_IROTH (00004): Read permission, others
+        // S_IRWXO (00007): Read, write, execute/search by others
+        // S_IXGRP (00010): Execute/search permission, group
+        // S_IWGRP (00020): Write permission, group
+        // S_IRGRP (00040): Read permission, group
+        // S_IRWXG (00070): Read, write, execute/search by group
+        // S_IXUSR (00100): Execute/search permission, owner
+        // S_IWUSR (00200): Write permission, owner
+        // S_IRUSR (00400): Read permission, owner
+        // S_IRWXU (00700): Read, write, execute/search by owner
+        // S_ISVTX (01000): On directories, restricted deletion flag
+        // S_ISGID (02000): Set-group-ID on execution
+        // S_ISUID (04000): Set-user-ID on execution
+        
+        currentMode = DecimalToOctal(statStruct->st_mode & 07777);
+        desiredMode = desiredAccess;
+
+        if (((desiredMode & S_IRWXU) && ((desiredMode & S_IRWXU) != (currentMode & S_IRWXU))) ||
+            ((desiredMode & S_IRWXG) && ((desiredMode & S_IRWXG) != (currentMode & S_IRWXG))) ||
+            ((desiredMode & S_IRWXO) && ((desiredMode & S_IRWXO) != (currentMode & S_IRWXO))) ||
+            ((desiredMode & S_IRUSR) && ((desiredMode & S_IRUSR) != (currentMode & S_IRUSR))) ||
+            ((desiredMode & S_IRGRP) && ((desiredMode & S_IRGRP) != (currentMode & S_IRGRP))) ||
+            ((desiredMode & S_IROTH) && ((desiredMode & S_IROTH) != (currentMode & S_IROTH))) ||
+            ((desiredMode & S_IWUSR) && ((desiredMode & S_IWUSR) != (currentMode & S_IWUSR))) ||
+            ((desiredMode & S_IWGRP) && ((desiredMode & S_IWGRP) != (currentMode & S_IWGRP))) ||
+            ((desiredMode & S_IWOTH) && ((desiredMode & S_IWOTH) != (currentMode & S_IWOTH))) ||
+            ((desiredMode & S_IXUSR) && ((desiredMode & S_IXUSR) != (currentMode & S_IXUSR))) ||
+            ((desiredMode & S_IXGRP) && ((desiredMode & S_IXGRP) != (currentMode & S_IXGRP))) ||
+            ((desiredMode & S_IXOTH) && ((desiredMode & S_IXOTH) != (currentMode & S_IXOTH))) ||
+            ((desiredMode & S_ISUID) && ((desiredMode & S_ISUID) != (currentMode & S_ISUID))) ||
+            ((desiredMode & S_ISGID) && ((desiredMode & S_ISGID) != (currentMode & S_ISGID))) ||
+            (directory && (desiredMode & S_ISVTX) && ((desiredMode & S_ISVTX) != (currentMode & S_ISVTX))) ||
+            (currentMode > desiredMode))
+        {
+            OsConfigLogError(log, "CheckAccess: access to '%s' (%d) does not match expected (%d)", name, currentMode, desiredMode);
+            OsConfigCaptureReason(reason, "Access to '%s' (%d) does not match expected (%d)", name, currentMode, desiredMode);
+            result = ENOENT;
+        }
+        else
+        {
+            // Special case for the MPI Client
+            if (NULL != log)
+            {
+                OsConfigLogInfo(log, "CheckAccess: access to '%s' (%d) matches expected (%d)", name, currentMode, desiredMode);
+            }
+            
+            OsConfigCaptureSuccessReason(reason, "'%s' has required access (%d) and ownership (uid: %d, gid: %u)", name, desiredMode, desiredOwnerId, desiredGroupId);
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static int CheckAccess(bool directory, const char* name, int desiredOwnerId, int desiredGroupId, unsigned int desiredAccess, bool rootCanOverwriteOwnership, char** reason, void* log)
+{
+    struct stat statStruct = {0};
+    int result = ENOENT;
+
     if (NULL == name)
     {
         OsConfigLogError(log, "CheckAccess called with an invalid name argument");
@@ -599,76 +1053,7 @@ static int CheckAccess(bool directory, const char* name, int desiredOwnerId, int
     {
         if (0 == (result = stat(name, &statStruct)))
         {
-            if (((-1 != desiredOwnerId) && (((uid_t)desiredOwnerId != statStruct.st_uid) && (directory && rootCanOverwriteOwnership && ((0 != statStruct.st_uid))))) ||
-                ((-1 != desiredGroupId) && (((gid_t)desiredGroupId != statStruct.st_gid) && (directory && rootCanOverwriteOwnership && ((0 != statStruct.st_gid))))))
-            {
-                OsConfigLogError(log, "CheckAccess: ownership of '%s' (%d, %d) does not match expected (%d, %d)",
-                    name, statStruct.st_uid, statStruct.st_gid, desiredOwnerId, desiredGroupId);
-                OsConfigCaptureReason(reason, "Ownership of '%s' (%d, %d) does not match expected (%d, %d)",
-                    name, statStruct.st_uid, statStruct.st_gid, desiredOwnerId, desiredGroupId);
-                result = ENOENT;
-            }
-            else
-            {
-                // Special case for the MPI Client
-                if (NULL != log)
-                {
-                    OsConfigLogInfo(log, "CheckAccess: ownership of '%s' (%d, %d) matches expected (%d, %d)", 
-                        name, statStruct.st_uid, statStruct.st_gid, desiredOwnerId, desiredGroupId);
-                }
-
-                // S_IXOTH (00001): Execute/search permission, others
-                // S_IWOTH (00002): Write permission, others
-                // S_IROTH (00004): Read permission, others
-                // S_IRWXO (00007): Read, write, execute/search by others
-                // S_IXGRP (00010): Execute/search permission, group
-                // S_IWGRP (00020): Write permission, group
-                // S_IRGRP (00040): Read permission, group
-                // S_IRWXG (00070): Read, write, execute/search by group
-                // S_IXUSR (00100): Execute/search permission, owner
-                // S_IWUSR (00200): Write permission, owner
-                // S_IRUSR (00400): Read permission, owner
-                // S_IRWXU (00700): Read, write, execute/search by owner
-                // S_ISVTX (01000): On directories, restricted deletion flag
-                // S_ISGID (02000): Set-group-ID on execution
-                // S_ISUID (04000): Set-user-ID on execution
-                
-                currentMode = DecimalToOctal(statStruct.st_mode & 07777);
-                desiredMode = desiredAccess;
-
-                if (((desiredMode & S_IRWXU) && ((desiredMode & S_IRWXU) != (currentMode & S_IRWXU))) ||
-                    ((desiredMode & S_IRWXG) && ((desiredMode & S_IRWXG) != (currentMode & S_IRWXG))) ||
-                    ((desiredMode & S_IRWXO) && ((desiredMode & S_IRWXO) != (currentMode & S_IRWXO))) ||
-                    ((desiredMode & S_IRUSR) && ((desiredMode & S_IRUSR) != (currentMode & S_IRUSR))) ||
-                    ((desiredMode & S_IRGRP) && ((desiredMode & S_IRGRP) != (currentMode & S_IRGRP))) ||
-                    ((desiredMode & S_IROTH) && ((desiredMode & S_IROTH) != (currentMode & S_IROTH))) ||
-                    ((desiredMode & S_IWUSR) && ((desiredMode & S_IWUSR) != (currentMode & S_IWUSR))) ||
-                    ((desiredMode & S_IWGRP) && ((desiredMode & S_IWGRP) != (currentMode & S_IWGRP))) ||
-                    ((desiredMode & S_IWOTH) && ((desiredMode & S_IWOTH) != (currentMode & S_IWOTH))) ||
-                    ((desiredMode & S_IXUSR) && ((desiredMode & S_IXUSR) != (currentMode & S_IXUSR))) ||
-                    ((desiredMode & S_IXGRP) && ((desiredMode & S_IXGRP) != (currentMode & S_IXGRP))) ||
-                    ((desiredMode & S_IXOTH) && ((desiredMode & S_IXOTH) != (currentMode & S_IXOTH))) ||
-                    ((desiredMode & S_ISUID) && ((desiredMode & S_ISUID) != (currentMode & S_ISUID))) ||
-                    ((desiredMode & S_ISGID) && ((desiredMode & S_ISGID) != (currentMode & S_ISGID))) ||
-                    (directory && (desiredMode & S_ISVTX) && ((desiredMode & S_ISVTX) != (currentMode & S_ISVTX))) ||
-                    (currentMode > desiredMode))
-                {
-                    OsConfigLogError(log, "CheckAccess: access to '%s' (%d) does not match expected (%d)", name, currentMode, desiredMode);
-                    OsConfigCaptureReason(reason, "Access to '%s' (%d) does not match expected (%d)", name, currentMode, desiredMode);
-                    result = ENOENT;
-                }
-                else
-                {
-                    // Special case for the MPI Client
-                    if (NULL != log)
-                    {
-                        OsConfigLogInfo(log, "CheckAccess: access to '%s' (%d) matches expected (%d)", name, currentMode, desiredMode);
-                    }
-                    
-                    OsConfigCaptureSuccessReason(reason, "'%s' has required access (%d) and ownership (uid: %d, gid: %u)", name, desiredMode, desiredOwnerId, desiredGroupId);
-                    result = 0;
-                }
-            }
+            result = CheckStatAccess(&statStruct, directory, name, desiredOwnerId, desiredGroupId, desiredAccess, rootCanOverwriteOwnership, reason, log);
         }
         else
         {
@@ -762,49 +1147,63 @@ int SetDirectoryAccess(const char* directoryName, unsigned int desiredOwnerId, u
     return SetAccess(true, directoryName, desiredOwnerId, desiredGroupId, desiredAccess, log);
 }
 
-static unsigned int GetNumberOfCharacterInstancesInFile(const char* fileName, char what)
+// Block size used when counting characters in a file
+#define FILE_COUNT_BLOCK (64 * 1024)
+
+static unsigned int GetNumberOfCharacterInstancesInFile(const char* fileName, char what, bool stopAtFirst)
 {
     unsigned int numberOf = 0;
-    FILE* file = NULL;
-    int fileSize = 0;
-    int i = 0;
-    int next = 0;
+    char* buffer = NULL;
+    const char* next = NULL;
+    const char* end = NULL;
+    ssize_t bytes = 0;
+    int fileDescriptor = -1;
 
-    if (FileExists(fileName))
+    if ((NULL == fileName) || (0 > (fileDescriptor = open(fileName, O_RDONLY | O_CLOEXEC))))
+    {
+        return numberOf;
+    }
+
+    if (NULL != (buffer = (char*)malloc(FILE_COUNT_BLOCK)))
     {
-        if (NULL != (file = fopen(fileName, "r")))
+        while ((0 < (bytes = read(fileDescriptor, buffer, FILE_COUNT_BLOCK))) || ((0 > bytes) && (EINTR == errno)))
         {
-            fseek(file, 0, SEEK_END);
-            fileSize = ftell(file);
-            fseek(file, 0, SEEK_SET);
+            next = buffer;
+            end = buffer + ((bytes > 0) ? bytes : 0);
 
-            for (i = 0; i < fileSize; i++)
+            while ((next < end) && (NULL != (next = (const char*)memchr(next, what, (size_t)(end - next)))))
             {
-                if (what == (next = fgetc(file)))
-                {
-                    numberOf += 1;
-                }
-                else if (EOF == next)
+                numberOf += 1;
+                next += 1;
+
+                if (stopAtFirst)
                 {
                     break;
                 }
             }
 
-            fclose(file);
+            if (stopAtFirst && numberOf)
+            {
+                break;
+            }
         }
+
+        FREE_MEMORY(buffer);
     }
 
+    close(fileDescriptor);
+
     return numberOf;
 }
 
 unsigned int GetNumberOfLinesInFile(const char* fileName)
 {
-    return GetNumberOfCharacterInstancesInFile(fileName, EOL);
+    return GetNumberOfCharacterInstancesInFile(fileName, EOL, false);
 }
 
 bool CharacterFoundInFile(const char* fileName, char what)
 {
-    return (GetNumberOfCharacterInstancesInFile(fileName, what) > 0) ? true : false;
+    return (GetNumberOfCharacterInstancesInFile(fileName, what, true) > 0) ? true : false;
 }
 
 int CheckNoLegacyPlusEntriesInFile(const char* fileName, char** reason, void* log)
@@ -872,7 +1271,7 @@ int GetDirectoryAccess(const char* name, unsigned int* ownerId, unsigned int* gr
     return GetAccess(true, name, ownerId, groupId, mode, log);
 }
 
-static int RestoreSelinuxContext(const char* target, void* log)
+int RestoreSelinuxContext(const char* target, void* log)
 {
     char* restoreCommand = NULL;
     char* textResult = NULL;
@@ -910,6 +1309,9 @@ int RenameFile(const char* original, const char* target, void* log)
         return EINVAL;
     }
 
+    InvalidateFileCache(original);
+    InvalidateFileCache(target);
+
     if (0 == (status = rename(original, target)))
     {
         if (IsSelinuxPresent())
@@ -1016,6 +1418,8 @@ int ReplaceMarkedLinesInFile(const char* fileName, const char* marker, const cha
         return ENOMEM;
     }
 
+    InvalidateFileCache(fileName);
+
     if (NULL != (fileNameCopy = DuplicateString(fileName)))
     {
         fileDirectory = dirname(fileNameCopy);
@@ -1146,7 +1550,9 @@ int ReplaceMarkedLinesInFile(const char* fileName, const char* marker, const cha
 
 int FindTextInFile(const char* fileName, const char* text, void* log)
 {
-    char* contents = NULL;
+    FILE_SPAN contents = {0};
+    const char* end = NULL;
+    size_t size = 0;
     int status = 0;
 
     if ((NULL == fileName) || (NULL == text) || (0 == strlen(text)))
@@ -1161,14 +1567,17 @@ int FindTextInFile(const char* fileName, const char* text, void* log)
         return ENOENT;
     }
 
-    if (NULL == (contents = LoadStringFromFile(fileName, false, log)))
+    if (0 != OpenFileSpan(fileName, &contents, log))
     {
         OsConfigLogError(log, "FindTextInFile: cannot read from '%s'", fileName);
         status = ENOENT;
     }
     else
     {
-        if (NULL != strstr(contents, text))
+        // Like the string search this replaces, the contents end at the first null character
+        size = (NULL != (end = (const char*)memchr(contents.data, 0, contents.size))) ? (size_t)(end - contents.data) : contents.size;
+
+        if (NULL != memmem(contents.data, size, text, strlen(text)))
         {
             OsConfigLogInfo(log, "FindTextInFile: '%s' found in '%s'", text, fileName);
         }
@@ -1178,7 +1587,7 @@ int FindTextInFile(const char* fileName, const char* text, void* log)
             status = ENOENT;
         }
 
-        FREE_MEMORY(contents);
+        CloseFileSpan(&contents);
     }
 
     return status;
@@ -1407,7 +1816,7 @@ int CheckSmallFileContainsText(const char* fileName, const char* text, char** re
         return EINVAL;
     }
 
-    if (NULL != (contents = LoadStringFromFile(fileName, false, log)))
+    if (NULL != (contents = LoadCachedStringFromFile(fileName, log)))
     {
         contentsLength = strlen(contents);
         
@@ -1429,50 +1838,231 @@ int CheckSmallFileContainsText(const char* fileName, const char* text, char** re
     return status;
 }
 
-int FindTextInFolder(const char* directory, const char* text, void* log)
+// Folder searches skip files larger than this, the folders searched hold configuration files
+#define FOLDER_SEARCH_MAX_FILE_BYTES (16 * 1024 * 1024)
+
+// Folder entries are read and searched this many bytes at a time
+#define FOLDER_SEARCH_READ_CHUNK FILE_SPAN_MAP_THRESHOLD
+
+// Folders with at least this many candidate files are searched by a small pool of threads
+#define FOLDER_SEARCH_PARALLEL_ENTRIES 64
+#define FOLDER_SEARCH_MAX_THREADS 4
+
+typedef struct FOLDER_SEARCH
+{
+    const char* directory;
+    int directoryDescriptor;
+    const char* text;
+    size_t textLength;
+    char** names;
+    unsigned int numberOfNames;
+    unsigned int next;
+    bool found;
+    pthread_mutex_t lock;
+    void* log;
+} FOLDER_SEARCH;
+
+static int FindTextInFolderEntry(FOLDER_SEARCH* search, const char* name)
 {
-    const char* pathTemplate = "%s/%s";
+    struct stat statStruct = {0};
+    char* buffer = NULL;
+    const char* end = NULL;
+    size_t kept = 0;
+    size_t size = 0;
+    ssize_t bytes = 0;
+    off_t offset = 0;
+    int fileDescriptor = -1;
+    int status = ENOENT;
 
+    // Non-blocking so that a FIFO left in the folder cannot stall the open
+    if (0 > (fileDescriptor = openat(search->directoryDescriptor, name, O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK)))
+    {
+        return ENOENT;
+    }
+
+    if ((0 != fstat(fileDescriptor, &statStruct)) || (false == S_ISREG(statStruct.st_mode)) || (0 == statStruct.st_size))
+    {
+        status = ENOENT;
+    }
+    else if (statStruct.st_size > FOLDER_SEARCH_MAX_FILE_BYTES)
+    {
+        OsConfigLogInfo(search->log, "FindTextInFolder: skipping '%s/%s' of %ld bytes", search->directory, name, (long)statStruct.st_size);
+    }
+    else if (NULL != (buffer = (char*)malloc(FOLDER_SEARCH_READ_CHUNK + search->textLength)))
+    {
+        // Read in chunks instead of mapped, other processes may truncate these files while they are searched.
+        // The tail of each chunk that could start a match is kept in front of the next one, and the search ends at the first null character
+        while ((ENOENT == status) && (NULL == end))
+        {
+            if (0 >= (bytes = pread(fileDescriptor, buffer + kept, FOLDER_SEARCH_READ_CHUNK, offset)))
+            {
+                if ((0 > bytes) && (EINTR == errno))
+                {
+                    continue;
+                }
+                break;
+            }
+
+            offset += bytes;
+            size = (NULL != (end = (const char*)memchr(buffer + kept, 0, (size_t)bytes))) ? (size_t)(end - buffer) : (kept + (size_t)bytes);
+
+            if (NULL != memmem(buffer, size, search->text, search->textLength))
+            {
+                status = 0;
+            }
+            else
+            {
+                kept = (size < search->textLength) ? size : (search->textLength - 1);
+                memmove(buffer, buffer + size - kept, kept);
+            }
+        }
+
+        FREE_MEMORY(buffer);
+    }
+
+    close(fileDescriptor);
+
+    if (0 == status)
+    {
+        OsConfigLogInfo(search->log, "FindTextInFolder: '%s' found in '%s/%s'", search->text, search->directory, name);
+    }
+
+    return status;
+}
+
+static void* FolderSearchWorker(void* context)
+{
+    FOLDER_SEARCH* search = (FOLDER_SEARCH*)context;
+    unsigned int index = 0;
+
+    while (true)
+    {
+        pthread_mutex_lock(&search->lock);
+        index = search->found ? search->numberOfNames : search->next++;
+        pthread_mutex_unlock(&search->lock);
+
+        if (index >= search->numberOfNames)
+        {
+            break;
+        }
+
+        if (0 == FindTextInFolderEntry(search, search->names[index]))
+        {
+            // Callers only need to know whether the text is present anywhere, stop the other workers
+            pthread_mutex_lock(&search->lock);
+            search->found = true;
+            pthread_mutex_unlock(&search->lock);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+int FindTextInFolder(const char* directory, const char* text, void* log)
+{
+    FOLDER_SEARCH search = {0};
+    pthread_t threads[FOLDER_SEARCH_MAX_THREADS] = {0};
+    unsigned int numberOfThreads = 0;
+    unsigned int capacity = 0;
+    unsigned int i = 0;
     DIR* home = NULL;
     struct dirent* entry = NULL;
-    char* path = NULL;
-    size_t length = 0;
-    int status = ENOENT, _status = 0;
+    char** names = NULL;
+    int status = ENOENT;
 
     if ((NULL == directory) || (false == DirectoryExists(directory)) || (NULL == text))
     {
         OsConfigLogError(log, "FindTextInFolder called with invalid arguments");
         return EINVAL;
     }
-    
-    if (NULL != (home = opendir(directory)))
+
+    if (0 == strlen(text))
+    {
+        OsConfigLogInfo(log, "FindTextInFolder: '%s' not found in any file under '%s'", text, directory);
+        return ENOENT;
+    }
+
+    if (NULL == (home = opendir(directory)))
+    {
+        OsConfigLogError(log, "FindTextInFolder: cannot open '%s' (%d)", directory, errno);
+        return ENOENT;
+    }
+
+    search.directory = directory;
+    search.directoryDescriptor = dirfd(home);
+    search.text = text;
+    search.textLength = strlen(text);
+    search.log = log;
+    pthread_mutex_init(&search.lock, NULL);
+
+    while (NULL != (entry = readdir(home)))
     {
-        while (NULL != (entry = readdir(home)))
+        if ((0 == strcmp(entry->d_name, ".")) || (0 == strcmp(entry->d_name, "..")))
         {
-            if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
+            continue;
+        }
+
+        // Entries known not to be files or links to files are skipped without opening them
+        if ((DT_UNKNOWN != entry->d_type) && (DT_REG != entry->d_type) && (DT_LNK != entry->d_type))
+        {
+            continue;
+        }
+
+        if (search.numberOfNames >= capacity)
+        {
+            capacity = capacity ? (capacity * 2) : 32;
+            if (NULL == (names = (char**)realloc(search.names, capacity * sizeof(char*))))
             {
-                length = strlen(pathTemplate) + strlen(directory) + strlen(entry->d_name);
-                if (NULL == (path = malloc(length + 1)))
-                {
-                    OsConfigLogError(log, "FindTextInFolder: out of memory");
-                    status = ENOMEM;
-                    break;
-                }
+                OsConfigLogError(log, "FindTextInFolder: out of memory");
+                status = ENOMEM;
+                break;
+            }
+            search.names = names;
+        }
 
-                memset(path, 0, length + 1);
-                snprintf(path, length, pathTemplate, directory, entry->d_name);
+        if (NULL == (search.names[search.numberOfNames] = DuplicateString(entry->d_name)))
+        {
+            OsConfigLogError(log, "FindTextInFolder: out of memory");
+            status = ENOMEM;
+            break;
+        }
+
+        search.numberOfNames += 1;
+    }
 
-                if ((0 == (_status = FindTextInFile(path, text, log))) && (0 != status))
+    if (ENOMEM != status)
+    {
+        if (search.numberOfNames >= FOLDER_SEARCH_PARALLEL_ENTRIES)
+        {
+            for (i = 0; i < (FOLDER_SEARCH_MAX_THREADS - 1); i++)
+            {
+                if (0 == pthread_create(&threads[numberOfThreads], NULL, FolderSearchWorker, &search))
                 {
-                    status = _status;
+                    numberOfThreads += 1;
                 }
-
-                FREE_MEMORY(path);
             }
         }
 
-        closedir(home);
+        // The calling thread takes part in the search and does all of it when no workers were started
+        FolderSearchWorker(&search);
+
+        for (i = 0; i < numberOfThreads; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+
+        status = search.found ? 0 : ENOENT;
+    }
+
+    for (i = 0; i < search.numberOfNames; i++)
+    {
+        FREE_MEMORY(search.names[i]);
     }
+    FREE_MEMORY(search.names);
+
+    pthread_mutex_destroy(&search.lock);
+    closedir(home);
 
     if (status)
     {
@@ -1532,7 +2122,7 @@ static int IsLineNotFoundOrCommentedOut(const char* fileName, char commentMark,
 
     if (FileExists(fileName))
     {
-        if (NULL == (contents = LoadStringFromFile(fileName, false, log)))
+        if (NULL == (contents = LoadCachedStringFromFile(fileName, log)))
         {
             OsConfigLogError(log, "IsLineNotFoundOrCommentedOut: cannot read from '%s'", fileName);
             OsConfigCaptureReason(reason, "Cannot read from file '%s'", fileName);
@@ -1654,7 +2244,118 @@ int CheckLineFoundNotCommentedOut(const char* fileName, char commentMark, const
     return result;
 }
 
-static int FindTextInCommandOutput(const char* command, const char* text, void* log)
+// Same outcome and reasons as a chain of CheckTextIsNotFoundInFile calls stopping at the first text found, with a single pass over the file
+int CheckTextsAreNotFoundInFile(const char* fileName, const char** texts, unsigned int numberOfTexts, char** reason, void* log)
+{
+    TEXT_SEARCH_RESULT* results = NULL;
+    unsigned int i = 0;
+    int result = 0;
+
+    if ((NULL == fileName) || (NULL == texts) || (0 == numberOfTexts))
+    {
+        OsConfigLogError(log, "CheckTextsAreNotFoundInFile called with invalid arguments");
+        return EINVAL;
+    }
+
+    if (false == FileExists(fileName))
+    {
+        OsConfigCaptureSuccessReason(reason, "'%s' not found", fileName);
+    }
+    else if (NULL == (results = (TEXT_SEARCH_RESULT*)calloc(numberOfTexts, sizeof(TEXT_SEARCH_RESULT))))
+    {
+        OsConfigLogError(log, "CheckTextsAreNotFoundInFile: out of memory");
+        result = ENOMEM;
+    }
+    else
+    {
+        if (0 == (result = SearchTextsInFile(fileName, texts, numberOfTexts, 0, results, log)))
+        {
+            for (i = 0; i < numberOfTexts; i++)
+            {
+                if (0 == results[i].found)
+                {
+                    OsConfigCaptureSuccessReason(reason, "'%s' not found in '%s'", texts[i], fileName);
+                }
+                else
+                {
+                    OsConfigLogInfo(log, "CheckTextsAreNotFoundInFile: '%s' found in '%s' at line %u", texts[i], fileName, results[i].firstLine);
+                    OsConfigCaptureReason(reason, "'%s' found in '%s'", texts[i], fileName);
+                    result = ENOENT;
+                    break;
+                }
+            }
+        }
+
+        FREE_MEMORY(results);
+    }
+
+    return result;
+}
+
+// Same outcome and reasons as a chain of CheckLineNotFoundOrCommentedOut calls stopping at the first uncommented line, with a single pass over the file
+int CheckLinesNotFoundOrCommentedOut(const char* fileName, char commentMark, const char** texts, unsigned int numberOfTexts, char** reason, void* log)
+{
+    TEXT_SEARCH_RESULT* results = NULL;
+    unsigned int i = 0;
+    int result = 0;
+
+    if ((NULL == fileName) || (NULL == texts) || (0 == numberOfTexts))
+    {
+        OsConfigLogError(log, "CheckLinesNotFoundOrCommentedOut called with invalid arguments");
+        return EINVAL;
+    }
+
+    if (false == FileExists(fileName))
+    {
+        for (i = 0; i < numberOfTexts; i++)
+        {
+            if (OsConfigIsSuccessReason(reason))
+            {
+                OsConfigCaptureSuccessReason(reason, "'%s' not found to look for '%s'", fileName, texts[i]);
+            }
+            else
+            {
+                OsConfigCaptureReason(reason, "'%s' is not found to look for '%s'", fileName, texts[i]);
+            }
+        }
+    }
+    else if (NULL == (results = (TEXT_SEARCH_RESULT*)calloc(numberOfTexts, sizeof(TEXT_SEARCH_RESULT))))
+    {
+        OsConfigLogError(log, "CheckLinesNotFoundOrCommentedOut: out of memory");
+        result = ENOMEM;
+    }
+    else
+    {
+        if (0 != (result = SearchTextsInFile(fileName, texts, numberOfTexts, commentMark, results, log)))
+        {
+            OsConfigCaptureReason(reason, "Cannot read from file '%s'", fileName);
+        }
+        else
+        {
+            for (i = 0; i < numberOfTexts; i++)
+            {
+                if (results[i].foundUncommented > 0)
+                {
+                    OsConfigLogInfo(log, "CheckLinesNotFoundOrCommentedOut: '%s' found in '%s' and it's not commented out with '%c'", texts[i], fileName, commentMark);
+                    OsConfigCaptureReason(reason, "'%s' found in '%s' and it's not commented out with '%c'", texts[i], fileName, commentMark);
+                    result = EEXIST;
+                    break;
+                }
+                else
+                {
+                    OsConfigCaptureSuccessReason(reason, "'%s' not found in '%s' or it's commented out with '%c'", texts[i], fileName, commentMark);
+                }
+            }
+        }
+
+        FREE_MEMORY(results);
+    }
+
+    return result;
+}
+
+// Audit passes probe the same read-only commands many times, their outputs are reused unless something gets remediated
+static int FindTextInCommandOutput(const char* command, const char* text, unsigned int cacheSeconds, void* log)
 {
     char* results = NULL;
     int status = 0;
@@ -1666,7 +2367,7 @@ static int FindTextInCommandOutput(const char* command, const char* text, void*
     }
 
     // Execute this command with a 60 seconds timeout
-    if (0 == (status = ExecuteCommand(NULL, command, true, false, 0, 60, &results, NULL, log)))
+    if (0 == (status = ExecuteCachedCommand(NULL, command, true, false, 0, 60, cacheSeconds, &results, log)))
     {
         if ((NULL != results) && (0 < strlen(results)) && (NULL != strstr(results, text)))
         {
@@ -1687,11 +2388,11 @@ static int FindTextInCommandOutput(const char* command, const char* text, void*
     return status;
 }
 
-int CheckTextFoundInCommandOutput(const char* command, const char* text, char** reason, void* log)
+static int CheckTextFoundInCommandOutputWithCache(const char* command, const char* text, unsigned int cacheSeconds, char** reason, void* log)
 {
     int result = 0;
 
-    if (0 == (result = FindTextInCommandOutput(command, text, log)))
+    if (0 == (result = FindTextInCommandOutput(command, text, cacheSeconds, log)))
     {
         OsConfigCaptureSuccessReason(reason, "'%s' found in response from command '%s'", text, command);
     }
@@ -1707,11 +2408,21 @@ int CheckTextFoundInCommandOutput(const char* command, const char* text, char**
     return result;
 }
 
+int CheckTextFoundInCommandOutput(const char* command, const char* text, char** reason, void* log)
+{
+    return CheckTextFoundInCommandOutputWithCache(command, text, 0, reason, log);
+}
+
+int CheckTextFoundInCachedCommandOutput(const char* command, const char* text, char** reason, void* log)
+{
+    return CheckTextFoundInCommandOutputWithCache(command, text, COMMAND_CACHE_SECONDS, reason, log);
+}
+
 int CheckTextNotFoundInCommandOutput(const char* command, const char* text, char** reason, void* log)
 {
     int result = 0;
 
-    if (ENOENT == (result = FindTextInCommandOutput(command, text, log)))
+    if (ENOENT == (result = FindTextInCommandOutput(command, text, 0, log)))
     {
         OsConfigCaptureSuccessReason(reason, "'%s' not found in response from command '%s'", text, command);
         result = 0;
@@ -1787,7 +2498,7 @@ char* GetStringOptionFromFile(const char* fileName, const char* option, char sep
 
     if (option && (0 == CheckFileExists(fileName, NULL, log)))
     {
-        if (NULL == (contents = LoadStringFromFile(fileName, false, log)))
+        if (NULL == (contents = LoadCachedStringFromFile(fileName, log)))
         {
             OsConfigLogError(log, "GetStringOptionFromFile: cannot read from '%s'", fileName);
         }
@@ -1816,7 +2527,7 @@ int GetIntegerOptionFromFile(const char* fileName, const char* option, char sepa
 
     if (option && (0 == CheckFileExists(fileName, NULL, log)))
     {
-        if (NULL == (contents = LoadStringFromFile(fileName, false, log)))
+        if (NULL == (contents = LoadCachedStringFromFile(fileName, log)))
         {
             OsConfigLogError(log, "GetIntegerOptionFromFile: cannot read from '%s'", fileName);
         }
@@ -0,0 +1,278 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "Internal.h"
+
+static long long GetGitTimeMilliseconds(void)
+{
+    struct timespec now = {0};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((long long)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+static int ExecuteTimedGitCommand(const char* command, const char* operation, void* log)
+{
+    long long startTime = GetGitTimeMilliseconds();
+    int error = ExecuteCommand(NULL, command, false, false, 0, 0, NULL, NULL, log);
+
+    OsConfigLogInfo(log, "Git %s completed with %d in %lld milliseconds", operation, error, GetGitTimeMilliseconds() - startTime);
+
+    return error;
+}
+
+static int ReadGitCommitId(const char* command, char* commitId, void* log)
+{
+    char* textResult = NULL;
+    size_t length = 0;
+    int error = 0;
+
+    memset(commitId, 0, GIT_COMMIT_ID_MAX_LENGTH + 1);
+
+    if (0 == (error = ExecuteCommand(NULL, command, false, false, 0, 0, &textResult, NULL, log)))
+    {
+        // The commit id is the first token of the command output
+        length = textResult ? strspn(textResult, "0123456789abcdef") : 0;
+        if ((40 == length) || (GIT_COMMIT_ID_MAX_LENGTH == length))
+        {
+            memcpy(commitId, textResult, length);
+        }
+        else
+        {
+            error = ENOENT;
+        }
+    }
+
+    FREE_MEMORY(textResult);
+
+    return error;
+}
+
+static int ReadGitCloneCommitId(const char* clonePath, char* commitId, void* log)
+{
+    const char* headTemplate = "git -C %s rev-parse HEAD";
+    char* headCommand = NULL;
+    int error = 0;
+
+    if (NULL == (headCommand = FormatAllocateString(headTemplate, clonePath)))
+    {
+        OsConfigLogError(log, "ReadGitCloneCommitId: out of memory");
+        return ENOMEM;
+    }
+
+    error = ReadGitCommitId(headCommand, commitId, log);
+
+    FREE_MEMORY(headCommand);
+
+    return error;
+}
+
+static int ConfigureGitSparseCheckout(const char* clonePath, const char* sparsePath, void* log)
+{
+    const char* sparseConfigTemplate = "git -C %s config core.sparseCheckout true";
+    const char* infoDirectoryTemplate = "%s/.git/info";
+    const char* sparseFileTemplate = "%s/.git/info/sparse-checkout";
+    const char* sparsePatternTemplate = "/%s\n";
+
+    char* sparseConfigCommand = FormatAllocateString(sparseConfigTemplate, clonePath);
+    char* infoDirectory = FormatAllocateString(infoDirectoryTemplate, clonePath);
+    char* sparseFile = FormatAllocateString(sparseFileTemplate, clonePath);
+    char* sparsePattern = FormatAllocateString(sparsePatternTemplate, sparsePath);
+    int error = 0;
+
+    if ((NULL == sparseConfigCommand) || (NULL == infoDirectory) || (NULL == sparseFile) || (NULL == sparsePattern))
+    {
+        OsConfigLogError(log, "ConfigureGitSparseCheckout: out of memory");
+        error = ENOMEM;
+    }
+    else if (0 != (error = ExecuteCommand(NULL, sparseConfigCommand, false, false, 0, 0, NULL, NULL, log)))
+    {
+        OsConfigLogError(log, "ConfigureGitSparseCheckout: failed enabling sparse checkout for the Git clone at %s (%d)", clonePath, error);
+    }
+    else if ((0 != mkdir(infoDirectory, S_IRWXU)) && (EEXIST != errno))
+    {
+        error = errno;
+        OsConfigLogError(log, "ConfigureGitSparseCheckout: failed creating %s (%d)", infoDirectory, error);
+    }
+    else if (false == SavePayloadToFile(sparseFile, sparsePattern, strlen(sparsePattern), log))
+    {
+        OsConfigLogError(log, "ConfigureGitSparseCheckout: failed saving the sparse checkout pattern to %s", sparseFile);
+        error = EACCES;
+    }
+
+    FREE_MEMORY(sparseConfigCommand);
+    FREE_MEMORY(infoDirectory);
+    FREE_MEMORY(sparseFile);
+    FREE_MEMORY(sparsePattern);
+
+    return error;
+}
+
+int DeleteGitClone(const char* clonePath, void* log)
+{
+    const char* cleanUpTemplate = "rm -r %s";
+    char* cleanUpCommand = NULL;
+    int result = 0;
+
+    if (NULL == clonePath)
+    {
+        OsConfigLogError(log, "DeleteGitClone: invalid argument");
+        return EINVAL;
+    }
+
+    if (NULL == (cleanUpCommand = FormatAllocateString(cleanUpTemplate, clonePath)))
+    {
+        OsConfigLogError(log, "DeleteGitClone: out of memory");
+        return ENOMEM;
+    }
+
+    result = ExecuteCommand(NULL, cleanUpCommand, false, false, 0, 0, NULL, NULL, log);
+    FREE_MEMORY(cleanUpCommand);
+
+    return result;
+}
+
+int CloneGitBranch(const char* repositoryUrl, const char* branch, const char* clonePath, const char* sparsePath, char* commitId, void* log)
+{
+    // A shallow clone of only the branch tip, without a working tree, where only the sparse path is later checked out.
+    // The blob filter avoids downloading any other file contents but needs Git 2.19 or newer, so we retry without it
+    const char* cloneTemplate = "git clone -q --depth 1 --branch %s --single-branch --no-checkout %s %s %s";
+    const char* blobFilter = "--filter=blob:none";
+    const char* configTemplate = "git config --global --add safe.directory %s";
+    const char* checkoutTemplate = "git -C %s checkout -q %s";
+
+    char* configCommand = NULL;
+    char* cloneCommand = NULL;
+    char* filteredCloneCommand = NULL;
+    char* checkoutCommand = NULL;
+    int error = 0;
+
+    // Do not log repositoryUrl as it may contain Git account credentials
+
+    if ((NULL == repositoryUrl) || (NULL == branch) || (NULL == clonePath) || (NULL == sparsePath) || (NULL == commitId) ||
+        (0 == strcmp("", clonePath)) || (0 == strcmp("", sparsePath)))
+    {
+        OsConfigLogError(log, "CloneGitBranch: invalid arguments");
+        return EINVAL;
+    }
+    else if ((0 == strcmp("", repositoryUrl)) || (0 == strcmp("", branch)))
+    {
+        OsConfigLogError(log, "CloneGitBranch: invoked with no Git repository or branch");
+        return ENOENT;
+    }
+
+    memset(commitId, 0, GIT_COMMIT_ID_MAX_LENGTH + 1);
+
+    filteredCloneCommand = FormatAllocateString(cloneTemplate, branch, blobFilter, repositoryUrl, clonePath);
+    cloneCommand = FormatAllocateString(cloneTemplate, branch, "", repositoryUrl, clonePath);
+    configCommand = FormatAllocateString(configTemplate, clonePath);
+    checkoutCommand = FormatAllocateString(checkoutTemplate, clonePath, branch);
+
+    if ((NULL == filteredCloneCommand) || (NULL == cloneCommand) || (NULL == configCommand) || (NULL == checkoutCommand))
+    {
+        OsConfigLogError(log, "CloneGitBranch: out of memory");
+        error = ENOMEM;
+    }
+    else
+    {
+        DeleteGitClone(clonePath, log);
+
+        if (0 != ExecuteTimedGitCommand(filteredCloneCommand, "filtered clone", log))
+        {
+            DeleteGitClone(clonePath, log);
+            error = ExecuteTimedGitCommand(cloneCommand, "clone", log);
+        }
+
+        if (0 != error)
+        {
+            OsConfigLogError(log, "CloneGitBranch: failed making a new Git clone at %s (%d)", clonePath, error);
+        }
+        else if (0 != (error = ExecuteCommand(NULL, configCommand, false, false, 0, 0, NULL, NULL, log)))
+        {
+            OsConfigLogError(log, "CloneGitBranch: failed configuring the new Git clone at %s (%d)", clonePath, error);
+        }
+        else if (0 != (error = ConfigureGitSparseCheckout(clonePath, sparsePath, log)))
+        {
+            OsConfigLogError(log, "CloneGitBranch: failed configuring sparse checkout for the new Git clone at %s (%d)", clonePath, error);
+        }
+        else if (0 != (error = ExecuteCommand(NULL, checkoutCommand, false, false, 0, 0, NULL, NULL, log)))
+        {
+            OsConfigLogError(log, "CloneGitBranch: failed checking out Git branch %s (%d)", branch, error);
+        }
+        else if (0 != (error = ReadGitCloneCommitId(clonePath, commitId, log)))
+        {
+            OsConfigLogError(log, "CloneGitBranch: failed reading the current commit of the new Git clone at %s (%d)", clonePath, error);
+        }
+    }
+
+    FREE_MEMORY(filteredCloneCommand);
+    FREE_MEMORY(cloneCommand);
+    FREE_MEMORY(configCommand);
+    FREE_MEMORY(checkoutCommand);
+
+    return error;
+}
+
+int UpdateGitClone(const char* branch, const char* clonePath, char* commitId, bool* updated, void* log)
+{
+    const char* remoteHeadTemplate = "git -C %s ls-remote -q origin refs/heads/%s";
+    const char* fetchTemplate = "git -C %s fetch -q --depth 1 origin %s";
+    const char* resetTemplate = "git -C %s reset -q --hard FETCH_HEAD";
+
+    char remoteCommitId[GIT_COMMIT_ID_MAX_LENGTH + 1] = {0};
+    char* remoteHeadCommand = NULL;
+    char* fetchCommand = NULL;
+    char* resetCommand = NULL;
+    int error = 0;
+
+    if ((NULL == branch) || (NULL == clonePath) || (NULL == commitId) || (NULL == updated))
+    {
+        OsConfigLogError(log, "UpdateGitClone: invalid arguments");
+        return EINVAL;
+    }
+
+    *updated = false;
+
+    remoteHeadCommand = FormatAllocateString(remoteHeadTemplate, clonePath, branch);
+    fetchCommand = FormatAllocateString(fetchTemplate, clonePath, branch);
+    resetCommand = FormatAllocateString(resetTemplate, clonePath);
+
+    if ((NULL == remoteHeadCommand) || (NULL == fetchCommand) || (NULL == resetCommand))
+    {
+        OsConfigLogError(log, "UpdateGitClone: out of memory");
+        error = ENOMEM;
+    }
+    else if (0 != (error = ReadGitCommitId(remoteHeadCommand, remoteCommitId, log)))
+    {
+        OsConfigLogError(log, "UpdateGitClone: failed reading the head commit of Git branch %s (%d)", branch, error);
+    }
+    else if (0 == strcmp(remoteCommitId, commitId))
+    {
+        // The branch did not move since the last update, there is nothing to fetch or check out
+        if (IsFullLoggingEnabled())
+        {
+            OsConfigLogInfo(log, "UpdateGitClone: Git branch %s is unchanged at commit %s", branch, commitId);
+        }
+    }
+    else if (0 != (error = ExecuteTimedGitCommand(fetchCommand, "fetch", log)))
+    {
+        OsConfigLogError(log, "UpdateGitClone: failed Git fetch from branch %s to local clone %s (%d)", branch, clonePath, error);
+    }
+    else if (0 != (error = ExecuteCommand(NULL, resetCommand, false, false, 0, 0, NULL, NULL, log)))
+    {
+        OsConfigLogError(log, "UpdateGitClone: failed checking out Git branch %s (%d)", branch, error);
+    }
+    else if (0 != (error = ReadGitCloneCommitId(clonePath, commitId, log)))
+    {
+        OsConfigLogError(log, "UpdateGitClone: failed reading the current commit of the Git clone at %s (%d)", clonePath, error);
+    }
+    else
+    {
+        *updated = true;
+    }
+
+    FREE_MEMORY(remoteHeadCommand);
+    FREE_MEMORY(fetchCommand);
+    FREE_MEMORY(resetCommand);
+
+    return error;
+}
@@ -0,0 +1,214 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "Internal.h"
+
+#include <fcntl.h>
+
+// Size of the chunks read from the files being hashed
+#define HASH_READ_CHUNK (64 * 1024)
+
+// SHA-256 as specified in FIPS 180-4
+static const uint32_t g_sha256RoundConstants[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define SHA256_ROTATE(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void Sha256Transform(SHA256_CONTEXT* context, const unsigned char* block)
+{
+    uint32_t schedule[64] = {0};
+    uint32_t a = 0, b = 0, c = 0, d = 0, e = 0, f = 0, g = 0, h = 0;
+    uint32_t first = 0, second = 0;
+    int i = 0;
+
+    for (i = 0; i < 16; i++)
+    {
+        schedule[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) | ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+    }
+
+    for (i = 16; i < 64; i++)
+    {
+        first = SHA256_ROTATE(schedule[i - 15], 7) ^ SHA256_ROTATE(schedule[i - 15], 18) ^ (schedule[i - 15] >> 3);
+        second = SHA256_ROTATE(schedule[i - 2], 17) ^ SHA256_ROTATE(schedule[i - 2], 19) ^ (schedule[i - 2] >> 10);
+        schedule[i] = schedule[i - 16] + first + schedule[i - 7] + second;
+    }
+
+    a = context->state[0];
+    b = context->state[1];
+    c = context->state[2];
+    d = context->state[3];
+    e = context->state[4];
+    f = context->state[5];
+    g = context->state[6];
+    h = context->state[7];
+
+    for (i = 0; i < 64; i++)
+    {
+        first = h + (SHA256_ROTATE(e, 6) ^ SHA256_ROTATE(e, 11) ^ SHA256_ROTATE(e, 25)) + ((e & f) ^ (~e & g)) + g_sha256RoundConstants[i] + schedule[i];
+        second = (SHA256_ROTATE(a, 2) ^ SHA256_ROTATE(a, 13) ^ SHA256_ROTATE(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + first;
+        d = c;
+        c = b;
+        b = a;
+        a = first + second;
+    }
+
+    context->state[0] += a;
+    context->state[1] += b;
+    context->state[2] += c;
+    context->state[3] += d;
+    context->state[4] += e;
+    context->state[5] += f;
+    context->state[6] += g;
+    context->state[7] += h;
+}
+
+void Sha256Initialize(SHA256_CONTEXT* context)
+{
+    static const uint32_t initialState[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+    memset(context, 0, sizeof(SHA256_CONTEXT));
+    memcpy(context->state, initialState, sizeof(initialState));
+}
+
+void Sha256Update(SHA256_CONTEXT* context, const void* data, size_t length)
+{
+    const unsigned char* next = (const unsigned char*)data;
+    size_t take = 0;
+
+    context->length += length;
+
+    if (context->blockSize > 0)
+    {
+        take = ((SHA256_BLOCK_SIZE - context->blockSize) < length) ? (SHA256_BLOCK_SIZE - context->blockSize) : length;
+        memcpy(context->block + context->blockSize, next, take);
+        context->blockSize += take;
+        next += take;
+        length -= take;
+
+        if (SHA256_BLOCK_SIZE == context->blockSize)
+        {
+            Sha256Transform(context, context->block);
+            context->blockSize = 0;
+        }
+    }
+
+    // Whole blocks are hashed where they are, only the tail is kept for the next update
+    for (; length >= SHA256_BLOCK_SIZE; next += SHA256_BLOCK_SIZE, length -= SHA256_BLOCK_SIZE)
+    {
+        Sha256Transform(context, next);
+    }
+
+    if (length > 0)
+    {
+        memcpy(context->block, next, length);
+        context->blockSize = length;
+    }
+}
+
+// Writes the digest as 64 lowercase hexadecimal characters and a null terminator, same as sha256sum prints it
+void Sha256Finalize(SHA256_CONTEXT* context, char* digest)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    uint64_t bits = context->length * 8;
+    int i = 0;
+
+    context->block[context->blockSize++] = 0x80;
+
+    if (context->blockSize > (SHA256_BLOCK_SIZE - 8))
+    {
+        memset(context->block + context->blockSize, 0, SHA256_BLOCK_SIZE - context->blockSize);
+        Sha256Transform(context, context->block);
+        context->blockSize = 0;
+    }
+
+    memset(context->block + context->blockSize, 0, SHA256_BLOCK_SIZE - 8 - context->blockSize);
+
+    for (i = 0; i < 8; i++)
+    {
+        context->block[SHA256_BLOCK_SIZE - 1 - i] = (unsigned char)(bits >> (i * 8));
+    }
+
+    Sha256Transform(context, context->block);
+
+    for (i = 0; i < 32; i++)
+    {
+        digest[i * 2] = hexDigits[(context->state[i / 4] >> (24 - ((i % 4) * 8)) >> 4) & 0x0F];
+        digest[i * 2 + 1] = hexDigits[(context->state[i / 4] >> (24 - ((i % 4) * 8))) & 0x0F];
+    }
+
+    digest[SHA256_DIGEST_LENGTH] = 0;
+}
+
+char* HashFile(const char* fileName, void* log)
+{
+    SHA256_CONTEXT context;
+    char* buffer = NULL;
+    char* hash = NULL;
+    ssize_t bytes = 0;
+    int descriptor = -1;
+    int status = 0;
+
+    if (NULL == fileName)
+    {
+        OsConfigLogError(log, "HashFile called with an invalid argument");
+        return NULL;
+    }
+
+    if (0 > (descriptor = open(fileName, O_RDONLY | O_CLOEXEC)))
+    {
+        OsConfigLogError(log, "HashFile: cannot open '%s' (%d)", fileName, errno);
+        return NULL;
+    }
+
+    if ((NULL == (buffer = (char*)malloc(HASH_READ_CHUNK))) || (NULL == (hash = (char*)malloc(SHA256_DIGEST_LENGTH + 1))))
+    {
+        OsConfigLogError(log, "HashFile: out of memory");
+        status = ENOMEM;
+    }
+    else
+    {
+        Sha256Initialize(&context);
+
+        while (0 != (bytes = read(descriptor, buffer, HASH_READ_CHUNK)))
+        {
+            if (bytes > 0)
+            {
+                Sha256Update(&context, buffer, (size_t)bytes);
+            }
+            else if (EINTR != errno)
+            {
+                status = errno ? errno : EIO;
+                OsConfigLogError(log, "HashFile: cannot read '%s' (%d)", fileName, status);
+                break;
+            }
+        }
+
+        if (0 == status)
+        {
+            Sha256Finalize(&context, hash);
+        }
+    }
+
+    close(descriptor);
+    FREE_MEMORY(buffer);
+
+    if (0 != status)
+    {
+        FREE_MEMORY(hash);
+    }
+
+    return hash;
+}
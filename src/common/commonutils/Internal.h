@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
 #include <sys/types.h>
@@ -42,4 +43,26 @@
 
 #define MAX_STRING_LENGTH 512
 
+#define SHA256_BLOCK_SIZE 64
+#define SHA256_DIGEST_LENGTH 64
+
+typedef struct SHA256_CONTEXT
+{
+    uint32_t state[8];
+    uint64_t length;
+    unsigned char block[SHA256_BLOCK_SIZE];
+    size_t blockSize;
+} SHA256_CONTEXT;
+
+// Counts how many times each name (or id, when names is NULL) appears among the keys, returns an allocated array parallel to the keys
+unsigned int* CountAccountKeys(const char** names, const unsigned int* ids, unsigned int numberOfKeys, void* log);
+
+// Relabels the file with restorecon, for files replaced by rename when SELinux is present
+int RestoreSelinuxContext(const char* target, void* log);
+
+// Streaming SHA-256, the digest is written as SHA256_DIGEST_LENGTH hexadecimal characters plus a null terminator
+void Sha256Initialize(SHA256_CONTEXT* context);
+void Sha256Update(SHA256_CONTEXT* context, const void* data, size_t length);
+void Sha256Finalize(SHA256_CONTEXT* context, char* digest);
+
 #endif // INTERNAL_H
\ No newline at end of file
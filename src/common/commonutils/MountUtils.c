@@ -3,12 +3,229 @@
 
 #include "Internal.h"
 
-int CheckFileSystemMountingOption(const char* mountFileName, const char* mountDirectory, const char* mountType, const char* desiredOption, char** reason, void* log)
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+
+// Mount tables stay parsed while the file is unchanged, so that all mount checks during an audit share one parse
+typedef struct MOUNT_ENTRY
+{
+    char* fsName;
+    char* directory;
+    char* type;
+    char* options;
+    int frequency;
+    int pass;
+} MOUNT_ENTRY;
+
+typedef struct MOUNT_TABLE
+{
+    char* fileName;
+    // Live tables (such as /etc/mtab linked to /proc/self/mounts) change without a new mtime and are checked with g_mountGeneration
+    bool live;
+    unsigned long long generation;
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec modified;
+    MOUNT_ENTRY* entries;
+    unsigned int numberOfEntries;
+    struct MOUNT_TABLE* next;
+} MOUNT_TABLE;
+
+static MOUNT_TABLE* g_mountTables = NULL;
+static pthread_mutex_t g_mountTablesLock = PTHREAD_MUTEX_INITIALIZER;
+
+// The kernel flags /proc/self/mountinfo with POLLPRI after every mount or unmount
+static int g_mountInfoDescriptor = -1;
+static unsigned long long g_mountGeneration = 1;
+
+static void FreeMountTableEntries(MOUNT_TABLE* table)
+{
+    unsigned int i = 0;
+
+    for (i = 0; i < table->numberOfEntries; i++)
+    {
+        FREE_MEMORY(table->entries[i].fsName);
+        FREE_MEMORY(table->entries[i].directory);
+        FREE_MEMORY(table->entries[i].type);
+        FREE_MEMORY(table->entries[i].options);
+    }
+
+    FREE_MEMORY(table->entries);
+    table->numberOfEntries = 0;
+}
+
+// Called with g_mountTablesLock held
+static unsigned long long GetMountGeneration(void)
+{
+    struct pollfd descriptor = {0};
+
+    if (0 > g_mountInfoDescriptor)
+    {
+        g_mountInfoDescriptor = open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+    }
+
+    if (0 <= g_mountInfoDescriptor)
+    {
+        descriptor.fd = g_mountInfoDescriptor;
+        descriptor.events = POLLPRI;
+
+        if ((0 < poll(&descriptor, 1, 0)) && (descriptor.revents & (POLLPRI | POLLERR)))
+        {
+            g_mountGeneration += 1;
+        }
+    }
+    else
+    {
+        // Without the poll events every lookup parses the live table again
+        g_mountGeneration += 1;
+    }
+
+    return g_mountGeneration;
+}
+
+static int ParseMountTable(MOUNT_TABLE* table, void* log)
 {
     FILE* mountFileHandle = NULL;
     struct mntent* mountStruct = NULL;
+    MOUNT_ENTRY* entries = NULL;
+    MOUNT_ENTRY* entry = NULL;
+    unsigned int capacity = 0;
+    int status = 0;
+
+    if (NULL == (mountFileHandle = setmntent(table->fileName, "r")))
+    {
+        status = (0 == errno) ? ENOENT : errno;
+        OsConfigLogError(log, "ParseMountTable: could not open file '%s', setmntent() failed (%d)", table->fileName, status);
+        return status;
+    }
+
+    while ((0 == status) && (NULL != (mountStruct = getmntent(mountFileHandle))))
+    {
+        if (table->numberOfEntries == capacity)
+        {
+            capacity = capacity ? (2 * capacity) : 32;
+
+            if (NULL == (entries = (MOUNT_ENTRY*)realloc(table->entries, capacity * sizeof(MOUNT_ENTRY))))
+            {
+                status = ENOMEM;
+                break;
+            }
+
+            table->entries = entries;
+        }
+
+        entry = &table->entries[table->numberOfEntries++];
+        memset(entry, 0, sizeof(MOUNT_ENTRY));
+        entry->frequency = mountStruct->mnt_freq;
+        entry->pass = mountStruct->mnt_passno;
+
+        if ((NULL == (entry->fsName = DuplicateString(mountStruct->mnt_fsname ? mountStruct->mnt_fsname : ""))) ||
+            (NULL == (entry->directory = DuplicateString(mountStruct->mnt_dir ? mountStruct->mnt_dir : ""))) ||
+            (NULL == (entry->type = DuplicateString(mountStruct->mnt_type ? mountStruct->mnt_type : ""))) ||
+            (NULL == (entry->options = DuplicateString(mountStruct->mnt_opts ? mountStruct->mnt_opts : ""))))
+        {
+            status = ENOMEM;
+        }
+    }
+
+    endmntent(mountFileHandle);
+
+    if (0 != status)
+    {
+        OsConfigLogError(log, "ParseMountTable: out of memory");
+        FreeMountTableEntries(table);
+    }
+
+    return status;
+}
+
+// Returns the parsed table for the file, parsing it again when it changed. Called with g_mountTablesLock held
+static MOUNT_TABLE* GetMountTable(const char* mountFileName, void* log)
+{
+    MOUNT_TABLE* table = NULL;
+    struct stat statStruct = {0};
+    char* resolvedName = NULL;
+    unsigned long long generation = 0;
+
+    if (0 != stat(mountFileName, &statStruct))
+    {
+        return NULL;
+    }
+
+    for (table = g_mountTables; NULL != table; table = table->next)
+    {
+        if (0 == strcmp(table->fileName, mountFileName))
+        {
+            break;
+        }
+    }
+
+    if (NULL == table)
+    {
+        if ((NULL == (table = (MOUNT_TABLE*)calloc(1, sizeof(MOUNT_TABLE)))) || (NULL == (table->fileName = DuplicateString(mountFileName))))
+        {
+            OsConfigLogError(log, "GetMountTable: out of memory");
+            FREE_MEMORY(table);
+            return NULL;
+        }
+
+        if (NULL != (resolvedName = realpath(mountFileName, NULL)))
+        {
+            table->live = (0 == strncmp(resolvedName, "/proc/", strlen("/proc/"))) ? true : false;
+            FREE_MEMORY(resolvedName);
+        }
+
+        table->next = g_mountTables;
+        g_mountTables = table;
+    }
+
+    if (table->live)
+    {
+        generation = GetMountGeneration();
+    }
+
+    if ((NULL != table->entries) && (table->device == statStruct.st_dev) && (table->inode == statStruct.st_ino) && (table->size == statStruct.st_size) &&
+        (table->modified.tv_sec == statStruct.st_mtim.tv_sec) && (table->modified.tv_nsec == statStruct.st_mtim.tv_nsec) && (table->generation == generation))
+    {
+        return table;
+    }
+
+    FreeMountTableEntries(table);
+    table->device = statStruct.st_dev;
+    table->inode = statStruct.st_ino;
+    table->size = statStruct.st_size;
+    table->modified = statStruct.st_mtim;
+    table->generation = generation;
+
+    if (0 != ParseMountTable(table, log))
+    {
+        return NULL;
+    }
+
+    // An empty table still counts as parsed
+    if (NULL == table->entries)
+    {
+        table->entries = (MOUNT_ENTRY*)calloc(1, sizeof(MOUNT_ENTRY));
+    }
+
+    if (IsFullLoggingEnabled())
+    {
+        OsConfigLogInfo(log, "GetMountTable: %u entries parsed from '%s'", table->numberOfEntries, mountFileName);
+    }
+
+    return (NULL != table->entries) ? table : NULL;
+}
+
+int CheckFileSystemMountingOption(const char* mountFileName, const char* mountDirectory, const char* mountType, const char* desiredOption, char** reason, void* log)
+{
+    const MOUNT_TABLE* table = NULL;
+    const MOUNT_ENTRY* entry = NULL;
+    struct mntent mountStruct = {0};
     bool matchFound = false;
     int lineNumber = 1;
+    unsigned int i = 0;
     int status = 0;
     
     if ((NULL == mountFileName) || ((NULL == mountDirectory) && (NULL == mountType)) || (NULL == desiredOption))
@@ -31,60 +248,64 @@ int CheckFileSystemMountingOption(const char* mountFileName, const char* mountDi
         return 0;
     }
 
-    if (NULL != (mountFileHandle = setmntent(mountFileName, "r")))
+    pthread_mutex_lock(&g_mountTablesLock);
+
+    if (NULL != (table = GetMountTable(mountFileName, log)))
     {
-        while (NULL != (mountStruct = getmntent(mountFileHandle)))
+        for (i = 0; i < table->numberOfEntries; i++, lineNumber++)
         {
-            if (((NULL != mountDirectory) && (NULL != mountStruct->mnt_dir) && (NULL != strstr(mountStruct->mnt_dir, mountDirectory))) ||
-                ((NULL != mountType) && (NULL != mountStruct->mnt_type) && (NULL != strstr(mountStruct->mnt_type, mountType))))
+            entry = &table->entries[i];
+
+            if (((NULL != mountDirectory) && (NULL != strstr(entry->directory, mountDirectory))) ||
+                ((NULL != mountType) && (NULL != strstr(entry->type, mountType))))
             {
                 matchFound = true;
                 
-                if (NULL != hasmntopt(mountStruct, desiredOption))
+                // hasmntopt only looks at the options of the entry
+                mountStruct.mnt_opts = entry->options;
+
+                if (NULL != hasmntopt(&mountStruct, desiredOption))
                 {
                     OsConfigLogInfo(log, "CheckFileSystemMountingOption: option '%s' for mount directory '%s' or mount type '%s' found in '%s' at line %d ('%s')", 
-                        desiredOption, mountDirectory ? mountDirectory : "-", mountType ? mountType : "-", mountFileName, lineNumber, mountStruct->mnt_opts);
+                        desiredOption, mountDirectory ? mountDirectory : "-", mountType ? mountType : "-", mountFileName, lineNumber, entry->options);
                     
                     if (NULL != mountDirectory)
                     {
                         OsConfigCaptureSuccessReason(reason, "Option '%s' for mount directory '%s' found in '%s' at line %d ('%s')", 
-                            desiredOption, mountDirectory, mountFileName, lineNumber, mountStruct->mnt_opts);
+                            desiredOption, mountDirectory, mountFileName, lineNumber, entry->options);
                     }
 
                     if (NULL != mountType)
                     {
                         OsConfigCaptureSuccessReason(reason, "Option '%s' for mount type '%s' found in '%s' at line %d ('%s')", 
-                            desiredOption, mountType, mountFileName, lineNumber, mountStruct->mnt_opts);
+                            desiredOption, mountType, mountFileName, lineNumber, entry->options);
                     }
                 }
                 else
                 {
                     status = ENOENT;
                     OsConfigLogError(log, "CheckFileSystemMountingOption: option '%s' for mount directory '%s' or mount type '%s' missing from file '%s' at line %d ('%s')",
-                        desiredOption, mountDirectory ? mountDirectory : "-", mountType ? mountType : "-", mountFileName, lineNumber, mountStruct->mnt_opts);
+                        desiredOption, mountDirectory ? mountDirectory : "-", mountType ? mountType : "-", mountFileName, lineNumber, entry->options);
                     
                     if (NULL != mountDirectory)
                     {
                         OsConfigCaptureReason(reason, "Option '%s' for mount directory '%s' is missing from file '%s' at line %d ('%s')", 
-                            desiredOption, mountDirectory, mountFileName, lineNumber, mountStruct->mnt_opts);
+                            desiredOption, mountDirectory, mountFileName, lineNumber, entry->options);
                     }
 
                     if (NULL != mountType)
                     {
                         OsConfigCaptureReason(reason, "Option '%s' for mount type '%s' missing from file '%s' at line %d ('%s')", 
-                            desiredOption, mountType, mountFileName, lineNumber, mountStruct->mnt_opts);
+                            desiredOption, mountType, mountFileName, lineNumber, entry->options);
                     }
                 }
 
                 if (IsFullLoggingEnabled())
                 {
                     OsConfigLogInfo(log, "CheckFileSystemMountingOption, line %d in '%s': mnt_fsname '%s', mnt_dir '%s', mnt_type '%s', mnt_opts '%s', mnt_freq %d, mnt_passno %d", 
-                        lineNumber, mountFileName, mountStruct->mnt_fsname, mountStruct->mnt_dir, mountStruct->mnt_type, mountStruct->mnt_opts, 
-                        mountStruct->mnt_freq, mountStruct->mnt_passno);
+                        lineNumber, mountFileName, entry->fsName, entry->directory, entry->type, entry->options, entry->frequency, entry->pass);
                 }
             }
-
-            lineNumber += 1;
         }
 
         if (false == matchFound)
@@ -103,16 +324,16 @@ int CheckFileSystemMountingOption(const char* mountFileName, const char* mountDi
                 OsConfigCaptureSuccessReason(reason, "Found no entries about mount type '%s' in '%s' to look for option '%s'", mountType, mountFileName, desiredOption);
             }
         }
-
-        endmntent(mountFileHandle);
     }
     else
     {
         status = (0 == errno) ? ENOENT : errno;
-        OsConfigLogError(log, "CheckFileSystemMountingOption: could not open file '%s', setmntent() failed (%d)", mountFileName, status);
-        OsConfigCaptureReason(reason, "Cannot access '%s', setmntent() failed (%d)", mountFileName, status);
+        OsConfigLogError(log, "CheckFileSystemMountingOption: could not read file '%s' (%d)", mountFileName, status);
+        OsConfigCaptureReason(reason, "Cannot access '%s' (%d)", mountFileName, status);
     }
 
+    pthread_mutex_unlock(&g_mountTablesLock);
+
     return status;
 }
 
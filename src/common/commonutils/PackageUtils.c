@@ -3,6 +3,9 @@
 
 #include "Internal.h"
 
+#include <fnmatch.h>
+#include <pthread.h>
+
 static const char* g_aptGet = "apt-get";
 static const char* g_dpkg = "dpkg";
 static const char* g_tdnf = "tdnf";
@@ -17,8 +20,43 @@ static bool g_tdnfIsPresent = false;
 static bool g_dnfIsPresent = false;
 static bool g_yumIsPresent = false;
 static bool g_zypperIsPresent = false;
+static pthread_mutex_t g_packageManagersPresenceLock = PTHREAD_MUTEX_INITIALIZER;
 static bool g_aptGetUpdateExecuted = false;
 
+static const char* g_dpkgStatusFile = "/var/lib/dpkg/status";
+
+// Locations of the RPM database, the first one present stamps the package index built from 'rpm -qa'
+static const char* g_rpmDatabaseFiles[] = {
+    "/var/lib/rpm/rpmdb.sqlite",
+    "/var/lib/rpm/Packages",
+    "/usr/lib/sysimage/rpm/rpmdb.sqlite",
+    "/usr/lib/sysimage/rpm/Packages.db"
+};
+
+// Names of the installed packages, rebuilt when the package database file changes.
+// A database modified this recently may still change within the same timestamp and is read again on the next query
+#define PACKAGE_INDEX_SETTLE_SECONDS 2
+
+typedef struct PACKAGE_INDEX
+{
+    char* source;
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec modified;
+    bool settled;
+    // All names point into this buffer
+    char* buffer;
+    char** names;
+    unsigned int numberOfNames;
+    // Open addressing hash table of indexes into names, plus one, 0 marks an empty bucket
+    unsigned int* buckets;
+    unsigned int numberOfBuckets;
+} PACKAGE_INDEX;
+
+static PACKAGE_INDEX g_packageIndex = {0};
+static pthread_mutex_t g_packageIndexLock = PTHREAD_MUTEX_INITIALIZER;
+
 int IsPresent(const char* what, void* log)
 {
     const char* commandTemplate = "command -v %s";
@@ -51,16 +89,44 @@ int IsPresent(const char* what, void* log)
 
 static void CheckPackageManagersPresence(void* log)
 {
+    const char* packageManagers[] = { g_aptGet, g_dpkg, g_tdnf, g_dnf, g_yum, g_zypper };
+    bool* isPresent[] = { &g_aptGetIsPresent, &g_dpkgIsPresent, &g_tdnfIsPresent, &g_dnfIsPresent, &g_yumIsPresent, &g_zypperIsPresent };
+    char* commands[ARRAY_SIZE(packageManagers)] = {0};
+    int statuses[ARRAY_SIZE(packageManagers)] = {0};
+    unsigned int i = 0;
+
+    // Set only once all the presence values are filled in, concurrent first callers wait for them on the lock
+    if (__atomic_load_n(&g_checkedPackageManagersPresence, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_packageManagersPresenceLock);
+
     if (false == g_checkedPackageManagersPresence)
     {
-        g_checkedPackageManagersPresence = true;
-        g_aptGetIsPresent = (0 == IsPresent(g_aptGet, log)) ? true : false;
-        g_dpkgIsPresent = (0 == IsPresent(g_dpkg, log)) ? true : false;
-        g_tdnfIsPresent = (0 == IsPresent(g_tdnf, log)) ? true : false;
-        g_dnfIsPresent = (0 == IsPresent(g_dnf, log)) ? true : false;
-        g_yumIsPresent = (0 == IsPresent(g_yum, log)) ? true : false;
-        g_zypperIsPresent = (0 == IsPresent(g_zypper, log)) ? true : false;
+        // Look for all package managers at once
+        for (i = 0; i < ARRAY_SIZE(packageManagers); i++)
+        {
+            commands[i] = FormatAllocateString("command -v %s", packageManagers[i]);
+        }
+
+        ExecuteCommandBatch((const char**)commands, ARRAY_SIZE(packageManagers), false, false, 0, 0, 0, statuses, NULL, log);
+
+        for (i = 0; i < ARRAY_SIZE(packageManagers); i++)
+        {
+            if ((NULL != commands[i]) && (0 == statuses[i]))
+            {
+                *isPresent[i] = true;
+                OsConfigLogInfo(log, "'%s' is locally present", packageManagers[i]);
+            }
+            FREE_MEMORY(commands[i]);
+        }
+
+        __atomic_store_n(&g_checkedPackageManagersPresence, true, __ATOMIC_RELEASE);
     }
+
+    pthread_mutex_unlock(&g_packageManagersPresenceLock);
 }
 
 static int CheckOrInstallPackage(const char* commandTemplate, const char* packageManager, const char* packageName, void* log)
@@ -89,6 +155,316 @@ static int CheckOrInstallPackage(const char* commandTemplate, const char* packag
     return status;
 }
 
+static unsigned int HashPackageName(const char* name)
+{
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+
+    for (; 0 != *name; name++)
+    {
+        hash = (hash ^ (unsigned char)*name) * 16777619u;
+    }
+
+    return hash;
+}
+
+static void ClearPackageIndex(PACKAGE_INDEX* index)
+{
+    FREE_MEMORY(index->source);
+    FREE_MEMORY(index->buffer);
+    FREE_MEMORY(index->names);
+    FREE_MEMORY(index->buckets);
+    memset(index, 0, sizeof(PACKAGE_INDEX));
+}
+
+static bool IsInPackageIndex(const PACKAGE_INDEX* index, const char* name)
+{
+    unsigned int bucket = 0;
+
+    if (0 == index->numberOfBuckets)
+    {
+        return false;
+    }
+
+    for (bucket = HashPackageName(name) & (index->numberOfBuckets - 1); 0 != index->buckets[bucket]; bucket = (bucket + 1) & (index->numberOfBuckets - 1))
+    {
+        if (0 == strcmp(index->names[index->buckets[bucket] - 1], name))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int AddToPackageIndex(PACKAGE_INDEX* index, char* name, unsigned int* capacity)
+{
+    char** names = NULL;
+
+    if (0 == name[0])
+    {
+        return 0;
+    }
+
+    if (index->numberOfNames >= *capacity)
+    {
+        *capacity = *capacity ? (*capacity * 2) : 1024;
+        if (NULL == (names = (char**)realloc(index->names, *capacity * sizeof(char*))))
+        {
+            return ENOMEM;
+        }
+        index->names = names;
+    }
+
+    index->names[index->numberOfNames++] = name;
+
+    return 0;
+}
+
+static int HashPackageIndex(PACKAGE_INDEX* index)
+{
+    unsigned int bucket = 0;
+    unsigned int i = 0;
+
+    // At most half full
+    for (index->numberOfBuckets = 16; index->numberOfBuckets < (2 * index->numberOfNames); index->numberOfBuckets *= 2);
+
+    if (NULL == (index->buckets = (unsigned int*)calloc(index->numberOfBuckets, sizeof(unsigned int))))
+    {
+        return ENOMEM;
+    }
+
+    for (i = 0; i < index->numberOfNames; i++)
+    {
+        for (bucket = HashPackageName(index->names[i]) & (index->numberOfBuckets - 1); 0 != index->buckets[bucket]; bucket = (bucket + 1) & (index->numberOfBuckets - 1));
+        index->buckets[bucket] = i + 1;
+    }
+
+    return 0;
+}
+
+// Parses dpkg status stanzas, keeping packages both selected for install and installed, like 'dpkg -l | grep ^ii'
+static int ParseDpkgStatus(PACKAGE_INDEX* index)
+{
+    const char* packageField = "Package:";
+    const char* statusField = "Status:";
+    const char* installed = "install ok installed";
+    char* line = index->buffer;
+    char* next = NULL;
+    char* name = NULL;
+    bool isInstalled = false;
+    unsigned int capacity = 0;
+    int status = 0;
+
+    while ((0 == status) && (NULL != line))
+    {
+        if (NULL != (next = strchr(line, EOL)))
+        {
+            *next = 0;
+            next += 1;
+        }
+
+        if (0 == strncmp(line, packageField, strlen(packageField)))
+        {
+            for (name = line + strlen(packageField); isspace(*name); name++);
+            TruncateAtFirst(name, ' ');
+        }
+        else if (0 == strncmp(line, statusField, strlen(statusField)))
+        {
+            for (line += strlen(statusField); isspace(*line); line++);
+            isInstalled = (0 == strncmp(line, installed, strlen(installed))) ? true : false;
+        }
+        else if (0 == line[0])
+        {
+            // End of stanza
+            if ((NULL != name) && isInstalled)
+            {
+                status = AddToPackageIndex(index, name, &capacity);
+            }
+            name = NULL;
+            isInstalled = false;
+        }
+
+        line = next;
+    }
+
+    if ((0 == status) && (NULL != name) && isInstalled)
+    {
+        status = AddToPackageIndex(index, name, &capacity);
+    }
+
+    return status;
+}
+
+// Parses one package name per line
+static int ParsePackageList(PACKAGE_INDEX* index)
+{
+    char* line = index->buffer;
+    char* next = NULL;
+    unsigned int capacity = 0;
+    int status = 0;
+
+    while ((0 == status) && (NULL != line))
+    {
+        if (NULL != (next = strchr(line, EOL)))
+        {
+            *next = 0;
+            next += 1;
+        }
+
+        TruncateAtFirst(line, ' ');
+        status = AddToPackageIndex(index, line, &capacity);
+        line = next;
+    }
+
+    return status;
+}
+
+// Makes sure g_packageIndex lists the packages from the source database, reading it again only when the database changed.
+// The dpkg status file is parsed directly, for RPM the source only stamps the index and the names come from listingCommand
+static int RefreshPackageIndex(const char* source, const char* listingCommand, void* log)
+{
+    PACKAGE_INDEX index = {0};
+    struct stat statStruct = {0};
+    time_t now = time(NULL);
+    int status = 0;
+
+    if (0 != stat(source, &statStruct))
+    {
+        OsConfigLogInfo(log, "RefreshPackageIndex: cannot access '%s' (%d)", source, errno);
+        return ENODATA;
+    }
+
+    if ((NULL != g_packageIndex.source) && (0 == strcmp(g_packageIndex.source, source)) && g_packageIndex.settled &&
+        (g_packageIndex.device == statStruct.st_dev) && (g_packageIndex.inode == statStruct.st_ino) && (g_packageIndex.size == statStruct.st_size) &&
+        (g_packageIndex.modified.tv_sec == statStruct.st_mtim.tv_sec) && (g_packageIndex.modified.tv_nsec == statStruct.st_mtim.tv_nsec))
+    {
+        return 0;
+    }
+
+    index.device = statStruct.st_dev;
+    index.inode = statStruct.st_ino;
+    index.size = statStruct.st_size;
+    index.modified = statStruct.st_mtim;
+    index.settled = ((now - statStruct.st_mtim.tv_sec) >= PACKAGE_INDEX_SETTLE_SECONDS) ? true : false;
+
+    if (NULL == (index.source = DuplicateString(source)))
+    {
+        status = ENOMEM;
+    }
+    else if (NULL == listingCommand)
+    {
+        if (NULL == (index.buffer = LoadStringFromFile(source, false, log)))
+        {
+            OsConfigLogError(log, "RefreshPackageIndex: cannot read '%s'", source);
+            status = ENODATA;
+        }
+        else
+        {
+            status = ParseDpkgStatus(&index);
+        }
+    }
+    else if (0 != ExecuteCommand(NULL, listingCommand, false, false, 0, 0, &index.buffer, NULL, log))
+    {
+        OsConfigLogError(log, "RefreshPackageIndex: '%s' failed", listingCommand);
+        status = ENODATA;
+    }
+    else
+    {
+        status = ParsePackageList(&index);
+    }
+
+    if (0 == status)
+    {
+        status = HashPackageIndex(&index);
+    }
+
+    if (0 == status)
+    {
+        ClearPackageIndex(&g_packageIndex);
+        memcpy(&g_packageIndex, &index, sizeof(PACKAGE_INDEX));
+        OsConfigLogInfo(log, "RefreshPackageIndex: %u installed packages listed from '%s'", g_packageIndex.numberOfNames, source);
+    }
+    else
+    {
+        ClearPackageIndex(&index);
+    }
+
+    return status;
+}
+
+static int QueryPackageIndex(const char* source, const char* listingCommand, const char* packageName, void* log)
+{
+    unsigned int i = 0;
+    int status = ENOENT;
+
+    // Regular expressions are left to the package manager
+    if (NULL != strchr(packageName, '^'))
+    {
+        return EOPNOTSUPP;
+    }
+
+    pthread_mutex_lock(&g_packageIndexLock);
+
+    if (0 == (status = RefreshPackageIndex(source, listingCommand, log)))
+    {
+        if ((NULL != strchr(packageName, '*')) || (NULL != strchr(packageName, '?')) || (NULL != strchr(packageName, '[')))
+        {
+            status = ENOENT;
+            for (i = 0; i < g_packageIndex.numberOfNames; i++)
+            {
+                if (0 == fnmatch(packageName, g_packageIndex.names[i], 0))
+                {
+                    status = 0;
+                    break;
+                }
+            }
+        }
+        else
+        {
+            status = IsInPackageIndex(&g_packageIndex, packageName) ? 0 : ENOENT;
+        }
+    }
+
+    pthread_mutex_unlock(&g_packageIndexLock);
+
+    return status;
+}
+
+int IsPackageInDpkgStatus(const char* statusFile, const char* packageName, void* log)
+{
+    if ((NULL == statusFile) || (NULL == packageName) || (0 == strlen(packageName)))
+    {
+        OsConfigLogError(log, "IsPackageInDpkgStatus called with invalid arguments");
+        return EINVAL;
+    }
+
+    return QueryPackageIndex(statusFile, NULL, packageName, log);
+}
+
+static int IsPackageInRpmDatabase(const char* packageName, void* log)
+{
+    const char* listingCommand = "rpm -qa --queryformat '%{NAME}\\n'";
+    unsigned int i = 0;
+
+    for (i = 0; i < ARRAY_SIZE(g_rpmDatabaseFiles); i++)
+    {
+        if (FileExists(g_rpmDatabaseFiles[i]))
+        {
+            return QueryPackageIndex(g_rpmDatabaseFiles[i], listingCommand, packageName, log);
+        }
+    }
+
+    return ENODATA;
+}
+
+void InvalidatePackageIndex(void)
+{
+    pthread_mutex_lock(&g_packageIndexLock);
+    ClearPackageIndex(&g_packageIndex);
+    pthread_mutex_unlock(&g_packageIndexLock);
+}
+
 int IsPackageInstalled(const char* packageName, void* log)
 {
     const char* commandTemplateDpkg = "%s -l %s | grep ^ii";
@@ -97,9 +473,25 @@ int IsPackageInstalled(const char* packageName, void* log)
     const char* commandTemplateZypper = "%s se -x %s";
     int status = ENOENT;
 
+    if ((NULL == packageName) || (0 == strlen(packageName)))
+    {
+        OsConfigLogError(log, "IsPackageInstalled called with invalid arguments");
+        return EINVAL;
+    }
+
     CheckPackageManagersPresence(log);
 
-    if (g_dpkgIsPresent)
+    // Answer from the index of installed packages when possible, running the package manager only when the index is not available
+    if (g_dpkgIsPresent && ((0 == (status = IsPackageInDpkgStatus(g_dpkgStatusFile, packageName, log))) || (ENOENT == status)))
+    {
+        OsConfigLogInfo(log, "IsPackageInstalled: '%s' looked up in '%s'", packageName, g_dpkgStatusFile);
+    }
+    else if ((g_tdnfIsPresent || g_dnfIsPresent || g_yumIsPresent || g_zypperIsPresent) &&
+        ((0 == (status = IsPackageInRpmDatabase(packageName, log))) || (ENOENT == status)))
+    {
+        OsConfigLogInfo(log, "IsPackageInstalled: '%s' looked up in the RPM database", packageName);
+    }
+    else if (g_dpkgIsPresent)
     {
         status = CheckOrInstallPackage(commandTemplateDpkg, g_dpkg, packageName, log);
     }
@@ -228,6 +620,9 @@ int InstallOrUpdatePackage(const char* packageName, void* log)
         status = CheckOrInstallPackage(commandTemplate, g_zypper, packageName, log);
     }
 
+    // The package manager ran (even a failed run can change what is installed), the index is read again on the next lookup
+    InvalidatePackageIndex();
+
     if (0 == status)
     {
         status = IsPackageInstalled(packageName, log);
@@ -293,6 +688,8 @@ int UninstallPackage(const char* packageName, void* log)
             status = CheckOrInstallPackage(commandTemplateAllElse, g_zypper, packageName, log);
         }
 
+        InvalidatePackageIndex();
+
         if ((0 == status) && (0 == IsPackageInstalled(packageName, log)))
         {
             status = ENOENT;
@@ -0,0 +1,668 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "Internal.h"
+
+#include <fcntl.h>
+
+// The optional index saved next to the reported configuration file
+#define INDEX_FILE_EXTENSION ".index"
+#define INDEX_SIZE "size"
+#define INDEX_INODE "inode"
+#define INDEX_MTIME "mtime"
+#define INDEX_MTIME_NANOSECONDS "mtimeNanoseconds"
+#define INDEX_COMPONENTS "components"
+#define INDEX_OFFSET "offset"
+#define INDEX_LENGTH "length"
+
+typedef struct REPORTED_COMPONENT
+{
+    char* name;
+
+    // Compact JSON serialization of the component object, as saved to the file
+    char* value;
+    size_t valueLength;
+    size_t hash;
+
+    // Copy of the value last received with a payload, to find unchanged components without serializing them again
+    JSON_Value* parsed;
+
+    bool present;
+} REPORTED_COMPONENT;
+
+typedef struct REPORTED_WRITER
+{
+    char* fileName;
+    char* indexFileName;
+    bool indexed;
+    bool changed;
+    REPORTED_COMPONENT* components;
+    unsigned int numComponents;
+    unsigned int maxComponents;
+} REPORTED_WRITER;
+
+REPORTED_WRITER_HANDLE OpenReportedWriter(const char* fileName, bool indexed, void* log)
+{
+    REPORTED_WRITER* writer = NULL;
+
+    if ((NULL == fileName) || (0 == strlen(fileName)))
+    {
+        OsConfigLogError(log, "OpenReportedWriter: invalid argument");
+        return NULL;
+    }
+
+    if (NULL == (writer = (REPORTED_WRITER*)malloc(sizeof(REPORTED_WRITER))))
+    {
+        OsConfigLogError(log, "OpenReportedWriter: out of memory");
+        return NULL;
+    }
+
+    memset(writer, 0, sizeof(REPORTED_WRITER));
+    writer->indexed = indexed;
+
+    // Nothing is known about what the file currently contains, the first save always writes it
+    writer->changed = true;
+
+    if ((NULL == (writer->fileName = DuplicateString(fileName))) ||
+        (indexed && (NULL == (writer->indexFileName = ConcatenateStrings(fileName, INDEX_FILE_EXTENSION)))))
+    {
+        OsConfigLogError(log, "OpenReportedWriter: out of memory");
+        CloseReportedWriter(writer);
+        writer = NULL;
+    }
+
+    return (REPORTED_WRITER_HANDLE)writer;
+}
+
+static void FreeParsedReportedComponent(REPORTED_COMPONENT* component)
+{
+    if (NULL != component->parsed)
+    {
+        json_value_free(component->parsed);
+        component->parsed = NULL;
+    }
+}
+
+void CloseReportedWriter(REPORTED_WRITER_HANDLE handle)
+{
+    REPORTED_WRITER* writer = (REPORTED_WRITER*)handle;
+    unsigned int i = 0;
+
+    if (NULL == writer)
+    {
+        return;
+    }
+
+    for (i = 0; i < writer->numComponents; i++)
+    {
+        FREE_MEMORY(writer->components[i].name);
+        FREE_MEMORY(writer->components[i].value);
+        FreeParsedReportedComponent(&writer->components[i]);
+    }
+
+    FREE_MEMORY(writer->components);
+    FREE_MEMORY(writer->fileName);
+    FREE_MEMORY(writer->indexFileName);
+    FREE_MEMORY(writer);
+}
+
+static REPORTED_COMPONENT* FindReportedComponent(REPORTED_WRITER* writer, const char* componentName)
+{
+    unsigned int i = 0;
+
+    for (i = 0; i < writer->numComponents; i++)
+    {
+        if (0 == strcmp(writer->components[i].name, componentName))
+        {
+            return &writer->components[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void RemoveReportedComponent(REPORTED_WRITER* writer, unsigned int index)
+{
+    FREE_MEMORY(writer->components[index].name);
+    FREE_MEMORY(writer->components[index].value);
+    FreeParsedReportedComponent(&writer->components[index]);
+
+    // Keep the order of the remaining components
+    memmove(&writer->components[index], &writer->components[index + 1], (writer->numComponents - index - 1) * sizeof(REPORTED_COMPONENT));
+    writer->numComponents -= 1;
+    writer->changed = true;
+}
+
+int UpdateReportedComponent(REPORTED_WRITER_HANDLE handle, const char* componentName, const char* componentValue, void* log)
+{
+    REPORTED_WRITER* writer = (REPORTED_WRITER*)handle;
+    REPORTED_COMPONENT* component = NULL;
+    REPORTED_COMPONENT* components = NULL;
+    char* value = NULL;
+    size_t hash = 0;
+
+    if ((NULL == writer) || (NULL == componentName) || (0 == strlen(componentName)))
+    {
+        OsConfigLogError(log, "UpdateReportedComponent: invalid arguments");
+        return EINVAL;
+    }
+
+    component = FindReportedComponent(writer, componentName);
+
+    if (NULL == componentValue)
+    {
+        if (NULL != component)
+        {
+            RemoveReportedComponent(writer, (unsigned int)(component - writer->components));
+        }
+        return 0;
+    }
+
+    hash = HashString(componentValue);
+
+    if ((NULL != component) && (component->hash == hash) && (0 == strcmp(component->value, componentValue)))
+    {
+        // Unchanged, the saved serialization is reused as is
+        component->present = true;
+        return 0;
+    }
+
+    if (NULL == (value = DuplicateString(componentValue)))
+    {
+        OsConfigLogError(log, "UpdateReportedComponent: out of memory");
+        return ENOMEM;
+    }
+
+    if (NULL == component)
+    {
+        if (writer->numComponents >= writer->maxComponents)
+        {
+            if (NULL == (components = (REPORTED_COMPONENT*)realloc(writer->components, (writer->maxComponents + 8) * sizeof(REPORTED_COMPONENT))))
+            {
+                OsConfigLogError(log, "UpdateReportedComponent: out of memory");
+                FREE_MEMORY(value);
+                return ENOMEM;
+            }
+
+            writer->components = components;
+            writer->maxComponents += 8;
+        }
+
+        component = &writer->components[writer->numComponents];
+        memset(component, 0, sizeof(REPORTED_COMPONENT));
+
+        if (NULL == (component->name = DuplicateString(componentName)))
+        {
+            OsConfigLogError(log, "UpdateReportedComponent: out of memory");
+            FREE_MEMORY(value);
+            return ENOMEM;
+        }
+
+        writer->numComponents += 1;
+    }
+
+    FREE_MEMORY(component->value);
+    FreeParsedReportedComponent(component);
+    component->value = value;
+    component->valueLength = strlen(value);
+    component->hash = hash;
+    component->present = true;
+    writer->changed = true;
+
+    return 0;
+}
+
+int UpdateReportedPayload(REPORTED_WRITER_HANDLE handle, const char* payload, void* log)
+{
+    REPORTED_WRITER* writer = (REPORTED_WRITER*)handle;
+    JSON_Value* rootValue = NULL;
+    JSON_Object* rootObject = NULL;
+    REPORTED_COMPONENT* component = NULL;
+    JSON_Value* componentValue = NULL;
+    const char* name = NULL;
+    char* value = NULL;
+    size_t count = 0;
+    size_t i = 0;
+    unsigned int j = 0;
+    int status = 0;
+
+    if ((NULL == writer) || (NULL == payload))
+    {
+        OsConfigLogError(log, "UpdateReportedPayload: invalid arguments");
+        return EINVAL;
+    }
+
+    if ((NULL == (rootValue = json_parse_string(payload))) || (NULL == (rootObject = json_value_get_object(rootValue))))
+    {
+        OsConfigLogError(log, "UpdateReportedPayload: the reported payload is not a valid JSON object");
+        status = EINVAL;
+    }
+    else
+    {
+        for (j = 0; j < writer->numComponents; j++)
+        {
+            writer->components[j].present = false;
+        }
+
+        count = json_object_get_count(rootObject);
+
+        for (i = 0; (i < count) && (0 == status); i++)
+        {
+            name = json_object_get_name(rootObject, i);
+            componentValue = json_object_get_value_at(rootObject, i);
+
+            // Only the components that changed since the last payload get serialized again
+            if ((NULL != (component = FindReportedComponent(writer, name))) && (NULL != component->parsed) && json_value_equals(component->parsed, componentValue))
+            {
+                component->present = true;
+            }
+            else if (NULL == (value = json_serialize_to_string(componentValue)))
+            {
+                OsConfigLogError(log, "UpdateReportedPayload: failed to serialize component '%s'", name);
+                status = ENOMEM;
+            }
+            else
+            {
+                if ((0 == (status = UpdateReportedComponent(writer, name, value, log))) && (NULL != (component = FindReportedComponent(writer, name))))
+                {
+                    // Without the copy the component is serialized and compared again next time
+                    FreeParsedReportedComponent(component);
+                    component->parsed = json_value_deep_copy(componentValue);
+                }
+                json_free_serialized_string(value);
+            }
+        }
+
+        if (0 == status)
+        {
+            // Drop the components no longer reported
+            for (j = writer->numComponents; j > 0; j--)
+            {
+                if (false == writer->components[j - 1].present)
+                {
+                    RemoveReportedComponent(writer, j - 1);
+                }
+            }
+        }
+    }
+
+    if (NULL != rootValue)
+    {
+        json_value_free(rootValue);
+    }
+
+    return status;
+}
+
+static int SaveFileAtomically(const char* fileName, const char* payload, size_t payloadSizeBytes, void* log)
+{
+    const char* tempFileNameTemplate = "%s.XXXXXX";
+    char* tempFileName = NULL;
+    char* directoryName = NULL;
+    size_t written = 0;
+    ssize_t result = 0;
+    int descriptor = -1;
+    int status = 0;
+
+    if (NULL == (tempFileName = FormatAllocateString(tempFileNameTemplate, fileName)))
+    {
+        OsConfigLogError(log, "SaveFileAtomically: out of memory");
+        return ENOMEM;
+    }
+
+    // The temporary file is created in the same directory with restricted access (0600) so that the rename is atomic
+    if (-1 == (descriptor = mkstemp(tempFileName)))
+    {
+        status = errno ? errno : EACCES;
+        OsConfigLogError(log, "SaveFileAtomically: failed to create a temporary file for '%s' (%d)", fileName, status);
+    }
+    else
+    {
+        while ((0 == status) && (written < payloadSizeBytes))
+        {
+            if (0 < (result = write(descriptor, payload + written, payloadSizeBytes - written)))
+            {
+                written += (size_t)result;
+            }
+            else if (EINTR != errno)
+            {
+                status = errno ? errno : EIO;
+                OsConfigLogError(log, "SaveFileAtomically: failed writing to '%s' (%d)", tempFileName, status);
+            }
+        }
+
+        if ((0 == status) && (0 != fsync(descriptor)))
+        {
+            status = errno ? errno : EIO;
+            OsConfigLogError(log, "SaveFileAtomically: fsync of '%s' failed (%d)", tempFileName, status);
+        }
+
+        close(descriptor);
+
+        if ((0 == status) && (0 != rename(tempFileName, fileName)))
+        {
+            status = errno ? errno : EACCES;
+            OsConfigLogError(log, "SaveFileAtomically: rename('%s' to '%s') failed (%d)", tempFileName, fileName, status);
+        }
+
+        if (0 != status)
+        {
+            remove(tempFileName);
+        }
+        else if ((NULL != (directoryName = DuplicateString(fileName))) && (0 <= (descriptor = open(dirname(directoryName), O_RDONLY | O_DIRECTORY | O_CLOEXEC))))
+        {
+            // Make the rename itself durable
+            fsync(descriptor);
+            close(descriptor);
+        }
+    }
+
+    FREE_MEMORY(directoryName);
+    FREE_MEMORY(tempFileName);
+
+    return status;
+}
+
+static int SaveReportedIndex(REPORTED_WRITER* writer, const size_t* offsets, size_t size, const struct stat* statStruct, void* log)
+{
+    JSON_Value* rootValue = NULL;
+    JSON_Object* rootObject = NULL;
+    JSON_Value* componentsValue = NULL;
+    JSON_Object* componentsObject = NULL;
+    JSON_Value* entryValue = NULL;
+    JSON_Object* entryObject = NULL;
+    char* serialized = NULL;
+    unsigned int i = 0;
+    int status = 0;
+
+    if ((NULL == (rootValue = json_value_init_object())) || (NULL == (rootObject = json_value_get_object(rootValue))) ||
+        (NULL == (componentsValue = json_value_init_object())) || (NULL == (componentsObject = json_value_get_object(componentsValue))))
+    {
+        OsConfigLogError(log, "SaveReportedIndex: out of memory");
+        status = ENOMEM;
+    }
+    else
+    {
+        json_object_set_number(rootObject, INDEX_SIZE, (double)size);
+        json_object_set_number(rootObject, INDEX_INODE, (double)statStruct->st_ino);
+        json_object_set_number(rootObject, INDEX_MTIME, (double)statStruct->st_mtim.tv_sec);
+        json_object_set_number(rootObject, INDEX_MTIME_NANOSECONDS, (double)statStruct->st_mtim.tv_nsec);
+        json_object_set_value(rootObject, INDEX_COMPONENTS, componentsValue);
+        componentsValue = NULL;
+
+        for (i = 0; (i < writer->numComponents) && (0 == status); i++)
+        {
+            if ((NULL == (entryValue = json_value_init_object())) || (NULL == (entryObject = json_value_get_object(entryValue))))
+            {
+                OsConfigLogError(log, "SaveReportedIndex: out of memory");
+                status = ENOMEM;
+            }
+            else
+            {
+                json_object_set_number(entryObject, INDEX_OFFSET, (double)offsets[i]);
+                json_object_set_number(entryObject, INDEX_LENGTH, (double)writer->components[i].valueLength);
+                json_object_set_value(componentsObject, writer->components[i].name, entryValue);
+                entryValue = NULL;
+            }
+        }
+
+        if (0 == status)
+        {
+            if (NULL == (serialized = json_serialize_to_string(rootValue)))
+            {
+                OsConfigLogError(log, "SaveReportedIndex: failed to serialize the index");
+                status = ENOMEM;
+            }
+            else
+            {
+                status = SaveFileAtomically(writer->indexFileName, serialized, strlen(serialized), log);
+                json_free_serialized_string(serialized);
+            }
+        }
+    }
+
+    if (NULL != entryValue)
+    {
+        json_value_free(entryValue);
+    }
+
+    if (NULL != componentsValue)
+    {
+        json_value_free(componentsValue);
+    }
+
+    if (NULL != rootValue)
+    {
+        json_value_free(rootValue);
+    }
+
+    return status;
+}
+
+int SaveReportedFile(REPORTED_WRITER_HANDLE handle, void* log)
+{
+    REPORTED_WRITER* writer = (REPORTED_WRITER*)handle;
+    struct stat statStruct = {0};
+    JSON_Value* nameValue = NULL;
+    char* name = NULL;
+    char* buffer = NULL;
+    size_t* offsets = NULL;
+    size_t size = 0;
+    size_t position = 0;
+    size_t nameLength = 0;
+    unsigned int i = 0;
+    int status = 0;
+
+    if (NULL == writer)
+    {
+        OsConfigLogError(log, "SaveReportedFile: invalid argument");
+        return EINVAL;
+    }
+    else if (false == writer->changed)
+    {
+        return 0;
+    }
+
+    // Opening and closing braces plus the null terminator, then for each component: the quoted name (escaped, at most 6 bytes per character), ':' and ','
+    size = 3;
+    for (i = 0; i < writer->numComponents; i++)
+    {
+        size += (6 * strlen(writer->components[i].name)) + 2 + 1 + writer->components[i].valueLength + 1;
+    }
+
+    if ((NULL == (buffer = (char*)malloc(size))) || ((writer->numComponents > 0) && (NULL == (offsets = (size_t*)malloc(writer->numComponents * sizeof(size_t))))))
+    {
+        OsConfigLogError(log, "SaveReportedFile: out of memory");
+        FREE_MEMORY(buffer);
+        return ENOMEM;
+    }
+
+    buffer[position++] = '{';
+
+    for (i = 0; (i < writer->numComponents) && (0 == status); i++)
+    {
+        // Let parson quote and escape the component name
+        if ((NULL == (nameValue = json_value_init_string(writer->components[i].name))) || (NULL == (name = json_serialize_to_string(nameValue))))
+        {
+            OsConfigLogError(log, "SaveReportedFile: failed to serialize component name '%s'", writer->components[i].name);
+            status = ENOMEM;
+        }
+        else
+        {
+            if (i > 0)
+            {
+                buffer[position++] = ',';
+            }
+
+            nameLength = strlen(name);
+            memcpy(&buffer[position], name, nameLength);
+            position += nameLength;
+            buffer[position++] = ':';
+
+            offsets[i] = position;
+            memcpy(&buffer[position], writer->components[i].value, writer->components[i].valueLength);
+            position += writer->components[i].valueLength;
+        }
+
+        if (NULL != name)
+        {
+            json_free_serialized_string(name);
+            name = NULL;
+        }
+
+        if (NULL != nameValue)
+        {
+            json_value_free(nameValue);
+            nameValue = NULL;
+        }
+    }
+
+    buffer[position++] = '}';
+    buffer[position] = 0;
+
+    if ((0 == status) && (0 == (status = SaveFileAtomically(writer->fileName, buffer, position, log))))
+    {
+        // The index records which file it describes, the one just renamed in place
+        if (writer->indexed && ((0 != stat(writer->fileName, &statStruct)) || (0 != SaveReportedIndex(writer, offsets, position, &statStruct, log))))
+        {
+            // Readers validate the index against the file and fall back to parsing the whole file
+            OsConfigLogError(log, "SaveReportedFile: failed to save the index for '%s'", writer->fileName);
+        }
+
+        writer->changed = false;
+    }
+
+    FREE_MEMORY(offsets);
+    FREE_MEMORY(buffer);
+
+    return status;
+}
+
+static char* LoadIndexedReportedComponent(const char* fileName, const char* componentName, void* log)
+{
+    struct stat statStruct = {0};
+    JSON_Value* indexValue = NULL;
+    JSON_Object* indexObject = NULL;
+    JSON_Object* entryObject = NULL;
+    JSON_Value* nameValue = NULL;
+    JSON_Value* componentValue = NULL;
+    char* indexFileName = NULL;
+    char* indexContents = NULL;
+    char* name = NULL;
+    char* buffer = NULL;
+    char* result = NULL;
+    size_t nameLength = 0;
+    size_t offset = 0;
+    size_t length = 0;
+    int descriptor = -1;
+
+    if ((NULL == (indexFileName = ConcatenateStrings(fileName, INDEX_FILE_EXTENSION))) ||
+        (NULL == (indexContents = LoadStringFromFile(indexFileName, false, log))) ||
+        (NULL == (indexValue = json_parse_string(indexContents))) ||
+        (NULL == (indexObject = json_value_get_object(indexValue))) ||
+        (NULL == (entryObject = json_object_get_object(json_object_get_object(indexObject, INDEX_COMPONENTS), componentName))))
+    {
+        // Silently fall back to parsing the whole file
+    }
+    else if ((0 != stat(fileName, &statStruct)) || ((size_t)statStruct.st_size != (size_t)json_object_get_number(indexObject, INDEX_SIZE)) ||
+        (statStruct.st_ino != (ino_t)json_object_get_number(indexObject, INDEX_INODE)) ||
+        (statStruct.st_mtim.tv_sec != (time_t)json_object_get_number(indexObject, INDEX_MTIME)) ||
+        (statStruct.st_mtim.tv_nsec != (long)json_object_get_number(indexObject, INDEX_MTIME_NANOSECONDS)))
+    {
+        // Replaced or rewritten by someone else since the index was saved, even if the size is the same
+        OsConfigLogInfo(log, "LoadIndexedReportedComponent: the index does not match '%s'", fileName);
+    }
+    else if ((NULL == (nameValue = json_value_init_string(componentName))) || (NULL == (name = json_serialize_to_string(nameValue))))
+    {
+        OsConfigLogError(log, "LoadIndexedReportedComponent: out of memory");
+    }
+    else
+    {
+        offset = (size_t)json_object_get_number(entryObject, INDEX_OFFSET);
+        length = (size_t)json_object_get_number(entryObject, INDEX_LENGTH);
+        nameLength = strlen(name);
+
+        // Read the component preceded by its quoted name and ':' so we can verify that the index points to the right place
+        if ((offset > nameLength) && ((offset + length) <= (size_t)statStruct.st_size) &&
+            (NULL != (buffer = (char*)malloc(nameLength + 1 + length + 1))) && (-1 != (descriptor = open(fileName, O_RDONLY))))
+        {
+            if (((ssize_t)(nameLength + 1 + length) == pread(descriptor, buffer, nameLength + 1 + length, (off_t)(offset - nameLength - 1))) &&
+                (0 == strncmp(buffer, name, nameLength)) && (':' == buffer[nameLength]))
+            {
+                buffer[nameLength + 1 + length] = 0;
+
+                if (NULL != (componentValue = json_parse_string(&buffer[nameLength + 1])))
+                {
+                    result = DuplicateString(&buffer[nameLength + 1]);
+                    json_value_free(componentValue);
+                }
+            }
+
+            close(descriptor);
+        }
+    }
+
+    if (NULL != name)
+    {
+        json_free_serialized_string(name);
+    }
+
+    if (NULL != nameValue)
+    {
+        json_value_free(nameValue);
+    }
+
+    if (NULL != indexValue)
+    {
+        json_value_free(indexValue);
+    }
+
+    FREE_MEMORY(buffer);
+    FREE_MEMORY(indexContents);
+    FREE_MEMORY(indexFileName);
+
+    return result;
+}
+
+char* LoadReportedComponentFromFile(const char* fileName, const char* componentName, void* log)
+{
+    JSON_Value* rootValue = NULL;
+    JSON_Value* componentValue = NULL;
+    char* contents = NULL;
+    char* serialized = NULL;
+    char* result = NULL;
+
+    if ((NULL == fileName) || (NULL == componentName) || (0 == strlen(componentName)))
+    {
+        OsConfigLogError(log, "LoadReportedComponentFromFile: invalid arguments");
+        return NULL;
+    }
+
+    if (NULL != (result = LoadIndexedReportedComponent(fileName, componentName, log)))
+    {
+        return result;
+    }
+
+    if ((NULL != (contents = LoadStringFromFile(fileName, false, log))) && (NULL != (rootValue = json_parse_string(contents))) &&
+        (NULL != (componentValue = json_object_get_value(json_value_get_object(rootValue), componentName))))
+    {
+        if (NULL != (serialized = json_serialize_to_string(componentValue)))
+        {
+            result = DuplicateString(serialized);
+            json_free_serialized_string(serialized);
+        }
+    }
+    else
+    {
+        OsConfigLogInfo(log, "LoadReportedComponentFromFile: component '%s' not found in '%s'", componentName, fileName);
+    }
+
+    if (NULL != rootValue)
+    {
+        json_value_free(rootValue);
+    }
+
+    FREE_MEMORY(contents);
+
+    return result;
+}
@@ -0,0 +1,363 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "Internal.h"
+#include "UserUtils.h"
+
+#include <fcntl.h>
+#include <shadow.h>
+
+// name:password:last change:minimum:maximum:warning:inactivity:expiration:reserved
+#define SHADOW_NUMBER_OF_FIELDS 9
+
+static const char* g_etcShadow = "/etc/shadow";
+
+static int CompareShadowAgingChanges(const void* left, const void* right)
+{
+    return strcmp((*(const SHADOW_AGING_CHANGE* const*)left)->username, (*(const SHADOW_AGING_CHANGE* const*)right)->username);
+}
+
+// Splits a shadow line in place, returns the number of fields found. Anything past the last field stays in it
+static unsigned int SplitShadowLine(char* line, char** fields)
+{
+    unsigned int numberOfFields = 0;
+
+    fields[numberOfFields++] = line;
+
+    for (; (0 != *line) && (numberOfFields < SHADOW_NUMBER_OF_FIELDS); line++)
+    {
+        if (':' == *line)
+        {
+            *line = 0;
+            fields[numberOfFields++] = line + 1;
+        }
+    }
+
+    return numberOfFields;
+}
+
+// Appends the line to the new contents, growing the buffer as needed
+static int AppendShadowText(char** contents, size_t* size, size_t* capacity, const char* text, size_t length)
+{
+    char* newContents = NULL;
+    size_t newCapacity = 0;
+
+    if ((*size + length + 1) > *capacity)
+    {
+        newCapacity = (*capacity ? *capacity : 4096);
+        while ((*size + length + 1) > newCapacity)
+        {
+            newCapacity *= 2;
+        }
+
+        if (NULL == (newContents = (char*)realloc(*contents, newCapacity)))
+        {
+            return ENOMEM;
+        }
+
+        *contents = newContents;
+        *capacity = newCapacity;
+    }
+
+    memcpy(*contents + *size, text, length);
+    *size += length;
+    (*contents)[*size] = 0;
+
+    return 0;
+}
+
+// Writes the contents next to the shadow file with the same owner and mode, flushes it and renames it over the shadow file
+static int ReplaceShadowFile(const char* shadowFile, const char* contents, size_t size, void* log)
+{
+    struct stat statStruct = {0};
+    char* tempFileName = NULL;
+    char* directoryName = NULL;
+    const char* next = contents;
+    size_t left = size;
+    ssize_t written = 0;
+    int descriptor = -1;
+    int status = 0;
+
+    if (0 != stat(shadowFile, &statStruct))
+    {
+        status = errno ? errno : ENOENT;
+        OsConfigLogError(log, "ReplaceShadowFile: stat('%s') failed with %d", shadowFile, status);
+        return status;
+    }
+
+    if (NULL == (tempFileName = FormatAllocateString("%s+", shadowFile)))
+    {
+        OsConfigLogError(log, "ReplaceShadowFile: out of memory");
+        return ENOMEM;
+    }
+
+    // A leftover from an interrupted rewrite is replaced, we hold the lock
+    unlink(tempFileName);
+
+    if (0 > (descriptor = open(tempFileName, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC | O_NOFOLLOW, 0)))
+    {
+        status = errno ? errno : EACCES;
+        OsConfigLogError(log, "ReplaceShadowFile: cannot create '%s' (%d)", tempFileName, status);
+        FREE_MEMORY(tempFileName);
+        return status;
+    }
+
+    if ((0 != fchown(descriptor, statStruct.st_uid, statStruct.st_gid)) || (0 != fchmod(descriptor, statStruct.st_mode & 07777)))
+    {
+        status = errno ? errno : EPERM;
+        OsConfigLogError(log, "ReplaceShadowFile: cannot set owner and mode of '%s' (%d)", tempFileName, status);
+    }
+
+    while ((0 == status) && (left > 0))
+    {
+        if (0 < (written = write(descriptor, next, left)))
+        {
+            next += written;
+            left -= (size_t)written;
+        }
+        else if (EINTR != errno)
+        {
+            status = errno ? errno : EIO;
+            OsConfigLogError(log, "ReplaceShadowFile: cannot write to '%s' (%d)", tempFileName, status);
+        }
+    }
+
+    if ((0 == status) && (0 != fsync(descriptor)))
+    {
+        status = errno ? errno : EIO;
+        OsConfigLogError(log, "ReplaceShadowFile: cannot flush '%s' (%d)", tempFileName, status);
+    }
+
+    close(descriptor);
+
+    if ((0 == status) && (0 != rename(tempFileName, shadowFile)))
+    {
+        status = errno ? errno : EIO;
+        OsConfigLogError(log, "ReplaceShadowFile: cannot rename '%s' to '%s' (%d)", tempFileName, shadowFile, status);
+    }
+
+    InvalidateFileCache(shadowFile);
+
+    if (0 != status)
+    {
+        unlink(tempFileName);
+    }
+    else
+    {
+        // The renamed file carries the label of the temporary file, put back the one of the shadow file (shadow_t) or logins break
+        if (IsSelinuxPresent())
+        {
+            RestoreSelinuxContext(shadowFile, log);
+        }
+
+        // Make the rename itself durable
+        if ((NULL != (directoryName = DuplicateString(shadowFile))) && (0 <= (descriptor = open(dirname(directoryName), O_RDONLY | O_DIRECTORY | O_CLOEXEC))))
+        {
+            fsync(descriptor);
+            close(descriptor);
+        }
+    }
+
+    FREE_MEMORY(directoryName);
+    FREE_MEMORY(tempFileName);
+
+    return status;
+}
+
+// Drops the cached password entries of the name service caches, as chage does after changing the shadow file
+static void FlushShadowCaches(void* log)
+{
+    const char* commands[] = {
+        "if command -v nscd > /dev/null; then nscd -i passwd; fi",
+        "if command -v sss_cache > /dev/null; then sss_cache -E; fi"
+    };
+    unsigned int i = 0;
+    int status = 0;
+
+    for (i = 0; i < ARRAY_SIZE(commands); i++)
+    {
+        if (0 != (status = ExecuteCommand(NULL, commands[i], false, false, 0, 0, NULL, NULL, log)))
+        {
+            OsConfigLogInfo(log, "FlushShadowCaches: '%s' failed with %d", commands[i], status);
+        }
+    }
+}
+
+int SetShadowAgingValues(const char* shadowFile, SHADOW_AGING_CHANGE* changes, unsigned int numberOfChanges, void* log)
+{
+    SHADOW_AGING_CHANGE** sorted = NULL;
+    SHADOW_AGING_CHANGE** found = NULL;
+    SHADOW_AGING_CHANGE key = {0};
+    SHADOW_AGING_CHANGE* keyPointer = &key;
+    char* fields[SHADOW_NUMBER_OF_FIELDS] = {0};
+    char values[SHADOW_NUMBER_OF_FIELDS][32] = {{0}};
+    char* current = NULL;
+    char* line = NULL;
+    char* next = NULL;
+    char* contents = NULL;
+    size_t size = 0, capacity = 0;
+    unsigned int numberOfFields = 0, applied = 0, i = 0;
+    bool locked = false;
+    bool changed = false;
+    int status = 0;
+
+    if ((NULL == changes) || (0 == numberOfChanges))
+    {
+        OsConfigLogError(log, "SetShadowAgingValues called with invalid arguments");
+        return EINVAL;
+    }
+
+    for (i = 0; i < numberOfChanges; i++)
+    {
+        if ((NULL == changes[i].username) || (0 == strlen(changes[i].username)) || (NULL != strchr(changes[i].username, ':')) ||
+            (changes[i].field < ShadowLastChange) || (changes[i].field > ShadowInactivityPeriod))
+        {
+            OsConfigLogError(log, "SetShadowAgingValues: invalid change %u", i);
+            return EINVAL;
+        }
+
+        // Until the user is found in the shadow file
+        changes[i].result = ENOENT;
+    }
+
+    if (NULL == (sorted = (SHADOW_AGING_CHANGE**)malloc(numberOfChanges * sizeof(SHADOW_AGING_CHANGE*))))
+    {
+        OsConfigLogError(log, "SetShadowAgingValues: out of memory");
+        return ENOMEM;
+    }
+
+    for (i = 0; i < numberOfChanges; i++)
+    {
+        sorted[i] = &changes[i];
+    }
+
+    qsort(sorted, numberOfChanges, sizeof(SHADOW_AGING_CHANGE*), CompareShadowAgingChanges);
+
+    // Only the system shadow file is shared with the other shadow tools, a fixture root has nobody else to lock out
+    if (NULL == shadowFile)
+    {
+        if (0 != lckpwdf())
+        {
+            status = errno ? errno : EBUSY;
+            OsConfigLogError(log, "SetShadowAgingValues: cannot lock the password files (%d)", status);
+            FREE_MEMORY(sorted);
+            return status;
+        }
+
+        locked = true;
+        shadowFile = g_etcShadow;
+    }
+
+    if (NULL == (current = LoadStringFromFile(shadowFile, false, log)))
+    {
+        OsConfigLogError(log, "SetShadowAgingValues: cannot read '%s'", shadowFile);
+        status = EACCES;
+    }
+
+    for (line = current; (NULL != line) && (0 == status); line = next)
+    {
+        if (NULL != (next = strchr(line, EOL)))
+        {
+            *next = 0;
+            next += 1;
+        }
+        else if (0 == *line)
+        {
+            break;
+        }
+
+        numberOfFields = SplitShadowLine(line, fields);
+        key.username = fields[0];
+
+        if (NULL != (found = (SHADOW_AGING_CHANGE**)bsearch(&keyPointer, sorted, numberOfChanges, sizeof(SHADOW_AGING_CHANGE*), CompareShadowAgingChanges)))
+        {
+            // Go back to the first of the changes for this user
+            for (; (found > sorted) && (0 == strcmp((*(found - 1))->username, fields[0])); found--);
+
+            for (; (found < (sorted + numberOfChanges)) && (0 == strcmp((*found)->username, fields[0])); found++)
+            {
+                if (SHADOW_NUMBER_OF_FIELDS != numberOfFields)
+                {
+                    OsConfigLogError(log, "SetShadowAgingValues: the entry of user '%s' in '%s' has %u fields instead of %d, not changed",
+                        fields[0], shadowFile, numberOfFields, SHADOW_NUMBER_OF_FIELDS);
+                    (*found)->result = EINVAL;
+                    continue;
+                }
+
+                // Negative values clear the field, same as chage with -1
+                if ((*found)->value >= 0)
+                {
+                    snprintf(values[(*found)->field], sizeof(values[0]), "%ld", (*found)->value);
+                }
+                else
+                {
+                    values[(*found)->field][0] = 0;
+                }
+
+                fields[(*found)->field] = values[(*found)->field];
+                (*found)->result = 0;
+                changed = true;
+                applied += 1;
+            }
+        }
+
+        for (i = 0; (i < numberOfFields) && (0 == status); i++)
+        {
+            if (0 != i)
+            {
+                status = AppendShadowText(&contents, &size, &capacity, ":", 1);
+            }
+
+            if (0 == status)
+            {
+                status = AppendShadowText(&contents, &size, &capacity, fields[i], strlen(fields[i]));
+            }
+        }
+
+        if (0 == status)
+        {
+            status = AppendShadowText(&contents, &size, &capacity, "\n", 1);
+        }
+
+        if (ENOMEM == status)
+        {
+            OsConfigLogError(log, "SetShadowAgingValues: out of memory");
+        }
+    }
+
+    if ((0 == status) && changed)
+    {
+        if (0 == (status = ReplaceShadowFile(shadowFile, contents, size, log)))
+        {
+            OsConfigLogInfo(log, "SetShadowAgingValues: %u of %u changes applied to '%s' in a single write", applied, numberOfChanges, shadowFile);
+        }
+    }
+
+    if (0 != status)
+    {
+        for (i = 0; i < numberOfChanges; i++)
+        {
+            if (0 == changes[i].result)
+            {
+                changes[i].result = status;
+            }
+        }
+    }
+
+    if (locked)
+    {
+        ulckpwdf();
+        InvalidateAccountSnapshot();
+
+        if ((0 == status) && changed)
+        {
+            FlushShadowCaches(log);
+        }
+    }
+
+    FREE_MEMORY(contents);
+    FREE_MEMORY(current);
+    FREE_MEMORY(sorted);
+
+    return status;
+}
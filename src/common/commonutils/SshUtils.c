@@ -4,7 +4,11 @@
 #include "Internal.h"
 #include "SshUtils.h"
 
+#include <glob.h>
+#include <pthread.h>
+
 static const char* g_sshServerService = "sshd";
+static const char* g_sshServerDefaultConfiguration = "/etc/ssh/sshd_config";
 static const char* g_sshServerConfiguration = "/etc/ssh/sshd_config";
 static const char* g_sshServerConfigurationBackup = "/etc/ssh/sshd_config.bak";
 static const char* g_osconfigRemediationConf = "/etc/ssh/sshd_config.d/osconfig_remediation.conf";
@@ -139,48 +143,354 @@ static char* g_desiredAppropriateCiphersForSsh = NULL;
 
 static bool g_auditOnlySession = true;
 
-static char* GetSshServerState(const char* name, void* log)
+// The effective SSH Server configuration reported by 'sshd -T' is taken once into a snapshot and reused by all checks
+// for up to this long, or until the configuration files change or get remediated
+#define SSH_SERVER_STATE_CACHE_SECONDS 60
+
+static const char* g_sshdDashTCommand = "sshd -T";
+
+typedef struct SSH_SERVER_SETTING
+{
+    const char* name;
+    const char* value;
+    // Next setting with the same name plus one, for options listed once per value such as allowusers, 0 when last
+    unsigned int next;
+} SSH_SERVER_SETTING;
+
+typedef struct SSH_SERVER_SNAPSHOT
+{
+    // The 'sshd -T' output, names and values point into it
+    char* buffer;
+    SSH_SERVER_SETTING* settings;
+    unsigned int numberOfSettings;
+    // Open addressing hash table of the first setting for each name plus one, 0 marks an empty bucket
+    unsigned int* buckets;
+    unsigned int numberOfBuckets;
+    unsigned long long configurationStamp;
+    time_t taken;
+} SSH_SERVER_SNAPSHOT;
+
+static SSH_SERVER_SNAPSHOT g_sshServerSnapshot = {0};
+static pthread_mutex_t g_sshServerSnapshotLock = PTHREAD_MUTEX_INITIALIZER;
+
+static int ReportSshServerStateWithSshd(char** response, void* log)
 {
-    const char* sshdDashTCommand = "sshd -T";
-    const char* commandTemplateForOne = "%s | grep  -m 1 -w %s";
-    char* command = NULL;
-    char* textResult = NULL;
     int status = 0;
 
-    if (NULL == name)
+    if (0 != (status = ExecuteCommand(NULL, g_sshdDashTCommand, false, false, 0, 0, response, NULL, NULL)))
     {
-        if (0 != (status = ExecuteCommand(NULL, sshdDashTCommand, true, false, 0, 0, &textResult, NULL, NULL)))
-        {
-            OsConfigLogError(log, "GetSshServerState: '%s' failed with %d and '%s'", sshdDashTCommand, status, textResult);
-            FREE_MEMORY(textResult);
-        }
+        OsConfigLogError(log, "ReportSshServerStateWithSshd: '%s' failed with %d and '%s'", g_sshdDashTCommand, status, *response);
     }
-    else
+
+    return status;
+}
+
+static SshServerStateProvider g_sshServerStateProvider = ReportSshServerStateWithSshd;
+static unsigned int g_sshServerStateCacheSeconds = SSH_SERVER_STATE_CACHE_SECONDS;
+
+static unsigned long long HashSshBytes(unsigned long long hash, const void* bytes, size_t size)
+{
+    // FNV-1a
+    const unsigned char* next = (const unsigned char*)bytes;
+    size_t i = 0;
+
+    for (i = 0; i < size; i++)
     {
-        if (NULL != (command = FormatAllocateString(commandTemplateForOne, sshdDashTCommand, name)))
+        hash = (hash ^ next[i]) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static unsigned long long HashSshConfigurationFile(unsigned long long hash, const char* fileName)
+{
+    struct stat statStruct = {0};
+
+    hash = HashSshBytes(hash, fileName, strlen(fileName));
+
+    if (0 == stat(fileName, &statStruct))
+    {
+        hash = HashSshBytes(hash, &statStruct.st_ino, sizeof(statStruct.st_ino));
+        hash = HashSshBytes(hash, &statStruct.st_size, sizeof(statStruct.st_size));
+        hash = HashSshBytes(hash, &statStruct.st_mtim, sizeof(statStruct.st_mtim));
+    }
+
+    return hash;
+}
+
+// Identifies the current version of sshd_config and of all the files it includes, changes when any of them is edited, added or removed
+static unsigned long long GetSshConfigurationStamp(void* log)
+{
+    const char* include = "include";
+    unsigned long long hash = 14695981039346656037ULL;
+    char* configuration = NULL;
+    char* line = NULL;
+    char* next = NULL;
+    char* pattern = NULL;
+    char* fullPattern = NULL;
+    char* context = NULL;
+    glob_t found = {0};
+    size_t i = 0;
+
+    hash = HashSshConfigurationFile(hash, g_sshServerConfiguration);
+
+    if (NULL == (configuration = LoadCachedStringFromFile(g_sshServerConfiguration, log)))
+    {
+        return hash;
+    }
+
+    for (line = configuration; NULL != line; line = next)
+    {
+        if (NULL != (next = strchr(line, EOL)))
         {
-            if (0 != (status = ExecuteCommand(NULL, command, true, false, 0, 0, &textResult, NULL, NULL)))
-            {
-                OsConfigLogError(log, "GetSshServerState: '%s' failed with %d and '%s'", command, status, textResult);
-                FREE_MEMORY(textResult);
-            }
-            else if ((NULL != textResult) && (NULL != strstr(textResult, name)))
+            *next = 0;
+            next += 1;
+        }
+
+        for (; isspace(*line); line++);
+
+        if ((0 != strncasecmp(line, include, strlen(include))) || (false == isspace(line[strlen(include)])))
+        {
+            continue;
+        }
+
+        // Each Include lists one or more glob patterns, relative ones are under /etc/ssh
+        for (pattern = strtok_r(line + strlen(include), " \t\r", &context); NULL != pattern; pattern = strtok_r(NULL, " \t\r", &context))
+        {
+            if (NULL != (fullPattern = ('/' == pattern[0]) ? DuplicateString(pattern) : FormatAllocateString("/etc/ssh/%s", pattern)))
             {
-                RemovePrefixUpToString(textResult, name);
-                RemovePrefixUpTo(textResult, ' ');
-                RemovePrefixBlanks(textResult);
-                RemoveTrailingBlanks(textResult);
+                hash = HashSshBytes(hash, fullPattern, strlen(fullPattern));
+
+                if (0 == glob(fullPattern, 0, NULL, &found))
+                {
+                    for (i = 0; i < found.gl_pathc; i++)
+                    {
+                        hash = HashSshConfigurationFile(hash, found.gl_pathv[i]);
+                    }
+                }
+
+                globfree(&found);
+                FREE_MEMORY(fullPattern);
             }
         }
+    }
+
+    FREE_MEMORY(configuration);
+
+    return hash;
+}
+
+static unsigned int HashSshServerSettingName(const char* name)
+{
+    unsigned int hash = 2166136261u;
+
+    for (; 0 != *name; name++)
+    {
+        hash = (hash ^ (unsigned char)tolower((unsigned char)*name)) * 16777619u;
+    }
+
+    return hash;
+}
+
+static void ClearSshServerSnapshot(SSH_SERVER_SNAPSHOT* snapshot)
+{
+    FREE_MEMORY(snapshot->buffer);
+    FREE_MEMORY(snapshot->settings);
+    FREE_MEMORY(snapshot->buckets);
+    memset(snapshot, 0, sizeof(SSH_SERVER_SNAPSHOT));
+}
+
+static const SSH_SERVER_SETTING* FindSshServerSetting(const SSH_SERVER_SNAPSHOT* snapshot, const char* name)
+{
+    unsigned int bucket = 0;
+
+    if (0 == snapshot->numberOfBuckets)
+    {
+        return NULL;
+    }
+
+    for (bucket = HashSshServerSettingName(name) & (snapshot->numberOfBuckets - 1); 0 != snapshot->buckets[bucket]; bucket = (bucket + 1) & (snapshot->numberOfBuckets - 1))
+    {
+        if (0 == strcasecmp(snapshot->settings[snapshot->buckets[bucket] - 1].name, name))
+        {
+            return &snapshot->settings[snapshot->buckets[bucket] - 1];
+        }
+    }
+
+    return NULL;
+}
+
+// Splits the 'sshd -T' output, one 'name value' per line, into the settings of the snapshot
+static int ParseSshServerSnapshot(SSH_SERVER_SNAPSHOT* snapshot)
+{
+    SSH_SERVER_SETTING* setting = NULL;
+    char* line = NULL;
+    char* next = NULL;
+    char* value = NULL;
+    unsigned int numberOfLines = 1;
+    unsigned int bucket = 0;
+    unsigned int i = 0;
+
+    for (line = snapshot->buffer; 0 != *line; line++)
+    {
+        numberOfLines += (EOL == *line) ? 1 : 0;
+    }
+
+    for (snapshot->numberOfBuckets = 16; snapshot->numberOfBuckets < (2 * numberOfLines); snapshot->numberOfBuckets *= 2);
+
+    if ((NULL == (snapshot->settings = (SSH_SERVER_SETTING*)calloc(numberOfLines, sizeof(SSH_SERVER_SETTING)))) ||
+        (NULL == (snapshot->buckets = (unsigned int*)calloc(snapshot->numberOfBuckets, sizeof(unsigned int)))))
+    {
+        return ENOMEM;
+    }
+
+    for (line = snapshot->buffer; NULL != line; line = next)
+    {
+        if (NULL != (next = strchr(line, EOL)))
+        {
+            *next = 0;
+            next += 1;
+        }
+
+        for (; isspace(*line); line++);
+
+        if (0 == line[0])
+        {
+            continue;
+        }
+
+        if (NULL != (value = strchr(line, ' ')))
+        {
+            *value = 0;
+            for (value += 1; isspace(*value); value++);
+            RemoveTrailingBlanks(value);
+        }
+
+        i = snapshot->numberOfSettings++;
+        snapshot->settings[i].name = line;
+        snapshot->settings[i].value = value ? value : "";
+
+        if (NULL != (setting = (SSH_SERVER_SETTING*)FindSshServerSetting(snapshot, line)))
+        {
+            // Another value for a name already seen, chain it after the last one
+            for (; 0 != setting->next; setting = &snapshot->settings[setting->next - 1]);
+            setting->next = i + 1;
+        }
         else
         {
-            OsConfigLogError(log, "GetSshServerState: FormatAllocateString failed");
+            for (bucket = HashSshServerSettingName(line) & (snapshot->numberOfBuckets - 1); 0 != snapshot->buckets[bucket]; bucket = (bucket + 1) & (snapshot->numberOfBuckets - 1));
+            snapshot->buckets[bucket] = i + 1;
         }
+    }
 
-        FREE_MEMORY(command);
+    return 0;
+}
+
+// Makes sure g_sshServerSnapshot reflects the current configuration, called with g_sshServerSnapshotLock held
+static int RefreshSshServerSnapshot(void* log)
+{
+    SSH_SERVER_SNAPSHOT snapshot = {0};
+    unsigned long long configurationStamp = GetSshConfigurationStamp(log);
+    time_t now = time(NULL);
+    int status = 0;
+
+    if ((NULL != g_sshServerSnapshot.buffer) && (configurationStamp == g_sshServerSnapshot.configurationStamp) &&
+        (now >= g_sshServerSnapshot.taken) && ((now - g_sshServerSnapshot.taken) < (time_t)g_sshServerStateCacheSeconds))
+    {
+        return 0;
     }
 
-    return textResult;
+    snapshot.configurationStamp = configurationStamp;
+    snapshot.taken = now;
+
+    if (0 != (status = g_sshServerStateProvider(&snapshot.buffer, log)))
+    {
+        OsConfigLogError(log, "RefreshSshServerSnapshot: cannot read the effective SSH Server configuration (%d)", status);
+    }
+    else if (NULL == snapshot.buffer)
+    {
+        OsConfigLogError(log, "RefreshSshServerSnapshot: the effective SSH Server configuration is empty");
+        status = ENOENT;
+    }
+    else if (0 != (status = ParseSshServerSnapshot(&snapshot)))
+    {
+        OsConfigLogError(log, "RefreshSshServerSnapshot: failed to parse the effective SSH Server configuration (%d)", status);
+    }
+
+    if (0 == status)
+    {
+        ClearSshServerSnapshot(&g_sshServerSnapshot);
+        memcpy(&g_sshServerSnapshot, &snapshot, sizeof(SSH_SERVER_SNAPSHOT));
+        OsConfigLogInfo(log, "RefreshSshServerSnapshot: %u settings reported", g_sshServerSnapshot.numberOfSettings);
+    }
+    else
+    {
+        ClearSshServerSnapshot(&snapshot);
+    }
+
+    return status;
+}
+
+static void InvalidateSshServerState(void)
+{
+    pthread_mutex_lock(&g_sshServerSnapshotLock);
+    ClearSshServerSnapshot(&g_sshServerSnapshot);
+    pthread_mutex_unlock(&g_sshServerSnapshotLock);
+}
+
+void SetSshServerStateProvider(SshServerStateProvider provider, const char* configurationFile, unsigned int cacheSeconds)
+{
+    pthread_mutex_lock(&g_sshServerSnapshotLock);
+    g_sshServerStateProvider = provider ? provider : ReportSshServerStateWithSshd;
+    g_sshServerConfiguration = configurationFile ? configurationFile : g_sshServerDefaultConfiguration;
+    g_sshServerStateCacheSeconds = provider ? cacheSeconds : SSH_SERVER_STATE_CACHE_SECONDS;
+    ClearSshServerSnapshot(&g_sshServerSnapshot);
+    pthread_mutex_unlock(&g_sshServerSnapshotLock);
+}
+
+// Returns the first value reported for the named option, or NULL when the option is not reported
+char* GetSshServerState(const char* name, void* log)
+{
+    const SSH_SERVER_SETTING* setting = NULL;
+    char* value = NULL;
+
+    if (NULL == name)
+    {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&g_sshServerSnapshotLock);
+
+    if ((0 == RefreshSshServerSnapshot(log)) && (NULL != (setting = FindSshServerSetting(&g_sshServerSnapshot, name))))
+    {
+        value = DuplicateString(setting->value);
+    }
+
+    pthread_mutex_unlock(&g_sshServerSnapshotLock);
+
+    return value;
+}
+
+// Checks whether any of the values reported for the named option is the given one
+bool IsSshServerStateValue(const char* name, const char* value, void* log)
+{
+    const SSH_SERVER_SETTING* setting = NULL;
+    bool found = false;
+
+    pthread_mutex_lock(&g_sshServerSnapshotLock);
+
+    if (0 == RefreshSshServerSnapshot(log))
+    {
+        for (setting = FindSshServerSetting(&g_sshServerSnapshot, name); (NULL != setting) && (false == found);
+            setting = setting->next ? &g_sshServerSnapshot.settings[setting->next - 1] : NULL)
+        {
+            found = (0 == strcmp(setting->value, value)) ? true : false;
+        }
+    }
+
+    pthread_mutex_unlock(&g_sshServerSnapshotLock);
+
+    return found;
 }
 
 static int IsSshServerActive(void* log)
@@ -724,10 +1034,6 @@ int CheckSshProtocol(char** reason, void* log)
 
 static int CheckAllowDenyUsersGroups(const char* lowercase, const char* expectedValue, char** reason, void* log)
 {
-    const char* commandTemplate = "%s -T | grep \"%s %s\"";
-    char* command = NULL;
-    char* textResult = NULL;
-    size_t commandLength = 0;
     size_t valueLength = 0;
     size_t i = 0;
     char* value = NULL;
@@ -750,6 +1056,7 @@ static int CheckAllowDenyUsersGroups(const char* lowercase, const char* expected
 
     valueLength = strlen(expectedValue);
 
+    // The SSH Server reports these options once per user or group, each one in the list must be among them
     for (i = 0; i < valueLength; i++)
     {
         if (NULL == (value = DuplicateString(&(expectedValue[i]))))
@@ -758,31 +1065,21 @@ static int CheckAllowDenyUsersGroups(const char* lowercase, const char* expected
             status = ENOMEM;
             break;
         }
-        else
-        {
-            TruncateAtFirst(value, ' ');
 
-            commandLength = strlen(commandTemplate) + strlen(g_sshServerService) + strlen(lowercase) + strlen(value) + 1;
-            if (NULL != (command = malloc(commandLength)))
-            {
-                memset(command, 0, commandLength);
-                snprintf(command, commandLength, commandTemplate, g_sshServerService, lowercase, value);
+        TruncateAtFirst(value, ' ');
 
-                status = ExecuteCommand(NULL, command, true, false, 0, 0, &textResult, NULL, NULL);
+        if ((0 < strlen(value)) && (false == IsSshServerStateValue(lowercase, value, log)))
+        {
+            OsConfigLogInfo(log, "CheckAllowDenyUsersGroups: '%s %s' not found in SSH Server response", lowercase, value);
+            status = ENOENT;
+        }
 
-                FREE_MEMORY(textResult);
-                FREE_MEMORY(command);
-            }
-            else
-            {
-                OsConfigLogError(log, "CheckAllowDenyUsersGroups: failed to allocate memory");
-                status = ENOMEM;
-                FREE_MEMORY(value);
-                break;
-            }
+        i += strlen(value);
+        FREE_MEMORY(value);
 
-            i += strlen(value);
-            FREE_MEMORY(value);
+        if (0 != status)
+        {
+            break;
         }
     }
 
@@ -1180,6 +1477,8 @@ void SshAuditCleanup(void* log)
             RestartDaemon(g_sshServerService, log);
         }
     }
+
+    InvalidateSshServerState();
     
     FREE_MEMORY(g_desiredPermissionsOnEtcSshSshdConfig);
     FREE_MEMORY(g_desiredSshPort);
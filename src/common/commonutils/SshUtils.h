@@ -14,6 +14,15 @@ int InitializeSshAuditCheck(const char* name, char* value, void* log);
 int ProcessSshAuditCheck(const char* name, char* value, char** reason, void* log);
 void SshAuditCleanup(void* log);
 
+// Returns the allocated effective SSH Server configuration in the format of 'sshd -T', one 'name value' line per value
+typedef int(*SshServerStateProvider)(char** response, void* log);
+
+// The effective configuration of the SSH Server configured by configurationFile is taken from the provider and reused for up to cacheSeconds,
+// or until configurationFile or the files it includes change. SetSshServerStateProvider(NULL, NULL, 0) goes back to 'sshd -T' and /etc/ssh/sshd_config
+void SetSshServerStateProvider(SshServerStateProvider provider, const char* configurationFile, unsigned int cacheSeconds);
+char* GetSshServerState(const char* name, void* log);
+bool IsSshServerStateValue(const char* name, const char* value, void* log);
+
 #ifdef __cplusplus
 }
 #endif
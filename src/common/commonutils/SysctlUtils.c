@@ -0,0 +1,440 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "Internal.h"
+
+#include <fcntl.h>
+
+static const char* g_procSys = "/proc/sys";
+static const char* g_etcSysctlConf = "/etc/sysctl.conf";
+
+// Maps a dotted kernel parameter name such as net.ipv4.tcp_syncookies to its file under the /proc/sys root
+static char* GetSysctlPath(const char* procSysRoot, const char* name)
+{
+    char* path = NULL;
+    char* next = NULL;
+    size_t rootLength = 0;
+
+    if (NULL != (path = FormatAllocateString("%s/%s", procSysRoot ? procSysRoot : g_procSys, name)))
+    {
+        // Names already given as paths (net/ipv4/tcp_syncookies) are used as they are
+        if (NULL == strchr(name, '/'))
+        {
+            rootLength = strlen(procSysRoot ? procSysRoot : g_procSys);
+            for (next = path + rootLength + 1; 0 != *next; next++)
+            {
+                if ('.' == *next)
+                {
+                    *next = '/';
+                }
+            }
+        }
+    }
+
+    return path;
+}
+
+// Collapses the tabs and runs of blanks that separate multiple values (such as in net.ipv4.tcp_rmem) into single spaces
+static void NormalizeSysctlValue(char* value)
+{
+    char* source = value;
+    char* destination = value;
+    bool blank = false;
+
+    for (; isspace(*source); source++);
+
+    for (; 0 != *source; source++)
+    {
+        if (isspace(*source))
+        {
+            blank = true;
+        }
+        else
+        {
+            if (blank)
+            {
+                *destination++ = ' ';
+                blank = false;
+            }
+            *destination++ = *source;
+        }
+    }
+
+    *destination = 0;
+}
+
+char* GetSysctlValue(const char* procSysRoot, const char* name, void* log)
+{
+    char* path = NULL;
+    char* value = NULL;
+
+    if ((NULL == name) || (0 == strlen(name)))
+    {
+        OsConfigLogError(log, "GetSysctlValue called with invalid arguments");
+        return NULL;
+    }
+
+    if (NULL == (path = GetSysctlPath(procSysRoot, name)))
+    {
+        OsConfigLogError(log, "GetSysctlValue: out of memory");
+    }
+    else if (NULL == (value = LoadStringFromFile(path, false, log)))
+    {
+        OsConfigLogInfo(log, "GetSysctlValue: '%s' cannot be read from '%s' (%d)", name, path, errno);
+    }
+    else
+    {
+        NormalizeSysctlValue(value);
+    }
+
+    FREE_MEMORY(path);
+
+    return value;
+}
+
+int CheckSysctlValue(const char* procSysRoot, const char* name, const char* expectedValue, char** reason, void* log)
+{
+    char* value = NULL;
+    char* expected = NULL;
+    int status = 0;
+
+    if ((NULL == name) || (NULL == expectedValue))
+    {
+        OsConfigLogError(log, "CheckSysctlValue called with invalid arguments");
+        return EINVAL;
+    }
+
+    if (NULL == (expected = DuplicateString(expectedValue)))
+    {
+        OsConfigLogError(log, "CheckSysctlValue: out of memory");
+        return ENOMEM;
+    }
+
+    NormalizeSysctlValue(expected);
+
+    if (NULL == (value = GetSysctlValue(procSysRoot, name, log)))
+    {
+        OsConfigCaptureReason(reason, "Kernel parameter '%s' is not found", name);
+        status = ENOENT;
+    }
+    else if (0 == strcmp(value, expected))
+    {
+        OsConfigCaptureSuccessReason(reason, "Kernel parameter '%s' is set to '%s'", name, value);
+    }
+    else
+    {
+        OsConfigCaptureReason(reason, "Kernel parameter '%s' is set to '%s' instead of '%s'", name, value, expected);
+        status = ENOENT;
+    }
+
+    OsConfigLogInfo(log, "CheckSysctlValue('%s', '%s'): %s (%d)", name, expected, PLAIN_STATUS_FROM_ERRNO(status), status);
+
+    FREE_MEMORY(value);
+    FREE_MEMORY(expected);
+
+    return status;
+}
+
+static int WriteSysctlValue(const char* procSysRoot, const char* name, const char* value, void* log)
+{
+    char* path = NULL;
+    size_t length = strlen(value);
+    ssize_t written = 0;
+    int descriptor = -1;
+    int status = 0;
+
+    if (NULL == (path = GetSysctlPath(procSysRoot, name)))
+    {
+        return ENOMEM;
+    }
+
+    // Kernel parameters take the whole value in a single write
+    if (0 > (descriptor = open(path, O_WRONLY | O_CLOEXEC | (procSysRoot ? O_TRUNC : 0))))
+    {
+        status = errno ? errno : ENOENT;
+        OsConfigLogError(log, "WriteSysctlValue: cannot open '%s' (%d)", path, status);
+    }
+    else
+    {
+        while ((0 > (written = write(descriptor, value, length))) && (EINTR == errno));
+
+        if ((0 > written) || ((size_t)written != length))
+        {
+            status = ((0 > written) && errno) ? errno : EIO;
+            OsConfigLogError(log, "WriteSysctlValue: cannot write '%s' to '%s' (%d)", value, path, status);
+        }
+
+        close(descriptor);
+    }
+
+    FREE_MEMORY(path);
+
+    return status;
+}
+
+// Returns the name set by a 'name = value' sysctl.d line, or NULL for comments and blank lines. Modifies the line
+static char* GetSysctlLineName(char* line)
+{
+    char* name = line;
+
+    for (; isspace(*name) || ('-' == *name); name++);
+
+    if ((0 == *name) || ('#' == *name) || (';' == *name))
+    {
+        return NULL;
+    }
+
+    TruncateAtFirst(name, '=');
+    RemoveTrailingBlanks(name);
+
+    return name;
+}
+
+// Only settings that were applied count, those that failed are not persisted
+static bool IsSysctlNameInSettings(const char* name, const SYSCTL_SETTING* settings, unsigned int numberOfSettings)
+{
+    unsigned int i = 0;
+
+    for (i = 0; i < numberOfSettings; i++)
+    {
+        if ((0 == settings[i].result) && (0 == strcmp(name, settings[i].name)))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Rewrites the drop-in once with the applied settings, keeping the lines it has for other parameters
+static int SaveSysctlDropIn(const char* dropInFile, const SYSCTL_SETTING* settings, unsigned int numberOfSettings, void* log)
+{
+    char* current = NULL;
+    char* line = NULL;
+    char* next = NULL;
+    char* name = NULL;
+    char* copy = NULL;
+    char* contents = NULL;
+    char* newContents = NULL;
+    unsigned int i = 0;
+    int status = 0;
+
+    if (NULL == (contents = DuplicateString("")))
+    {
+        return ENOMEM;
+    }
+
+    if (FileExists(dropInFile) && (NULL != (current = LoadStringFromFile(dropInFile, false, log))))
+    {
+        for (line = current; (NULL != line) && (0 == status); line = next)
+        {
+            if (NULL != (next = strchr(line, EOL)))
+            {
+                *next = 0;
+                next += 1;
+            }
+
+            if ((0 == line[0]) && (NULL == next))
+            {
+                break;
+            }
+
+            if (NULL == (copy = DuplicateString(line)))
+            {
+                status = ENOMEM;
+            }
+            else
+            {
+                if ((NULL == (name = GetSysctlLineName(copy))) || (false == IsSysctlNameInSettings(name, settings, numberOfSettings)))
+                {
+                    if (NULL == (newContents = FormatAllocateString("%s%s\n", contents, line)))
+                    {
+                        status = ENOMEM;
+                    }
+                    else
+                    {
+                        FREE_MEMORY(contents);
+                        contents = newContents;
+                    }
+                }
+
+                FREE_MEMORY(copy);
+            }
+        }
+
+        FREE_MEMORY(current);
+    }
+
+    for (i = 0; (i < numberOfSettings) && (0 == status); i++)
+    {
+        if (0 != settings[i].result)
+        {
+            continue;
+        }
+
+        if (NULL == (newContents = FormatAllocateString("%s%s = %s\n", contents, settings[i].name, settings[i].value)))
+        {
+            status = ENOMEM;
+        }
+        else
+        {
+            FREE_MEMORY(contents);
+            contents = newContents;
+        }
+    }
+
+    if ((0 == status) && (false == SecureSaveToFile(dropInFile, contents, strlen(contents), log)))
+    {
+        OsConfigLogError(log, "SaveSysctlDropIn: failed to save '%s'", dropInFile);
+        status = ENOENT;
+    }
+
+    FREE_MEMORY(contents);
+
+    return status;
+}
+
+// /etc/sysctl.conf is applied after the drop-ins, lines there setting the same parameters get the new values too.
+// Lines starting with '#' or ';' are comments (sysctl.conf(5)) and are kept as they are
+static void AlignSysctlConf(const SYSCTL_SETTING* settings, unsigned int numberOfSettings, void* log)
+{
+    char* current = NULL;
+    char* line = NULL;
+    char* next = NULL;
+    char* name = NULL;
+    char* copy = NULL;
+    char* contents = NULL;
+    char* newContents = NULL;
+    bool aligned = false;
+    unsigned int i = 0;
+    int status = 0;
+
+    if ((false == FileExists(g_etcSysctlConf)) || (NULL == (current = LoadStringFromFile(g_etcSysctlConf, false, log))))
+    {
+        return;
+    }
+
+    if (NULL == (contents = DuplicateString("")))
+    {
+        FREE_MEMORY(current);
+        return;
+    }
+
+    for (line = current; (NULL != line) && (0 == status); line = next)
+    {
+        if (NULL != (next = strchr(line, EOL)))
+        {
+            *next = 0;
+            next += 1;
+        }
+
+        if ((0 == line[0]) && (NULL == next))
+        {
+            break;
+        }
+
+        if (NULL == (copy = DuplicateString(line)))
+        {
+            status = ENOMEM;
+            break;
+        }
+
+        // Only parameters that were applied are aligned
+        for (i = 0, name = GetSysctlLineName(copy); (NULL != name) && (i < numberOfSettings); i++)
+        {
+            if ((0 == settings[i].result) && (0 == strcmp(name, settings[i].name)))
+            {
+                break;
+            }
+        }
+
+        if ((NULL != name) && (i < numberOfSettings))
+        {
+            newContents = FormatAllocateString("%s%s = %s\n", contents, settings[i].name, settings[i].value);
+            aligned = true;
+        }
+        else
+        {
+            newContents = FormatAllocateString("%s%s\n", contents, line);
+        }
+
+        FREE_MEMORY(copy);
+
+        if (NULL == newContents)
+        {
+            status = ENOMEM;
+        }
+        else
+        {
+            FREE_MEMORY(contents);
+            contents = newContents;
+        }
+    }
+
+    if (0 != status)
+    {
+        OsConfigLogError(log, "AlignSysctlConf: out of memory");
+    }
+    else if (aligned && (false == SecureSaveToFile(g_etcSysctlConf, contents, strlen(contents), log)))
+    {
+        OsConfigLogError(log, "AlignSysctlConf: failed to save '%s'", g_etcSysctlConf);
+    }
+
+    FREE_MEMORY(contents);
+    FREE_MEMORY(current);
+}
+
+int SetSysctlValues(const char* procSysRoot, SYSCTL_SETTING* settings, unsigned int numberOfSettings, const char* dropInFile, void* log)
+{
+    unsigned int applied = 0;
+    unsigned int i = 0;
+    int status = 0, _status = 0;
+
+    if ((NULL == settings) || (0 == numberOfSettings))
+    {
+        OsConfigLogError(log, "SetSysctlValues called with invalid arguments");
+        return EINVAL;
+    }
+
+    for (i = 0; i < numberOfSettings; i++)
+    {
+        if ((NULL == settings[i].name) || (0 == strlen(settings[i].name)) || (NULL == settings[i].value))
+        {
+            OsConfigLogError(log, "SetSysctlValues: invalid setting %u", i);
+            return EINVAL;
+        }
+    }
+
+    // Apply all values at runtime first, then persist the applied ones with a single write
+    for (i = 0; i < numberOfSettings; i++)
+    {
+        if (0 == (settings[i].result = WriteSysctlValue(procSysRoot, settings[i].name, settings[i].value, log)))
+        {
+            OsConfigLogInfo(log, "SetSysctlValues: '%s' set to '%s'", settings[i].name, settings[i].value);
+            applied += 1;
+        }
+        else if (0 == status)
+        {
+            status = settings[i].result;
+        }
+    }
+
+    if ((NULL != dropInFile) && (0 < applied))
+    {
+        if (0 != (_status = SaveSysctlDropIn(dropInFile, settings, numberOfSettings, log)))
+        {
+            status = (0 == status) ? _status : status;
+        }
+        else
+        {
+            OsConfigLogInfo(log, "SetSysctlValues: %u values persisted in '%s'", applied, dropInFile);
+        }
+
+        if (NULL == procSysRoot)
+        {
+            AlignSysctlConf(settings, numberOfSettings, log);
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,339 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "Internal.h"
+#include <stdint.h>
+
+// Multi-pattern search over a buffer in a single pass (Aho-Corasick compiled into a full byte transition table)
+
+#define TEXT_SEARCH_ALPHABET 256
+#define TEXT_SEARCH_NO_PATTERN ((unsigned int)-1)
+
+// Upper bound for the combined length of the patterns so that the transition table stays small (each state takes 1 KB)
+#define TEXT_SEARCH_MAX_STATES 4096
+
+struct TEXT_SEARCH
+{
+    unsigned int numberOfPatterns;
+    unsigned int numberOfStates;
+    char commentMark;
+    // Length and number of EOLs contained in each pattern
+    size_t* patternLengths;
+    unsigned int* patternLines;
+    // Next pattern identical to this one, duplicates are reported separately
+    unsigned int* nextDuplicate;
+    // Full transition table, numberOfStates x TEXT_SEARCH_ALPHABET
+    unsigned int* transitions;
+    // Pattern ending at each state, and nearest state on the failure chain that also ends a pattern
+    unsigned int* output;
+    unsigned int* outputLink;
+};
+
+void FreeTextSearch(TEXT_SEARCH* search)
+{
+    if (NULL != search)
+    {
+        FREE_MEMORY(search->patternLengths);
+        FREE_MEMORY(search->patternLines);
+        FREE_MEMORY(search->nextDuplicate);
+        FREE_MEMORY(search->transitions);
+        FREE_MEMORY(search->output);
+        FREE_MEMORY(search->outputLink);
+        FREE_MEMORY(search);
+    }
+}
+
+TEXT_SEARCH* CompileTextSearch(const char** patterns, unsigned int numberOfPatterns, char commentMark, void* log)
+{
+    TEXT_SEARCH* search = NULL;
+    unsigned int* failure = NULL;
+    unsigned int* queue = NULL;
+    unsigned int head = 0, tail = 0;
+    unsigned int maxStates = 1;
+    unsigned int state = 0, next = 0, i = 0, c = 0;
+    size_t j = 0;
+
+    if ((NULL == patterns) || (0 == numberOfPatterns))
+    {
+        OsConfigLogError(log, "CompileTextSearch called with invalid arguments");
+        return NULL;
+    }
+
+    for (i = 0; i < numberOfPatterns; i++)
+    {
+        if ((NULL == patterns[i]) || (0 == patterns[i][0]))
+        {
+            OsConfigLogError(log, "CompileTextSearch: pattern %u is empty", i);
+            return NULL;
+        }
+        maxStates += strlen(patterns[i]);
+    }
+
+    if (maxStates > TEXT_SEARCH_MAX_STATES)
+    {
+        OsConfigLogError(log, "CompileTextSearch: patterns are too long (%u states, maximum is %d)", maxStates, TEXT_SEARCH_MAX_STATES);
+        return NULL;
+    }
+
+    if ((NULL == (search = (TEXT_SEARCH*)calloc(1, sizeof(TEXT_SEARCH)))) ||
+        (NULL == (search->patternLengths = (size_t*)calloc(numberOfPatterns, sizeof(size_t)))) ||
+        (NULL == (search->patternLines = (unsigned int*)calloc(numberOfPatterns, sizeof(unsigned int)))) ||
+        (NULL == (search->nextDuplicate = (unsigned int*)calloc(numberOfPatterns, sizeof(unsigned int)))) ||
+        (NULL == (search->transitions = (unsigned int*)calloc((size_t)maxStates * TEXT_SEARCH_ALPHABET, sizeof(unsigned int)))) ||
+        (NULL == (search->output = (unsigned int*)calloc(maxStates, sizeof(unsigned int)))) ||
+        (NULL == (search->outputLink = (unsigned int*)calloc(maxStates, sizeof(unsigned int)))) ||
+        (NULL == (failure = (unsigned int*)calloc(maxStates, sizeof(unsigned int)))) ||
+        (NULL == (queue = (unsigned int*)calloc(maxStates, sizeof(unsigned int)))))
+    {
+        OsConfigLogError(log, "CompileTextSearch: out of memory");
+        FreeTextSearch(search);
+        FREE_MEMORY(failure);
+        return NULL;
+    }
+
+    search->numberOfPatterns = numberOfPatterns;
+    search->commentMark = commentMark;
+    search->numberOfStates = 1;
+
+    for (i = 0; i < maxStates; i++)
+    {
+        search->output[i] = TEXT_SEARCH_NO_PATTERN;
+        search->outputLink[i] = 0;
+    }
+
+    // Build the trie, state 0 is the root and no edge leads back to it so 0 also marks a missing edge
+    for (i = 0; i < numberOfPatterns; i++)
+    {
+        state = 0;
+        search->patternLengths[i] = strlen(patterns[i]);
+        search->nextDuplicate[i] = TEXT_SEARCH_NO_PATTERN;
+
+        for (j = 0; j < search->patternLengths[i]; j++)
+        {
+            c = (unsigned char)patterns[i][j];
+
+            if (EOL == patterns[i][j])
+            {
+                search->patternLines[i] += 1;
+            }
+
+            if (0 == (next = search->transitions[(size_t)state * TEXT_SEARCH_ALPHABET + c]))
+            {
+                next = search->numberOfStates++;
+                search->transitions[(size_t)state * TEXT_SEARCH_ALPHABET + c] = next;
+            }
+
+            state = next;
+        }
+
+        if (TEXT_SEARCH_NO_PATTERN == search->output[state])
+        {
+            search->output[state] = i;
+        }
+        else
+        {
+            next = search->output[state];
+            while (TEXT_SEARCH_NO_PATTERN != search->nextDuplicate[next])
+            {
+                next = search->nextDuplicate[next];
+            }
+            search->nextDuplicate[next] = i;
+        }
+    }
+
+    // Breadth first over the trie, filling in failure links and turning missing edges into transitions
+    for (c = 0; c < TEXT_SEARCH_ALPHABET; c++)
+    {
+        if (0 != (next = search->transitions[c]))
+        {
+            failure[next] = 0;
+            queue[tail++] = next;
+        }
+    }
+
+    while (head < tail)
+    {
+        state = queue[head++];
+
+        search->outputLink[state] = (TEXT_SEARCH_NO_PATTERN != search->output[failure[state]]) ? failure[state] : search->outputLink[failure[state]];
+
+        for (c = 0; c < TEXT_SEARCH_ALPHABET; c++)
+        {
+            next = search->transitions[(size_t)state * TEXT_SEARCH_ALPHABET + c];
+
+            if (0 != next)
+            {
+                failure[next] = search->transitions[(size_t)failure[state] * TEXT_SEARCH_ALPHABET + c];
+                queue[tail++] = next;
+            }
+            else
+            {
+                search->transitions[(size_t)state * TEXT_SEARCH_ALPHABET + c] = search->transitions[(size_t)failure[state] * TEXT_SEARCH_ALPHABET + c];
+            }
+        }
+    }
+
+    FREE_MEMORY(failure);
+    FREE_MEMORY(queue);
+
+    return search;
+}
+
+static int ReportTextMatches(const TEXT_SEARCH* search, unsigned int state, const char* buffer, size_t end, size_t lineStart,
+    size_t firstComment, unsigned int line, TextMatchCallback callback, void* context)
+{
+    TEXT_MATCH match = {0, 0, 0, false};
+    unsigned int pattern = TEXT_SEARCH_NO_PATTERN;
+    size_t index = 0;
+    int status = 0;
+
+    for (; 0 != state; state = search->outputLink[state])
+    {
+        for (pattern = search->output[state]; TEXT_SEARCH_NO_PATTERN != pattern; pattern = search->nextDuplicate[pattern])
+        {
+            match.pattern = pattern;
+            match.offset = end + 1 - search->patternLengths[pattern];
+            match.line = line - search->patternLines[pattern];
+
+            if (match.offset >= lineStart)
+            {
+                match.commented = (firstComment < match.offset) ? true : false;
+            }
+            else
+            {
+                // The pattern itself spans lines, walk back from where it starts
+                match.commented = false;
+                for (index = match.offset; index > 0; index--)
+                {
+                    if (EOL == buffer[index - 1])
+                    {
+                        break;
+                    }
+                    else if (search->commentMark == buffer[index - 1])
+                    {
+                        match.commented = true;
+                        break;
+                    }
+                }
+            }
+
+            if (0 != (status = callback(&match, context)))
+            {
+                return status;
+            }
+        }
+    }
+
+    return status;
+}
+
+int ScanWithTextSearch(const TEXT_SEARCH* search, const char* buffer, size_t size, TextMatchCallback callback, void* context)
+{
+    const unsigned int* transitions = NULL;
+    unsigned int state = 0;
+    unsigned int line = 1;
+    size_t lineStart = 0;
+    size_t firstComment = SIZE_MAX;
+    size_t i = 0;
+    int status = 0;
+
+    if ((NULL == search) || ((NULL == buffer) && (0 != size)) || (NULL == callback))
+    {
+        return EINVAL;
+    }
+
+    transitions = search->transitions;
+
+    for (i = 0; i < size; i++)
+    {
+        if (EOL == buffer[i])
+        {
+            line += 1;
+            lineStart = i + 1;
+            firstComment = SIZE_MAX;
+        }
+        else if ((search->commentMark == buffer[i]) && (SIZE_MAX == firstComment))
+        {
+            firstComment = i;
+        }
+
+        state = transitions[(size_t)state * TEXT_SEARCH_ALPHABET + (unsigned char)buffer[i]];
+
+        if (((TEXT_SEARCH_NO_PATTERN != search->output[state]) || (0 != search->outputLink[state])) &&
+            (0 != (status = ReportTextMatches(search, state, buffer, i, lineStart, firstComment, line, callback, context))))
+        {
+            break;
+        }
+    }
+
+    return status;
+}
+
+static int TallyTextMatch(const TEXT_MATCH* match, void* context)
+{
+    TEXT_SEARCH_RESULT* result = &((TEXT_SEARCH_RESULT*)context)[match->pattern];
+
+    if (0 == result->found)
+    {
+        result->firstLine = match->line;
+    }
+
+    result->found += 1;
+
+    if (false == match->commented)
+    {
+        result->foundUncommented += 1;
+    }
+
+    return 0;
+}
+
+int SearchTextsInFile(const char* fileName, const char** texts, unsigned int numberOfTexts, char commentMark, TEXT_SEARCH_RESULT* results, void* log)
+{
+    TEXT_SEARCH* search = NULL;
+    FILE_SPAN contents = {0};
+    const char* end = NULL;
+    size_t size = 0;
+    int status = 0;
+
+    if ((NULL == fileName) || (NULL == texts) || (0 == numberOfTexts) || (NULL == results))
+    {
+        OsConfigLogError(log, "SearchTextsInFile called with invalid arguments");
+        return EINVAL;
+    }
+
+    memset(results, 0, numberOfTexts * sizeof(TEXT_SEARCH_RESULT));
+
+    if (false == FileExists(fileName))
+    {
+        OsConfigLogInfo(log, "SearchTextsInFile: file '%s' not found", fileName);
+        return ENOENT;
+    }
+
+    if (NULL == (search = CompileTextSearch(texts, numberOfTexts, commentMark, log)))
+    {
+        return EINVAL;
+    }
+
+    if (0 != OpenFileSpan(fileName, &contents, log))
+    {
+        OsConfigLogError(log, "SearchTextsInFile: cannot read from '%s'", fileName);
+        status = EACCES;
+    }
+    else
+    {
+        // Like the string searches this replaces, the contents end at the first null character
+        size = (NULL != (end = (const char*)memchr(contents.data, 0, contents.size))) ? (size_t)(end - contents.data) : contents.size;
+        status = ScanWithTextSearch(search, contents.data, size, TallyTextMatch, results);
+        CloseFileSpan(&contents);
+    }
+
+    FreeTextSearch(search);
+
+    if (IsFullLoggingEnabled())
+    {
+        OsConfigLogInfo(log, "SearchTextsInFile: searched '%s' for %u texts (%d)", fileName, numberOfTexts, status);
+    }
+
+    return status;
+}
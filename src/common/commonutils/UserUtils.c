@@ -4,6 +4,8 @@
 #include "Internal.h"
 #include "UserUtils.h"
 
+#include <fcntl.h>
+#include <pthread.h>
 #include <shadow.h>
 
 #define MAX_GROUPS_USER_CAN_BE_IN 32
@@ -189,9 +191,143 @@ static bool IsNoLoginUser(SIMPLIFIED_USER* user)
     return noLogin;
 }
 
-static int CheckIfUserHasPassword(SIMPLIFIED_USER* user, void* log)
+typedef struct SHADOW_ENTRY
 {
+    char* name;
+    // Only the start of the password field is kept, enough to tell the hashing algorithm or the lock mark
+    char password[4];
+    bool hasPassword;
+    long lastChange;
+    long minimumAge;
+    long maximumAge;
+    long warningPeriod;
+    long inactivityPeriod;
+    long expirationDate;
+} SHADOW_ENTRY;
+
+static int CompareShadowEntries(const void* left, const void* right)
+{
+    return strcmp(((const SHADOW_ENTRY*)left)->name, ((const SHADOW_ENTRY*)right)->name);
+}
+
+static void FreeShadowEntries(SHADOW_ENTRY** shadowEntries, unsigned int numberOfShadowEntries)
+{
+    unsigned int i = 0;
+
+    if (NULL != *shadowEntries)
+    {
+        for (i = 0; i < numberOfShadowEntries; i++)
+        {
+            FREE_MEMORY((*shadowEntries)[i].name);
+        }
+
+        FREE_MEMORY(*shadowEntries);
+    }
+}
+
+// Reads the shadow database once into an array sorted by user name, instead of one getspnam (and one pass over the file) per user
+static int ReadShadowEntries(const char* shadowFile, SHADOW_ENTRY** shadowEntries, unsigned int* numberOfShadowEntries, void* log)
+{
+    FILE* shadowStream = NULL;
     struct spwd* shadowEntry = NULL;
+    SHADOW_ENTRY* entries = NULL;
+    SHADOW_ENTRY* entry = NULL;
+    unsigned int capacity = 0;
+    int status = 0;
+
+    *shadowEntries = NULL;
+    *numberOfShadowEntries = 0;
+
+    // Without a file of its own the shadow database is read through the name service switch
+    if (NULL == shadowFile)
+    {
+        setspent();
+    }
+    else if (NULL == (shadowStream = fopen(shadowFile, "r")))
+    {
+        OsConfigLogError(log, "ReadShadowEntries: cannot open '%s' (%d)", shadowFile, errno);
+        return ENOENT;
+    }
+
+    while ((0 == status) && (NULL != (shadowEntry = shadowStream ? fgetspent(shadowStream) : getspent())))
+    {
+        if (NULL == shadowEntry->sp_namp)
+        {
+            continue;
+        }
+
+        if (*numberOfShadowEntries == capacity)
+        {
+            capacity = capacity ? (2 * capacity) : 64;
+
+            if (NULL == (entries = (SHADOW_ENTRY*)realloc(*shadowEntries, capacity * sizeof(SHADOW_ENTRY))))
+            {
+                OsConfigLogError(log, "ReadShadowEntries: out of memory");
+                status = ENOMEM;
+                break;
+            }
+
+            *shadowEntries = entries;
+        }
+
+        entry = &(*shadowEntries)[*numberOfShadowEntries];
+        memset(entry, 0, sizeof(SHADOW_ENTRY));
+
+        if (NULL == (entry->name = DuplicateString(shadowEntry->sp_namp)))
+        {
+            OsConfigLogError(log, "ReadShadowEntries: out of memory");
+            status = ENOMEM;
+            break;
+        }
+
+        if (NULL != shadowEntry->sp_pwdp)
+        {
+            strncpy(entry->password, shadowEntry->sp_pwdp, sizeof(entry->password) - 1);
+            entry->hasPassword = true;
+        }
+
+        entry->lastChange = shadowEntry->sp_lstchg;
+        entry->minimumAge = shadowEntry->sp_min;
+        entry->maximumAge = shadowEntry->sp_max;
+        entry->warningPeriod = shadowEntry->sp_warn;
+        entry->inactivityPeriod = shadowEntry->sp_inact;
+        entry->expirationDate = shadowEntry->sp_expire;
+
+        *numberOfShadowEntries += 1;
+    }
+
+    if (NULL != shadowStream)
+    {
+        fclose(shadowStream);
+    }
+    else
+    {
+        endspent();
+    }
+
+    if (0 == status)
+    {
+        qsort(*shadowEntries, *numberOfShadowEntries, sizeof(SHADOW_ENTRY), CompareShadowEntries);
+    }
+    else
+    {
+        FreeShadowEntries(shadowEntries, *numberOfShadowEntries);
+        *numberOfShadowEntries = 0;
+    }
+
+    return status;
+}
+
+static const SHADOW_ENTRY* FindShadowEntry(const SHADOW_ENTRY* shadowEntries, unsigned int numberOfShadowEntries, const char* name)
+{
+    SHADOW_ENTRY key = {0};
+    key.name = (char*)name;
+    return (0 < numberOfShadowEntries) ? (const SHADOW_ENTRY*)bsearch(&key, shadowEntries, numberOfShadowEntries, sizeof(SHADOW_ENTRY), CompareShadowEntries) : NULL;
+}
+
+static int CheckIfUserHasPassword(SIMPLIFIED_USER* user, const SHADOW_ENTRY* shadowEntries, unsigned int numberOfShadowEntries, void* log)
+{
+    const SHADOW_ENTRY* shadowEntry = NULL;
     char control = 0;
     int status = 0;
 
@@ -206,23 +342,21 @@ static int CheckIfUserHasPassword(SIMPLIFIED_USER* user, void* log)
         return 0;
     }
 
-    setspent();
-
-    if (NULL != (shadowEntry = getspnam(user->username)))
+    if (NULL != (shadowEntry = FindShadowEntry(shadowEntries, numberOfShadowEntries, user->username)))
     {
-        control = shadowEntry->sp_pwdp ? shadowEntry->sp_pwdp[0] : 'n';
+        control = shadowEntry->hasPassword ? shadowEntry->password[0] : 'n';
 
         switch (control)
         {
             case '$':
-                switch (shadowEntry->sp_pwdp[1])
+                switch (shadowEntry->password[1])
                 {
                     case '1':
                         user->passwordEncryption = md5;
                         break;
 
                     case '2':
-                        switch (shadowEntry->sp_pwdp[2])
+                        switch (shadowEntry->password[2])
                         {
                             case 'a':
                                 user->passwordEncryption = blowfish;
@@ -250,12 +384,12 @@ static int CheckIfUserHasPassword(SIMPLIFIED_USER* user, void* log)
                 }
 
                 user->hasPassword = true;
-                user->lastPasswordChange = shadowEntry->sp_lstchg;
-                user->minimumPasswordAge = shadowEntry->sp_min;
-                user->maximumPasswordAge = shadowEntry->sp_max;
-                user->warningPeriod = shadowEntry->sp_warn;
-                user->inactivityPeriod = shadowEntry->sp_inact;
-                user->expirationDate = shadowEntry->sp_expire;
+                user->lastPasswordChange = shadowEntry->lastChange;
+                user->minimumPasswordAge = shadowEntry->minimumAge;
+                user->maximumPasswordAge = shadowEntry->maximumAge;
+                user->warningPeriod = shadowEntry->warningPeriod;
+                user->inactivityPeriod = shadowEntry->inactivityPeriod;
+                user->expirationDate = shadowEntry->expirationDate;
                 break;
 
             case '!':
@@ -277,50 +411,164 @@ static int CheckIfUserHasPassword(SIMPLIFIED_USER* user, void* log)
     }
     else
     {
-        OsConfigLogError(log, "CheckIfUserHasPassword: getspnam('%s') failed (%d)", user->username, errno);
+        OsConfigLogError(log, "CheckIfUserHasPassword: user '%s' not found in '%s'", user->username, g_etcShadow);
         status = ENOENT;
     }
 
-    endspent();
-
     return status;
 }
 
-int EnumerateUsers(SIMPLIFIED_USER** userList, unsigned int* size, char** reason, void* log)
+// The user and group lists stay enumerated while the account files are unchanged, and for at most this long (other name services have no file to watch)
+#define ACCOUNT_SNAPSHOT_CACHE_SECONDS 60
+
+typedef struct ACCOUNT_SNAPSHOT
 {
-    const char* passwdFile = "/etc/passwd";
+    SIMPLIFIED_USER* users;
+    unsigned int numberOfUsers;
+    unsigned long long usersStamp;
+    time_t usersTaken;
+    SIMPLIFIED_GROUP* groups;
+    unsigned int numberOfGroups;
+    unsigned long long groupsStamp;
+    time_t groupsTaken;
+} ACCOUNT_SNAPSHOT;
+
+static ACCOUNT_SNAPSHOT g_accountSnapshot = {0};
+static pthread_mutex_t g_accountSnapshotLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Set by SetAccountFiles, these replace the account databases of the system
+static char* g_accountPasswdFile = NULL;
+static char* g_accountShadowFile = NULL;
+static char* g_accountGroupFile = NULL;
+
+static unsigned long long GetAccountFilesStamp(const char** files, unsigned int numberOfFiles)
+{
+    struct stat statStruct = {0};
+    unsigned long long hash = 14695981039346656037ULL;
+    unsigned long long values[5] = {0};
+    const unsigned char* bytes = NULL;
+    unsigned int i = 0;
+    size_t j = 0;
 
-    struct passwd* userEntry = NULL;
+    for (i = 0; i < numberOfFiles; i++)
+    {
+        memset(values, 0, sizeof(values));
+
+        if (0 == stat(files[i], &statStruct))
+        {
+            values[0] = (unsigned long long)statStruct.st_dev;
+            values[1] = (unsigned long long)statStruct.st_ino;
+            values[2] = (unsigned long long)statStruct.st_size;
+            values[3] = (unsigned long long)statStruct.st_mtim.tv_sec;
+            values[4] = (unsigned long long)statStruct.st_mtim.tv_nsec;
+        }
+
+        // FNV-1a
+        for (bytes = (const unsigned char*)values, j = 0; j < sizeof(values); j++)
+        {
+            hash = (hash ^ bytes[j]) * 1099511628211ULL;
+        }
+    }
+
+    return hash;
+}
+
+static bool IsAccountSnapshotCurrent(time_t taken, unsigned long long stamp, unsigned long long currentStamp)
+{
+    time_t now = time(NULL);
+    return ((stamp == currentStamp) && (now >= taken) && ((now - taken) < ACCOUNT_SNAPSHOT_CACHE_SECONDS)) ? true : false;
+}
+
+static int CopyUsersList(SIMPLIFIED_USER** destination, const SIMPLIFIED_USER* source, unsigned int size, void* log)
+{
     unsigned int i = 0;
-    size_t listSize = 0;
     int status = 0;
 
-    if ((NULL == userList) || (NULL == size))
+    if (0 == size)
     {
-        OsConfigLogError(log, "EnumerateUsers: invalid arguments");
-        return EINVAL;
+        *destination = NULL;
+        return 0;
     }
 
+    if (NULL == (*destination = (SIMPLIFIED_USER*)calloc(size, sizeof(SIMPLIFIED_USER))))
+    {
+        OsConfigLogError(log, "CopyUsersList: out of memory");
+        return ENOMEM;
+    }
+
+    for (i = 0; i < size; i++)
+    {
+        memcpy(&((*destination)[i]), &source[i], sizeof(SIMPLIFIED_USER));
+        (*destination)[i].username = NULL;
+        (*destination)[i].home = NULL;
+        (*destination)[i].shell = NULL;
+
+        if (((NULL != source[i].username) && (NULL == ((*destination)[i].username = DuplicateString(source[i].username)))) ||
+            ((NULL != source[i].home) && (NULL == ((*destination)[i].home = DuplicateString(source[i].home)))) ||
+            ((NULL != source[i].shell) && (NULL == ((*destination)[i].shell = DuplicateString(source[i].shell)))))
+        {
+            OsConfigLogError(log, "CopyUsersList: out of memory");
+            status = ENOMEM;
+            break;
+        }
+    }
+
+    if (0 != status)
+    {
+        FreeUsersList(destination, size);
+    }
+
+    return status;
+}
+
+static int ReadUsers(SIMPLIFIED_USER** userList, unsigned int* size, void* log)
+{
+    const char* passwdFile = g_accountPasswdFile ? g_accountPasswdFile : g_etcPasswd;
+
+    FILE* passwdStream = NULL;
+    struct passwd* userEntry = NULL;
+    SHADOW_ENTRY* shadowEntries = NULL;
+    unsigned int numberOfShadowEntries = 0;
+    unsigned int i = 0;
+    int status = 0;
+
     *userList = NULL;
     *size = 0;
 
     if (0 != (*size = GetNumberOfLinesInFile(passwdFile)))
     {
-        listSize = (*size) * sizeof(SIMPLIFIED_USER);
-        if (NULL != (*userList = malloc(listSize)))
+        // Zeroed up front, so that on any failure below the list can be freed whole
+        if (NULL == (*userList = (SIMPLIFIED_USER*)calloc(*size, sizeof(SIMPLIFIED_USER))))
         {
-            memset(*userList, 0, listSize);
-
-            setpwent();
+            OsConfigLogError(log, "EnumerateUsers: out of memory");
+            *size = 0;
+            status = ENOMEM;
+        }
+        else if (0 != (status = ReadShadowEntries(g_accountShadowFile, &shadowEntries, &numberOfShadowEntries, log)))
+        {
+            OsConfigLogError(log, "EnumerateUsers: failed reading '%s' (%d)", g_accountShadowFile ? g_accountShadowFile : g_etcShadow, status);
+        }
+        else if ((NULL != g_accountPasswdFile) && (NULL == (passwdStream = fopen(g_accountPasswdFile, "r"))))
+        {
+            OsConfigLogError(log, "EnumerateUsers: cannot open '%s' (%d)", g_accountPasswdFile, errno);
+            FreeShadowEntries(&shadowEntries, numberOfShadowEntries);
+            status = ENOENT;
+        }
+        else
+        {
+            if (NULL == passwdStream)
+            {
+                setpwent();
+            }
 
-            while ((NULL != (userEntry = getpwent())) && (i < *size))
+            while ((NULL != (userEntry = passwdStream ? fgetpwent(passwdStream) : getpwent())) && (i < *size))
             {
                 if (0 != (status = CopyUserEntry(&((*userList)[i]), userEntry, log)))
                 {
                     OsConfigLogError(log, "EnumerateUsers: failed making copy of user entry (%d)", status);
                     break;
                 }
-                else if (0 != (status = CheckIfUserHasPassword(&((*userList)[i]), log)))
+                else if (0 != (status = CheckIfUserHasPassword(&((*userList)[i]), shadowEntries, numberOfShadowEntries, log)))
                 {
                     OsConfigLogError(log, "EnumerateUsers: failed checking user's login and password (%d)", status);
                     break;
@@ -329,13 +577,19 @@ int EnumerateUsers(SIMPLIFIED_USER** userList, unsigned int* size, char** reason
                 i += 1;
             }
 
-            endpwent();
-        }
-        else
-        {
-            OsConfigLogError(log, "EnumerateUsers: out of memory");
-            *size = 0;
-            status = ENOMEM;
+            if (NULL != passwdStream)
+            {
+                fclose(passwdStream);
+            }
+            else
+            {
+                endpwent();
+            }
+
+            // On failure the entry being filled is released as well
+            *size = (0 == status) ? i : (i + 1);
+
+            FreeShadowEntries(&shadowEntries, numberOfShadowEntries);
         }
     }
     else
@@ -344,11 +598,10 @@ int EnumerateUsers(SIMPLIFIED_USER** userList, unsigned int* size, char** reason
         status = EPERM;
     }
 
-    
     if (0 != status)
     {
-        OsConfigLogError(log, "EnumerateUsers failed with %d", status);
-        OsConfigCaptureReason(reason, "Failed to enumerate users (%d). User database may be corrupt. Automatic remediation is not possible", status);
+        FreeUsersList(userList, *size);
+        *size = 0;
     }
     else if (IsFullLoggingEnabled())
     {
@@ -364,6 +617,56 @@ int EnumerateUsers(SIMPLIFIED_USER** userList, unsigned int* size, char** reason
     return status;
 }
 
+int EnumerateUsers(SIMPLIFIED_USER** userList, unsigned int* size, char** reason, void* log)
+{
+    const char* files[] = {g_accountPasswdFile ? g_accountPasswdFile : g_etcPasswd, g_accountShadowFile ? g_accountShadowFile : g_etcShadow};
+    unsigned long long stamp = 0;
+    int status = 0;
+
+    if ((NULL == userList) || (NULL == size))
+    {
+        OsConfigLogError(log, "EnumerateUsers: invalid arguments");
+        return EINVAL;
+    }
+
+    *userList = NULL;
+    *size = 0;
+
+    pthread_mutex_lock(&g_accountSnapshotLock);
+
+    stamp = GetAccountFilesStamp(files, ARRAY_SIZE(files));
+
+    if ((NULL == g_accountSnapshot.users) || (false == IsAccountSnapshotCurrent(g_accountSnapshot.usersTaken, g_accountSnapshot.usersStamp, stamp)))
+    {
+        FreeUsersList(&g_accountSnapshot.users, g_accountSnapshot.numberOfUsers);
+        g_accountSnapshot.numberOfUsers = 0;
+
+        if (0 == (status = ReadUsers(&g_accountSnapshot.users, &g_accountSnapshot.numberOfUsers, log)))
+        {
+            g_accountSnapshot.usersStamp = stamp;
+            g_accountSnapshot.usersTaken = time(NULL);
+        }
+    }
+
+    if (0 == status)
+    {
+        if (0 == (status = CopyUsersList(userList, g_accountSnapshot.users, g_accountSnapshot.numberOfUsers, log)))
+        {
+            *size = g_accountSnapshot.numberOfUsers;
+        }
+    }
+
+    pthread_mutex_unlock(&g_accountSnapshotLock);
+
+    if (0 != status)
+    {
+        OsConfigLogError(log, "EnumerateUsers failed with %d", status);
+        OsConfigCaptureReason(reason, "Failed to enumerate users (%d). User database may be corrupt. Automatic remediation is not possible", status);
+    }
+
+    return status;
+}
+
 void FreeGroupList(SIMPLIFIED_GROUP** groupList, unsigned int size)
 {
     unsigned int i = 0;
@@ -509,34 +812,38 @@ int EnumerateUserGroups(SIMPLIFIED_USER* user, SIMPLIFIED_GROUP** groupList, uns
     return status;
 }
 
-int EnumerateAllGroups(SIMPLIFIED_GROUP** groupList, unsigned int* size, char** reason, void* log)
+static int ReadGroups(SIMPLIFIED_GROUP** groupList, unsigned int* size, void* log)
 {
-    const char* groupFile = "/etc/group";
+    const char* groupFile = g_accountGroupFile ? g_accountGroupFile : "/etc/group";
+    FILE* groupStream = NULL;
     struct group* groupEntry = NULL;
     size_t groupNameLength = 0;
     size_t listSize = 0;
     unsigned int i = 0;
     int status = 0;
 
-    if ((NULL == groupList) || (NULL == size))
-    {
-        OsConfigLogError(log, "EnumerateAllGroups: invalid arguments");
-        return EINVAL;
-    }
-
     *groupList = NULL;
     *size = 0;
 
     if (0 != (*size = GetNumberOfLinesInFile(groupFile)))
     {
         listSize = (*size) * sizeof(SIMPLIFIED_GROUP);
-        if (NULL != (*groupList = malloc(listSize)))
+        if ((NULL != g_accountGroupFile) && (NULL == (groupStream = fopen(g_accountGroupFile, "r"))))
+        {
+            OsConfigLogError(log, "EnumerateAllGroups: cannot open '%s' (%d)", g_accountGroupFile, errno);
+            *size = 0;
+            status = ENOENT;
+        }
+        else if (NULL != (*groupList = malloc(listSize)))
         {
             memset(*groupList, 0, listSize);
 
-            setgrent();
+            if (NULL == groupStream)
+            {
+                setgrent();
+            }
 
-            while ((NULL != (groupEntry = getgrent())) && (i < *size))
+            while ((NULL != (groupEntry = groupStream ? fgetgrent(groupStream) : getgrent())) && (i < *size))
             {
                 (*groupList)[i].groupId = groupEntry->gr_gid;
                 (*groupList)[i].groupName = NULL;
@@ -566,7 +873,14 @@ int EnumerateAllGroups(SIMPLIFIED_GROUP** groupList, unsigned int* size, char**
                 i += 1;
             }
 
-            endgrent();
+            if (NULL != groupStream)
+            {
+                fclose(groupStream);
+            }
+            else
+            {
+                endgrent();
+            }
 
             if (IsFullLoggingEnabled())
             {
@@ -579,6 +893,11 @@ int EnumerateAllGroups(SIMPLIFIED_GROUP** groupList, unsigned int* size, char**
         {
             OsConfigLogError(log, "EnumerateAllGroups: out of memory (1)");
             status = ENOMEM;
+
+            if (NULL != groupStream)
+            {
+                fclose(groupStream);
+            }
         }
     }
     else
@@ -587,72 +906,351 @@ int EnumerateAllGroups(SIMPLIFIED_GROUP** groupList, unsigned int* size, char**
         status = EPERM;
     }
 
-    if (status)
+    if (0 != status)
     {
-        OsConfigCaptureReason(reason, "Failed to enumerate user groups (%d). User group database may be corrupt. Automatic remediation is not possible", status);
+        FreeGroupList(groupList, *size);
+        *size = 0;
     }
 
     return status;
 }
 
-int CheckAllEtcPasswdGroupsExistInEtcGroup(char** reason, void* log)
+static int CopyGroupList(SIMPLIFIED_GROUP** destination, const SIMPLIFIED_GROUP* source, unsigned int size, void* log)
 {
-    SIMPLIFIED_USER* userList = NULL;
-    unsigned int userListSize = 0;
-    struct SIMPLIFIED_GROUP* userGroupList = NULL;
-    unsigned int userGroupListSize = 0;
-    struct SIMPLIFIED_GROUP* groupList = NULL;
-    unsigned int groupListSize = 0;
-    unsigned int i = 0, j = 0, k = 0;
-    bool found = false;
+    unsigned int i = 0;
     int status = 0;
 
-    if ((0 == (status = EnumerateUsers(&userList, &userListSize, reason, log))) &&
-        (0 == (status = EnumerateAllGroups(&groupList, &groupListSize, reason, log))))
+    if (0 == size)
     {
-        for (i = 0; (i < userListSize) && (0 == status); i++)
-        {
-            if (0 == (status = EnumerateUserGroups(&userList[i], &userGroupList, &userGroupListSize, reason, log)))
-            {
-                for (j = 0; (j < userGroupListSize) && (0 == status); j++)
-                {
-                    found = false;
-
-                    for (k = 0; (k < groupListSize) && (0 == status); k++)
-                    {
-                        if (userGroupList[j].groupId == groupList[k].groupId)
-                        {
-                            if (IsFullLoggingEnabled())
-                            {
-                                OsConfigLogInfo(log, "CheckAllEtcPasswdGroupsExistInEtcGroup: group '%s' (%u) of user '%s' (%u) found in '/etc/group'",
-                                    userList[i].username, userList[i].userId, userGroupList[j].groupName, userGroupList[j].groupId);
-                            }
+        *destination = NULL;
+        return 0;
+    }
 
-                            found = true;
-                            break;
-                        }
-                    }
+    if (NULL == (*destination = (SIMPLIFIED_GROUP*)calloc(size, sizeof(SIMPLIFIED_GROUP))))
+    {
+        OsConfigLogError(log, "CopyGroupList: out of memory");
+        return ENOMEM;
+    }
 
-                    if (false == found)
-                    {
-                        OsConfigLogError(log, "CheckAllEtcPasswdGroupsExistInEtcGroup: group '%s' (%u) of user '%s' (%u) not found in '/etc/group'",
-                            userList[i].username, userList[i].userId, userGroupList[j].groupName, userGroupList[j].groupId);
-                        OsConfigCaptureReason(reason, "Group '%s' (%u) of user '%s' (%u) not found in '/etc/group'", 
-                            userList[i].username, userList[i].userId, userGroupList[j].groupName, userGroupList[j].groupId);
-                        status = ENOENT;
-                        break;
-                    }
-                }
+    for (i = 0; i < size; i++)
+    {
+        (*destination)[i].groupId = source[i].groupId;
+        (*destination)[i].hasUsers = source[i].hasUsers;
 
-                FreeGroupList(&userGroupList, userGroupListSize);
-            }
+        if ((NULL != source[i].groupName) && (NULL == ((*destination)[i].groupName = DuplicateString(source[i].groupName))))
+        {
+            OsConfigLogError(log, "CopyGroupList: out of memory");
+            status = ENOMEM;
+            break;
         }
     }
 
-    FreeUsersList(&userList, userListSize);
-    FreeGroupList(&groupList, groupListSize);
-
-    if (0 == status)
+    if (0 != status)
+    {
+        FreeGroupList(destination, size);
+    }
+
+    return status;
+}
+
+int EnumerateAllGroups(SIMPLIFIED_GROUP** groupList, unsigned int* size, char** reason, void* log)
+{
+    const char* files[] = {g_accountGroupFile ? g_accountGroupFile : "/etc/group"};
+    unsigned long long stamp = 0;
+    int status = 0;
+
+    if ((NULL == groupList) || (NULL == size))
+    {
+        OsConfigLogError(log, "EnumerateAllGroups: invalid arguments");
+        return EINVAL;
+    }
+
+    *groupList = NULL;
+    *size = 0;
+
+    pthread_mutex_lock(&g_accountSnapshotLock);
+
+    stamp = GetAccountFilesStamp(files, ARRAY_SIZE(files));
+
+    if ((NULL == g_accountSnapshot.groups) || (false == IsAccountSnapshotCurrent(g_accountSnapshot.groupsTaken, g_accountSnapshot.groupsStamp, stamp)))
+    {
+        FreeGroupList(&g_accountSnapshot.groups, g_accountSnapshot.numberOfGroups);
+        g_accountSnapshot.numberOfGroups = 0;
+
+        if (0 == (status = ReadGroups(&g_accountSnapshot.groups, &g_accountSnapshot.numberOfGroups, log)))
+        {
+            g_accountSnapshot.groupsStamp = stamp;
+            g_accountSnapshot.groupsTaken = time(NULL);
+        }
+    }
+
+    if (0 == status)
+    {
+        if (0 == (status = CopyGroupList(groupList, g_accountSnapshot.groups, g_accountSnapshot.numberOfGroups, log)))
+        {
+            *size = g_accountSnapshot.numberOfGroups;
+        }
+    }
+
+    pthread_mutex_unlock(&g_accountSnapshotLock);
+
+    if (status)
+    {
+        OsConfigCaptureReason(reason, "Failed to enumerate user groups (%d). User group database may be corrupt. Automatic remediation is not possible", status);
+    }
+
+    return status;
+}
+
+void InvalidateAccountSnapshot(void)
+{
+    pthread_mutex_lock(&g_accountSnapshotLock);
+    FreeUsersList(&g_accountSnapshot.users, g_accountSnapshot.numberOfUsers);
+    FreeGroupList(&g_accountSnapshot.groups, g_accountSnapshot.numberOfGroups);
+    memset(&g_accountSnapshot, 0, sizeof(ACCOUNT_SNAPSHOT));
+    pthread_mutex_unlock(&g_accountSnapshotLock);
+}
+
+int SetAccountFiles(const char* passwdFile, const char* shadowFile, const char* groupFile, void* log)
+{
+    int status = 0;
+
+    pthread_mutex_lock(&g_accountSnapshotLock);
+
+    FreeUsersList(&g_accountSnapshot.users, g_accountSnapshot.numberOfUsers);
+    FreeGroupList(&g_accountSnapshot.groups, g_accountSnapshot.numberOfGroups);
+    memset(&g_accountSnapshot, 0, sizeof(ACCOUNT_SNAPSHOT));
+
+    FREE_MEMORY(g_accountPasswdFile);
+    FREE_MEMORY(g_accountShadowFile);
+    FREE_MEMORY(g_accountGroupFile);
+
+    if (((NULL != passwdFile) && (NULL == (g_accountPasswdFile = DuplicateString(passwdFile)))) ||
+        ((NULL != shadowFile) && (NULL == (g_accountShadowFile = DuplicateString(shadowFile)))) ||
+        ((NULL != groupFile) && (NULL == (g_accountGroupFile = DuplicateString(groupFile)))))
+    {
+        OsConfigLogError(log, "SetAccountFiles: out of memory");
+        FREE_MEMORY(g_accountPasswdFile);
+        FREE_MEMORY(g_accountShadowFile);
+        FREE_MEMORY(g_accountGroupFile);
+        status = ENOMEM;
+    }
+
+    pthread_mutex_unlock(&g_accountSnapshotLock);
+
+    return status;
+}
+
+static unsigned int HashAccountKey(const char* name, unsigned int id)
+{
+    unsigned int hash = 2166136261u;
+
+    if (NULL == name)
+    {
+        return id * 2654435761u;
+    }
+
+    // FNV-1a
+    for (; 0 != *name; name++)
+    {
+        hash = (hash ^ (unsigned char)*name) * 16777619u;
+    }
+
+    return hash;
+}
+
+// Counts how many times each key appears through a hash table, instead of comparing every pair. Keys are the names when names
+// is not NULL (a NULL name is never equal to another) and the ids otherwise. Returns an allocated array parallel to the keys
+unsigned int* CountAccountKeys(const char** names, const unsigned int* ids, unsigned int numberOfKeys, void* log)
+{
+    unsigned int* counts = NULL;
+    unsigned int* first = NULL;
+    unsigned int* buckets = NULL;
+    unsigned int numberOfBuckets = 16;
+    unsigned int bucket = 0, other = 0, i = 0;
+
+    for (; numberOfBuckets < (2 * numberOfKeys); numberOfBuckets *= 2);
+
+    // Buckets hold the index plus one of the first key with each value, 0 marks an empty bucket
+    if ((NULL == (counts = (unsigned int*)calloc(numberOfKeys + 1, sizeof(unsigned int)))) ||
+        (NULL == (first = (unsigned int*)calloc(numberOfKeys + 1, sizeof(unsigned int)))) ||
+        (NULL == (buckets = (unsigned int*)calloc(numberOfBuckets, sizeof(unsigned int)))))
+    {
+        OsConfigLogError(log, "CountAccountKeys: out of memory");
+        FREE_MEMORY(counts);
+        FREE_MEMORY(first);
+        return NULL;
+    }
+
+    for (i = 0; i < numberOfKeys; i++)
+    {
+        first[i] = i;
+
+        if ((NULL == names) || (NULL != names[i]))
+        {
+            for (bucket = HashAccountKey(names ? names[i] : NULL, ids ? ids[i] : 0) & (numberOfBuckets - 1); 0 != buckets[bucket]; bucket = (bucket + 1) & (numberOfBuckets - 1))
+            {
+                other = buckets[bucket] - 1;
+
+                if ((NULL != names) ? (0 == strcmp(names[other], names[i])) : (ids[other] == ids[i]))
+                {
+                    first[i] = other;
+                    break;
+                }
+            }
+
+            if (0 == buckets[bucket])
+            {
+                buckets[bucket] = i + 1;
+            }
+        }
+
+        counts[first[i]] += 1;
+    }
+
+    for (i = 0; i < numberOfKeys; i++)
+    {
+        counts[i] = counts[first[i]];
+    }
+
+    FREE_MEMORY(first);
+    FREE_MEMORY(buckets);
+
+    return counts;
+}
+
+static unsigned int* CountUserKeys(const SIMPLIFIED_USER* userList, unsigned int userListSize, bool byName, void* log)
+{
+    const char** names = NULL;
+    unsigned int* ids = NULL;
+    unsigned int* counts = NULL;
+    unsigned int i = 0;
+
+    if ((NULL != (names = (const char**)calloc(userListSize + 1, sizeof(const char*)))) &&
+        (NULL != (ids = (unsigned int*)calloc(userListSize + 1, sizeof(unsigned int)))))
+    {
+        for (i = 0; i < userListSize; i++)
+        {
+            names[i] = userList[i].username;
+            ids[i] = (unsigned int)userList[i].userId;
+        }
+
+        counts = CountAccountKeys(byName ? names : NULL, ids, userListSize, log);
+    }
+    else
+    {
+        OsConfigLogError(log, "CountUserKeys: out of memory");
+    }
+
+    FREE_MEMORY(names);
+    FREE_MEMORY(ids);
+
+    return counts;
+}
+
+static unsigned int* CountGroupKeys(const SIMPLIFIED_GROUP* groupList, unsigned int groupListSize, bool byName, void* log)
+{
+    const char** names = NULL;
+    unsigned int* ids = NULL;
+    unsigned int* counts = NULL;
+    unsigned int i = 0;
+
+    if ((NULL != (names = (const char**)calloc(groupListSize + 1, sizeof(const char*)))) &&
+        (NULL != (ids = (unsigned int*)calloc(groupListSize + 1, sizeof(unsigned int)))))
+    {
+        for (i = 0; i < groupListSize; i++)
+        {
+            names[i] = groupList[i].groupName;
+            ids[i] = (unsigned int)groupList[i].groupId;
+        }
+
+        counts = CountAccountKeys(byName ? names : NULL, ids, groupListSize, log);
+    }
+    else
+    {
+        OsConfigLogError(log, "CountGroupKeys: out of memory");
+    }
+
+    FREE_MEMORY(names);
+    FREE_MEMORY(ids);
+
+    return counts;
+}
+
+static int CompareGroupIds(const void* left, const void* right)
+{
+    gid_t leftId = *(const gid_t*)left;
+    gid_t rightId = *(const gid_t*)right;
+    return (leftId < rightId) ? -1 : ((leftId > rightId) ? 1 : 0);
+}
+
+// Returns an allocated and sorted array of the ids of all groups, to look them up with bsearch
+static gid_t* GetSortedGroupIds(const SIMPLIFIED_GROUP* groupList, unsigned int groupListSize, void* log)
+{
+    gid_t* groupIds = NULL;
+    unsigned int i = 0;
+
+    if (NULL == (groupIds = (gid_t*)calloc(groupListSize + 1, sizeof(gid_t))))
+    {
+        OsConfigLogError(log, "GetSortedGroupIds: out of memory");
+        return NULL;
+    }
+
+    for (i = 0; i < groupListSize; i++)
+    {
+        groupIds[i] = groupList[i].groupId;
+    }
+
+    qsort(groupIds, groupListSize, sizeof(gid_t), CompareGroupIds);
+
+    return groupIds;
+}
+
+int CheckAllEtcPasswdGroupsExistInEtcGroup(char** reason, void* log)
+{
+    SIMPLIFIED_USER* userList = NULL;
+    unsigned int userListSize = 0;
+    struct SIMPLIFIED_GROUP* groupList = NULL;
+    unsigned int groupListSize = 0;
+    gid_t* groupIds = NULL;
+    unsigned int i = 0;
+    int status = 0;
+
+    if ((0 == (status = EnumerateUsers(&userList, &userListSize, reason, log))) &&
+        (0 == (status = EnumerateAllGroups(&groupList, &groupListSize, reason, log))))
+    {
+        if (NULL == (groupIds = GetSortedGroupIds(groupList, groupListSize, log)))
+        {
+            status = ENOMEM;
+        }
+        else
+        {
+            // The other groups of a user are the groups that list the user as member, so only the primary group can be missing
+            for (i = 0; i < userListSize; i++)
+            {
+                if (NULL == bsearch(&userList[i].groupId, groupIds, groupListSize, sizeof(gid_t), CompareGroupIds))
+                {
+                    OsConfigLogError(log, "CheckAllEtcPasswdGroupsExistInEtcGroup: group %u of user '%s' (%u) not found in '/etc/group'",
+                        userList[i].groupId, userList[i].username, userList[i].userId);
+                    OsConfigCaptureReason(reason, "Group %u of user '%s' (%u) not found in '/etc/group'", 
+                        userList[i].groupId, userList[i].username, userList[i].userId);
+                    status = ENOENT;
+                    break;
+                }
+                else if (IsFullLoggingEnabled())
+                {
+                    OsConfigLogInfo(log, "CheckAllEtcPasswdGroupsExistInEtcGroup: group %u of user '%s' (%u) found in '/etc/group'",
+                        userList[i].groupId, userList[i].username, userList[i].userId);
+                }
+            }
+        }
+    }
+
+    FREE_MEMORY(groupIds);
+    FreeUsersList(&userList, userListSize);
+    FreeGroupList(&groupList, groupListSize);
+
+    if (0 == status)
     {
         OsConfigLogInfo(log, "CheckAllEtcPasswdGroupsExistInEtcGroup: all groups in '/etc/passwd' exist in '/etc/group'");
         OsConfigCaptureSuccessReason(reason, "All user groups in '/etc/passwd' exist in '/etc/group'");
@@ -671,12 +1269,17 @@ int SetAllEtcPasswdGroupsToExistInEtcGroup(void* log)
     unsigned int userGroupListSize = 0;
     struct SIMPLIFIED_GROUP* groupList = NULL;
     unsigned int groupListSize = 0;
-    unsigned int i = 0, j = 0, k = 0;
-    bool found = false;
+    gid_t* groupIds = NULL;
+    unsigned int i = 0, j = 0;
     int status = 0, _status = 0;
 
     if ((0 == (status = EnumerateUsers(&userList, &userListSize, NULL, log))) &&
-        (0 == (status = EnumerateAllGroups(&groupList, &groupListSize, NULL, log))))
+        (0 == (status = EnumerateAllGroups(&groupList, &groupListSize, NULL, log))) &&
+        (NULL == (groupIds = GetSortedGroupIds(groupList, groupListSize, log))))
+    {
+        status = ENOMEM;
+    }
+    else if (0 == status)
     {
         for (i = 0; (i < userListSize) && (0 == status); i++)
         {
@@ -684,24 +1287,15 @@ int SetAllEtcPasswdGroupsToExistInEtcGroup(void* log)
             {
                 for (j = 0; (j < userGroupListSize) && (0 == status); j++)
                 {
-                    found = false;
-
-                    for (k = 0; (k < groupListSize) && (0 == status); k++)
+                    if (NULL != bsearch(&userGroupList[j].groupId, groupIds, groupListSize, sizeof(gid_t), CompareGroupIds))
                     {
-                        if (userGroupList[j].groupId == groupList[k].groupId)
+                        if (IsFullLoggingEnabled())
                         {
-                            if (IsFullLoggingEnabled())
-                            {
-                                OsConfigLogInfo(log, "SetAllEtcPasswdGroupsToExistInEtcGroup: group '%s' (%u) of user '%s' (%u) found in '/etc/group'",
-                                    userGroupList[j].groupName, userGroupList[j].groupId, userList[i].username, userList[i].userId);
-                            }
-
-                            found = true;
-                            break;
+                            OsConfigLogInfo(log, "SetAllEtcPasswdGroupsToExistInEtcGroup: group '%s' (%u) of user '%s' (%u) found in '/etc/group'",
+                                userGroupList[j].groupName, userGroupList[j].groupId, userList[i].username, userList[i].userId);
                         }
                     }
-
-                    if (false == found)
+                    else
                     {
                         OsConfigLogError(log, "SetAllEtcPasswdGroupsToExistInEtcGroup: group '%s' (%u) of user '%s' (%u) not found in '/etc/group'",
                             userGroupList[j].groupName, userGroupList[j].groupId, userList[i].username, userList[i].userId);
@@ -739,6 +1333,7 @@ int SetAllEtcPasswdGroupsToExistInEtcGroup(void* log)
         }
     }
 
+    FREE_MEMORY(groupIds);
     FreeUsersList(&userList, userListSize);
     FreeGroupList(&groupList, groupListSize);
 
@@ -754,34 +1349,32 @@ int CheckNoDuplicateUidsExist(char** reason, void* log)
 {
     SIMPLIFIED_USER* userList = NULL;
     unsigned int userListSize = 0;
-    unsigned int i = 0, j = 0;
-    unsigned int hits = 0;
+    unsigned int* counts = NULL;
+    unsigned int i = 0;
     int status = 0;
 
     if (0 == (status = EnumerateUsers(&userList, &userListSize, reason, log)))
     {
-        for (i = 0; (i < userListSize) && (0 == status); i++)
+        if (NULL == (counts = CountUserKeys(userList, userListSize, false, log)))
         {
-            hits = 0;
-
-            for (j = 0; (j < userListSize) && (0 == status); j++)
+            status = ENOMEM;
+        }
+        else
+        {
+            for (i = 0; i < userListSize; i++)
             {
-                if (userList[i].userId == userList[j].userId)
+                if (1 < counts[i])
                 {
-                    hits += 1;
-
-                    if (hits > 1)
-                    {
-                        OsConfigLogError(log, "CheckNoDuplicateUidsExist: uid %u appears more than a single time in '/etc/passwd'", userList[i].userId);
-                        OsConfigCaptureReason(reason, "Uid %u appears more than a single time in '/etc/passwd'", userList[i].userId);
-                        status = EEXIST;
-                        break;
-                    }
+                    OsConfigLogError(log, "CheckNoDuplicateUidsExist: uid %u appears more than a single time in '/etc/passwd'", userList[i].userId);
+                    OsConfigCaptureReason(reason, "Uid %u appears more than a single time in '/etc/passwd'", userList[i].userId);
+                    status = EEXIST;
+                    break;
                 }
             }
         }
     }
 
+    FREE_MEMORY(counts);
     FreeUsersList(&userList, userListSize);
 
     if (0 == status)
@@ -845,37 +1438,35 @@ int SetNoDuplicateUids(void* log)
 {
     SIMPLIFIED_USER* userList = NULL;
     unsigned int userListSize = 0;
-    unsigned int i = 0, j = 0;
-    unsigned int hits = 0;
+    unsigned int* counts = NULL;
+    unsigned int i = 0;
     int status = 0, _status = 0;
 
     if (0 == (status = EnumerateUsers(&userList, &userListSize, NULL, log)))
     {
-        for (i = 0; i < userListSize; i++)
+        if (NULL == (counts = CountUserKeys(userList, userListSize, false, log)))
         {
-            hits = 0;
-
-            for (j = 0; j < userListSize; j++)
+            status = ENOMEM;
+        }
+        else
+        {
+            for (i = 0; i < userListSize; i++)
             {
-                if (userList[i].userId == userList[j].userId)
+                if (1 < counts[i])
                 {
-                    hits += 1;
-                }
-            }
-
-            if (hits > 1)
-            {
-                OsConfigLogError(log, "SetNoDuplicateUids: user '%s' (%u) appears more than a single time in '/etc/passwd', deleting this user account",
-                    userList[i].username, userList[i].userId);
+                    OsConfigLogError(log, "SetNoDuplicateUids: user '%s' (%u) appears more than a single time in '/etc/passwd', deleting this user account",
+                        userList[i].username, userList[i].userId);
 
-                if ((0 != (_status = RemoveUser(&(userList[i]), log))) && (0 == status))
-                {
-                    status = _status;
+                    if ((0 != (_status = RemoveUser(&(userList[i]), log))) && (0 == status))
+                    {
+                        status = _status;
+                    }
                 }
             }
         }
     }
 
+    FREE_MEMORY(counts);
     FreeUsersList(&userList, userListSize);
 
     if (0 == status)
@@ -890,34 +1481,32 @@ int CheckNoDuplicateGidsExist(char** reason, void* log)
 {
     SIMPLIFIED_GROUP* groupList = NULL;
     unsigned int groupListSize = 0;
-    unsigned int i = 0, j = 0;
-    unsigned int hits = 0;
+    unsigned int* counts = NULL;
+    unsigned int i = 0;
     int status = 0;
 
     if (0 == (status = EnumerateAllGroups(&groupList, &groupListSize, reason, log)))
     {
-        for (i = 0; (i < groupListSize) && (0 == status); i++)
+        if (NULL == (counts = CountGroupKeys(groupList, groupListSize, false, log)))
         {
-            hits = 0;
-
-            for (j = 0; (j < groupListSize) && (0 == status); j++)
+            status = ENOMEM;
+        }
+        else
+        {
+            for (i = 0; i < groupListSize; i++)
             {
-                if (groupList[i].groupId == groupList[j].groupId)
+                if (1 < counts[i])
                 {
-                    hits += 1;
-
-                    if (hits > 1)
-                    {
-                        OsConfigLogError(log, "CheckNoDuplicateGidsExist: gid %u appears more than a single time in '/etc/group'", groupList[i].groupId);
-                        OsConfigCaptureReason(reason, "Gid %u appears more than a single time in '/etc/group'", groupList[i].groupId);
-                        status = EEXIST;
-                        break;
-                    }
+                    OsConfigLogError(log, "CheckNoDuplicateGidsExist: gid %u appears more than a single time in '/etc/group'", groupList[i].groupId);
+                    OsConfigCaptureReason(reason, "Gid %u appears more than a single time in '/etc/group'", groupList[i].groupId);
+                    status = EEXIST;
+                    break;
                 }
             }
         }
     }
 
+    FREE_MEMORY(counts);
     FreeGroupList(&groupList, groupListSize);
 
     if (0 == status)
@@ -996,35 +1585,33 @@ int SetNoDuplicateGids(void* log)
 {
     SIMPLIFIED_GROUP* groupList = NULL;
     unsigned int groupListSize = 0;
-    unsigned int i = 0, j = 0;
-    unsigned int hits = 0;
+    unsigned int* counts = NULL;
+    unsigned int i = 0;
     int status = 0, _status = 0;
 
     if (0 == (status = EnumerateAllGroups(&groupList, &groupListSize, NULL, log)))
     {
-        for (i = 0; i < groupListSize; i++)
+        if (NULL == (counts = CountGroupKeys(groupList, groupListSize, false, log)))
         {
-            hits = 0;
-
-            for (j = 0; j < groupListSize; j++)
+            status = ENOMEM;
+        }
+        else
+        {
+            for (i = 0; i < groupListSize; i++)
             {
-                if (groupList[i].groupId == groupList[j].groupId)
+                if (1 < counts[i])
                 {
-                    hits += 1;
+                    OsConfigLogError(log, "SetNoDuplicateGids: gid %u appears more than a single time in '/etc/group'", groupList[i].groupId);
+                    if ((0 != (_status = RemoveGroup(&(groupList[i]), log))) && (0 == status))
+                    {
+                        status = _status;
+                    }
                 }
             }
+        }
+    }
 
-            if (hits > 1)
-            {
-                OsConfigLogError(log, "SetNoDuplicateGids: gid %u appears more than a single time in '/etc/group'", groupList[i].groupId);
-                if ((0 != (_status = RemoveGroup(&(groupList[i]), log))) && (0 == status))
-                {
-                    status = _status;
-                }
-            }
-        }
-    }
-
+    FREE_MEMORY(counts);
     FreeGroupList(&groupList, groupListSize);
 
     if (0 == status)
@@ -1039,34 +1626,32 @@ int CheckNoDuplicateUserNamesExist(char** reason, void* log)
 {
     SIMPLIFIED_USER* userList = NULL;
     unsigned int userListSize = 0;
-    unsigned int i = 0, j = 0;
-    unsigned int hits = 0;
+    unsigned int* counts = NULL;
+    unsigned int i = 0;
     int status = 0;
 
     if (0 == (status = EnumerateUsers(&userList, &userListSize, reason, log)))
     {
-        for (i = 0; (i < userListSize) && (0 == status); i++)
+        if (NULL == (counts = CountUserKeys(userList, userListSize, true, log)))
         {
-            hits = 0;
-
-            for (j = 0; (j < userListSize) && (0 == status); j++)
+            status = ENOMEM;
+        }
+        else
+        {
+            for (i = 0; i < userListSize; i++)
             {
-                if (userList[i].username && userList[j].username && (0 == strcmp(userList[i].username, userList[j].username)))
+                if (1 < counts[i])
                 {
-                    hits += 1;
-
-                    if (hits > 1)
-                    {
-                        OsConfigLogError(log, "CheckNoDuplicateUserNamesExist: username '%s' appears more than a single time in '/etc/passwd'", userList[i].username);
-                        OsConfigCaptureReason(reason, "Username '%s' appears more than a single time in '/etc/passwd'", userList[i].username);
-                        status = EEXIST;
-                        break;
-                    }
+                    OsConfigLogError(log, "CheckNoDuplicateUserNamesExist: username '%s' appears more than a single time in '/etc/passwd'", userList[i].username);
+                    OsConfigCaptureReason(reason, "Username '%s' appears more than a single time in '/etc/passwd'", userList[i].username);
+                    status = EEXIST;
+                    break;
                 }
             }
         }
     }
 
+    FREE_MEMORY(counts);
     FreeUsersList(&userList, userListSize);
 
     if (0 == status)
@@ -1082,36 +1667,34 @@ int SetNoDuplicateUserNames(void* log)
 {
     SIMPLIFIED_USER* userList = NULL;
     unsigned int userListSize = 0;
-    unsigned int i = 0, j = 0;
-    unsigned int hits = 0;
+    unsigned int* counts = NULL;
+    unsigned int i = 0;
     int status = 0, _status = 0;
 
     if (0 == (status = EnumerateUsers(&userList, &userListSize, NULL, log)))
     {
-        for (i = 0; i < userListSize; i++)
+        if (NULL == (counts = CountUserKeys(userList, userListSize, true, log)))
         {
-            hits = 0;
-
-            for (j = 0; j < userListSize; j++)
-            {
-                if (userList[i].username && userList[j].username && (0 == strcmp(userList[i].username, userList[j].username)))
-                {
-                    hits += 1;
-                }
-            }
-
-            if (hits > 1)
+            status = ENOMEM;
+        }
+        else
+        {
+            for (i = 0; i < userListSize; i++)
             {
-                OsConfigLogError(log, "SetNoDuplicateUserNames: username '%s' appears more than a single time in '/etc/passwd'", userList[i].username);
-                
-                if ((0 != (_status = RemoveUser(&(userList[i]), log))) && (0 == status))
+                if (1 < counts[i])
                 {
-                    status = _status;
+                    OsConfigLogError(log, "SetNoDuplicateUserNames: username '%s' appears more than a single time in '/etc/passwd'", userList[i].username);
+            
+                    if ((0 != (_status = RemoveUser(&(userList[i]), log))) && (0 == status))
+                    {
+                        status = _status;
+                    }
                 }
             }
         }
     }
 
+    FREE_MEMORY(counts);
     FreeUsersList(&userList, userListSize);
 
     if (0 == status)
@@ -1126,34 +1709,32 @@ int CheckNoDuplicateGroupNamesExist(char** reason, void* log)
 {
     SIMPLIFIED_GROUP* groupList = NULL;
     unsigned int groupListSize = 0;
-    unsigned int i = 0, j = 0;
-    unsigned int hits = 0;
+    unsigned int* counts = NULL;
+    unsigned int i = 0;
     int status = 0;
 
     if (0 == (status = EnumerateAllGroups(&groupList, &groupListSize, reason, log)))
     {
-        for (i = 0; (i < groupListSize) && (0 == status); i++)
+        if (NULL == (counts = CountGroupKeys(groupList, groupListSize, true, log)))
         {
-            hits = 0;
-
-            for (j = 0; (j < groupListSize) && (0 == status); j++)
+            status = ENOMEM;
+        }
+        else
+        {
+            for (i = 0; i < groupListSize; i++)
             {
-                if (0 == strcmp(groupList[i].groupName, groupList[j].groupName))
+                if (1 < counts[i])
                 {
-                    hits += 1;
-
-                    if (hits > 1)
-                    {
-                        OsConfigLogError(log, "CheckNoDuplicateGroupNamesExist: group name '%s' appears more than a single time in '/etc/group'", groupList[i].groupName);
-                        OsConfigCaptureReason(reason, "Group name '%s' appears more than a single time in '/etc/group'", groupList[i].groupName);
-                        status = EEXIST;
-                        break;
-                    }
+                    OsConfigLogError(log, "CheckNoDuplicateGroupNamesExist: group name '%s' appears more than a single time in '/etc/group'", groupList[i].groupName);
+                    OsConfigCaptureReason(reason, "Group name '%s' appears more than a single time in '/etc/group'", groupList[i].groupName);
+                    status = EEXIST;
+                    break;
                 }
             }
         }
     }
 
+    FREE_MEMORY(counts);
     FreeGroupList(&groupList, groupListSize);
 
     if (0 == status)
@@ -1169,35 +1750,33 @@ int SetNoDuplicateGroupNames(void* log)
 {
     SIMPLIFIED_GROUP* groupList = NULL;
     unsigned int groupListSize = 0;
-    unsigned int i = 0, j = 0;
-    unsigned int hits = 0;
+    unsigned int* counts = NULL;
+    unsigned int i = 0;
     int status = 0, _status = 0;
 
     if (0 == (status = EnumerateAllGroups(&groupList, &groupListSize, NULL, log)))
     {
-        for (i = 0; i < groupListSize; i++)
+        if (NULL == (counts = CountGroupKeys(groupList, groupListSize, true, log)))
         {
-            hits = 0;
-
-            for (j = 0; j < groupListSize; j++)
-            {
-                if (groupList[i].groupId == groupList[j].groupId)
-                {
-                    hits += 1;
-                }
-            }
-
-            if (hits > 1)
+            status = ENOMEM;
+        }
+        else
+        {
+            for (i = 0; i < groupListSize; i++)
             {
-                OsConfigLogError(log, "SetNoDuplicateGroupNames: group name '%s' appears more than a single time in '/etc/group'", groupList[i].groupName);
-                if ((0 != (_status = RemoveGroup(&(groupList[i]), log))) && (0 == status))
+                if (1 < counts[i])
                 {
-                    status = _status;
+                    OsConfigLogError(log, "SetNoDuplicateGroupNames: group name '%s' appears more than a single time in '/etc/group'", groupList[i].groupName);
+                    if ((0 != (_status = RemoveGroup(&(groupList[i]), log))) && (0 == status))
+                    {
+                        status = _status;
+                    }
                 }
             }
         }
     }
 
+    FREE_MEMORY(counts);
     FreeGroupList(&groupList, groupListSize);
 
     if (0 == status)
@@ -1544,152 +2123,709 @@ int RemoveUsersWithoutPasswords(void* log)
         }
     }
 
-    FreeUsersList(&userList, userListSize);
+    FreeUsersList(&userList, userListSize);
+
+    if (0 == status)
+    {
+        OsConfigLogInfo(log, "RemoveUsersWithoutPasswords: all users who need passwords have passwords set");
+    }
+
+    return status;
+}
+
+int CheckRootIsOnlyUidZeroAccount(char** reason, void* log)
+{
+    SIMPLIFIED_USER* userList = NULL;
+    unsigned int userListSize = 0, i = 0;
+    int status = 0;
+
+    if (0 == (status = EnumerateUsers(&userList, &userListSize, reason, log)))
+    {
+        for (i = 0; i < userListSize; i++)
+        {
+            if (((NULL == userList[i].username) || (0 != strcmp(userList[i].username, g_root))) && (0 == userList[i].userId))
+            {
+                OsConfigLogError(log, "CheckRootIsOnlyUidZeroAccount: user '%s' (%u, %u) is not root but has uid 0", 
+                    userList[i].username, userList[i].userId, userList[i].groupId);
+                OsConfigCaptureReason(reason, "User '%s' (%u, %u) is not root but has uid 0", 
+                    userList[i].username, userList[i].userId, userList[i].groupId);
+                status = EACCES;
+            }
+        }
+    }
+
+    FreeUsersList(&userList, userListSize);
+
+    if (0 == status)
+    {
+        OsConfigLogInfo(log, "CheckRootIsOnlyUidZeroAccount: all users who are not root have uids (user ids) greater than 0");
+        OsConfigCaptureSuccessReason(reason, "All users who are not root have uids (user ids) greater than 0");
+    }
+
+    return status;
+}
+
+int SetRootIsOnlyUidZeroAccount(void* log)
+{
+    SIMPLIFIED_USER* userList = NULL;
+    unsigned int userListSize = 0, i = 0;
+    int status = 0, _status = 0;
+
+    if (0 == (status = EnumerateUsers(&userList, &userListSize, NULL, log)))
+    {
+        for (i = 0; i < userListSize; i++)
+        {
+            if (((NULL == userList[i].username) || (0 != strcmp(userList[i].username, g_root))) && (0 == userList[i].userId))
+            {
+                OsConfigLogError(log, "SetRootIsOnlyUidZeroAccount: user '%s' (%u, %u) is not root but has uid 0",
+                    userList[i].username, userList[i].userId, userList[i].groupId);
+
+                if ((0 != (_status = RemoveUser(&(userList[i]), log))) && (0 == status))
+                {
+                    status = _status;
+                }
+            }
+        }
+    }
+
+    FreeUsersList(&userList, userListSize);
+
+    if (0 == status)
+    {
+        OsConfigLogInfo(log, "SetRootIsOnlyUidZeroAccount: all users who are not root have uids (user ids) greater than 0");
+    }
+
+    return status;
+}
+
+int CheckDefaultRootAccountGroupIsGidZero(char** reason, void* log)
+{
+    SIMPLIFIED_USER* userList = NULL;
+    unsigned int userListSize = 0;
+    unsigned int i = 0;
+    int status = 0;
+
+    if (0 == (status = EnumerateUsers(&userList, &userListSize, reason, log)))
+    {
+        for (i = 0; i < userListSize; i++)
+        {
+            if ((0 == strcmp(userList[i].username, g_root)) && (0 == userList[i].userId) && (0 != userList[i].groupId))
+            {
+                OsConfigLogError(log, "CheckDefaultRootAccountuserIsGidZero: root user '%s' (%u) has default gid %u instead of gid 0", 
+                    userList[i].username, userList[i].userId, userList[i].groupId);
+                OsConfigCaptureReason(reason, "Root user '%s' (%u) has default gid %u instead of gid 0",
+                    userList[i].username, userList[i].userId, userList[i].groupId);
+                status = EPERM;
+            }
+        }
+    }
+
+    FreeUsersList(&userList, userListSize);
+
+    if (0 == status)
+    {
+        OsConfigLogInfo(log, "CheckDefaultRootAccountGroupIsGidZero: default root group is gid 0");
+        OsConfigCaptureSuccessReason(reason, "Default root group is gid 0");
+    }
+
+    return status;
+}
+
+int SetDefaultRootAccountGroupIsGidZero(void* log)
+{
+    int status = 0;
+
+    if (0 != (status = CheckDefaultRootAccountGroupIsGidZero(NULL, log)))
+    {
+        status = RepairRootGroup(log);
+    }
+
+    return status;
+}
+
+// Homes are walked by a small pool of threads, a home still being walked after the timeout (such as a hung network mount) is reported as not audited
+#define HOME_AUDIT_MAX_THREADS 4
+#define HOME_AUDIT_TIMEOUT_SECONDS 10
+
+// The facts collected from the homes are reused by the home and dot file checks that follow each other within this long
+#define HOME_AUDIT_CACHE_SECONDS 10
+
+typedef enum HOME_AUDIT_STATE
+{
+    HomeAuditPending = 0,
+    HomeAuditRunning,
+    HomeAuditDone,
+    HomeAuditTimedOut
+} HOME_AUDIT_STATE;
+
+typedef struct HOME_DOT_FILE
+{
+    char* name;
+    // Not following links, permission rules apply to the regular files only
+    struct stat statStruct;
+    // Whether the name resolves (same as FileExists for links)
+    bool resolves;
+} HOME_DOT_FILE;
+
+typedef struct HOME_AUDIT
+{
+    HOME_AUDIT_STATE state;
+    struct timespec started;
+    // Whether the home is a directory that can be opened (same as DirectoryExists)
+    bool exists;
+    struct stat statStruct;
+    HOME_DOT_FILE* dotFiles;
+    unsigned int numberOfDotFiles;
+} HOME_AUDIT;
+
+// Shared with the workers, the last one out (the caller included) frees it so that a worker stuck on a home can be left behind
+typedef struct HOME_AUDIT_POOL
+{
+    char** homes;
+    HOME_AUDIT* audits;
+    unsigned int numberOfHomes;
+    unsigned int timeoutSeconds;
+    unsigned int next;
+    unsigned int references;
+    bool abandoned;
+    pthread_mutex_t lock;
+    pthread_cond_t progress;
+} HOME_AUDIT_POOL;
+
+typedef struct HOME_AUDIT_SNAPSHOT
+{
+    SIMPLIFIED_USER* users;
+    unsigned int numberOfUsers;
+    // Audit of each user's home, NULL for users whose home is not audited
+    HOME_AUDIT** userAudits;
+    HOME_AUDIT* audits;
+    unsigned int numberOfAudits;
+    unsigned long long stamp;
+    time_t taken;
+} HOME_AUDIT_SNAPSHOT;
+
+static HOME_AUDIT_SNAPSHOT g_homeAudit = {0};
+static pthread_mutex_t g_homeAuditLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Set by SetHomeAuditAccounts, these replace the system accounts and the walk timeout
+static SIMPLIFIED_USER* g_homeAuditUsers = NULL;
+static unsigned int g_homeAuditNumberOfUsers = 0;
+static unsigned int g_homeAuditTimeoutSeconds = HOME_AUDIT_TIMEOUT_SECONDS;
+
+static void FreeHomeAudit(HOME_AUDIT* audit)
+{
+    unsigned int i = 0;
+
+    for (i = 0; i < audit->numberOfDotFiles; i++)
+    {
+        FREE_MEMORY(audit->dotFiles[i].name);
+    }
+
+    FREE_MEMORY(audit->dotFiles);
+    audit->numberOfDotFiles = 0;
+}
+
+static bool IsHomeAuditOverdue(const struct timespec* started, const struct timespec* now, unsigned int timeoutSeconds)
+{
+    return ((now->tv_sec - started->tv_sec) >= (time_t)timeoutSeconds) ? true : false;
+}
+
+// Opens the home once and collects everything the home and dot file rules need relative to that descriptor
+static void AuditHome(const char* home, const struct timespec* started, unsigned int timeoutSeconds, HOME_AUDIT* audit)
+{
+    HOME_DOT_FILE* dotFiles = NULL;
+    DIR* directory = NULL;
+    struct dirent* entry = NULL;
+    struct timespec now = {0, 0};
+    unsigned int capacity = 0;
+    int descriptor = -1;
+
+    audit->state = HomeAuditDone;
+
+    if (0 > (descriptor = open(home, O_RDONLY | O_DIRECTORY | O_CLOEXEC)))
+    {
+        return;
+    }
+
+    if ((0 != fstat(descriptor, &audit->statStruct)) || (NULL == (directory = fdopendir(descriptor))))
+    {
+        close(descriptor);
+        return;
+    }
+
+    audit->exists = true;
+
+    while (NULL != (entry = readdir(directory)))
+    {
+        if (('.' != entry->d_name[0]) || (0 == strcmp(entry->d_name, ".")) || (0 == strcmp(entry->d_name, "..")))
+        {
+            continue;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (IsHomeAuditOverdue(started, &now, timeoutSeconds))
+        {
+            audit->state = HomeAuditTimedOut;
+            break;
+        }
+
+        if (audit->numberOfDotFiles >= capacity)
+        {
+            capacity = capacity ? (capacity * 2) : 16;
+            if (NULL == (dotFiles = (HOME_DOT_FILE*)realloc(audit->dotFiles, capacity * sizeof(HOME_DOT_FILE))))
+            {
+                break;
+            }
+            audit->dotFiles = dotFiles;
+        }
+
+        memset(&audit->dotFiles[audit->numberOfDotFiles], 0, sizeof(HOME_DOT_FILE));
+
+        if (0 != fstatat(descriptor, entry->d_name, &audit->dotFiles[audit->numberOfDotFiles].statStruct, AT_SYMLINK_NOFOLLOW))
+        {
+            continue;
+        }
+        else if (NULL == (audit->dotFiles[audit->numberOfDotFiles].name = DuplicateString(entry->d_name)))
+        {
+            break;
+        }
+
+        audit->dotFiles[audit->numberOfDotFiles].resolves = S_ISLNK(audit->dotFiles[audit->numberOfDotFiles].statStruct.st_mode) ?
+            (0 == faccessat(descriptor, entry->d_name, F_OK, 0)) : true;
+        audit->numberOfDotFiles += 1;
+    }
+
+    closedir(directory);
+}
+
+static void ReleaseHomeAuditPool(HOME_AUDIT_POOL* pool)
+{
+    unsigned int references = 0;
+    unsigned int i = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    references = --pool->references;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (0 == references)
+    {
+        for (i = 0; i < pool->numberOfHomes; i++)
+        {
+            FreeHomeAudit(&pool->audits[i]);
+        }
+
+        FREE_MEMORY(pool->audits);
+        FREE_MEMORY(pool->homes);
+        pthread_cond_destroy(&pool->progress);
+        pthread_mutex_destroy(&pool->lock);
+        FREE_MEMORY(pool);
+    }
+}
+
+static void RunHomeAudits(HOME_AUDIT_POOL* pool)
+{
+    HOME_AUDIT audit = {0};
+    struct timespec started = {0, 0};
+    unsigned int index = 0;
+
+    while (true)
+    {
+        pthread_mutex_lock(&pool->lock);
+        if ((false == pool->abandoned) && ((index = pool->next) < pool->numberOfHomes))
+        {
+            pool->next += 1;
+            clock_gettime(CLOCK_MONOTONIC, &started);
+            pool->audits[index].state = HomeAuditRunning;
+            pool->audits[index].started = started;
+        }
+        else
+        {
+            index = pool->numberOfHomes;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        if (index >= pool->numberOfHomes)
+        {
+            break;
+        }
+
+        memset(&audit, 0, sizeof(HOME_AUDIT));
+        AuditHome(pool->homes[index], &started, pool->timeoutSeconds, &audit);
+
+        pthread_mutex_lock(&pool->lock);
+        if (HomeAuditRunning == pool->audits[index].state)
+        {
+            audit.started = started;
+            pool->audits[index] = audit;
+        }
+        else
+        {
+            // The caller already gave up on this home
+            FreeHomeAudit(&audit);
+        }
+        pthread_cond_signal(&pool->progress);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static void* HomeAuditWorker(void* context)
+{
+    HOME_AUDIT_POOL* pool = (HOME_AUDIT_POOL*)context;
+
+    RunHomeAudits(pool);
+    ReleaseHomeAuditPool(pool);
+
+    return NULL;
+}
+
+// Audits the homes (the list is borrowed for the call), returning one audit per home. Homes not audited in time are left marked as timed out
+static int AuditHomes(const char** homes, unsigned int numberOfHomes, unsigned int timeoutSeconds, HOME_AUDIT** audits, void* log)
+{
+    HOME_AUDIT_POOL* pool = NULL;
+    pthread_condattr_t attributes;
+    pthread_attr_t threadAttributes;
+    pthread_t thread;
+    struct timespec now = {0, 0};
+    struct timespec wakeUp = {0, 0};
+    unsigned int numberOfThreads = 0, pending = 0, running = 0, overdue = 0, i = 0;
+    size_t homesSize = 0;
+    char* strings = NULL;
+
+    *audits = NULL;
+
+    if (0 == numberOfHomes)
+    {
+        return 0;
+    }
+
+    // The pool keeps its own copy of the homes, the workers may outlive this call
+    for (i = 0; i < numberOfHomes; i++)
+    {
+        homesSize += strlen(homes[i]) + 1;
+    }
+
+    if ((NULL == (pool = (HOME_AUDIT_POOL*)calloc(1, sizeof(HOME_AUDIT_POOL)))) ||
+        (NULL == (pool->homes = (char**)malloc(numberOfHomes * sizeof(char*) + homesSize))) ||
+        (NULL == (pool->audits = (HOME_AUDIT*)calloc(numberOfHomes, sizeof(HOME_AUDIT)))) ||
+        (NULL == (*audits = (HOME_AUDIT*)calloc(numberOfHomes, sizeof(HOME_AUDIT)))))
+    {
+        OsConfigLogError(log, "AuditHomes: out of memory");
+        if (NULL != pool)
+        {
+            FREE_MEMORY(pool->homes);
+            FREE_MEMORY(pool->audits);
+            FREE_MEMORY(pool);
+        }
+        return ENOMEM;
+    }
+
+    for (i = 0, strings = (char*)(pool->homes + numberOfHomes); i < numberOfHomes; i++)
+    {
+        pool->homes[i] = strings;
+        strcpy(strings, homes[i]);
+        strings += strlen(homes[i]) + 1;
+    }
+
+    pool->numberOfHomes = numberOfHomes;
+    pool->timeoutSeconds = timeoutSeconds;
+    pool->references = 1;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&pool->progress, &attributes);
+    pthread_condattr_destroy(&attributes);
+
+    pthread_attr_init(&threadAttributes);
+    pthread_attr_setdetachstate(&threadAttributes, PTHREAD_CREATE_DETACHED);
+
+    for (i = 0; (i < HOME_AUDIT_MAX_THREADS) && (i < numberOfHomes); i++)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pool->references += 1;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (0 == pthread_create(&thread, &threadAttributes, HomeAuditWorker, pool))
+        {
+            numberOfThreads += 1;
+        }
+        else
+        {
+            pthread_mutex_lock(&pool->lock);
+            pool->references -= 1;
+            pthread_mutex_unlock(&pool->lock);
+        }
+    }
+
+    pthread_attr_destroy(&threadAttributes);
+
+    if (0 == numberOfThreads)
+    {
+        OsConfigLogInfo(log, "AuditHomes: no worker threads, walking %u homes serially", numberOfHomes);
+        RunHomeAudits(pool);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (true)
+    {
+        pending = running = overdue = 0;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        for (i = 0; i < numberOfHomes; i++)
+        {
+            if (HomeAuditPending == pool->audits[i].state)
+            {
+                pending += 1;
+            }
+            else if (HomeAuditRunning == pool->audits[i].state)
+            {
+                if (IsHomeAuditOverdue(&pool->audits[i].started, &now, timeoutSeconds))
+                {
+                    overdue += 1;
+                }
+                else
+                {
+                    running += 1;
+                }
+            }
+        }
+
+        // Done when no home is making progress and the homes left (if any) have no worker free to take them
+        if ((0 == running) && ((0 == pending) || (overdue >= numberOfThreads)))
+        {
+            break;
+        }
+
+        wakeUp = now;
+        wakeUp.tv_sec += 1;
+        pthread_cond_timedwait(&pool->progress, &pool->lock, &wakeUp);
+    }
+
+    pool->abandoned = true;
+
+    for (i = 0; i < numberOfHomes; i++)
+    {
+        if ((HomeAuditPending == pool->audits[i].state) || (HomeAuditRunning == pool->audits[i].state))
+        {
+            OsConfigLogError(log, "AuditHomes: '%s' not audited within %u seconds", pool->homes[i], timeoutSeconds);
+            pool->audits[i].state = HomeAuditTimedOut;
+        }
+
+        // The collected facts move to the caller
+        (*audits)[i] = pool->audits[i];
+        pool->audits[i].dotFiles = NULL;
+        pool->audits[i].numberOfDotFiles = 0;
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    ReleaseHomeAuditPool(pool);
+
+    return 0;
+}
 
-    if (0 == status)
+static void FreeHomeAuditSnapshot(HOME_AUDIT_SNAPSHOT* snapshot)
+{
+    unsigned int i = 0;
+
+    for (i = 0; i < snapshot->numberOfAudits; i++)
     {
-        OsConfigLogInfo(log, "RemoveUsersWithoutPasswords: all users who need passwords have passwords set");
+        FreeHomeAudit(&snapshot->audits[i]);
     }
 
-    return status;
+    FREE_MEMORY(snapshot->audits);
+    FREE_MEMORY(snapshot->userAudits);
+    FreeUsersList(&snapshot->users, snapshot->numberOfUsers);
+    memset(snapshot, 0, sizeof(HOME_AUDIT_SNAPSHOT));
 }
 
-int CheckRootIsOnlyUidZeroAccount(char** reason, void* log)
+static int CompareHomes(const void* left, const void* right)
 {
-    SIMPLIFIED_USER* userList = NULL;
-    unsigned int userListSize = 0, i = 0;
+    return strcmp(*(const char* const*)left, *(const char* const*)right);
+}
+
+// Called with g_homeAuditLock held. Users who can never login (nologin shell) are not audited, homes shared by several users are walked once
+static int RefreshHomeAudit(char** reason, void* log)
+{
+    const char* accountFiles[] = { g_etcPasswd, g_etcShadow };
+    HOME_AUDIT_SNAPSHOT snapshot = {0};
+    const char** homes = NULL;
+    const char** found = NULL;
+    unsigned long long stamp = GetAccountFilesStamp(accountFiles, ARRAY_SIZE(accountFiles));
+    time_t now = time(NULL);
+    unsigned int numberOfHomes = 0, i = 0, j = 0;
     int status = 0;
 
-    if (0 == (status = EnumerateUsers(&userList, &userListSize, reason, log)))
+    if ((NULL != g_homeAudit.users) && (stamp == g_homeAudit.stamp) && (now >= g_homeAudit.taken) && ((now - g_homeAudit.taken) < HOME_AUDIT_CACHE_SECONDS))
     {
-        for (i = 0; i < userListSize; i++)
+        return 0;
+    }
+
+    FreeHomeAuditSnapshot(&g_homeAudit);
+
+    if (NULL != g_homeAuditUsers)
+    {
+        if (0 != (status = CopyUsersList(&snapshot.users, g_homeAuditUsers, g_homeAuditNumberOfUsers, log)))
         {
-            if (((NULL == userList[i].username) || (0 != strcmp(userList[i].username, g_root))) && (0 == userList[i].userId))
-            {
-                OsConfigLogError(log, "CheckRootIsOnlyUidZeroAccount: user '%s' (%u, %u) is not root but has uid 0", 
-                    userList[i].username, userList[i].userId, userList[i].groupId);
-                OsConfigCaptureReason(reason, "User '%s' (%u, %u) is not root but has uid 0", 
-                    userList[i].username, userList[i].userId, userList[i].groupId);
-                status = EACCES;
-            }
+            return status;
         }
+
+        snapshot.numberOfUsers = g_homeAuditNumberOfUsers;
+    }
+    else if (0 != (status = EnumerateUsers(&snapshot.users, &snapshot.numberOfUsers, reason, log)))
+    {
+        return status;
     }
 
-    FreeUsersList(&userList, userListSize);
+    if ((NULL == (snapshot.userAudits = (HOME_AUDIT**)calloc(snapshot.numberOfUsers + 1, sizeof(HOME_AUDIT*)))) ||
+        (NULL == (homes = (const char**)calloc(snapshot.numberOfUsers + 1, sizeof(const char*)))))
+    {
+        OsConfigLogError(log, "RefreshHomeAudit: out of memory");
+        FreeHomeAuditSnapshot(&snapshot);
+        return ENOMEM;
+    }
 
-    if (0 == status)
+    for (i = 0; i < snapshot.numberOfUsers; i++)
     {
-        OsConfigLogInfo(log, "CheckRootIsOnlyUidZeroAccount: all users who are not root have uids (user ids) greater than 0");
-        OsConfigCaptureSuccessReason(reason, "All users who are not root have uids (user ids) greater than 0");
+        if ((false == snapshot.users[i].noLogin) && (NULL != snapshot.users[i].home))
+        {
+            homes[numberOfHomes++] = snapshot.users[i].home;
+        }
     }
 
-    return status;
-}
+    qsort(homes, numberOfHomes, sizeof(const char*), CompareHomes);
 
-int SetRootIsOnlyUidZeroAccount(void* log)
-{
-    SIMPLIFIED_USER* userList = NULL;
-    unsigned int userListSize = 0, i = 0;
-    int status = 0, _status = 0;
+    for (i = 0, j = 0; i < numberOfHomes; i++)
+    {
+        if ((0 == j) || (0 != strcmp(homes[j - 1], homes[i])))
+        {
+            homes[j++] = homes[i];
+        }
+    }
 
-    if (0 == (status = EnumerateUsers(&userList, &userListSize, NULL, log)))
+    numberOfHomes = j;
+
+    if (0 == (status = AuditHomes(homes, numberOfHomes, g_homeAuditTimeoutSeconds, &snapshot.audits, log)))
     {
-        for (i = 0; i < userListSize; i++)
+        snapshot.numberOfAudits = numberOfHomes;
+
+        for (i = 0; i < snapshot.numberOfUsers; i++)
         {
-            if (((NULL == userList[i].username) || (0 != strcmp(userList[i].username, g_root))) && (0 == userList[i].userId))
+            if ((false == snapshot.users[i].noLogin) && (NULL != snapshot.users[i].home) &&
+                (NULL != (found = (const char**)bsearch(&snapshot.users[i].home, homes, numberOfHomes, sizeof(const char*), CompareHomes))))
             {
-                OsConfigLogError(log, "SetRootIsOnlyUidZeroAccount: user '%s' (%u, %u) is not root but has uid 0",
-                    userList[i].username, userList[i].userId, userList[i].groupId);
-
-                if ((0 != (_status = RemoveUser(&(userList[i]), log))) && (0 == status))
-                {
-                    status = _status;
-                }
+                snapshot.userAudits[i] = &snapshot.audits[found - homes];
             }
         }
-    }
-
-    FreeUsersList(&userList, userListSize);
 
-    if (0 == status)
+        snapshot.stamp = stamp;
+        snapshot.taken = now;
+        g_homeAudit = snapshot;
+        OsConfigLogInfo(log, "RefreshHomeAudit: audited %u homes of %u users", numberOfHomes, snapshot.numberOfUsers);
+    }
+    else
     {
-        OsConfigLogInfo(log, "SetRootIsOnlyUidZeroAccount: all users who are not root have uids (user ids) greater than 0");
+        FreeHomeAuditSnapshot(&snapshot);
     }
 
+    FREE_MEMORY(homes);
+
     return status;
 }
 
-int CheckDefaultRootAccountGroupIsGidZero(char** reason, void* log)
+static void InvalidateHomeAudit(void)
+{
+    pthread_mutex_lock(&g_homeAuditLock);
+    FreeHomeAuditSnapshot(&g_homeAudit);
+    pthread_mutex_unlock(&g_homeAuditLock);
+}
+
+int SetHomeAuditAccounts(const SIMPLIFIED_USER* users, unsigned int numberOfUsers, unsigned int timeoutSeconds, void* log)
 {
-    SIMPLIFIED_USER* userList = NULL;
-    unsigned int userListSize = 0;
-    unsigned int i = 0;
     int status = 0;
 
-    if (0 == (status = EnumerateUsers(&userList, &userListSize, reason, log)))
+    pthread_mutex_lock(&g_homeAuditLock);
+
+    FreeHomeAuditSnapshot(&g_homeAudit);
+    FreeUsersList(&g_homeAuditUsers, g_homeAuditNumberOfUsers);
+    g_homeAuditNumberOfUsers = 0;
+    g_homeAuditTimeoutSeconds = HOME_AUDIT_TIMEOUT_SECONDS;
+
+    if ((NULL != users) && (0 < numberOfUsers))
     {
-        for (i = 0; i < userListSize; i++)
+        if (0 == (status = CopyUsersList(&g_homeAuditUsers, users, numberOfUsers, log)))
         {
-            if ((0 == strcmp(userList[i].username, g_root)) && (0 == userList[i].userId) && (0 != userList[i].groupId))
-            {
-                OsConfigLogError(log, "CheckDefaultRootAccountuserIsGidZero: root user '%s' (%u) has default gid %u instead of gid 0", 
-                    userList[i].username, userList[i].userId, userList[i].groupId);
-                OsConfigCaptureReason(reason, "Root user '%s' (%u) has default gid %u instead of gid 0",
-                    userList[i].username, userList[i].userId, userList[i].groupId);
-                status = EPERM;
-            }
+            g_homeAuditNumberOfUsers = numberOfUsers;
+            g_homeAuditTimeoutSeconds = timeoutSeconds;
         }
     }
 
-    FreeUsersList(&userList, userListSize);
-
-    if (0 == status)
-    {
-        OsConfigLogInfo(log, "CheckDefaultRootAccountGroupIsGidZero: default root group is gid 0");
-        OsConfigCaptureSuccessReason(reason, "Default root group is gid 0");
-    }
+    pthread_mutex_unlock(&g_homeAuditLock);
 
     return status;
 }
 
-int SetDefaultRootAccountGroupIsGidZero(void* log)
+static const HOME_DOT_FILE* FindHomeDotFile(const HOME_AUDIT* audit, const char* name)
 {
-    int status = 0;
+    unsigned int i = 0;
 
-    if (0 != (status = CheckDefaultRootAccountGroupIsGidZero(NULL, log)))
+    for (i = 0; i < audit->numberOfDotFiles; i++)
     {
-        status = RepairRootGroup(log);
+        if (0 == strcmp(audit->dotFiles[i].name, name))
+        {
+            return &audit->dotFiles[i];
+        }
     }
 
-    return status;
+    return NULL;
+}
+
+// A home that could not be walked in time is reported as not audited rather than waited on
+static int ReportHomeAuditTimeout(const char* caller, const SIMPLIFIED_USER* user, char** reason, void* log)
+{
+    OsConfigLogError(log, "%s: user '%s' (%u, %u) home directory '%s' could not be audited within %u seconds",
+        caller, user->username, user->userId, user->groupId, user->home, g_homeAuditTimeoutSeconds);
+    OsConfigCaptureReason(reason, "User '%s' (%u, %u) home directory '%s' could not be audited within %u seconds",
+        user->username, user->userId, user->groupId, user->home, g_homeAuditTimeoutSeconds);
+    return ETIMEDOUT;
 }
 
 int CheckAllUsersHomeDirectoriesExist(char** reason, void* log)
 {
-    SIMPLIFIED_USER* userList = NULL;
-    unsigned int userListSize = 0, i = 0;
+    SIMPLIFIED_USER* user = NULL;
+    HOME_AUDIT* audit = NULL;
+    unsigned int i = 0;
     int status = 0;
 
-    if (0 == (status = EnumerateUsers(&userList, &userListSize, reason, log)))
+    pthread_mutex_lock(&g_homeAuditLock);
+
+    if (0 == (status = RefreshHomeAudit(reason, log)))
     {
-        for (i = 0; i < userListSize; i++)
+        for (i = 0; i < g_homeAudit.numberOfUsers; i++)
         {
-            if (userList[i].noLogin || userList[i].cannotLogin || userList[i].isLocked)
+            user = &g_homeAudit.users[i];
+            audit = g_homeAudit.userAudits[i];
+
+            if (user->noLogin || user->cannotLogin || user->isLocked || (NULL == user->home))
             {
                 continue;
             }
-            else if ((NULL != userList[i].home) && (false == DirectoryExists(userList[i].home)))
+            else if ((HomeAuditTimedOut == audit->state) && (false == audit->exists))
+            {
+                status = ReportHomeAuditTimeout("CheckAllUsersHomeDirectoriesExist", user, reason, log);
+            }
+            else if (false == audit->exists)
             {
                 OsConfigLogError(log, "CheckAllUsersHomeDirectoriesExist: user '%s' (%u, %u) home directory '%s' not found or is not a directory", 
-                    userList[i].username, userList[i].userId, userList[i].groupId, userList[i].home);
+                    user->username, user->userId, user->groupId, user->home);
                 OsConfigCaptureReason(reason, "User '%s' (%u, %u) home directory '%s' not found or is not a directory",
-                    userList[i].username, userList[i].userId, userList[i].groupId, userList[i].home);
+                    user->username, user->userId, user->groupId, user->home);
                 status = ENOENT;
             }
         }
     }
 
-    FreeUsersList(&userList, userListSize);
+    pthread_mutex_unlock(&g_homeAuditLock);
 
     if (0 == status)
     {
@@ -1756,6 +2892,8 @@ int SetUserHomeDirectories(void* log)
 
     FreeUsersList(&userList, userListSize);
 
+    InvalidateHomeAudit();
+
     if (0 == status)
     {
         OsConfigLogInfo(log, "SetUserHomeDirectories: all users who can login have home directories that exist, have correct ownership, and access");
@@ -1764,86 +2902,66 @@ int SetUserHomeDirectories(void* log)
     return status;
 }
 
-static int CheckHomeDirectoryOwnership(SIMPLIFIED_USER* user, void* log)
+int CheckUsersOwnTheirHomeDirectories(char** reason, void* log)
 {
-    struct stat statStruct = {0};
+    SIMPLIFIED_USER* user = NULL;
+    HOME_AUDIT* audit = NULL;
+    unsigned int i = 0;
+    bool ownsHome = false;
     int status = 0;
 
-    if ((NULL == user) || (NULL == user->home))
-    {
-        OsConfigLogError(log, "CheckHomeDirectoryOwnership called with an invalid argument");
-        return EINVAL;
-    }
+    pthread_mutex_lock(&g_homeAuditLock);
 
-    if (DirectoryExists(user->home))
+    if (0 == (status = RefreshHomeAudit(reason, log)))
     {
-        if (0 == (status = stat(user->home, &statStruct)))
-        {
-            if (((uid_t)user->userId != statStruct.st_uid) || ((gid_t)user->groupId != statStruct.st_gid))
-            {
-                status = ENOENT;
-            }
-        }
-        else
+        for (i = 0; i < g_homeAudit.numberOfUsers; i++)
         {
-            OsConfigLogError(log, "CheckHomeDirectoryOwnership: stat('%s') failed with %d", user->home, errno);
-        }
-    }
-    else
-    {
-        OsConfigLogInfo(log, "CheckHomeDirectoryOwnership: directory '%s' is not found, nothing to check", user->home);
-    }
-
-    return status;
-}
-
-int CheckUsersOwnTheirHomeDirectories(char** reason, void* log)
-{
-    SIMPLIFIED_USER* userList = NULL;
-    unsigned int userListSize = 0, i = 0;
-    int status = 0;
+            user = &g_homeAudit.users[i];
+            audit = g_homeAudit.userAudits[i];
 
-    if (0 == (status = EnumerateUsers(&userList, &userListSize, reason, log)))
-    {
-        for (i = 0; i < userListSize; i++)
-        {
-            if (userList[i].noLogin || userList[i].cannotLogin || userList[i].isLocked)
+            if (user->noLogin || user->cannotLogin || user->isLocked)
             {
                 continue;
             }
-            else if (DirectoryExists(userList[i].home)) 
+            else if ((NULL != audit) && (HomeAuditTimedOut == audit->state) && (false == audit->exists))
             {
-                if (userList[i].cannotLogin && (0 != CheckHomeDirectoryOwnership(&userList[i], log)))
+                status = ReportHomeAuditTimeout("CheckUsersOwnTheirHomeDirectories", user, reason, log);
+            }
+            else if ((NULL != audit) && audit->exists)
+            {
+                ownsHome = (((uid_t)user->userId == audit->statStruct.st_uid) && ((gid_t)user->groupId == audit->statStruct.st_gid)) ? true : false;
+
+                if (user->cannotLogin && (false == ownsHome))
                 {
                     OsConfigLogInfo(log, "CheckUsersOwnTheirHomeDirectories: user '%s' (%u, %u) cannot login and their assigned home directory '%s' is owned by root",
-                        userList[i].username, userList[i].userId, userList[i].groupId, userList[i].home);
+                        user->username, user->userId, user->groupId, user->home);
                 }
-                else if (0 == CheckHomeDirectoryOwnership(&userList[i], log))
+                else if (ownsHome)
                 {
                     OsConfigLogInfo(log, "CheckUsersOwnTheirHomeDirectories: user '%s' (%u, %u) owns their assigned home directory '%s'",
-                        userList[i].username, userList[i].userId, userList[i].groupId, userList[i].home);
+                        user->username, user->userId, user->groupId, user->home);
                 }
                 else
                 {
                     OsConfigLogError(log, "CheckUsersOwnTheirHomeDirectories: user '%s' (%u, %u) does not own their assigned home directory '%s'",
-                        userList[i].username, userList[i].userId, userList[i].groupId, userList[i].home);
+                        user->username, user->userId, user->groupId, user->home);
                     OsConfigCaptureReason(reason, "User '%s' (%u, %u) does not own their assigned home directory '%s'",
-                        userList[i].username, userList[i].userId, userList[i].groupId, userList[i].home);
+                        user->username, user->userId, user->groupId, user->home);
                     status = ENOENT;
                 }
             }
             else
             {
                 OsConfigLogError(log, "CheckUsersOwnTheirHomeDirectories: user '%s' (%u, %u) assigned home directory '%s' does not exist",
-                    userList[i].username, userList[i].userId, userList[i].groupId, userList[i].home);
+                    user->username, user->userId, user->groupId, user->home);
                 OsConfigCaptureReason(reason, "User '%s' (%u, %u) assigned home directory '%s' does not exist",
-                    userList[i].username, userList[i].userId, userList[i].groupId, userList[i].home);
+                    user->username, user->userId, user->groupId, user->home);
                 status = ENOENT;
             }
         }
     }
 
-    FreeUsersList(&userList, userListSize);
+    pthread_mutex_unlock(&g_homeAuditLock);
 
     if (0 == status)
     {
@@ -1856,8 +2974,9 @@ int CheckUsersOwnTheirHomeDirectories(char** reason, void* log)
 
 int CheckRestrictedUserHomeDirectories(unsigned int* modes, unsigned int numberOfModes, char** reason, void* log)
 {
-    SIMPLIFIED_USER* userList = NULL;
-    unsigned int userListSize = 0, i = 0, j = 0;
+    SIMPLIFIED_USER* user = NULL;
+    HOME_AUDIT* audit = NULL;
+    unsigned int i = 0, j = 0;
     bool oneGoodMode = false;
     int status = 0;
 
@@ -1867,24 +2986,33 @@ int CheckRestrictedUserHomeDirectories(unsigned int* modes, unsigned int numberO
         return EINVAL;
     }
 
-    if (0 == (status = EnumerateUsers(&userList, &userListSize, reason, log)))
+    pthread_mutex_lock(&g_homeAuditLock);
+
+    if (0 == (status = RefreshHomeAudit(reason, log)))
     {
-        for (i = 0; i < userListSize; i++)
+        for (i = 0; i < g_homeAudit.numberOfUsers; i++)
         {
-            if (userList[i].noLogin || userList[i].cannotLogin || userList[i].isLocked)
+            user = &g_homeAudit.users[i];
+            audit = g_homeAudit.userAudits[i];
+
+            if (user->noLogin || user->cannotLogin || user->isLocked || (NULL == audit))
             {
                 continue;
             }
-            else if (DirectoryExists(userList[i].home))
+            else if ((HomeAuditTimedOut == audit->state) && (false == audit->exists))
+            {
+                status = ReportHomeAuditTimeout("CheckRestrictedUserHomeDirectories", user, reason, log);
+            }
+            else if (audit->exists)
             {
                 oneGoodMode = false;
 
                 for (j = 0; j < numberOfModes; j++)
                 {
-                    if (0 == CheckDirectoryAccess(userList[i].home, userList[i].userId, userList[i].groupId, modes[j], true, NULL, log))
+                    if (0 == CheckStatAccess(&audit->statStruct, true, user->home, user->userId, user->groupId, modes[j], true, NULL, log))
                     {
                         OsConfigLogInfo(log, "CheckRestrictedUserHomeDirectories: user '%s' (%u, %u) has proper restricted access (%u) for their assigned home directory '%s'",
-                            userList[i].username, userList[i].userId, userList[i].groupId, modes[j], userList[i].home);
+                            user->username, user->userId, user->groupId, modes[j], user->home);
                         oneGoodMode = true;
                         break;
                     }
@@ -1893,9 +3021,9 @@ int CheckRestrictedUserHomeDirectories(unsigned int* modes, unsigned int numberO
                 if (false == oneGoodMode)
                 {
                     OsConfigLogError(log, "CheckRestrictedUserHomeDirectories: user '%s' (%u, %u) does not have proper restricted access for their assigned home directory '%s'",
-                        userList[i].username, userList[i].userId, userList[i].groupId, userList[i].home);
+                        user->username, user->userId, user->groupId, user->home);
                     OsConfigCaptureReason(reason, "User '%s' (%u, %u) does not have proper restricted access for their assigned home directory '%s'",
-                        userList[i].username, userList[i].userId, userList[i].groupId, userList[i].home);
+                        user->username, user->userId, user->groupId, user->home);
 
                     if (0 == status)
                     {
@@ -1906,7 +3034,7 @@ int CheckRestrictedUserHomeDirectories(unsigned int* modes, unsigned int numberO
         }
     }
 
-    FreeUsersList(&userList, userListSize);
+    pthread_mutex_unlock(&g_homeAuditLock);
 
     if (0 == status)
     {
@@ -1919,8 +3047,9 @@ int CheckRestrictedUserHomeDirectories(unsigned int* modes, unsigned int numberO
 
 int SetRestrictedUserHomeDirectories(unsigned int* modes, unsigned int numberOfModes, unsigned int modeForRoot, unsigned int modeForOthers, void* log)
 {
-    SIMPLIFIED_USER* userList = NULL;
-    unsigned int userListSize = 0, i = 0, j = 0;
+    SIMPLIFIED_USER* user = NULL;
+    HOME_AUDIT* audit = NULL;
+    unsigned int i = 0, j = 0;
     bool oneGoodMode = false;
     int status = 0, _status = 0;
 
@@ -1930,52 +3059,58 @@ int SetRestrictedUserHomeDirectories(unsigned int* modes, unsigned int numberOfM
         return EINVAL;
     }
 
-    if (0 == (status = EnumerateUsers(&userList, &userListSize, NULL, log)))
+    pthread_mutex_lock(&g_homeAuditLock);
+
+    if (0 == (status = RefreshHomeAudit(NULL, log)))
     {
-        for (i = 0; i < userListSize; i++)
+        for (i = 0; i < g_homeAudit.numberOfUsers; i++)
         {
-            if (userList[i].noLogin || userList[i].cannotLogin || userList[i].isLocked)
+            user = &g_homeAudit.users[i];
+            audit = g_homeAudit.userAudits[i];
+
+            if (user->noLogin || user->cannotLogin || user->isLocked || (NULL == audit) || (false == audit->exists))
             {
                 continue;
             }
-            else if (DirectoryExists(userList[i].home))
-            {
-                oneGoodMode = false;
 
-                for (j = 0; j < numberOfModes; j++)
+            oneGoodMode = false;
+
+            for (j = 0; j < numberOfModes; j++)
+            {
+                if (0 == CheckStatAccess(&audit->statStruct, true, user->home, user->userId, user->groupId, modes[j], true, NULL, log))
                 {
-                    if (0 == CheckDirectoryAccess(userList[i].home, userList[i].userId, userList[i].groupId, modes[j], true, NULL, log))
-                    {
-                        OsConfigLogInfo(log, "SetRestrictedUserHomeDirectories: user '%s' (%u, %u) already has proper restricted access (%u) for their assigned home directory '%s'",
-                            userList[i].username, userList[i].userId, userList[i].groupId, modes[j], userList[i].home);
-                        oneGoodMode = true;
-                        break;
-                    }
+                    OsConfigLogInfo(log, "SetRestrictedUserHomeDirectories: user '%s' (%u, %u) already has proper restricted access (%u) for their assigned home directory '%s'",
+                        user->username, user->userId, user->groupId, modes[j], user->home);
+                    oneGoodMode = true;
+                    break;
                 }
+            }
 
-                if (false == oneGoodMode)
+            if (false == oneGoodMode)
+            {
+                if (0 == (_status = SetDirectoryAccess(user->home, user->userId, user->groupId, user->isRoot ? modeForRoot : modeForOthers, log)))
                 {
-                    if (0 == (_status = SetDirectoryAccess(userList[i].home, userList[i].userId, userList[i].groupId, userList[i].isRoot ? modeForRoot : modeForOthers, log)))
-                    {
-                        OsConfigLogInfo(log, "SetRestrictedUserHomeDirectories: user '%s' (%u, %u) has now proper restricted access (%u) for their assigned home directory '%s'",
-                            userList[i].username, userList[i].userId, userList[i].groupId, userList[i].isRoot ? modeForRoot : modeForOthers, userList[i].home);
-                    }
-                    else
-                    {
-                        OsConfigLogError(log, "SetRestrictedUserHomeDirectories: failed to set restricted access (%u) for user '%s' (%u, %u) assigned home directory '%s' (%d)",
-                            userList[i].isRoot ? modeForRoot : modeForOthers, userList[i].username, userList[i].userId, userList[i].groupId, userList[i].home, _status);
+                    OsConfigLogInfo(log, "SetRestrictedUserHomeDirectories: user '%s' (%u, %u) has now proper restricted access (%u) for their assigned home directory '%s'",
+                        user->username, user->userId, user->groupId, user->isRoot ? modeForRoot : modeForOthers, user->home);
+                }
+                else
+                {
+                    OsConfigLogError(log, "SetRestrictedUserHomeDirectories: failed to set restricted access (%u) for user '%s' (%u, %u) assigned home directory '%s' (%d)",
+                        user->isRoot ? modeForRoot : modeForOthers, user->username, user->userId, user->groupId, user->home, _status);
 
-                        if (0 == status)
-                        {
-                            status = _status;
-                        }
+                    if (0 == status)
+                    {
+                        status = _status;
                     }
                 }
             }
         }
     }
 
-    FreeUsersList(&userList, userListSize);
+    // The homes changed, the next check walks them again
+    FreeHomeAuditSnapshot(&g_homeAudit);
+
+    pthread_mutex_unlock(&g_homeAuditLock);
 
     if (0 == status)
     {
@@ -2125,53 +3260,73 @@ int CheckMinDaysBetweenPasswordChanges(long days, char** reason, void* log)
     return status;
 }
 
-int SetMinDaysBetweenPasswordChanges(long days, void* log)
+// Applies the aging changes collected for all users with a single rewrite of /etc/shadow, then logs the outcome for each user
+static int ApplyShadowAgingChanges(const char* caller, const char* what, SHADOW_AGING_CHANGE* changes, unsigned int numberOfChanges, void* log)
 {
-    const char* commandTemplate = "chage -m %ld %s";
-    char* command = NULL;
-    SIMPLIFIED_USER* userList = NULL;
-    unsigned int userListSize = 0, i = 0;
-    int status = 0, _status = 0;
+    unsigned int i = 0;
+    int status = 0;
 
-    if (0 == (status = EnumerateUsers(&userList, &userListSize, NULL, log)))
+    if (0 == numberOfChanges)
     {
-        for (i = 0; i < userListSize; i++)
+        return 0;
+    }
+
+    SetShadowAgingValues(NULL, changes, numberOfChanges, log);
+
+    for (i = 0; i < numberOfChanges; i++)
+    {
+        if (0 == changes[i].result)
         {
-            if (false == userList[i].hasPassword)
+            OsConfigLogInfo(log, "%s: user '%s' %s is now set to %ld days", caller, changes[i].username, what, changes[i].value);
+        }
+        else
+        {
+            OsConfigLogError(log, "%s: failed to set %s to %ld days for user '%s' (%d)", caller, what, changes[i].value, changes[i].username, changes[i].result);
+
+            if (0 == status)
             {
-                continue;
+                status = changes[i].result;
             }
-            else if (userList[i].minimumPasswordAge < days)
-            {
-                OsConfigLogInfo(log, "SetMinDaysBetweenPasswordChanges: user '%s' (%u, %u) minimum time between password changes of %ld days is less than requested %ld days",
-                    userList[i].username, userList[i].userId, userList[i].groupId, userList[i].minimumPasswordAge, days);
-                    
-                if (NULL == (command = FormatAllocateString(commandTemplate, days, userList[i].username)))
-                {
-                    OsConfigLogError(log, "SetMinDaysBetweenPasswordChanges: cannot allocate memory");
-                    status = ENOMEM;
-                    break;
-                }
-                else
-                {
-                    if (0 == (_status = ExecuteCommand(NULL, command, false, false, 0, 0, NULL, NULL, log)))
-                    {
-                        userList[i].minimumPasswordAge = days;
-                        OsConfigLogInfo(log, "SetMinDaysBetweenPasswordChanges: user '%s' (%u, %u) minimum time between password changes is now set to %ld days",
-                            userList[i].username, userList[i].userId, userList[i].groupId, days);
-                    }
+        }
+    }
 
-                    FREE_MEMORY(command);
+    return status;
+}
 
-                    if (_status && (0 == status))
-                    {
-                        status = _status;
-                    }
+int SetMinDaysBetweenPasswordChanges(long days, void* log)
+{
+    SIMPLIFIED_USER* userList = NULL;
+    SHADOW_AGING_CHANGE* changes = NULL;
+    unsigned int userListSize = 0, numberOfChanges = 0, i = 0;
+    int status = 0, _status = 0;
+
+    if (0 == (status = EnumerateUsers(&userList, &userListSize, NULL, log)))
+    {
+        if (NULL == (changes = (SHADOW_AGING_CHANGE*)calloc(userListSize + 1, sizeof(SHADOW_AGING_CHANGE))))
+        {
+            OsConfigLogError(log, "SetMinDaysBetweenPasswordChanges: cannot allocate memory");
+            status = ENOMEM;
+        }
+        else
+        {
+            for (i = 0; i < userListSize; i++)
+            {
+                if (userList[i].hasPassword && (userList[i].minimumPasswordAge < days))
+                {
+                    OsConfigLogInfo(log, "SetMinDaysBetweenPasswordChanges: user '%s' (%u, %u) minimum time between password changes of %ld days is less than requested %ld days",
+                        userList[i].username, userList[i].userId, userList[i].groupId, userList[i].minimumPasswordAge, days);
+                    changes[numberOfChanges].username = userList[i].username;
+                    changes[numberOfChanges].field = ShadowMinimumAge;
+                    changes[numberOfChanges].value = days;
+                    numberOfChanges += 1;
                 }
             }
+
+            status = ApplyShadowAgingChanges("SetMinDaysBetweenPasswordChanges", "minimum time between password changes", changes, numberOfChanges, log);
         }
     }
-    
+
+    FREE_MEMORY(changes);
     FreeUsersList(&userList, userListSize);
 
     if (0 == status)
@@ -2270,51 +3425,38 @@ int CheckMaxDaysBetweenPasswordChanges(long days, char** reason, void* log)
 
 int SetMaxDaysBetweenPasswordChanges(long days, void* log)
 {
-    const char* commandTemplate = "chage -M %ld %s";
-    char* command = NULL;
     SIMPLIFIED_USER* userList = NULL;
-    unsigned int userListSize = 0, i = 0;
+    SHADOW_AGING_CHANGE* changes = NULL;
+    unsigned int userListSize = 0, numberOfChanges = 0, i = 0;
     int status = 0, _status = 0;
 
     if (0 == (status = EnumerateUsers(&userList, &userListSize, NULL, log)))
     {
-        for (i = 0; i < userListSize; i++)
+        if (NULL == (changes = (SHADOW_AGING_CHANGE*)calloc(userListSize + 1, sizeof(SHADOW_AGING_CHANGE))))
         {
-            if (false == userList[i].hasPassword)
-            {
-                continue;
-            }
-            else if ((userList[i].maximumPasswordAge > days) || (userList[i].maximumPasswordAge < 0))
+            OsConfigLogError(log, "SetMaxDaysBetweenPasswordChanges: cannot allocate memory");
+            status = ENOMEM;
+        }
+        else
+        {
+            for (i = 0; i < userListSize; i++)
             {
-                OsConfigLogInfo(log, "SetMaxDaysBetweenPasswordChanges: user '%s' (%u, %u) has maximum time between password changes of %ld days while requested is %ld days",
-                    userList[i].username, userList[i].userId, userList[i].groupId, userList[i].maximumPasswordAge, days);
-
-                if (NULL == (command = FormatAllocateString(commandTemplate, days, userList[i].username)))
-                {
-                    OsConfigLogError(log, "SetMaxDaysBetweenPasswordChanges: cannot allocate memory");
-                    status = ENOMEM;
-                    break;
-                }
-                else
+                if (userList[i].hasPassword && ((userList[i].maximumPasswordAge > days) || (userList[i].maximumPasswordAge < 0)))
                 {
-                    if (0 == (_status = ExecuteCommand(NULL, command, false, false, 0, 0, NULL, NULL, log)))
-                    {
-                        userList[i].maximumPasswordAge = days;
-                        OsConfigLogInfo(log, "SetMaxDaysBetweenPasswordChanges: user '%s' (%u, %u) maximum time between password changes is now set to %ld days",
-                            userList[i].username, userList[i].userId, userList[i].groupId, days);
-                    }
-
-                    FREE_MEMORY(command);
-
-                    if (0 == status)
-                    {
-                        status = _status;
-                    }
+                    OsConfigLogInfo(log, "SetMaxDaysBetweenPasswordChanges: user '%s' (%u, %u) has maximum time between password changes of %ld days while requested is %ld days",
+                        userList[i].username, userList[i].userId, userList[i].groupId, userList[i].maximumPasswordAge, days);
+                    changes[numberOfChanges].username = userList[i].username;
+                    changes[numberOfChanges].field = ShadowMaximumAge;
+                    changes[numberOfChanges].value = days;
+                    numberOfChanges += 1;
                 }
             }
+
+            status = ApplyShadowAgingChanges("SetMaxDaysBetweenPasswordChanges", "maximum time between password changes", changes, numberOfChanges, log);
         }
     }
 
+    FREE_MEMORY(changes);
     FreeUsersList(&userList, userListSize);
 
     if (0 == status)
@@ -2341,52 +3483,40 @@ int SetMaxDaysBetweenPasswordChanges(long days, void* log)
 
 int EnsureUsersHaveDatesOfLastPasswordChanges(void* log)
 {
-    const char* commandTemplate = "chage -d %ld %s";
-    char* command = NULL;
     SIMPLIFIED_USER* userList = NULL;
-    unsigned int userListSize = 0, i = 0;
-    int status = 0, _status = 0;
+    SHADOW_AGING_CHANGE* changes = NULL;
+    unsigned int userListSize = 0, numberOfChanges = 0, i = 0;
     time_t currentTime = 0;
     long currentDate = time(&currentTime) / NUMBER_OF_SECONDS_IN_A_DAY;
+    int status = 0;
 
     if (0 == (status = EnumerateUsers(&userList, &userListSize, NULL, log)))
     {
-        for (i = 0; i < userListSize; i++)
+        if (NULL == (changes = (SHADOW_AGING_CHANGE*)calloc(userListSize + 1, sizeof(SHADOW_AGING_CHANGE))))
         {
-            if (false == userList[i].hasPassword)
-            {
-                continue;
-            }
-            else if (userList[i].lastPasswordChange < 0)
+            OsConfigLogError(log, "EnsureUsersHaveDatesOfLastPasswordChanges: cannot allocate memory");
+            status = ENOMEM;
+        }
+        else
+        {
+            for (i = 0; i < userListSize; i++)
             {
-                OsConfigLogInfo(log, "EnsureUsersHaveDatesOfLastPasswordChanges: password for user '%s' (%u, %u) was never changed (%lu)",
-                    userList[i].username, userList[i].userId, userList[i].groupId, userList[i].lastPasswordChange);
-
-                if (NULL == (command = FormatAllocateString(commandTemplate, currentDate, userList[i].username)))
-                {
-                    OsConfigLogError(log, "EnsureUsersHaveDatesOfLastPasswordChanges: cannot allocate memory");
-                    status = ENOMEM;
-                    break;
-                }
-                else
+                if (userList[i].hasPassword && (userList[i].lastPasswordChange < 0))
                 {
-                    if (0 == (_status = ExecuteCommand(NULL, command, false, false, 0, 0, NULL, NULL, log)))
-                    {
-                        OsConfigLogInfo(log, "EnsureUsersHaveDatesOfLastPasswordChanges: user '%s' (%u, %u) date of last password change is now set to %ld days since epoch (today)",
-                            userList[i].username, userList[i].userId, userList[i].groupId, currentDate);
-                    }
-
-                    FREE_MEMORY(command);
-
-                    if (0 == status)
-                    {
-                        status = _status;
-                    }
+                    OsConfigLogInfo(log, "EnsureUsersHaveDatesOfLastPasswordChanges: password for user '%s' (%u, %u) was never changed (%lu)",
+                        userList[i].username, userList[i].userId, userList[i].groupId, userList[i].lastPasswordChange);
+                    changes[numberOfChanges].username = userList[i].username;
+                    changes[numberOfChanges].field = ShadowLastChange;
+                    changes[numberOfChanges].value = currentDate;
+                    numberOfChanges += 1;
                 }
             }
+
+            status = ApplyShadowAgingChanges("EnsureUsersHaveDatesOfLastPasswordChanges", "date of last password change (in days since epoch)", changes, numberOfChanges, log);
         }
     }
 
+    FREE_MEMORY(changes);
     FreeUsersList(&userList, userListSize);
 
     if (0 == status)
@@ -2543,51 +3673,38 @@ int CheckPasswordExpirationWarning(long days, char** reason, void* log)
 
 int SetPasswordExpirationWarning(long days, void* log)
 {
-    const char* commandTemplate = "chage -W %ld %s";
-    char* command = NULL;
     SIMPLIFIED_USER* userList = NULL;
-    unsigned int userListSize = 0, i = 0;
+    SHADOW_AGING_CHANGE* changes = NULL;
+    unsigned int userListSize = 0, numberOfChanges = 0, i = 0;
     int status = 0, _status = 0;
 
     if (0 == (status = EnumerateUsers(&userList, &userListSize, NULL, log)))
     {
-        for (i = 0; i < userListSize; i++)
+        if (NULL == (changes = (SHADOW_AGING_CHANGE*)calloc(userListSize + 1, sizeof(SHADOW_AGING_CHANGE))))
         {
-            if (false == userList[i].hasPassword)
-            {
-                continue;
-            }
-            else if (userList[i].warningPeriod < days)
+            OsConfigLogError(log, "SetPasswordExpirationWarning: cannot allocate memory");
+            status = ENOMEM;
+        }
+        else
+        {
+            for (i = 0; i < userListSize; i++)
             {
-                OsConfigLogError(log, "SetPasswordExpirationWarning: user '%s' (%u, %u) password expiration warning time is %ld days, less than requested %ld days",
-                    userList[i].username, userList[i].userId, userList[i].groupId, userList[i].warningPeriod, days);
-
-                if (NULL == (command = FormatAllocateString(commandTemplate, days, userList[i].username)))
+                if (userList[i].hasPassword && (userList[i].warningPeriod < days))
                 {
-                    OsConfigLogError(log, "SetPasswordExpirationWarning: cannot allocate memory");
-                    status = ENOMEM;
-                    break;
-                }
-                else
-                {
-                    if (0 == (_status = ExecuteCommand(NULL, command, false, false, 0, 0, NULL, NULL, log)))
-                    {
-                        userList[i].warningPeriod = days;
-                        OsConfigLogInfo(log, "SetPasswordExpirationWarning: user '%s' (%u, %u) password expiration warning time is now set to %ld days",
-                            userList[i].username, userList[i].userId, userList[i].groupId, days);
-                    }
-
-                    FREE_MEMORY(command);
-
-                    if (0 == status)
-                    {
-                        status = _status;
-                    }
+                    OsConfigLogError(log, "SetPasswordExpirationWarning: user '%s' (%u, %u) password expiration warning time is %ld days, less than requested %ld days",
+                        userList[i].username, userList[i].userId, userList[i].groupId, userList[i].warningPeriod, days);
+                    changes[numberOfChanges].username = userList[i].username;
+                    changes[numberOfChanges].field = ShadowWarningPeriod;
+                    changes[numberOfChanges].value = days;
+                    numberOfChanges += 1;
                 }
             }
+
+            status = ApplyShadowAgingChanges("SetPasswordExpirationWarning", "password expiration warning time", changes, numberOfChanges, log);
         }
     }
 
+    FREE_MEMORY(changes);
     FreeUsersList(&userList, userListSize);
 
     if (0 == status)
@@ -2705,51 +3822,38 @@ int CheckLockoutAfterInactivityLessThan(long days, char** reason, void* log)
 
 int SetLockoutAfterInactivityLessThan(long days, void* log)
 {
-    const char* commandTemplate = "chage -I %ld %s";
-    char* command = NULL;
     SIMPLIFIED_USER* userList = NULL;
-    unsigned int userListSize = 0, i = 0;
-    int status = 0, _status = 0;
+    SHADOW_AGING_CHANGE* changes = NULL;
+    unsigned int userListSize = 0, numberOfChanges = 0, i = 0;
+    int status = 0;
 
     if (0 == (status = EnumerateUsers(&userList, &userListSize, NULL, log)))
     {
-        for (i = 0; i < userListSize; i++)
+        if (NULL == (changes = (SHADOW_AGING_CHANGE*)calloc(userListSize + 1, sizeof(SHADOW_AGING_CHANGE))))
         {
-            if ((false == userList[i].hasPassword) && (true == userList[i].isRoot))
-            {
-                continue;
-            }
-            else if (userList[i].inactivityPeriod > days)
+            OsConfigLogError(log, "SetLockoutAfterInactivityLessThan: cannot allocate memory");
+            status = ENOMEM;
+        }
+        else
+        {
+            for (i = 0; i < userListSize; i++)
             {
-                OsConfigLogInfo(log, "SetLockoutAfterInactivityLessThan: user '%s' (%u, %u) is locked out after %ld days of inactivity while requested is %ld days",
-                    userList[i].username, userList[i].userId, userList[i].groupId, userList[i].inactivityPeriod, days);
-
-                if (NULL == (command = FormatAllocateString(commandTemplate, days, userList[i].username)))
+                if (((userList[i].hasPassword) || (false == userList[i].isRoot)) && (userList[i].inactivityPeriod > days))
                 {
-                    OsConfigLogError(log, "SetLockoutAfterInactivityLessThan: cannot allocate memory");
-                    status = ENOMEM;
-                    break;
-                }
-                else
-                {
-                    if (0 == (_status = ExecuteCommand(NULL, command, false, false, 0, 0, NULL, NULL, log)))
-                    {
-                        userList[i].inactivityPeriod = days;
-                        OsConfigLogInfo(log, "SetLockoutAfterInactivityLessThan: user '%s' (%u, %u) lockout time after inactivity is now set to %ld days",
-                            userList[i].username, userList[i].userId, userList[i].groupId, days);
-                    }
-
-                    FREE_MEMORY(command);
-
-                    if (0 == status)
-                    {
-                        status = _status;
-                    }
+                    OsConfigLogInfo(log, "SetLockoutAfterInactivityLessThan: user '%s' (%u, %u) is locked out after %ld days of inactivity while requested is %ld days",
+                        userList[i].username, userList[i].userId, userList[i].groupId, userList[i].inactivityPeriod, days);
+                    changes[numberOfChanges].username = userList[i].username;
+                    changes[numberOfChanges].field = ShadowInactivityPeriod;
+                    changes[numberOfChanges].value = days;
+                    numberOfChanges += 1;
                 }
             }
+
+            status = ApplyShadowAgingChanges("SetLockoutAfterInactivityLessThan", "lockout time after inactivity", changes, numberOfChanges, log);
         }
     }
 
+    FREE_MEMORY(changes);
     FreeUsersList(&userList, userListSize);
 
     if (0 == status)
@@ -2892,12 +3996,12 @@ int CheckRootPasswordForSingleUserMode(char** reason, void* log)
 
 int CheckOrEnsureUsersDontHaveDotFiles(const char* name, bool removeDotFiles, char** reason, void* log)
 {
-    const char* templateDotPath = "%s/.%s";
-
-    SIMPLIFIED_USER* userList = NULL;
-    unsigned int userListSize = 0, i = 0;
-    size_t templateLength = 0, length = 0;
+    SIMPLIFIED_USER* user = NULL;
+    HOME_AUDIT* audit = NULL;
+    const HOME_DOT_FILE* dotFile = NULL;
+    char* dotName = NULL;
     char* dotPath = NULL;
+    unsigned int i = 0;
     int status = 0;
 
     if (NULL == name)
@@ -2906,59 +4010,71 @@ int CheckOrEnsureUsersDontHaveDotFiles(const char* name, bool removeDotFiles, ch
         return EINVAL;
     }
 
-    templateLength = strlen(templateDotPath) + strlen(name) + 1;
+    if (NULL == (dotName = FormatAllocateString(".%s", name)))
+    {
+        OsConfigLogError(log, "CheckOrEnsureUsersDontHaveDotFiles: out of memory");
+        return ENOMEM;
+    }
+
+    pthread_mutex_lock(&g_homeAuditLock);
 
-    if (0 == (status = EnumerateUsers(&userList, &userListSize, reason, log)))
+    if (0 == (status = RefreshHomeAudit(reason, log)))
     {
-        for (i = 0; i < userListSize; i++)
+        for (i = 0; i < g_homeAudit.numberOfUsers; i++)
         {
-            if ((userList[i].noLogin) || (userList[i].isRoot))
+            user = &g_homeAudit.users[i];
+            audit = g_homeAudit.userAudits[i];
+
+            if (user->noLogin || user->isRoot || (NULL == audit))
             {
                 continue;
             }
-            else if (DirectoryExists(userList[i].home))
+            else if (HomeAuditTimedOut == audit->state)
             {
-                length = templateLength + strlen(userList[i].home);
-
-                if (NULL == (dotPath = malloc(length)))
+                status = ReportHomeAuditTimeout("CheckOrEnsureUsersDontHaveDotFiles", user, reason, log);
+            }
+            else if ((NULL != (dotFile = FindHomeDotFile(audit, dotName))) && dotFile->resolves)
+            {
+                if (NULL == (dotPath = FormatAllocateString("%s/%s", user->home, dotName)))
                 {
                     OsConfigLogError(log, "CheckOrEnsureUsersDontHaveDotFiles: out of memory");
                     status = ENOMEM;
                     break;
                 }
-                
-                memset(dotPath, 0, length);
-                snprintf(dotPath, length, templateDotPath, userList[i].home, name);
 
-                if (FileExists(dotPath))
+                if (removeDotFiles)
                 {
-                    if (removeDotFiles)
-                    {
-                        remove(dotPath);
+                    remove(dotPath);
 
-                        if (FileExists(dotPath))
-                        {
-                            OsConfigLogError(log, "CheckOrEnsureUsersDontHaveDotFiles: for user '%s' (%u, %u), '%s' needs to be manually removed",
-                                userList[i].username, userList[i].userId, userList[i].groupId, dotPath);
-                            status = ENOENT;
-                        }
-                    }
-                    else
+                    if (FileExists(dotPath))
                     {
-                        OsConfigLogError(log, "CheckOrEnsureUsersDontHaveDotFiles: user '%s' (%u, %u) has file '.%s' ('%s')",
-                            userList[i].username, userList[i].userId, userList[i].groupId, name, dotPath);
-                        OsConfigCaptureReason(reason, "User '%s' (%u, %u) has file '.%s' ('%s')",
-                            userList[i].username, userList[i].userId, userList[i].groupId, name, dotPath);
+                        OsConfigLogError(log, "CheckOrEnsureUsersDontHaveDotFiles: for user '%s' (%u, %u), '%s' needs to be manually removed",
+                            user->username, user->userId, user->groupId, dotPath);
                         status = ENOENT;
                     }
                 }
+                else
+                {
+                    OsConfigLogError(log, "CheckOrEnsureUsersDontHaveDotFiles: user '%s' (%u, %u) has file '.%s' ('%s')",
+                        user->username, user->userId, user->groupId, name, dotPath);
+                    OsConfigCaptureReason(reason, "User '%s' (%u, %u) has file '.%s' ('%s')",
+                        user->username, user->userId, user->groupId, name, dotPath);
+                    status = ENOENT;
+                }
 
                 FREE_MEMORY(dotPath);
             }
         }
     }
 
-    FreeUsersList(&userList, userListSize);
+    if (removeDotFiles)
+    {
+        FreeHomeAuditSnapshot(&g_homeAudit);
+    }
+
+    pthread_mutex_unlock(&g_homeAuditLock);
+
+    FREE_MEMORY(dotName);
 
     if (0 == status)
     {
@@ -2971,14 +4087,10 @@ int CheckOrEnsureUsersDontHaveDotFiles(const char* name, bool removeDotFiles, ch
 
 int CheckUsersRestrictedDotFiles(unsigned int* modes, unsigned int numberOfModes, char** reason, void* log)
 {
-    const char* pathTemplate = "%s/%s";
-    
-    SIMPLIFIED_USER* userList = NULL;
-    unsigned int userListSize = 0, i = 0, j = 0;
-    DIR* home = NULL;
-    struct dirent* entry = NULL;
+    SIMPLIFIED_USER* user = NULL;
+    HOME_AUDIT* audit = NULL;
     char* path = NULL;
-    size_t length = 0;
+    unsigned int i = 0, j = 0, k = 0;
     bool oneGoodMode = false;
     int status = 0;
 
@@ -2988,67 +4100,71 @@ int CheckUsersRestrictedDotFiles(unsigned int* modes, unsigned int numberOfModes
         return EINVAL;
     }
 
-    if (0 == (status = EnumerateUsers(&userList, &userListSize, reason, log)))
+    pthread_mutex_lock(&g_homeAuditLock);
+
+    if (0 == (status = RefreshHomeAudit(reason, log)))
     {
-        for (i = 0; i < userListSize; i++)
+        for (i = 0; (i < g_homeAudit.numberOfUsers) && (ENOMEM != status); i++)
         {
-            if (userList[i].noLogin || userList[i].cannotLogin || userList[i].isLocked)
+            user = &g_homeAudit.users[i];
+            audit = g_homeAudit.userAudits[i];
+
+            if (user->noLogin || user->cannotLogin || user->isLocked || (NULL == audit))
+            {
+                continue;
+            }
+            else if (HomeAuditTimedOut == audit->state)
             {
+                status = ReportHomeAuditTimeout("CheckUsersRestrictedDotFiles", user, reason, log);
                 continue;
             }
-            else if (DirectoryExists(userList[i].home) && (NULL != (home = opendir(userList[i].home))))
+
+            for (k = 0; k < audit->numberOfDotFiles; k++)
             {
-                while (NULL != (entry = readdir(home)))
+                if (false == S_ISREG(audit->dotFiles[k].statStruct.st_mode))
                 {
-                    if ((DT_REG == entry->d_type) && ('.' == entry->d_name[0]))
-                    {
-                        length = strlen(pathTemplate) + strlen(userList[i].home) + strlen(entry->d_name);
-                        if (NULL == (path = malloc(length + 1)))
-                        {
-                            OsConfigLogError(log, "CheckUsersRestrictedDotFiles: out of memory");
-                            status = ENOMEM;
-                            break;
-                        }
-                        
-                        memset(path, 0, length + 1);
-                        snprintf(path, length, pathTemplate, userList[i].home, entry->d_name);
+                    continue;
+                }
 
-                        oneGoodMode = false;
+                if (NULL == (path = FormatAllocateString("%s/%s", user->home, audit->dotFiles[k].name)))
+                {
+                    OsConfigLogError(log, "CheckUsersRestrictedDotFiles: out of memory");
+                    status = ENOMEM;
+                    break;
+                }
 
-                        for (j = 0; j < numberOfModes; j++)
-                        {
-                            if (0 == CheckFileAccess(path, userList[i].userId, userList[i].groupId, modes[j], NULL, log))
-                            {
-                                OsConfigLogInfo(log, "CheckUsersRestrictedDotFiles: user '%s' (%u, %u) has proper restricted access (%u) for their dot file '%s'",
-                                    userList[i].username, userList[i].userId, userList[i].groupId, modes[j], path);
-                                oneGoodMode = true;
-                                break;
-                            }
-                        }
+                oneGoodMode = false;
 
-                        if (false == oneGoodMode)
-                        {
-                            OsConfigLogError(log, "CheckUsersRestrictedDotFiles: user '%s' (%u, %u) does not has have proper restricted access for their dot file '%s'",
-                                userList[i].username, userList[i].userId, userList[i].groupId, path);
-                            OsConfigCaptureReason(reason, "User '%s' (%u, %u) does not has have proper restricted access for their dot file '%s'",
-                                userList[i].username, userList[i].userId, userList[i].groupId, path);
+                for (j = 0; j < numberOfModes; j++)
+                {
+                    if (0 == CheckStatAccess(&audit->dotFiles[k].statStruct, false, path, user->userId, user->groupId, modes[j], false, NULL, log))
+                    {
+                        OsConfigLogInfo(log, "CheckUsersRestrictedDotFiles: user '%s' (%u, %u) has proper restricted access (%u) for their dot file '%s'",
+                            user->username, user->userId, user->groupId, modes[j], path);
+                        oneGoodMode = true;
+                        break;
+                    }
+                }
 
-                            if (0 == status)
-                            {
-                                status = ENOENT;
-                            }
-                        }
+                if (false == oneGoodMode)
+                {
+                    OsConfigLogError(log, "CheckUsersRestrictedDotFiles: user '%s' (%u, %u) does not has have proper restricted access for their dot file '%s'",
+                        user->username, user->userId, user->groupId, path);
+                    OsConfigCaptureReason(reason, "User '%s' (%u, %u) does not has have proper restricted access for their dot file '%s'",
+                        user->username, user->userId, user->groupId, path);
 
-                        FREE_MEMORY(path);
+                    if (0 == status)
+                    {
+                        status = ENOENT;
                     }
                 }
 
-                closedir(home);
+                FREE_MEMORY(path);
             }
         }
     }
 
-    FreeUsersList(&userList, userListSize);
+    pthread_mutex_unlock(&g_homeAuditLock);
 
     if (0 == status)
     {
@@ -3061,14 +4177,10 @@ int CheckUsersRestrictedDotFiles(unsigned int* modes, unsigned int numberOfModes
 
 int SetUsersRestrictedDotFiles(unsigned int* modes, unsigned int numberOfModes, unsigned int mode, void* log)
 {
-    const char* pathTemplate = "%s/%s";
-
-    SIMPLIFIED_USER* userList = NULL;
-    unsigned int userListSize = 0, i = 0, j = 0;
-    DIR* home = NULL;
-    struct dirent* entry = NULL;
+    SIMPLIFIED_USER* user = NULL;
+    HOME_AUDIT* audit = NULL;
     char* path = NULL;
-    size_t length = 0;
+    unsigned int i = 0, j = 0, k = 0;
     bool oneGoodMode = false;
     int status = 0, _status = 0;
 
@@ -3078,73 +4190,74 @@ int SetUsersRestrictedDotFiles(unsigned int* modes, unsigned int numberOfModes,
         return EINVAL;
     }
 
-    if (0 == (status = EnumerateUsers(&userList, &userListSize, NULL, log)))
+    pthread_mutex_lock(&g_homeAuditLock);
+
+    if (0 == (status = RefreshHomeAudit(NULL, log)))
     {
-        for (i = 0; i < userListSize; i++)
+        for (i = 0; (i < g_homeAudit.numberOfUsers) && (ENOMEM != status); i++)
         {
-            if (userList[i].noLogin || userList[i].cannotLogin || userList[i].isLocked)
+            user = &g_homeAudit.users[i];
+            audit = g_homeAudit.userAudits[i];
+
+            if (user->noLogin || user->cannotLogin || user->isLocked || (NULL == audit))
             {
                 continue;
             }
-            else if (DirectoryExists(userList[i].home) && (NULL != (home = opendir(userList[i].home))))
+
+            for (k = 0; k < audit->numberOfDotFiles; k++)
             {
-                while (NULL != (entry = readdir(home)))
+                if (false == S_ISREG(audit->dotFiles[k].statStruct.st_mode))
                 {
-                    if ((DT_REG == entry->d_type) && ('.' == entry->d_name[0]))
-                    {
-                        length = strlen(pathTemplate) + strlen(userList[i].home) + strlen(entry->d_name);
-                        if (NULL == (path = malloc(length + 1)))
-                        {
-                            OsConfigLogError(log, "SetUsersRestrictedDotFiles: out of memory");
-                            status = ENOMEM;
-                            break;
-                        }
+                    continue;
+                }
+
+                if (NULL == (path = FormatAllocateString("%s/%s", user->home, audit->dotFiles[k].name)))
+                {
+                    OsConfigLogError(log, "SetUsersRestrictedDotFiles: out of memory");
+                    status = ENOMEM;
+                    break;
+                }
 
-                        memset(path, 0, length + 1);
-                        snprintf(path, length, pathTemplate, userList[i].home, entry->d_name);
+                oneGoodMode = false;
 
-                        oneGoodMode = false;
+                for (j = 0; j < numberOfModes; j++)
+                {
+                    if (0 == CheckStatAccess(&audit->dotFiles[k].statStruct, false, path, user->userId, user->groupId, modes[j], false, NULL, log))
+                    {
+                        OsConfigLogInfo(log, "SetUsersRestrictedDotFiles: user '%s' (%u, %u) already has proper restricted access (%u) set for their dot file '%s'",
+                            user->username, user->userId, user->groupId, modes[j], path);
+                        oneGoodMode = true;
+                        break;
+                    }
+                }
 
-                        for (j = 0; j < numberOfModes; j++)
-                        {
-                            if (0 == CheckFileAccess(path, userList[i].userId, userList[i].groupId, modes[j], NULL, log))
-                            {
-                                OsConfigLogInfo(log, "SetUsersRestrictedDotFiles: user '%s' (%u, %u) already has proper restricted access (%u) set for their dot file '%s'",
-                                    userList[i].username, userList[i].userId, userList[i].groupId, modes[j], path);
-                                oneGoodMode = true;
-                                break;
-                            }
-                        }
+                if (false == oneGoodMode)
+                {
+                    if (0 == (_status = SetFileAccess(path, user->userId, user->groupId, mode, log)))
+                    {
+                        OsConfigLogInfo(log, "SetUsersRestrictedDotFiles: user '%s' (%u, %u) now has restricted access (%u) set for their dot file '%s'",
+                            user->username, user->userId, user->groupId, mode, path);
+                    }
+                    else
+                    {
+                        OsConfigLogError(log, "SetUsersRestrictedDotFiles: failed to set restricted access (%u) for user '%s' (%u, %u) dot file '%s'",
+                            mode, user->username, user->userId, user->groupId, path);
 
-                        if (false == oneGoodMode)
+                        if (0 == status)
                         {
-                            if (0 == (_status = SetFileAccess(path, userList[i].userId, userList[i].groupId, mode, log)))
-                            {
-                                OsConfigLogInfo(log, "SetUsersRestrictedDotFiles: user '%s' (%u, %u) now has restricted access (%u) set for their dot file '%s'",
-                                    userList[i].username, userList[i].userId, userList[i].groupId, mode, path);
-                            }
-                            else
-                            {
-                                OsConfigLogError(log, "SetUsersRestrictedDotFiles: failed to set restricted access (%u) for user '%s' (%u, %u) dot file '%s'",
-                                    mode, userList[i].username, userList[i].userId, userList[i].groupId, path);
-
-                                if (0 == status)
-                                {
-                                    status = _status;
-                                }
-                            }
+                            status = _status;
                         }
-                            
-                        FREE_MEMORY(path);
                     }
                 }
 
-                closedir(home);
+                FREE_MEMORY(path);
             }
         }
     }
 
-    FreeUsersList(&userList, userListSize);
+    FreeHomeAuditSnapshot(&g_homeAudit);
+
+    pthread_mutex_unlock(&g_homeAuditLock);
 
     if (0 == status)
     {
@@ -57,6 +57,25 @@ typedef struct SIMPLIFIED_USER
     long expirationDate;                 
 } SIMPLIFIED_USER;
 
+// Aging fields of a shadow entry that SetShadowAgingValues can change, by their position in the entry
+typedef enum ShadowAgingField
+{
+    ShadowLastChange = 2,
+    ShadowMinimumAge = 3,
+    ShadowMaximumAge = 4,
+    ShadowWarningPeriod = 5,
+    ShadowInactivityPeriod = 6
+} ShadowAgingField;
+
+typedef struct SHADOW_AGING_CHANGE
+{
+    const char* username;
+    ShadowAgingField field;
+    long value;
+    // Set for each change: 0 when applied, ENOENT when the user has no shadow entry, otherwise the error that prevented it
+    int result;
+} SHADOW_AGING_CHANGE;
+
 typedef struct SIMPLIFIED_GROUP
 {
     char* groupName;
@@ -76,6 +95,18 @@ int EnumerateUserGroups(SIMPLIFIED_USER* user, SIMPLIFIED_GROUP** groupList, uns
 int EnumerateAllGroups(SIMPLIFIED_GROUP** groupList, unsigned int* size, char** reason, void* log);
 void FreeGroupList(SIMPLIFIED_GROUP** groupList, unsigned int size);
 
+// Users and groups are enumerated once and served from a snapshot until the account files change
+void InvalidateAccountSnapshot(void);
+
+// Users and groups are read from these files instead of through the name service switch, a NULL file goes back to the system database
+int SetAccountFiles(const char* passwdFile, const char* shadowFile, const char* groupFile, void* log);
+
+// Replaces the accounts whose homes the home and dot file checks audit, and the time allowed to walk each home.
+// NULL users restores the accounts read from the system and the default timeout
+int SetHomeAuditAccounts(const SIMPLIFIED_USER* users, unsigned int numberOfUsers, unsigned int timeoutSeconds, void* log);
+
+int SetShadowAgingValues(const char* shadowFile, SHADOW_AGING_CHANGE* changes, unsigned int numberOfChanges, void* log);
+
 int CheckAllEtcPasswdGroupsExistInEtcGroup(char** reason, void* log);
 int SetAllEtcPasswdGroupsToExistInEtcGroup(void* log);
 int CheckNoDuplicateUidsExist(char** reason, void* log);
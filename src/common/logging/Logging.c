@@ -10,19 +10,88 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <limits.h>
+#include <fcntl.h>
+#if defined(HAVE_ZLIB)
+#include <zlib.h>
+#endif
 #include "Logging.h"
 
 #define MAX_LOG_TRIM 1000
 
+// Asynchronous logging: records are formatted by the callers into a bounded ring and written in batches by a background writer
+#define LOG_RING_SLOTS 1024
+#define LOG_RECORD_SIZE 1024
+#define LOG_BATCH_SIZE (64 * 1024)
+#define LOG_WRITER_IDLE_MILLISECONDS 1000
+#define LOG_FLUSH_WAIT_MILLISECONDS 10
+#define LOG_FLUSH_TIMEOUT_MILLISECONDS 5000
+#define LOG_SIGNAL_FLUSH_ATTEMPTS 100
+
+// Generation 1 is the backup log, older generations are <backup>.<N>, compressed to <backup>.<N>.gz when zlib is available
+#define LOG_COMPRESSED_SUFFIX ".gz"
+#define LOG_COMPRESSING_SUFFIX ".gz.tmp"
+#define LOG_COMPRESSION_CHUNK (64 * 1024)
+
 static bool g_fullLoggingEnabled = false;
 
-typedef struct OSCONFIG_LOG
+static unsigned int g_logSiteBurst = LOG_SITE_BURST;
+static unsigned int g_logSiteRecordsPerMinute = LOG_SITE_RECORDS_PER_MINUTE;
+static atomic_ullong g_suppressedLogRecords = 0;
+
+typedef struct LOG_RECORD
+{
+    // Equal to the ring position when the slot is free, position + 1 when it holds the record for that position
+    atomic_size_t sequence;
+    size_t length;
+    char data[LOG_RECORD_SIZE];
+} LOG_RECORD;
+
+typedef struct OSCONFIG_LOG OSCONFIG_LOG;
+
+typedef struct LOG_RING
+{
+    OSCONFIG_LOG* owner;
+    LOG_RECORD* records;
+    char* batch;
+    atomic_size_t enqueuePosition;
+    atomic_size_t drainedPosition;
+    size_t dequeuePosition;
+    atomic_ullong dropped;
+    unsigned long long reportedDropped;
+    atomic_bool draining;
+    atomic_bool writerIdle;
+    atomic_bool suspended;
+    atomic_bool stop;
+    atomic_int descriptor;
+    sem_t wakeUp;
+    pthread_t writer;
+    pthread_mutex_t fileLock;
+    pthread_mutex_t flushLock;
+    pthread_cond_t flushed;
+} LOG_RING;
+
+struct OSCONFIG_LOG
 {
     FILE* log;
     const char* logFileName;
     const char* backLogFileName;
     unsigned int trimLogCount;
-} OSCONFIG_LOG;
+    unsigned int generations;
+    long long retentionBytes;
+
+    // Published and withdrawn atomically. Callers that use the ring are counted in ringUsers, see AcquireLogRing
+    _Atomic(LOG_RING*) ring;
+    atomic_uint ringUsers;
+};
+
+// Serializes the rotations that rename the generations with their background compression
+static pthread_mutex_t g_logGenerationsLock = PTHREAD_MUTEX_INITIALIZER;
 
 void SetFullLogging(bool fullLogging)
 {
@@ -48,9 +117,12 @@ OSCONFIG_LOG_HANDLE OpenLog(const char* logFileName, const char* bakLogFileName)
     }
 
     memset(newLog, 0, sizeof(*newLog));
+    atomic_init(&newLog->ring, NULL);
+    atomic_init(&newLog->ringUsers, 0);
 
     newLog->logFileName = logFileName;
     newLog->backLogFileName = newLog->logFileName ? bakLogFileName : NULL;
+    newLog->generations = 1;
 
     if (NULL != newLog->logFileName)
     {
@@ -66,6 +138,28 @@ OSCONFIG_LOG_HANDLE OpenLog(const char* logFileName, const char* bakLogFileName)
     return (OSCONFIG_LOG_HANDLE)newLog;
 }
 
+static void StopLogWriter(OSCONFIG_LOG* whatLog);
+
+// Returns the ring, if any, kept alive until the matching ReleaseLogRing. The user is counted before the ring is read,
+// so once StopLogWriter withdraws the ring and sees no users left, nobody can still be holding it
+static LOG_RING* AcquireLogRing(OSCONFIG_LOG* whatLog)
+{
+    LOG_RING* ring = NULL;
+
+    atomic_fetch_add(&whatLog->ringUsers, 1);
+    if (NULL == (ring = atomic_load(&whatLog->ring)))
+    {
+        atomic_fetch_sub(&whatLog->ringUsers, 1);
+    }
+
+    return ring;
+}
+
+static void ReleaseLogRing(OSCONFIG_LOG* whatLog)
+{
+    atomic_fetch_sub(&whatLog->ringUsers, 1);
+}
+
 void CloseLog(OSCONFIG_LOG_HANDLE* log)
 {
     if ((NULL == log) || (NULL == (*log)))
@@ -75,6 +169,9 @@ void CloseLog(OSCONFIG_LOG_HANDLE* log)
 
     OSCONFIG_LOG* logToClose = (OSCONFIG_LOG*)(*log);
 
+    // Everything queued so far is written before the log is closed
+    StopLogWriter(logToClose);
+
     if (NULL != logToClose->log)
     {
         fclose(logToClose->log);
@@ -91,26 +188,353 @@ FILE* GetLogFile(OSCONFIG_LOG_HANDLE log)
     return log ? ((OSCONFIG_LOG*)log)->log : NULL;
 }
 
-static char g_logTime[TIME_FORMAT_STRING_LENGTH] = {0};
+static __thread time_t g_logTimeSecond = 0;
+static __thread char g_logTime[TIME_FORMAT_STRING_LENGTH] = {0};
 
 // Returns the local date/time formatted as YYYY-MM-DD HH:MM:SS (for example: 2014-03-19 11:11:52)
+// The time is formatted at most once a second per thread, the records in between reuse it
 char* GetFormattedTime()
 {
-    time_t rawTime = {0};
-    struct tm* timeInfo = NULL;
-    time(&rawTime);
-    timeInfo = localtime(&rawTime);
-    strftime(g_logTime, ARRAY_SIZE(g_logTime), "%Y-%m-%d %H:%M:%S", timeInfo);
+    time_t rawTime = time(NULL);
+    struct tm timeInfo = {0};
+
+    if ((rawTime != g_logTimeSecond) || (0 == g_logTime[0]))
+    {
+        if (NULL != localtime_r(&rawTime, &timeInfo))
+        {
+            strftime(g_logTime, ARRAY_SIZE(g_logTime), "%Y-%m-%d %H:%M:%S", &timeInfo);
+            g_logTimeSecond = rawTime;
+        }
+    }
+
     return g_logTime;
 }
 
+void SetLogRotation(OSCONFIG_LOG_HANDLE log, unsigned int generations, long long retentionBytes)
+{
+    OSCONFIG_LOG* whatLog = (OSCONFIG_LOG*)log;
+
+    if (NULL != whatLog)
+    {
+        whatLog->generations = (generations < 1) ? 1 : ((generations > MAX_LOG_GENERATIONS) ? MAX_LOG_GENERATIONS : generations);
+        whatLog->retentionBytes = (retentionBytes > 0) ? retentionBytes : 0;
+    }
+}
+
+static void GetLogGenerationName(const char* backLogFileName, unsigned int generation, const char* suffix, char* name, size_t size)
+{
+    if (generation <= 1)
+    {
+        snprintf(name, size, "%s", backLogFileName);
+    }
+    else
+    {
+        snprintf(name, size, "%s.%u%s", backLogFileName, generation, suffix);
+    }
+}
+
+// Returns the size of the generation, compressed or not, or -1 when there is no such generation
+static long long GetLogGenerationSize(const char* backLogFileName, unsigned int generation)
+{
+    struct stat statStruct = {0};
+    char name[PATH_MAX] = {0};
+
+    if (generation > 1)
+    {
+        GetLogGenerationName(backLogFileName, generation, LOG_COMPRESSED_SUFFIX, name, sizeof(name));
+        if (0 == stat(name, &statStruct))
+        {
+            return (long long)statStruct.st_size;
+        }
+    }
+
+    GetLogGenerationName(backLogFileName, generation, "", name, sizeof(name));
+
+    return (0 == stat(name, &statStruct)) ? (long long)statStruct.st_size : -1;
+}
+
+static void RemoveLogGeneration(const char* backLogFileName, unsigned int generation)
+{
+    char name[PATH_MAX] = {0};
+
+    GetLogGenerationName(backLogFileName, generation, "", name, sizeof(name));
+    unlink(name);
+
+    if (generation > 1)
+    {
+        GetLogGenerationName(backLogFileName, generation, LOG_COMPRESSED_SUFFIX, name, sizeof(name));
+        unlink(name);
+        GetLogGenerationName(backLogFileName, generation, LOG_COMPRESSING_SUFFIX, name, sizeof(name));
+        unlink(name);
+    }
+}
+
+// Makes room for the new backup log: drops the oldest generation and renames the others one generation older.
+// Each step is a single rename, a crash at any point loses at most the oldest generation
+static void ShiftLogGenerations(OSCONFIG_LOG* whatLog)
+{
+    const char* suffixes[] = {"", LOG_COMPRESSED_SUFFIX};
+    char from[PATH_MAX] = {0};
+    char to[PATH_MAX] = {0};
+    unsigned int generation = 0, i = 0;
+
+    RemoveLogGeneration(whatLog->backLogFileName, whatLog->generations);
+
+    for (generation = whatLog->generations; generation > 1; generation--)
+    {
+        // Left over by a compression interrupted by a crash, the uncompressed generation is still there
+        GetLogGenerationName(whatLog->backLogFileName, generation - 1, LOG_COMPRESSING_SUFFIX, from, sizeof(from));
+        if (generation > 2)
+        {
+            unlink(from);
+        }
+
+        for (i = 0; i < ARRAY_SIZE(suffixes); i++)
+        {
+            if ((generation > 2) || (0 == i))
+            {
+                GetLogGenerationName(whatLog->backLogFileName, generation - 1, suffixes[i], from, sizeof(from));
+                GetLogGenerationName(whatLog->backLogFileName, generation, suffixes[i], to, sizeof(to));
+                rename(from, to);
+            }
+        }
+    }
+}
+
+// Drops the oldest generations that do not fit in the retention budget, next to a full current log and the backup log
+static void ApplyLogRetention(OSCONFIG_LOG* whatLog)
+{
+    long long total = MAX_LOG_SIZE;
+    long long size = 0;
+    unsigned int generation = 0;
+
+    if ((whatLog->retentionBytes <= 0) || (whatLog->generations < 2))
+    {
+        return;
+    }
+
+    for (generation = 1; generation <= whatLog->generations; generation++)
+    {
+        if (0 > (size = GetLogGenerationSize(whatLog->backLogFileName, generation)))
+        {
+            continue;
+        }
+
+        total += size;
+
+        if ((generation > 1) && (total > whatLog->retentionBytes))
+        {
+            RemoveLogGeneration(whatLog->backLogFileName, generation);
+        }
+    }
+}
+
+#if defined(HAVE_ZLIB)
+typedef struct LOG_COMPRESSION
+{
+    char* backLogFileName;
+    unsigned int generations;
+} LOG_COMPRESSION;
+
+// Compresses to a temporary file that is flushed and then renamed, the uncompressed file is removed only after that
+static int CompressLogFile(const char* source, const char* temporary, const char* destination)
+{
+    char* buffer = NULL;
+    FILE* input = NULL;
+    gzFile output = NULL;
+    size_t size = 0;
+    int descriptor = -1, syncDescriptor = -1;
+    int status = 0;
+
+    if (NULL == (buffer = (char*)malloc(LOG_COMPRESSION_CHUNK)))
+    {
+        return ENOMEM;
+    }
+
+    if (NULL == (input = fopen(source, "r")))
+    {
+        free(buffer);
+        return errno ? errno : ENOENT;
+    }
+
+    if ((0 > (descriptor = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW, S_IRUSR | S_IWUSR))) ||
+        (0 > (syncDescriptor = dup(descriptor))) || (NULL == (output = gzdopen(descriptor, "wb"))))
+    {
+        status = errno ? errno : EIO;
+        if (0 <= descriptor)
+        {
+            close(descriptor);
+        }
+    }
+
+    while ((0 == status) && (0 < (size = fread(buffer, 1, LOG_COMPRESSION_CHUNK, input))))
+    {
+        if ((int)size != gzwrite(output, buffer, (unsigned int)size))
+        {
+            status = EIO;
+        }
+    }
+
+    if ((NULL != output) && (Z_OK != gzclose(output)) && (0 == status))
+    {
+        status = EIO;
+    }
+
+    if ((0 == status) && (0 != fsync(syncDescriptor)))
+    {
+        status = errno ? errno : EIO;
+    }
+
+    if (0 <= syncDescriptor)
+    {
+        close(syncDescriptor);
+    }
+
+    fclose(input);
+    free(buffer);
+
+    if ((0 == status) && (0 == rename(temporary, destination)))
+    {
+        RestrictAccessToRootOnly(destination);
+        unlink(source);
+    }
+    else
+    {
+        status = status ? status : (errno ? errno : EIO);
+        unlink(temporary);
+    }
+
+    return status;
+}
+
+// Compresses all uncompressed generations older than the backup log. Also completes what a crash interrupted
+static void* CompressLogGenerations(void* context)
+{
+    LOG_COMPRESSION* compression = (LOG_COMPRESSION*)context;
+    char source[PATH_MAX] = {0};
+    char temporary[PATH_MAX] = {0};
+    char destination[PATH_MAX] = {0};
+    struct stat statStruct = {0};
+    unsigned int generation = 0;
+
+    pthread_mutex_lock(&g_logGenerationsLock);
+
+    for (generation = 2; generation <= compression->generations; generation++)
+    {
+        GetLogGenerationName(compression->backLogFileName, generation, "", source, sizeof(source));
+        GetLogGenerationName(compression->backLogFileName, generation, LOG_COMPRESSING_SUFFIX, temporary, sizeof(temporary));
+        GetLogGenerationName(compression->backLogFileName, generation, LOG_COMPRESSED_SUFFIX, destination, sizeof(destination));
+
+        if (0 != stat(source, &statStruct))
+        {
+            continue;
+        }
+
+        if (0 == stat(destination, &statStruct))
+        {
+            // Already compressed, the crash came before the uncompressed file was removed
+            unlink(source);
+        }
+        else
+        {
+            CompressLogFile(source, temporary, destination);
+        }
+    }
+
+    pthread_mutex_unlock(&g_logGenerationsLock);
+
+    free(compression->backLogFileName);
+    free(compression);
+
+    return NULL;
+}
+
+static void StartLogCompression(OSCONFIG_LOG* whatLog)
+{
+    LOG_COMPRESSION* compression = NULL;
+    pthread_attr_t attributes;
+    pthread_t thread;
+
+    if ((NULL == (compression = (LOG_COMPRESSION*)calloc(1, sizeof(LOG_COMPRESSION)))) ||
+        (NULL == (compression->backLogFileName = strdup(whatLog->backLogFileName))))
+    {
+        free(compression);
+        return;
+    }
+
+    compression->generations = whatLog->generations;
+
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+
+    if (0 != pthread_create(&thread, &attributes, CompressLogGenerations, compression))
+    {
+        free(compression->backLogFileName);
+        free(compression);
+    }
+
+    pthread_attr_destroy(&attributes);
+}
+#endif
+
+// Rolls the log over to the backup copy and reopens it empty
+static void RollLogOver(OSCONFIG_LOG* whatLog)
+{
+    LOG_RING* ring = NULL;
+    bool generations = (NULL != whatLog->backLogFileName) && (whatLog->generations > 1);
+
+    fclose(whatLog->log);
+
+    if (generations)
+    {
+        // Waits for a compression still running on the generations about to be renamed
+        pthread_mutex_lock(&g_logGenerationsLock);
+        ShiftLogGenerations(whatLog);
+    }
+
+    // Rename the log in place to make a backup copy, overwriting previous copy if any:
+    if ((NULL == whatLog->backLogFileName) || (0 != rename(whatLog->logFileName, whatLog->backLogFileName)))
+    {
+        // If the log could not be renamed, empty it:
+        if (NULL != (whatLog->log = fopen(whatLog->logFileName, "w")))
+        {
+            fclose(whatLog->log);
+        }
+    }
+
+    // Reopen the log in append mode:
+    whatLog->log = fopen(whatLog->logFileName, "a");
+
+    // Reapply restrictions once the file is recreated (also for backup, if any):
+    RestrictAccessToRootOnly(whatLog->logFileName);
+    RestrictAccessToRootOnly(whatLog->backLogFileName);
+
+    if (NULL != (ring = AcquireLogRing(whatLog)))
+    {
+        atomic_store(&ring->descriptor, whatLog->log ? fileno(whatLog->log) : -1);
+        ReleaseLogRing(whatLog);
+    }
+
+    if (generations)
+    {
+        ApplyLogRetention(whatLog);
+        pthread_mutex_unlock(&g_logGenerationsLock);
+
+#if defined(HAVE_ZLIB)
+        // Off the logging path, the rotation itself is only renames
+        StartLogCompression(whatLog);
+#endif
+    }
+}
+
 // Checks and rolls the log over if larger than MAX_LOG_SIZE
 void TrimLog(OSCONFIG_LOG_HANDLE log)
 {
     OSCONFIG_LOG* whatLog = NULL;
     int fileSize = 0;
 
-    if ((NULL == log) || (NULL == (whatLog = (OSCONFIG_LOG*)log)))
+    // With asynchronous logging the writer checks the size after each batch
+    if ((NULL == log) || (NULL == (whatLog = (OSCONFIG_LOG*)log)) || (NULL == whatLog->log) || (NULL != atomic_load(&whatLog->ring)))
     {
         return;
     }
@@ -123,30 +547,584 @@ void TrimLog(OSCONFIG_LOG_HANDLE log)
     {
         // In append mode the file pointer will always be at end of file:
         fileSize = ftell(whatLog->log);
-        
+
         if ((fileSize >= MAX_LOG_SIZE) || (-1 == fileSize))
         {
-            fclose(whatLog->log);
+            RollLogOver(whatLog);
+        }
+    }
+}
 
-            // Rename the log in place to make a backup copy, overwriting previous copy if any:
-            if ((NULL == whatLog->backLogFileName) || (0 != rename(whatLog->logFileName, whatLog->backLogFileName)))
+// Claims the next free slot and copies the record in, drops the record when the ring is full. Lock-free, any number of producers
+static bool PutLogRecord(LOG_RING* ring, const char* data, size_t length)
+{
+    LOG_RECORD* record = NULL;
+    size_t position = atomic_load_explicit(&ring->enqueuePosition, memory_order_relaxed);
+    intptr_t difference = 0;
+
+    while (true)
+    {
+        record = &ring->records[position % LOG_RING_SLOTS];
+        difference = (intptr_t)atomic_load_explicit(&record->sequence, memory_order_acquire) - (intptr_t)position;
+
+        if (0 == difference)
+        {
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueuePosition, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
             {
-                // If the log could not be renamed, empty it:
-                whatLog->log = fopen(whatLog->logFileName, "w");
-                fclose(whatLog->log);
+                break;
             }
+        }
+        else if (difference < 0)
+        {
+            // The writer is a whole ring behind
+            atomic_fetch_add(&ring->dropped, 1);
+            return false;
+        }
+        else
+        {
+            position = atomic_load_explicit(&ring->enqueuePosition, memory_order_relaxed);
+        }
+    }
+
+    memcpy(record->data, data, length);
+    record->length = length;
+    atomic_store(&record->sequence, position + 1);
+
+    // The writer is woken only when it went to sleep, a busy writer picks the record up in its next batch
+    if (atomic_load(&ring->writerIdle))
+    {
+        sem_post(&ring->wakeUp);
+    }
+
+    return true;
+}
+
+// Copies the published records from the ring into the batch and frees their slots. Called only by the holder of the draining flag
+static size_t TakeLogRecords(LOG_RING* ring, char* batch, size_t batchSize)
+{
+    LOG_RECORD* record = NULL;
+    size_t position = ring->dequeuePosition;
+    size_t size = 0;
 
-            // Reopen the log in append mode:
-            whatLog->log = fopen(whatLog->logFileName, "a");
-            
-            // Reapply restrictions once the file is recreated (also for backup, if any):
-            RestrictAccessToRootOnly(whatLog->logFileName);
-            RestrictAccessToRootOnly(whatLog->backLogFileName);
+    while (true)
+    {
+        record = &ring->records[position % LOG_RING_SLOTS];
+
+        if ((atomic_load_explicit(&record->sequence, memory_order_acquire) != (position + 1)) || ((size + record->length) > batchSize))
+        {
+            break;
         }
+
+        memcpy(batch + size, record->data, record->length);
+        size += record->length;
+
+        atomic_store_explicit(&record->sequence, position + LOG_RING_SLOTS, memory_order_release);
+        position += 1;
     }
+
+    ring->dequeuePosition = position;
+
+    return size;
+}
+
+static bool IsLogRingEmpty(LOG_RING* ring)
+{
+    return (atomic_load(&ring->records[ring->dequeuePosition % LOG_RING_SLOTS].sequence) != (ring->dequeuePosition + 1));
+}
+
+// Writes all published records, reports the drops since the last drain and rolls the log over when it grew too large
+static size_t DrainLogRing(LOG_RING* ring)
+{
+    OSCONFIG_LOG* whatLog = ring->owner;
+    unsigned long long dropped = 0;
+    size_t size = 0, total = 0;
+    long fileSize = 0;
+
+    // Taken over for good by a fatal signal handler
+    if (atomic_exchange(&ring->draining, true))
+    {
+        return 0;
+    }
+
+    // A suspended writer still writes everything when stopping
+    if (atomic_load(&ring->suspended) && (false == atomic_load(&ring->stop)))
+    {
+        atomic_store(&ring->draining, false);
+        return 0;
+    }
+
+    pthread_mutex_lock(&ring->fileLock);
+
+    while (0 < (size = TakeLogRecords(ring, ring->batch, LOG_BATCH_SIZE)))
+    {
+        if (NULL != whatLog->log)
+        {
+            fwrite(ring->batch, 1, size, whatLog->log);
+        }
+        total += size;
+    }
+
+    if (NULL != whatLog->log)
+    {
+        if ((dropped = atomic_load(&ring->dropped)) != ring->reportedDropped)
+        {
+            fprintf(whatLog->log, "[%s] [%s:%d]%s%llu log records dropped, logging faster than the log can be written\n",
+                GetFormattedTime(), __SHORT_FILE__, __LINE__, __ERROR__, dropped - ring->reportedDropped);
+            ring->reportedDropped = dropped;
+        }
+
+        if (total > 0)
+        {
+            fflush(whatLog->log);
+
+            fileSize = ftell(whatLog->log);
+            if ((fileSize >= MAX_LOG_SIZE) || (-1 == fileSize))
+            {
+                RollLogOver(whatLog);
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&ring->fileLock);
+
+    atomic_store(&ring->drainedPosition, ring->dequeuePosition);
+    atomic_store(&ring->draining, false);
+
+    pthread_mutex_lock(&ring->flushLock);
+    pthread_cond_broadcast(&ring->flushed);
+    pthread_mutex_unlock(&ring->flushLock);
+
+    return total;
+}
+
+static void* LogWriter(void* context)
+{
+    LOG_RING* ring = (LOG_RING*)context;
+    struct timespec wakeUp = {0};
+    bool stopping = false;
+
+    while (true)
+    {
+        // Records queued before the stop request are written by this last pass
+        stopping = atomic_load(&ring->stop);
+
+        if ((0 < DrainLogRing(ring)) || stopping)
+        {
+            if (stopping)
+            {
+                break;
+            }
+            continue;
+        }
+
+        atomic_store(&ring->writerIdle, true);
+
+        if ((IsLogRingEmpty(ring) || atomic_load(&ring->suspended)) && (false == atomic_load(&ring->stop)))
+        {
+            clock_gettime(CLOCK_REALTIME, &wakeUp);
+            wakeUp.tv_sec += LOG_WRITER_IDLE_MILLISECONDS / 1000;
+            wakeUp.tv_nsec += (LOG_WRITER_IDLE_MILLISECONDS % 1000) * 1000000L;
+            if (wakeUp.tv_nsec >= 1000000000L)
+            {
+                wakeUp.tv_sec += 1;
+                wakeUp.tv_nsec -= 1000000000L;
+            }
+
+            while ((0 != sem_timedwait(&ring->wakeUp, &wakeUp)) && (EINTR == errno));
+        }
+
+        atomic_store(&ring->writerIdle, false);
+    }
+
+    return NULL;
+}
+
+// Waits for the callers that acquired the ring before it was withdrawn to release it
+static void WaitForLogRingUsers(OSCONFIG_LOG* whatLog)
+{
+    struct timespec pause = {0, 100000L};
+
+    while (0 < atomic_load(&whatLog->ringUsers))
+    {
+        nanosleep(&pause, NULL);
+    }
+}
+
+int EnableAsyncLogging(OSCONFIG_LOG_HANDLE log)
+{
+    OSCONFIG_LOG* whatLog = (OSCONFIG_LOG*)log;
+    LOG_RING* ring = NULL;
+    size_t i = 0;
+    int status = 0;
+
+    if ((NULL == whatLog) || (NULL == whatLog->log))
+    {
+        return EINVAL;
+    }
+
+    if (NULL != atomic_load(&whatLog->ring))
+    {
+        return 0;
+    }
+
+    if ((NULL == (ring = (LOG_RING*)calloc(1, sizeof(LOG_RING)))) ||
+        (NULL == (ring->records = (LOG_RECORD*)calloc(LOG_RING_SLOTS, sizeof(LOG_RECORD)))) ||
+        (NULL == (ring->batch = (char*)malloc(LOG_BATCH_SIZE))))
+    {
+        if (NULL != ring)
+        {
+            free(ring->records);
+            free(ring);
+        }
+        return ENOMEM;
+    }
+
+    for (i = 0; i < LOG_RING_SLOTS; i++)
+    {
+        atomic_init(&ring->records[i].sequence, i);
+    }
+
+    atomic_init(&ring->enqueuePosition, 0);
+    atomic_init(&ring->drainedPosition, 0);
+    atomic_init(&ring->dropped, 0);
+    atomic_init(&ring->draining, false);
+    atomic_init(&ring->writerIdle, false);
+    atomic_init(&ring->suspended, false);
+    atomic_init(&ring->stop, false);
+    atomic_init(&ring->descriptor, fileno(whatLog->log));
+    ring->owner = whatLog;
+
+    pthread_mutex_init(&ring->fileLock, NULL);
+    pthread_mutex_init(&ring->flushLock, NULL);
+    pthread_cond_init(&ring->flushed, NULL);
+    sem_init(&ring->wakeUp, 0, 0);
+
+    // Whatever was written synchronously so far goes first
+    fflush(whatLog->log);
+    atomic_store(&whatLog->ring, ring);
+
+    if (0 != (status = pthread_create(&ring->writer, NULL, LogWriter, ring)))
+    {
+        atomic_store(&whatLog->ring, NULL);
+        WaitForLogRingUsers(whatLog);
+        sem_destroy(&ring->wakeUp);
+        pthread_cond_destroy(&ring->flushed);
+        pthread_mutex_destroy(&ring->flushLock);
+        pthread_mutex_destroy(&ring->fileLock);
+        free(ring->batch);
+        free(ring->records);
+        free(ring);
+    }
+
+    return status;
+}
+
+static void StopLogWriter(OSCONFIG_LOG* whatLog)
+{
+    LOG_RING* ring = NULL;
+
+    // New records go to the file directly from now on
+    if (NULL == (ring = atomic_exchange(&whatLog->ring, NULL)))
+    {
+        return;
+    }
+
+    // Records queued by the callers still holding the ring are written by the last pass of the writer
+    WaitForLogRingUsers(whatLog);
+
+    atomic_store(&ring->stop, true);
+    sem_post(&ring->wakeUp);
+    pthread_join(ring->writer, NULL);
+
+    sem_destroy(&ring->wakeUp);
+    pthread_cond_destroy(&ring->flushed);
+    pthread_mutex_destroy(&ring->flushLock);
+    pthread_mutex_destroy(&ring->fileLock);
+    free(ring->batch);
+    free(ring->records);
+    free(ring);
+}
+
+bool IsAsyncLoggingEnabled(OSCONFIG_LOG_HANDLE log)
+{
+    return (log && (NULL != atomic_load(&((OSCONFIG_LOG*)log)->ring)));
+}
+
+// Waits, for a bounded time, until the records queued before this call are written
+void FlushLog(OSCONFIG_LOG_HANDLE log)
+{
+    OSCONFIG_LOG* whatLog = (OSCONFIG_LOG*)log;
+    LOG_RING* ring = NULL;
+    struct timespec deadline = {0};
+    size_t target = 0;
+    int waited = 0;
+
+    if ((NULL == whatLog) || (NULL == whatLog->log))
+    {
+        return;
+    }
+
+    if (NULL == (ring = AcquireLogRing(whatLog)))
+    {
+        fflush(whatLog->log);
+        return;
+    }
+
+    target = atomic_load(&ring->enqueuePosition);
+
+    pthread_mutex_lock(&ring->flushLock);
+
+    while ((atomic_load(&ring->drainedPosition) < target) && (waited < LOG_FLUSH_TIMEOUT_MILLISECONDS))
+    {
+        sem_post(&ring->wakeUp);
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LOG_FLUSH_WAIT_MILLISECONDS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        pthread_cond_timedwait(&ring->flushed, &ring->flushLock, &deadline);
+        waited += LOG_FLUSH_WAIT_MILLISECONDS;
+    }
+
+    pthread_mutex_unlock(&ring->flushLock);
+
+    ReleaseLogRing(whatLog);
+}
+
+// Writes the records still in the ring straight to the log file. Only for fatal signal handlers: takes no locks, allocates nothing
+// and uses only write(2). The writer is not restarted, the process is expected to exit right after
+void FlushLogFromSignal(OSCONFIG_LOG_HANDLE log)
+{
+    OSCONFIG_LOG* whatLog = (OSCONFIG_LOG*)log;
+    LOG_RING* ring = NULL;
+    LOG_RECORD* record = NULL;
+    struct timespec pause = {0, 1000000L};
+    size_t position = 0;
+    ssize_t written = 0;
+    int descriptor = -1;
+    int i = 0;
+
+    // The ring is not released, the process is about to exit
+    if ((NULL == whatLog) || (NULL == (ring = AcquireLogRing(whatLog))))
+    {
+        return;
+    }
+
+    // Give a writer in the middle of a batch the chance to finish it
+    for (i = 0; atomic_exchange(&ring->draining, true); i++)
+    {
+        if (i >= LOG_SIGNAL_FLUSH_ATTEMPTS)
+        {
+            return;
+        }
+        nanosleep(&pause, NULL);
+    }
+
+    if (0 > (descriptor = atomic_load(&ring->descriptor)))
+    {
+        return;
+    }
+
+    for (position = ring->dequeuePosition; ; position++)
+    {
+        record = &ring->records[position % LOG_RING_SLOTS];
+
+        if (atomic_load(&record->sequence) != (position + 1))
+        {
+            break;
+        }
+
+        written = write(descriptor, record->data, record->length);
+        (void)written;
+    }
+
+    ring->dequeuePosition = position;
+}
+
+// Holds the background writer back while records keep being queued, and dropped once the ring is full. When this returns
+// no batch is being written anymore. Resuming wakes the writer up
+void SuspendLogWriter(OSCONFIG_LOG_HANDLE log, bool suspend)
+{
+    OSCONFIG_LOG* whatLog = (OSCONFIG_LOG*)log;
+    LOG_RING* ring = NULL;
+    struct timespec pause = {0, 100000L};
+
+    if ((NULL == whatLog) || (NULL == (ring = AcquireLogRing(whatLog))))
+    {
+        return;
+    }
+
+    atomic_store(&ring->suspended, suspend);
+
+    if (suspend)
+    {
+        // Waits out a batch already being written, the next ones see the writer suspended
+        while (atomic_exchange(&ring->draining, true))
+        {
+            nanosleep(&pause, NULL);
+        }
+        atomic_store(&ring->draining, false);
+    }
+    else
+    {
+        sem_post(&ring->wakeUp);
+    }
+
+    ReleaseLogRing(whatLog);
+}
+
+unsigned long long GetDroppedLogRecords(OSCONFIG_LOG_HANDLE log)
+{
+    OSCONFIG_LOG* whatLog = (OSCONFIG_LOG*)log;
+    LOG_RING* ring = NULL;
+    unsigned long long dropped = 0;
+
+    if ((NULL != whatLog) && (NULL != (ring = AcquireLogRing(whatLog))))
+    {
+        dropped = atomic_load(&ring->dropped);
+        ReleaseLogRing(whatLog);
+    }
+
+    return dropped;
+}
+
+static void WriteLogRecordNow(OSCONFIG_LOG* whatLog, const char* fileName, int line, const char* level, const char* format, va_list arguments)
+{
+    flockfile(whatLog->log);
+    fprintf(whatLog->log, "[%s] [%s:%d]%s", GetFormattedTime(), fileName, line, level);
+    vfprintf(whatLog->log, format, arguments);
+    fputc('\n', whatLog->log);
+    fflush(whatLog->log);
+    funlockfile(whatLog->log);
+}
+
+void WriteToLog(OSCONFIG_LOG_HANDLE log, const char* fileName, int line, const char* level, const char* format, ...)
+{
+    OSCONFIG_LOG* whatLog = (OSCONFIG_LOG*)log;
+    LOG_RING* ring = NULL;
+    char record[LOG_RECORD_SIZE];
+    va_list arguments;
+    int prefixLength = 0, length = 0;
+
+    if ((NULL == whatLog) || (NULL == whatLog->log))
+    {
+        return;
+    }
+
+    if (NULL == (ring = AcquireLogRing(whatLog)))
+    {
+        TrimLog(log);
+        va_start(arguments, format);
+        WriteLogRecordNow(whatLog, fileName, line, level, format, arguments);
+        va_end(arguments);
+        return;
+    }
+
+    // The record is formatted here, queuing it is a copy into the ring
+    prefixLength = snprintf(record, sizeof(record), "[%s] [%s:%d]%s", GetFormattedTime(), fileName, line, level);
+    if ((0 <= prefixLength) && ((size_t)prefixLength < sizeof(record)))
+    {
+        va_start(arguments, format);
+        length = vsnprintf(record + prefixLength, sizeof(record) - prefixLength, format, arguments);
+        va_end(arguments);
+
+        if ((0 <= length) && ((size_t)(prefixLength + length + 1) < sizeof(record)))
+        {
+            record[prefixLength + length] = '\n';
+            PutLogRecord(ring, record, (size_t)(prefixLength + length + 1));
+            ReleaseLogRing(whatLog);
+            return;
+        }
+    }
+
+    // Records that do not fit in a slot are rare, they are written directly after the ones queued before them
+    FlushLog(log);
+    pthread_mutex_lock(&ring->fileLock);
+    if (NULL != whatLog->log)
+    {
+        va_start(arguments, format);
+        WriteLogRecordNow(whatLog, fileName, line, level, format, arguments);
+        va_end(arguments);
+    }
+    pthread_mutex_unlock(&ring->fileLock);
+    ReleaseLogRing(whatLog);
+}
+
+void SetLogRateLimit(unsigned int burst, unsigned int recordsPerMinute)
+{
+    g_logSiteBurst = burst;
+    g_logSiteRecordsPerMinute = recordsPerMinute;
+}
+
+unsigned long long GetSuppressedLogRecords(void)
+{
+    return atomic_load(&g_suppressedLogRecords);
+}
+
+// Token bucket per call site. The credit is kept in records times milliseconds per minute so that refills are exact integers
+bool IsLogSiteAllowed(OSCONFIG_LOG_HANDLE log, OSCONFIG_LOG_SITE* site, const char* fileName, int line, const char* level)
+{
+    const long long recordCost = 60 * 1000;
+    struct timespec now = {0};
+    long long milliseconds = 0, fullCredit = 0;
+    unsigned int burst = g_logSiteBurst;
+    unsigned int suppressed = 0;
+    bool allowed = true;
+
+    if ((0 == burst) || (NULL == site) || g_fullLoggingEnabled)
+    {
+        return true;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    milliseconds = ((long long)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+    fullCredit = (long long)burst * recordCost;
+
+    while (__atomic_test_and_set(&site->lock, __ATOMIC_ACQUIRE));
+
+    if (0 == site->refilled)
+    {
+        site->credit = fullCredit;
+    }
+    else if ((site->credit += (milliseconds - site->refilled) * g_logSiteRecordsPerMinute) > fullCredit)
+    {
+        site->credit = fullCredit;
+    }
+    site->refilled = milliseconds;
+
+    if (site->credit >= recordCost)
+    {
+        site->credit -= recordCost;
+        suppressed = site->suppressed;
+        site->suppressed = 0;
+    }
+    else
+    {
+        site->suppressed += 1;
+        allowed = false;
+    }
+
+    __atomic_clear(&site->lock, __ATOMIC_RELEASE);
+
+    if (false == allowed)
+    {
+        atomic_fetch_add(&g_suppressedLogRecords, 1);
+    }
+    else if (suppressed > 0)
+    {
+        // Goes ahead of the record that the site is allowed to log again
+        WriteToLog(log, fileName, line, level, "Suppressed %u similar messages", suppressed);
+        printf("[%s] [%s:%d]%sSuppressed %u similar messages\n", GetFormattedTime(), fileName, line, level, suppressed);
+    }
+
+    return allowed;
 }
 
 bool IsDaemon()
 {
     return (1 == getppid());
-}
\ No newline at end of file
+}
@@ -11,6 +11,24 @@
 
 #define TIME_FORMAT_STRING_LENGTH 20
 
+// Maximum number of rolled over logs kept, the backup log included
+#define MAX_LOG_GENERATIONS 32
+
+// Default per call site limit for OsConfigLogInfo and OsConfigLogError: a burst of up to LOG_SITE_BURST records,
+// then LOG_SITE_RECORDS_PER_MINUTE, with the records over the limit counted and summarized when the site logs again
+#define LOG_SITE_BURST 50
+#define LOG_SITE_RECORDS_PER_MINUTE 30
+
+typedef struct OSCONFIG_LOG_SITE
+{
+    long long credit;
+    long long refilled;
+    unsigned int suppressed;
+    char lock;
+} OSCONFIG_LOG_SITE;
+
+#define OSCONFIG_LOG_SITE_INITIALIZER {0, 0, 0, 0}
+
 #ifndef ARRAY_SIZE
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
 #endif
@@ -33,12 +51,29 @@ char* GetFormattedTime();
 void TrimLog(OSCONFIG_LOG_HANDLE log);
 bool IsDaemon(void);
 
+// Keeps up to the specified number of rolled over logs (1, the default, keeps only the backup log) within
+// the specified total of bytes (0 for no limit other than the number). Older generations are compressed when possible
+void SetLogRotation(OSCONFIG_LOG_HANDLE log, unsigned int generations, long long retentionBytes);
+
+// A burst of 0 turns the per call site limit off. The limit does not apply while full logging is enabled
+void SetLogRateLimit(unsigned int burst, unsigned int recordsPerMinute);
+bool IsLogSiteAllowed(OSCONFIG_LOG_HANDLE log, OSCONFIG_LOG_SITE* site, const char* fileName, int line, const char* level);
+unsigned long long GetSuppressedLogRecords(void);
+
+void WriteToLog(OSCONFIG_LOG_HANDLE log, const char* fileName, int line, const char* level, const char* format, ...) __attribute__((format(printf, 5, 6)));
+
+// Optional asynchronous logging: records are queued to a bounded ring and written by a background thread,
+// when the ring is full records are dropped and counted. CloseLog writes everything queued before closing
+int EnableAsyncLogging(OSCONFIG_LOG_HANDLE log);
+bool IsAsyncLoggingEnabled(OSCONFIG_LOG_HANDLE log);
+void FlushLog(OSCONFIG_LOG_HANDLE log);
+void FlushLogFromSignal(OSCONFIG_LOG_HANDLE log);
+void SuspendLogWriter(OSCONFIG_LOG_HANDLE log, bool suspend);
+unsigned long long GetDroppedLogRecords(OSCONFIG_LOG_HANDLE log);
+
 #define __SHORT_FILE__ (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
 #define __LOG__(log, format, loglevel, ...) printf("[%s] [%s:%d]%s" format "\n", GetFormattedTime(), __SHORT_FILE__, __LINE__, loglevel, ## __VA_ARGS__)
-#define __LOG_TO_FILE__(log, format, loglevel, ...) {\
-    TrimLog(log);\
-    fprintf(GetLogFile(log), "[%s] [%s:%d]%s" format "\n", GetFormattedTime(), __SHORT_FILE__, __LINE__, loglevel, ## __VA_ARGS__);\
-}\
+#define __LOG_TO_FILE__(log, format, loglevel, ...) WriteToLog(log, __SHORT_FILE__, __LINE__, loglevel, format, ## __VA_ARGS__)
 
 #define __INFO__ " "
 #define __ERROR__ " [ERROR] "
@@ -49,22 +84,26 @@ bool IsDaemon(void);
 #define OSCONFIG_FILE_LOG_ERROR(log, format, ...) __LOG_TO_FILE__(log, format, __ERROR__, ## __VA_ARGS__)
 
 #define OsConfigLogInfo(log, FORMAT, ...) {\
-    if (NULL != GetLogFile(log)) {\
-        OSCONFIG_FILE_LOG_INFO(log, FORMAT, ##__VA_ARGS__);\
-        fflush(GetLogFile(log));\
-    }\
-    if ((false == IsDaemon()) || (false == IsFullLoggingEnabled())) {\
-        OSCONFIG_LOG_INFO(log, FORMAT, ##__VA_ARGS__);\
+    static OSCONFIG_LOG_SITE _logSite = OSCONFIG_LOG_SITE_INITIALIZER;\
+    if (IsLogSiteAllowed(log, &_logSite, __SHORT_FILE__, __LINE__, __INFO__)) {\
+        if (NULL != GetLogFile(log)) {\
+            OSCONFIG_FILE_LOG_INFO(log, FORMAT, ##__VA_ARGS__);\
+        }\
+        if ((false == IsDaemon()) || (false == IsFullLoggingEnabled())) {\
+            OSCONFIG_LOG_INFO(log, FORMAT, ##__VA_ARGS__);\
+        }\
     }\
 }\
 
 #define OsConfigLogError(log, FORMAT, ...) {\
-    if (NULL != GetLogFile(log)) {\
-        OSCONFIG_FILE_LOG_ERROR(log, FORMAT, ##__VA_ARGS__);\
-        fflush(GetLogFile(log));\
-    }\
-    if ((false == IsDaemon()) || (false == IsFullLoggingEnabled())) {\
-        OSCONFIG_LOG_ERROR(log, FORMAT, ##__VA_ARGS__);\
+    static OSCONFIG_LOG_SITE _logSite = OSCONFIG_LOG_SITE_INITIALIZER;\
+    if (IsLogSiteAllowed(log, &_logSite, __SHORT_FILE__, __LINE__, __ERROR__)) {\
+        if (NULL != GetLogFile(log)) {\
+            OSCONFIG_FILE_LOG_ERROR(log, FORMAT, ##__VA_ARGS__);\
+        }\
+        if ((false == IsDaemon()) || (false == IsFullLoggingEnabled())) {\
+            OSCONFIG_LOG_ERROR(log, FORMAT, ##__VA_ARGS__);\
+        }\
     }\
 }\
 
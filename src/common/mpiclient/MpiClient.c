@@ -12,15 +12,37 @@
 #include <CommonUtils.h>
 #include <Logging.h>
 #include <Mpi.h>
+#include <MpiServer.h>
 
 #include "MpiClient.h"
 
 #define MPI_MAX_CONTENT_LENGTH 64
 
-#define HTTP_INTERNAL_SERVER_ERROR 500
-
 extern MPI_HANDLE g_mpiHandle;
 
+// When the platform runs in-process (colocated) the MPI calls are dispatched directly instead of over the socket
+static MPI_CALLS g_inProcessCalls = {0};
+static bool g_inProcess = false;
+
+void SetMpiClientInProcessCalls(const struct MPI_CALLS* calls)
+{
+    if (NULL != calls)
+    {
+        g_inProcessCalls = *calls;
+        g_inProcess = true;
+    }
+    else
+    {
+        memset(&g_inProcessCalls, 0, sizeof(g_inProcessCalls));
+        g_inProcess = false;
+    }
+}
+
+bool IsMpiClientInProcess(void)
+{
+    return g_inProcess;
+}
+
 static int CallMpi(const char* name, const char* request, char** response, int* responseSize, void* log)
 {
     const char* mpiSocket = "/run/osconfig/mpid.sock";
@@ -214,6 +236,13 @@ MPI_HANDLE CallMpiOpen(const char* clientName, const unsigned int maxPayloadSize
         return NULL;
     }
 
+    if (g_inProcess)
+    {
+        mpiHandle = g_inProcessCalls.mpiOpen(clientName, maxPayloadSizeBytes);
+        OsConfigLogInfo(log, "CallMpiOpen(%s, %u): %p ('%s'), in-process", clientName, maxPayloadSizeBytes, mpiHandle, mpiHandle ? (char*)mpiHandle : "");
+        return mpiHandle;
+    }
+
     snprintf(maxPayloadSizeBytesString, sizeof(maxPayloadSizeBytesString), "%d", maxPayloadSizeBytes);
     requestSize = strlen(requestBodyFormat) + strlen(clientName) + strlen(maxPayloadSizeBytesString) + 1;
 
@@ -262,6 +291,13 @@ void CallMpiClose(MPI_HANDLE clientSession, void* log)
         return;
     }
 
+    if (g_inProcess)
+    {
+        g_inProcessCalls.mpiClose(clientSession);
+        OsConfigLogInfo(log, "CallMpiClose(%p), in-process", clientSession);
+        return;
+    }
+
     requestSize = strlen(requestBodyFormat) + strlen((char*)clientSession) + 1;
 
     request = (char*)malloc(requestSize);
@@ -307,6 +343,13 @@ int CallMpiSet(const char* componentName, const char* propertyName, const MPI_JS
         return status;
     }
 
+    if (g_inProcess)
+    {
+        status = g_inProcessCalls.mpiSet(g_mpiHandle, componentName, propertyName, payload, payloadSizeBytes);
+        OsConfigLogInfo(log, "CallMpiSet(%p, %s, %s, %d bytes) in-process returned %d", g_mpiHandle, componentName, propertyName, payloadSizeBytes, status);
+        return status;
+    }
+
     requestSize = strlen(requestBodyFormat) + strlen((char*)g_mpiHandle) + strlen(componentName) + strlen(propertyName) + payloadSizeBytes + 1;
 
     request = (char*)malloc(requestSize);
@@ -369,6 +412,16 @@ int CallMpiGet(const char* componentName, const char* propertyName, MPI_JSON_STR
     *payload = NULL;
     *payloadSizeBytes = 0;
 
+    if (g_inProcess)
+    {
+        status = g_inProcessCalls.mpiGet(g_mpiHandle, componentName, propertyName, payload, payloadSizeBytes);
+        if (IsFullLoggingEnabled())
+        {
+            OsConfigLogInfo(log, "CallMpiGet(%p, %s, %s, %.*s, %d bytes) in-process: %d", g_mpiHandle, componentName, propertyName, *payloadSizeBytes, *payload, *payloadSizeBytes, status);
+        }
+        return status;
+    }
+
     requestSize = strlen(requestBodyFormat) + strlen((char*)g_mpiHandle) + strlen(componentName) + strlen(propertyName) + 1;
 
     request = (char*)malloc(requestSize);
@@ -445,6 +498,13 @@ int CallMpiSetDesired(const MPI_JSON_STRING payload, const int payloadSizeBytes,
         return status;
     }
 
+    if (g_inProcess)
+    {
+        status = g_inProcessCalls.mpiSetDesired(g_mpiHandle, payload, payloadSizeBytes);
+        OsConfigLogInfo(log, "CallMpiSetDesired(%p, %d bytes) in-process returned %d", g_mpiHandle, payloadSizeBytes, status);
+        return status;
+    }
+
     requestSize = strlen(requestBodyFormat) + strlen((char*)g_mpiHandle) + payloadSizeBytes + 1;
 
     request = (char*)malloc(requestSize);
@@ -507,6 +567,16 @@ int CallMpiGetReported(MPI_JSON_STRING* payload, int* payloadSizeBytes, void* lo
     *payload = NULL;
     *payloadSizeBytes = 0;
 
+    if (g_inProcess)
+    {
+        status = g_inProcessCalls.mpiGetReported(g_mpiHandle, payload, payloadSizeBytes);
+        if (IsFullLoggingEnabled())
+        {
+            OsConfigLogInfo(log, "CallMpiGetReported(%p, %.*s, %d bytes) in-process: %d", g_mpiHandle, *payloadSizeBytes, *payload, *payloadSizeBytes, status);
+        }
+        return status;
+    }
+
     requestSize = strlen(requestBodyFormat) + strlen((char*)g_mpiHandle) + 1;
 
     request = (char*)malloc(requestSize);
@@ -9,6 +9,12 @@ extern "C"
 {
 #endif
 
+struct MPI_CALLS;
+
+// Dispatches the MPI calls directly to a platform running in-process instead of over the MPI socket, NULL reverts to the socket
+void SetMpiClientInProcessCalls(const struct MPI_CALLS* calls);
+bool IsMpiClientInProcess(void);
+
 MPI_HANDLE CallMpiOpen(const char* clientName, const unsigned int maxPayloadSizeBytes, void* log);
 void CallMpiClose(MPI_HANDLE clientSession, void* log);
 int CallMpiSet(const char* componentName, const char* propertyName, const MPI_JSON_STRING payload, const int payloadSizeBytes, void* log);
@@ -8,13 +8,22 @@
 #include <list>
 #include <time.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 #include <fcntl.h>
 #include <gtest/gtest.h>
+#include <Logging.h>
 #include <CommonUtils.h>
 #include <UserUtils.h>
 #include <SshUtils.h>
 #include <Asb.h>
 
+// For CountAccountKeys
+extern "C"
+{
+#include <Internal.h>
+}
+
 using namespace std;
 
 class CommonUtilsTest : public ::testing::Test
@@ -132,6 +141,129 @@ TEST_F(CommonUtilsTest, LoadStringFromBigLengthFile)
     EXPECT_TRUE(Cleanup(m_path));
 }
 
+TEST_F(CommonUtilsTest, LoadStringFromProcFile)
+{
+    char* contents = nullptr;
+
+    // Files in /proc report no size
+    EXPECT_NE(nullptr, contents = LoadStringFromFile("/proc/self/status", false, nullptr));
+    EXPECT_NE(nullptr, strstr(contents, "Name:"));
+    EXPECT_NE(nullptr, strstr(contents, "Pid:"));
+    FREE_MEMORY(contents);
+
+    EXPECT_NE(nullptr, contents = LoadStringFromFile("/proc/self/status", true, nullptr));
+    EXPECT_EQ(0, strncmp(contents, "Name:", strlen("Name:")));
+    EXPECT_EQ(nullptr, strchr(contents, '\n'));
+    FREE_MEMORY(contents);
+}
+
+TEST_F(CommonUtilsTest, OpenFileSpan)
+{
+    const size_t size = 1024 * 1024;
+    FILE_SPAN span = {nullptr, 0, false, -1};
+    char* contents = nullptr;
+
+    EXPECT_EQ(EINVAL, OpenFileSpan(nullptr, &span, nullptr));
+    EXPECT_EQ(EINVAL, OpenFileSpan(m_path, nullptr, nullptr));
+    EXPECT_NE(0, OpenFileSpan("/tmp/~does_not_exist.test", &span, nullptr));
+
+    // Small files are read
+    EXPECT_TRUE(CreateTestFile(m_path, m_data));
+    EXPECT_EQ(0, OpenFileSpan(m_path, &span, nullptr));
+    EXPECT_FALSE(span.mapped);
+    EXPECT_EQ(strlen(m_data), span.size);
+    EXPECT_EQ(0, memcmp(m_data, span.data, span.size));
+    CloseFileSpan(&span);
+    EXPECT_EQ(nullptr, span.data);
+
+    // Large files are mapped
+    EXPECT_NE(nullptr, contents = (char*)malloc(size + 1));
+    memset(contents, 'a', size);
+    memcpy(contents + size - strlen("needle"), "needle", strlen("needle"));
+    contents[size] = 0;
+    EXPECT_TRUE(SavePayloadToFile(m_path, contents, size, nullptr));
+    EXPECT_EQ(0, OpenFileSpan(m_path, &span, nullptr));
+    EXPECT_TRUE(span.mapped);
+    EXPECT_EQ(size, span.size);
+    EXPECT_EQ(0, memcmp(contents, span.data, span.size));
+
+    // While mapped the file stays locked for writers that lock it
+    EXPECT_FALSE(SavePayloadToFile(m_path, "short", strlen("short"), nullptr));
+    EXPECT_EQ(0, memcmp(contents, span.data, span.size));
+    CloseFileSpan(&span);
+    EXPECT_EQ(-1, span.descriptor);
+
+    EXPECT_EQ(0, FindTextInFile(m_path, "needle", nullptr));
+    EXPECT_EQ(ENOENT, FindTextInFile(m_path, "haystack", nullptr));
+
+    // The search ends at the first null character, as it did when the file was read as a string
+    contents[size / 2] = 0;
+    EXPECT_TRUE(SavePayloadToFile(m_path, contents, size, nullptr));
+    EXPECT_EQ(ENOENT, FindTextInFile(m_path, "needle", nullptr));
+
+    FREE_MEMORY(contents);
+    EXPECT_TRUE(Cleanup(m_path));
+}
+
+TEST_F(CommonUtilsTest, LoadCachedStringFromFile)
+{
+    const char* old = "touch -d '1 hour ago' /tmp/~test.test";
+    char* contents = nullptr;
+    unsigned long long hits = 0;
+    unsigned long long misses = 0;
+    unsigned long long previousHits = 0;
+    unsigned long long previousMisses = 0;
+
+    EXPECT_EQ(nullptr, LoadCachedStringFromFile(nullptr, nullptr));
+    EXPECT_EQ(nullptr, LoadCachedStringFromFile("/tmp/~does_not_exist.test", nullptr));
+
+    InvalidateFileCache(nullptr);
+    GetFileCacheStatistics(&previousHits, &previousMisses);
+
+    // A file modified just now is read each time
+    EXPECT_TRUE(CreateTestFile(m_path, m_data));
+    EXPECT_STREQ(m_data, contents = LoadCachedStringFromFile(m_path, nullptr));
+    FREE_MEMORY(contents);
+    EXPECT_STREQ(m_data, contents = LoadCachedStringFromFile(m_path, nullptr));
+    FREE_MEMORY(contents);
+    GetFileCacheStatistics(&hits, &misses);
+    EXPECT_EQ(previousHits, hits);
+    EXPECT_EQ(previousMisses + 2, misses);
+
+    // Once settled it is read once
+    EXPECT_EQ(0, ExecuteCommand(nullptr, old, false, false, 0, 0, nullptr, nullptr, nullptr));
+    EXPECT_STREQ(m_data, contents = LoadCachedStringFromFile(m_path, nullptr));
+    FREE_MEMORY(contents);
+    EXPECT_STREQ(m_data, contents = LoadCachedStringFromFile(m_path, nullptr));
+    FREE_MEMORY(contents);
+    EXPECT_EQ(0, CheckSmallFileContainsText(m_path, m_data, nullptr, nullptr));
+    GetFileCacheStatistics(&hits, &misses);
+    EXPECT_EQ(previousHits + 2, hits);
+    EXPECT_EQ(previousMisses + 3, misses);
+
+    // Changed files are read again, whether changed by OSConfig or not
+    EXPECT_TRUE(CreateTestFile(m_path, m_dataWithEol));
+    EXPECT_EQ(0, ExecuteCommand(nullptr, old, false, false, 0, 0, nullptr, nullptr, nullptr));
+    EXPECT_STREQ(m_dataWithEol, contents = LoadCachedStringFromFile(m_path, nullptr));
+    FREE_MEMORY(contents);
+    EXPECT_TRUE(SavePayloadToFile(m_path, m_dataLowercase, strlen(m_dataLowercase), nullptr));
+    EXPECT_EQ(0, ExecuteCommand(nullptr, old, false, false, 0, 0, nullptr, nullptr, nullptr));
+    EXPECT_STREQ(m_dataLowercase, contents = LoadCachedStringFromFile(m_path, nullptr));
+    FREE_MEMORY(contents);
+    GetFileCacheStatistics(&hits, &misses);
+    EXPECT_EQ(previousHits + 2, hits);
+    EXPECT_EQ(previousMisses + 5, misses);
+
+    InvalidateFileCache(m_path);
+    EXPECT_STREQ(m_dataLowercase, contents = LoadCachedStringFromFile(m_path, nullptr));
+    FREE_MEMORY(contents);
+    GetFileCacheStatistics(&hits, &misses);
+    EXPECT_EQ(previousMisses + 6, misses);
+
+    InvalidateFileCache(nullptr);
+    EXPECT_TRUE(Cleanup(m_path));
+}
+
 TEST_F(CommonUtilsTest, SavePayloadToFile)
 {
     char* contents = NULL;
@@ -369,8 +501,8 @@ TEST_F(CommonUtilsTest, ExecuteMultipleCommandsAsOneCommandWithTextResult)
         { "echo alpha123 && echo beta123", true, true, 0, 0, "beta123 ", "alpha123 " },
         { "((echo alpha1234)&&(echo beta1234))", true, true, 0, 0, "beta1234 ", "alpha1234 " },
         { "((echo alpha12345) && echo beta12345)", true, true, 0, 0, "beta12345 ", "alpha12345 " },
-        { "echo alpha123456 > null; echo beta123456", true, true, 0, 0, "beta123456 ", nullptr },
-        { "echo alpha1234567 > null && echo beta1234567", true, true, 0, 0, "beta1234567 ", nullptr }
+        { "echo alpha123456 > /tmp/~null; echo beta123456", true, true, 0, 0, "beta123456 ", nullptr },
+        { "echo alpha1234567 > /tmp/~null && echo beta1234567", true, true, 0, 0, "beta1234567 ", nullptr }
     };
 
     int optionsSize = ARRAY_SIZE(options);
@@ -393,6 +525,8 @@ TEST_F(CommonUtilsTest, ExecuteMultipleCommandsAsOneCommandWithTextResult)
 
         FREE_MEMORY(textResult);
     }
+
+    EXPECT_TRUE(Cleanup("/tmp/~null"));
 }
 
 TEST_F(CommonUtilsTest, ExecuteCommandWithSpecialCharactersInTextResult)
@@ -425,6 +559,29 @@ TEST_F(CommonUtilsTest, ExecuteCommandWithSpecialCharactersInTextResult)
     FREE_MEMORY(textResult);
 }
 
+TEST_F(CommonUtilsTest, ExecuteCommandWithLargeOrBackgroundOutput)
+{
+    char* textResult = nullptr;
+    time_t start = 0;
+
+    // Output larger than the pipe buffer is drained even when truncated
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "head -c 300000 /dev/zero | tr '\\0' 'a'", false, false, 11, 10, &textResult, nullptr, nullptr));
+    EXPECT_STREQ("aaaaaaaaaa", textResult);
+    FREE_MEMORY(textResult);
+
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "head -c 300000 /dev/zero | tr '\\0' 'a'", false, false, 0, 0, &textResult, nullptr, nullptr));
+    EXPECT_NE(nullptr, textResult);
+    EXPECT_EQ(300000, strlen(textResult));
+    FREE_MEMORY(textResult);
+
+    // A process left running in background by the command does not hold the command
+    start = time(nullptr);
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "sleep 5 & echo done", false, false, 0, 0, &textResult, nullptr, nullptr));
+    EXPECT_STREQ("done\n", textResult);
+    EXPECT_GT(4, time(nullptr) - start);
+    FREE_MEMORY(textResult);
+}
+
 TEST_F(CommonUtilsTest, ExecuteCommandWithoutTextResult)
 {
     EXPECT_EQ(0, ExecuteCommand(nullptr, "echo test456", false, true, 0, 0, nullptr, nullptr, nullptr));
@@ -434,8 +591,9 @@ TEST_F(CommonUtilsTest, ExecuteCommandWithoutTextResult)
 TEST_F(CommonUtilsTest, ExecuteCommandWithRedirectorCharacter)
 {
     char* textResult = nullptr;
-    EXPECT_EQ(0, ExecuteCommand(nullptr, "echo test789 > testResultFile", false, true, 0, 0, &textResult, nullptr, nullptr));
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "echo test789 > /tmp/~testResultFile", false, true, 0, 0, &textResult, nullptr, nullptr));
     EXPECT_EQ(nullptr, textResult);
+    EXPECT_TRUE(Cleanup("/tmp/~testResultFile"));
 }
 
 TEST_F(CommonUtilsTest, ExecuteCommandWithNullArgument)
@@ -546,6 +704,8 @@ TEST_F(CommonUtilsTest, CancelCommand)
 {
     char* textResult = nullptr;
 
+    ::numberOfTimes = 0;
+
     EXPECT_EQ(ECANCELED, ExecuteCommand(nullptr, "sleep 20", false, true, 0, 120, &textResult, &(CallbackContext::TestCommandCallback), nullptr));
 
     FREE_MEMORY(textResult);
@@ -582,11 +742,183 @@ TEST_F(CommonUtilsTest, CancelCommandWithContext)
 
     char* textResult = nullptr;
 
+    ::numberOfTimes = 0;
+
     EXPECT_EQ(ECANCELED, ExecuteCommand((void*)(&context), "sleep 30", false, true, 0, 120, &textResult, &(CallbackContext::TestCommandCallback), nullptr));
 
     FREE_MEMORY(textResult);
 }
 
+TEST_F(CommonUtilsTest, ExecuteCommandWithCommandHelper)
+{
+    char* textResult = nullptr;
+
+    EXPECT_FALSE(IsCommandHelperActive());
+    SetCommandHelperPath("/tmp/~does_not_exist");
+    EXPECT_NE(0, StartCommandHelper(nullptr));
+    EXPECT_FALSE(IsCommandHelperActive());
+    SetCommandHelperPath(COMMAND_HELPER_TEST_PATH);
+    EXPECT_EQ(0, StartCommandHelper(nullptr));
+    EXPECT_TRUE(IsCommandHelperActive());
+
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "echo 'abc\"123' && echo error >&2", true, true, 0, 0, &textResult, nullptr, nullptr));
+    EXPECT_STREQ("abc 123 error ", textResult);
+    FREE_MEMORY(textResult);
+
+    EXPECT_EQ(3, ExecuteCommand(nullptr, "exit 3", false, false, 0, 0, &textResult, nullptr, nullptr));
+    EXPECT_EQ(nullptr, textResult);
+
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "head -c 300000 /dev/zero | tr '\\0' 'a'", false, false, 11, 0, &textResult, nullptr, nullptr));
+    EXPECT_STREQ("aaaaaaaaaa", textResult);
+    FREE_MEMORY(textResult);
+
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "head -c 300000 /dev/zero | tr '\\0' 'a'", false, false, 0, 0, &textResult, nullptr, nullptr));
+    EXPECT_NE(nullptr, textResult);
+    EXPECT_EQ(300000, strlen(textResult));
+    FREE_MEMORY(textResult);
+
+    // The whole output is forwarded to be hashed, past any text result limit
+    EXPECT_NE(nullptr, textResult = HashCommand("head -c 300000 /dev/zero | tr '\\0' 'a'", nullptr));
+    EXPECT_STREQ("12e1b9b179b29a4f7e5889b185d7ac71bff0ad1f49a7b391d0911b737a0f5381", textResult);
+    FREE_MEMORY(textResult);
+
+    EXPECT_EQ(ETIME, ExecuteCommand(nullptr, "sleep 10", false, false, 0, 1, &textResult, nullptr, nullptr));
+    FREE_MEMORY(textResult);
+
+    ::numberOfTimes = 0;
+    EXPECT_EQ(ECANCELED, ExecuteCommand(nullptr, "sleep 20", false, true, 0, 120, &textResult, &(CallbackContext::TestCommandCallback), nullptr));
+    FREE_MEMORY(textResult);
+
+    // The helper is restarted when it goes away
+    EXPECT_EQ(EPIPE, ExecuteCommand(nullptr, "kill -9 $PPID", false, false, 0, 0, &textResult, nullptr, nullptr));
+    FREE_MEMORY(textResult);
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "echo test123", false, false, 0, 0, &textResult, nullptr, nullptr));
+    EXPECT_STREQ("test123\n", textResult);
+    FREE_MEMORY(textResult);
+
+    StopCommandHelper(nullptr);
+    EXPECT_FALSE(IsCommandHelperActive());
+    SetCommandHelperPath(nullptr);
+}
+
+TEST_F(CommonUtilsTest, ExecuteCachedCommand)
+{
+    const char* command = "echo $$";
+    char* first = nullptr;
+    char* second = nullptr;
+    unsigned long long hits = 0;
+    unsigned long long misses = 0;
+    unsigned long long previousHits = 0;
+    unsigned long long previousMisses = 0;
+
+    InvalidateCommandCache();
+    GetCommandCacheStatistics(&previousHits, &previousMisses);
+
+    // Each run of the command prints a different process id, a cached result repeats it
+    EXPECT_EQ(0, ExecuteCachedCommand(nullptr, command, false, false, 0, 0, 60, &first, nullptr));
+    EXPECT_EQ(0, ExecuteCachedCommand(nullptr, command, false, false, 0, 0, 60, &second, nullptr));
+    EXPECT_NE(nullptr, first);
+    EXPECT_STREQ(first, second);
+    FREE_MEMORY(second);
+
+    GetCommandCacheStatistics(&hits, &misses);
+    EXPECT_EQ(previousHits + 1, hits);
+    EXPECT_EQ(previousMisses + 1, misses);
+
+    // Different flags or cache key do not share the cached result
+    EXPECT_EQ(0, ExecuteCachedCommand(nullptr, command, true, false, 0, 0, 60, &second, nullptr));
+    EXPECT_STRNE(first, second);
+    FREE_MEMORY(second);
+    EXPECT_EQ(0, ExecuteCachedCommand("other", command, false, false, 0, 0, 60, &second, nullptr));
+    EXPECT_STRNE(first, second);
+    FREE_MEMORY(second);
+
+    // Failures are cached too
+    EXPECT_EQ(127, ExecuteCachedCommand(nullptr, "~does_not_exist", false, false, 0, 0, 60, &second, nullptr));
+    FREE_MEMORY(second);
+    EXPECT_EQ(127, ExecuteCachedCommand(nullptr, "~does_not_exist", false, false, 0, 0, 60, nullptr, nullptr));
+
+    GetCommandCacheStatistics(&hits, &misses);
+    EXPECT_EQ(previousHits + 2, hits);
+    EXPECT_EQ(previousMisses + 4, misses);
+
+    // Invalidation and expiration run the command again
+    InvalidateCommandCache();
+    EXPECT_EQ(0, ExecuteCachedCommand(nullptr, command, false, false, 0, 0, 1, &second, nullptr));
+    EXPECT_STRNE(first, second);
+    FREE_MEMORY(first);
+    sleep(2);
+    EXPECT_EQ(0, ExecuteCachedCommand(nullptr, command, false, false, 0, 0, 1, &first, nullptr));
+    EXPECT_STRNE(first, second);
+    FREE_MEMORY(first);
+    FREE_MEMORY(second);
+
+    // Without a time to live nothing is kept
+    InvalidateCommandCache();
+    EXPECT_EQ(0, ExecuteCachedCommand(nullptr, command, false, false, 0, 0, 0, &first, nullptr));
+    EXPECT_EQ(0, ExecuteCachedCommand(nullptr, command, false, false, 0, 0, 0, &second, nullptr));
+    EXPECT_STRNE(first, second);
+    FREE_MEMORY(first);
+    FREE_MEMORY(second);
+
+    // Callers of the same command with different flags keep an entry each instead of evicting each other
+    InvalidateCommandCache();
+    GetCommandCacheStatistics(&previousHits, &previousMisses);
+    EXPECT_EQ(0, ExecuteCachedCommand(nullptr, command, true, false, 0, 0, COMMAND_CACHE_SECONDS, &first, nullptr));
+    EXPECT_EQ(0, ExecuteCachedCommand(nullptr, command, false, false, 0, 0, COMMAND_CACHE_SECONDS, &second, nullptr));
+    FREE_MEMORY(first);
+    FREE_MEMORY(second);
+    EXPECT_EQ(0, ExecuteCachedCommand(nullptr, command, true, false, 0, 0, COMMAND_CACHE_SECONDS, &first, nullptr));
+    EXPECT_EQ(0, ExecuteCachedCommand(nullptr, command, false, false, 0, 0, COMMAND_CACHE_SECONDS, &second, nullptr));
+    FREE_MEMORY(first);
+    FREE_MEMORY(second);
+    GetCommandCacheStatistics(&hits, &misses);
+    EXPECT_EQ(previousHits + 2, hits);
+    EXPECT_EQ(previousMisses + 2, misses);
+
+    InvalidateCommandCache();
+}
+
+TEST_F(CommonUtilsTest, ExecuteCommandBatch)
+{
+    const char* commands[] = { "sleep 2; echo one", "sleep 2; echo two", "sleep 2; exit 3", "sleep 2; echo four", "sleep 10", "~does_not_exist" };
+    int statuses[ARRAY_SIZE(commands)] = {0};
+    char* textResults[ARRAY_SIZE(commands)] = {0};
+    time_t start = 0;
+
+    EXPECT_EQ(EINVAL, ExecuteCommandBatch(nullptr, 1, false, false, 0, 0, 0, statuses, textResults, nullptr));
+    EXPECT_EQ(EINVAL, ExecuteCommandBatch(commands, 0, false, false, 0, 0, 0, statuses, textResults, nullptr));
+    EXPECT_EQ(EINVAL, ExecuteCommandBatch(commands, ARRAY_SIZE(commands), false, false, 0, 0, 0, nullptr, textResults, nullptr));
+
+    // The commands run together, the whole batch takes about as long as the slowest one, bounded by the timeout
+    start = time(nullptr);
+    EXPECT_EQ(0, ExecuteCommandBatch(commands, ARRAY_SIZE(commands), false, false, 0, 4, 0, statuses, textResults, nullptr));
+    EXPECT_GT(8, time(nullptr) - start);
+
+    EXPECT_EQ(0, statuses[0]);
+    EXPECT_STREQ("one\n", textResults[0]);
+    EXPECT_EQ(0, statuses[1]);
+    EXPECT_STREQ("two\n", textResults[1]);
+    EXPECT_EQ(3, statuses[2]);
+    EXPECT_EQ(nullptr, textResults[2]);
+    EXPECT_EQ(0, statuses[3]);
+    EXPECT_STREQ("four\n", textResults[3]);
+    EXPECT_EQ(ETIME, statuses[4]);
+    EXPECT_EQ(127, statuses[5]);
+
+    for (unsigned int i = 0; i < ARRAY_SIZE(commands); i++)
+    {
+        FREE_MEMORY(textResults[i]);
+    }
+
+    // With a parallelism limit of 2 the four sleeping commands take two rounds
+    start = time(nullptr);
+    EXPECT_EQ(0, ExecuteCommandBatch(commands, 4, false, false, 0, 0, 2, statuses, nullptr, nullptr));
+    EXPECT_LE(4, time(nullptr) - start);
+    EXPECT_EQ(0, statuses[0]);
+    EXPECT_EQ(3, statuses[2]);
+}
+
 TEST_F(CommonUtilsTest, ExecuteCommandWithTextResultWithAllCharacters)
 {
     char* textResult = nullptr;
@@ -1206,6 +1538,120 @@ TEST_F(CommonUtilsTest, HashCommand)
     FREE_MEMORY(hashThree);
 }
 
+TEST_F(CommonUtilsTest, HashCommandSpawnFailure)
+{
+    struct rlimit original = {};
+    struct rlimit limited = {};
+    std::list<int> descriptors;
+    char* hash = nullptr;
+    int descriptor = -1;
+
+    ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &original));
+    limited = original;
+    limited.rlim_cur = 64;
+    ASSERT_EQ(0, setrlimit(RLIMIT_NOFILE, &limited));
+
+    // With no descriptor left the output pipe cannot be created and the command is never spawned
+    while (0 <= (descriptor = dup(STDIN_FILENO)))
+    {
+        descriptors.push_back(descriptor);
+    }
+
+    EXPECT_EQ(EMFILE, ExecuteCommand(nullptr, "echo test", false, false, 0, 0, nullptr, nullptr, nullptr));
+    EXPECT_EQ(nullptr, hash = HashCommand("echo test", nullptr));
+    FREE_MEMORY(hash);
+
+    for (int next : descriptors)
+    {
+        close(next);
+    }
+    EXPECT_EQ(0, setrlimit(RLIMIT_NOFILE, &original));
+
+    // A command that runs and fails still gets its output hashed
+    EXPECT_STREQ("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", hash = HashCommand("exit 3", nullptr));
+    FREE_MEMORY(hash);
+}
+
+TEST_F(CommonUtilsTest, HashCommandMatchesSha256sum)
+{
+    const char* commands[] = {
+        "echo \"This is a test 1234567890\"",
+        "printf ''",
+        "printf 'abc'",
+        "seq 1 200000",
+        "printf '%063d' 0",
+        "printf '%064d' 0",
+        "ls /tmp/~does_not_exist"
+    };
+    char* hash = nullptr;
+    char* expected = nullptr;
+    char* command = nullptr;
+
+    for (auto source : commands)
+    {
+        EXPECT_NE(nullptr, command = FormatAllocateString("%s 2>/dev/null | sha256sum | head -c 64", source));
+        EXPECT_EQ(0, ExecuteCommand(nullptr, command, false, false, 0, 0, &expected, nullptr, nullptr));
+        EXPECT_NE(nullptr, hash = HashCommand(source, nullptr));
+        EXPECT_STREQ(expected, hash);
+        FREE_MEMORY(command);
+        FREE_MEMORY(expected);
+        FREE_MEMORY(hash);
+    }
+
+    EXPECT_TRUE(CreateTestFile(m_path, "abc"));
+    EXPECT_NE(nullptr, hash = HashFile(m_path, nullptr));
+    EXPECT_STREQ("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", hash);
+    FREE_MEMORY(hash);
+
+    EXPECT_TRUE(CreateTestFile(m_path, m_dataWithEol));
+    EXPECT_NE(nullptr, command = FormatAllocateString("sha256sum %s | head -c 64", m_path));
+    EXPECT_EQ(0, ExecuteCommand(nullptr, command, false, false, 0, 0, &expected, nullptr, nullptr));
+    EXPECT_NE(nullptr, hash = HashFile(m_path, nullptr));
+    EXPECT_STREQ(expected, hash);
+    FREE_MEMORY(command);
+    FREE_MEMORY(expected);
+    FREE_MEMORY(hash);
+    EXPECT_TRUE(Cleanup(m_path));
+
+    EXPECT_EQ(nullptr, HashFile(nullptr, nullptr));
+    EXPECT_EQ(nullptr, HashFile("/tmp/~does_not_exist", nullptr));
+}
+
+// Not run by default, run on demand with --gtest_also_run_disabled_tests --gtest_filter=*HashCommandBenchmark
+TEST_F(CommonUtilsTest, DISABLED_HashCommandBenchmark)
+{
+    const char source[] = "seq 1 100000";
+    const int iterations = 20;
+    char* command = nullptr;
+    char* hash = nullptr;
+    struct timespec start = {}, end = {};
+    long long pipelineMicroseconds = 0, nativeMicroseconds = 0;
+
+    EXPECT_NE(nullptr, command = FormatAllocateString("%s | sha256sum | head -c 64", source));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++)
+    {
+        EXPECT_EQ(0, ExecuteCommand(nullptr, command, false, false, 0, 0, &hash, nullptr, nullptr));
+        FREE_MEMORY(hash);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pipelineMicroseconds = ((end.tv_sec - start.tv_sec) * 1000000LL) + ((end.tv_nsec - start.tv_nsec) / 1000);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < iterations; i++)
+    {
+        EXPECT_NE(nullptr, hash = HashCommand(source, nullptr));
+        FREE_MEMORY(hash);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    nativeMicroseconds = ((end.tv_sec - start.tv_sec) * 1000000LL) + ((end.tv_nsec - start.tv_nsec) / 1000);
+
+    printf("HashCommand('%s') x %d: sha256sum pipeline %lld us, in process %lld us\n", source, iterations, pipelineMicroseconds, nativeMicroseconds);
+
+    FREE_MEMORY(command);
+}
+
 struct TestHttpHeader
 {
     const char* httpRequest;
@@ -1293,6 +1739,7 @@ TEST_F(CommonUtilsTest, LoadConfiguration)
           "\"LocalManagement\": 3,"
           "\"ModelVersion\": 11,"
           "\"IotHubProtocol\": 2,"
+          "\"ColocatedPlatform\": 1,"
           "\"Reported\": ["
           "  {"
           "    \"ComponentName\": \"DeviceInfo\","
@@ -1315,6 +1762,8 @@ TEST_F(CommonUtilsTest, LoadConfiguration)
     EXPECT_EQ(30, GetReportingIntervalFromJsonConfig(configuration, nullptr));
     EXPECT_EQ(11, GetModelVersionFromJsonConfig(configuration, nullptr));
     EXPECT_EQ(2, GetIotHubProtocolFromJsonConfig(configuration, nullptr));
+    EXPECT_TRUE(IsColocatedPlatformEnabledInJsonConfig(configuration));
+    EXPECT_FALSE(IsIotHubManagementEnabledInJsonConfig(configuration));
 
     // The value of 3 is too big, shall be changed to 1
     EXPECT_EQ(1, GetLocalManagementFromJsonConfig(configuration, nullptr));
@@ -1371,6 +1820,28 @@ TEST_F(CommonUtilsTest, SetAndCheckDirectoryAccess)
     EXPECT_EQ(EINVAL, CheckDirectoryAccess(nullptr, 0, 0, 777, false, nullptr, nullptr));
 }
 
+TEST_F(CommonUtilsTest, CheckStatAccess)
+{
+    unsigned int testModes[] = { 600, 640, 700, 750 };
+    int numTestModes = ARRAY_SIZE(testModes);
+    struct stat statStruct = {};
+
+    EXPECT_TRUE(CreateTestFile(m_path, m_data));
+    for (int i = 0; i < numTestModes; i++)
+    {
+        EXPECT_EQ(0, SetFileAccess(m_path, 0, 0, testModes[i], nullptr));
+        EXPECT_EQ(0, stat(m_path, &statStruct));
+        EXPECT_EQ(CheckFileAccess(m_path, 0, 0, testModes[i], nullptr, nullptr), CheckStatAccess(&statStruct, false, m_path, 0, 0, testModes[i], false, nullptr, nullptr));
+        EXPECT_EQ(0, CheckStatAccess(&statStruct, false, m_path, 0, 0, testModes[i], false, nullptr, nullptr));
+        EXPECT_NE(0, CheckStatAccess(&statStruct, false, m_path, 0, 0, 400, false, nullptr, nullptr));
+    }
+
+    EXPECT_TRUE(Cleanup(m_path));
+
+    EXPECT_EQ(EINVAL, CheckStatAccess(nullptr, false, m_path, 0, 0, 777, false, nullptr, nullptr));
+    EXPECT_EQ(EINVAL, CheckStatAccess(&statStruct, false, nullptr, 0, 0, 777, false, nullptr, nullptr));
+}
+
 TEST_F(CommonUtilsTest, CheckFileSystemMountingOption)
 {
     const char* testFstab = 
@@ -1433,6 +1904,16 @@ TEST_F(CommonUtilsTest, GetNumberOfLinesInFile)
     EXPECT_EQ(0, GetNumberOfLinesInFile(nullptr));
     EXPECT_EQ(0, GetNumberOfLinesInFile("~file_that_does_not_exist"));
     EXPECT_EQ(GetNumberOfLinesInFile("/etc/passwd"), GetNumberOfLinesInFile("/etc/shadow"));
+
+    // Large generated file, spanning many read blocks
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "awk 'BEGIN { for (i = 1; i <= 200000; i++) printf \"user%d:x:%d:%d::/home/user%d:/bin/bash\\n\", i, i, i, i }' > /tmp/~test.test", false, false, 0, 0, nullptr, nullptr, nullptr));
+    EXPECT_EQ(200000, GetNumberOfLinesInFile(m_path));
+    EXPECT_TRUE(CharacterFoundInFile(m_path, ':'));
+    EXPECT_FALSE(CharacterFoundInFile(m_path, '+'));
+    EXPECT_TRUE(AppendToFile(m_path, "+", 1, nullptr));
+    EXPECT_TRUE(CharacterFoundInFile(m_path, '+'));
+    EXPECT_EQ(200000, GetNumberOfLinesInFile(m_path));
+    EXPECT_TRUE(Cleanup(m_path));
 }
 
 TEST_F(CommonUtilsTest, CharacterFoundInFile)
@@ -1492,6 +1973,53 @@ TEST_F(CommonUtilsTest, EnumerateAllGroups)
     EXPECT_EQ(nullptr, groupList);
 }
 
+TEST_F(CommonUtilsTest, AccountSnapshot)
+{
+    SIMPLIFIED_USER* userList = NULL;
+    unsigned int userListSize = 0;
+    SIMPLIFIED_USER* otherUserList = NULL;
+    unsigned int otherUserListSize = 0;
+    SIMPLIFIED_GROUP* groupList = NULL;
+    unsigned int groupListSize = 0;
+    SIMPLIFIED_GROUP* otherGroupList = NULL;
+    unsigned int otherGroupListSize = 0;
+
+    EXPECT_EQ(0, EnumerateUsers(&userList, &userListSize, nullptr, nullptr));
+    EXPECT_EQ(0, EnumerateAllGroups(&groupList, &groupListSize, nullptr, nullptr));
+    ASSERT_NE(nullptr, userList);
+    ASSERT_NE(nullptr, groupList);
+
+    // Each caller gets its own copy of the snapshot
+    FREE_MEMORY(userList[0].username);
+    FREE_MEMORY(groupList[0].groupName);
+
+    EXPECT_EQ(0, EnumerateUsers(&otherUserList, &otherUserListSize, nullptr, nullptr));
+    EXPECT_EQ(0, EnumerateAllGroups(&otherGroupList, &otherGroupListSize, nullptr, nullptr));
+    EXPECT_EQ(userListSize, otherUserListSize);
+    EXPECT_EQ(groupListSize, otherGroupListSize);
+    EXPECT_NE(nullptr, otherUserList[0].username);
+    EXPECT_NE(nullptr, otherGroupList[0].groupName);
+    FreeUsersList(&otherUserList, otherUserListSize);
+    FreeGroupList(&otherGroupList, otherGroupListSize);
+
+    InvalidateAccountSnapshot();
+
+    EXPECT_EQ(0, EnumerateUsers(&otherUserList, &otherUserListSize, nullptr, nullptr));
+    EXPECT_EQ(userListSize, otherUserListSize);
+
+    for (unsigned int i = 1; i < userListSize; i++)
+    {
+        EXPECT_STREQ(userList[i].username, otherUserList[i].username);
+        EXPECT_EQ(userList[i].userId, otherUserList[i].userId);
+        EXPECT_EQ(userList[i].hasPassword, otherUserList[i].hasPassword);
+        EXPECT_EQ(userList[i].passwordEncryption, otherUserList[i].passwordEncryption);
+    }
+
+    FreeUsersList(&otherUserList, otherUserListSize);
+    FreeUsersList(&userList, userListSize);
+    FreeGroupList(&groupList, groupListSize);
+}
+
 TEST_F(CommonUtilsTest, CheckUsersAndGroups)
 {
     EXPECT_EQ(0, CheckAllEtcPasswdGroupsExistInEtcGroup(nullptr, nullptr));
@@ -1507,6 +2035,94 @@ TEST_F(CommonUtilsTest, CheckNoDuplicateUsersGroups)
     EXPECT_EQ(0, CheckNoDuplicateGroupNamesExist(nullptr, nullptr));
 }
 
+TEST_F(CommonUtilsTest, CountAccountKeys)
+{
+    const char* names[] = { "root", "bin", "root", nullptr, nullptr, "daemon", "bin", "root" };
+    unsigned int nameCounts[] = { 3, 2, 3, 1, 1, 1, 2, 3 };
+    unsigned int ids[1000] = {0};
+    unsigned int* counts = nullptr;
+    unsigned int i = 0;
+
+    // Names that are missing never match each other
+    ASSERT_NE(nullptr, counts = CountAccountKeys(names, nullptr, ARRAY_SIZE(names), nullptr));
+    for (i = 0; i < ARRAY_SIZE(names); i++)
+    {
+        EXPECT_EQ(nameCounts[i], counts[i]);
+    }
+    FREE_MEMORY(counts);
+
+    // Enough keys to grow the table and collide in it, ids under 100 appear 4 times and the others 3 times
+    for (i = 0; i < ARRAY_SIZE(ids); i++)
+    {
+        ids[i] = (i % 300) * 1000;
+    }
+    ASSERT_NE(nullptr, counts = CountAccountKeys(nullptr, ids, ARRAY_SIZE(ids), nullptr));
+    for (i = 0; i < ARRAY_SIZE(ids); i++)
+    {
+        EXPECT_EQ(((i % 300) < 100) ? 4u : 3u, counts[i]);
+    }
+    FREE_MEMORY(counts);
+
+    ASSERT_NE(nullptr, counts = CountAccountKeys(nullptr, ids, 1, nullptr));
+    EXPECT_EQ(1, counts[0]);
+    FREE_MEMORY(counts);
+}
+
+TEST_F(CommonUtilsTest, DuplicateAccountChecksWithLargeAccountFiles)
+{
+    const char* passwdFile = "/tmp/~testpasswd";
+    const char* shadowFile = "/tmp/~testshadow";
+    const char* groupFile = "/tmp/~testgroup";
+    struct timespec start = {0, 0};
+    struct timespec end = {0, 0};
+    double elapsed = 0;
+    char* reason = nullptr;
+
+    // Generated account files of 200000 accounts each, where every name and id is unique
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "awk 'BEGIN { for (i = 1; i <= 200000; i++) printf \"user%d:x:%d:%d::/home/user%d:/usr/sbin/nologin\\n\", i, i, i, i }' > /tmp/~testpasswd", false, false, 0, 0, nullptr, nullptr, nullptr));
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "awk 'BEGIN { for (i = 1; i <= 200000; i++) printf \"user%d:!:19300:0:99999:7:::\\n\", i }' > /tmp/~testshadow", false, false, 0, 0, nullptr, nullptr, nullptr));
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "awk 'BEGIN { for (i = 1; i <= 200000; i++) printf \"group%d:x:%d:\\n\", i, i }' > /tmp/~testgroup", false, false, 0, 0, nullptr, nullptr, nullptr));
+    ASSERT_EQ(0, SetAccountFiles(passwdFile, shadowFile, groupFile, nullptr));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    EXPECT_EQ(0, CheckNoDuplicateUidsExist(nullptr, nullptr));
+    EXPECT_EQ(0, CheckNoDuplicateGidsExist(nullptr, nullptr));
+    EXPECT_EQ(0, CheckNoDuplicateUserNamesExist(nullptr, nullptr));
+    EXPECT_EQ(0, CheckNoDuplicateGroupNamesExist(nullptr, nullptr));
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = ((end.tv_sec - start.tv_sec) * 1000.0) + ((end.tv_nsec - start.tv_nsec) / 1000000.0);
+    printf("Duplicate checks over 200000 users and 200000 groups: %.1f ms\n", elapsed);
+
+    // Comparing every pair would take minutes at this size
+    EXPECT_LT(elapsed, 10000.0);
+
+    // A duplicate uid and a duplicate user name, far apart in the file
+    EXPECT_TRUE(AppendToFile(passwdFile, "extra:x:150000:1::/home/extra:/usr/sbin/nologin\nuser7:x:200001:1::/home/user7:/usr/sbin/nologin\n", 96, nullptr));
+    EXPECT_TRUE(AppendToFile(shadowFile, "extra:!:19300:0:99999:7:::\n", 27, nullptr));
+    EXPECT_EQ(EEXIST, CheckNoDuplicateUidsExist(&reason, nullptr));
+    EXPECT_NE(nullptr, strstr(reason, "Uid 150000 appears more than a single time"));
+    FREE_MEMORY(reason);
+    EXPECT_EQ(EEXIST, CheckNoDuplicateUserNamesExist(&reason, nullptr));
+    EXPECT_NE(nullptr, strstr(reason, "user7"));
+    FREE_MEMORY(reason);
+
+    // A duplicate gid, and a duplicate group name with an id of its own
+    EXPECT_TRUE(AppendToFile(groupFile, "extra:x:199999:\n", 16, nullptr));
+    EXPECT_EQ(EEXIST, CheckNoDuplicateGidsExist(&reason, nullptr));
+    EXPECT_NE(nullptr, strstr(reason, "Gid 199999 appears more than a single time"));
+    FREE_MEMORY(reason);
+    EXPECT_EQ(0, CheckNoDuplicateGroupNamesExist(nullptr, nullptr));
+    EXPECT_TRUE(AppendToFile(groupFile, "group9:x:200009:\n", 17, nullptr));
+    EXPECT_EQ(EEXIST, CheckNoDuplicateGroupNamesExist(&reason, nullptr));
+    EXPECT_NE(nullptr, strstr(reason, "group9"));
+    FREE_MEMORY(reason);
+
+    EXPECT_EQ(0, SetAccountFiles(nullptr, nullptr, nullptr, nullptr));
+    EXPECT_TRUE(Cleanup(passwdFile));
+    EXPECT_TRUE(Cleanup(shadowFile));
+    EXPECT_TRUE(Cleanup(groupFile));
+}
+
 TEST_F(CommonUtilsTest, CheckNoPlusEntriesInFile)
 {
     const char* testPath = "~plusentries";
@@ -1569,9 +2185,127 @@ TEST_F(CommonUtilsTest, CheckUsersHavePasswords)
 
 TEST_F(CommonUtilsTest, CheckUserHomeDirectories)
 {
+    unsigned int modes[] = { 600, 644, 700 };
+    int homesExist = 0, ownHomes = 0, restrictedDotFiles = 0;
+
     //Optional:
-    CheckAllUsersHomeDirectoriesExist(nullptr, nullptr);
-    CheckUsersOwnTheirHomeDirectories(nullptr, nullptr);
+    homesExist = CheckAllUsersHomeDirectoriesExist(nullptr, nullptr);
+    ownHomes = CheckUsersOwnTheirHomeDirectories(nullptr, nullptr);
+    restrictedDotFiles = CheckUsersRestrictedDotFiles(modes, ARRAY_SIZE(modes), nullptr, nullptr);
+
+    // Checks that follow each other reuse one walk of the homes and reach the same results
+    EXPECT_EQ(homesExist, CheckAllUsersHomeDirectoriesExist(nullptr, nullptr));
+    EXPECT_EQ(ownHomes, CheckUsersOwnTheirHomeDirectories(nullptr, nullptr));
+    EXPECT_EQ(restrictedDotFiles, CheckUsersRestrictedDotFiles(modes, ARRAY_SIZE(modes), nullptr, nullptr));
+}
+
+TEST_F(CommonUtilsTest, AuditFixtureHomes)
+{
+    const char* names[] = { "good", "stranger", "open", "missing", "nologin" };
+    const char* homes[] = { "/tmp/~homes/good", "/tmp/~homes/stranger", "/tmp/~homes/open", "/tmp/~homes/missing", "/tmp/~homes/open" };
+    const unsigned int ids[] = { 54321, 54322, 54323, 54324, 54325 };
+    unsigned int homeModes[] = { 700, 750 };
+    unsigned int dotFileModes[] = { 600, 644, 700 };
+    SIMPLIFIED_USER users[5] = {};
+    SIMPLIFIED_USER deepUser = {};
+    char* reason = nullptr;
+    unsigned int i = 0;
+
+    // Homes with known violations: 'stranger' does not own their home, 'open' has a home and a dot file open to everyone plus a .forward file,
+    // the home of 'missing' does not exist and 'nologin' shares the home of 'open' but cannot login so is never reported
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "rm -rf /tmp/~homes && mkdir -p /tmp/~homes/good /tmp/~homes/stranger /tmp/~homes/open && "
+        "touch /tmp/~homes/good/.profile /tmp/~homes/open/.bashrc /tmp/~homes/open/.forward && "
+        "chown -R 54321:54321 /tmp/~homes/good && chmod 700 /tmp/~homes/good && chmod 600 /tmp/~homes/good/.profile && "
+        "chown -R 0:0 /tmp/~homes/stranger && chmod 700 /tmp/~homes/stranger && "
+        "chown -R 54323:54323 /tmp/~homes/open && chmod 777 /tmp/~homes/open && chmod 666 /tmp/~homes/open/.bashrc && chmod 600 /tmp/~homes/open/.forward",
+        false, false, 0, 0, nullptr, nullptr, nullptr));
+
+    for (i = 0; i < ARRAY_SIZE(users); i++)
+    {
+        users[i].username = (char*)names[i];
+        users[i].home = (char*)homes[i];
+        users[i].shell = (char*)"/bin/bash";
+        users[i].userId = ids[i];
+        users[i].groupId = ids[i];
+        users[i].hasPassword = true;
+    }
+
+    users[4].shell = (char*)"/usr/sbin/nologin";
+    users[4].noLogin = true;
+
+    ASSERT_EQ(0, SetHomeAuditAccounts(users, ARRAY_SIZE(users), 10, nullptr));
+
+    EXPECT_EQ(ENOENT, CheckAllUsersHomeDirectoriesExist(&reason, nullptr));
+    ASSERT_NE(nullptr, reason);
+    EXPECT_NE(nullptr, strstr(reason, "'missing'"));
+    EXPECT_EQ(nullptr, strstr(reason, "'good'"));
+    EXPECT_EQ(nullptr, strstr(reason, "'open'"));
+    FREE_MEMORY(reason);
+
+    EXPECT_EQ(ENOENT, CheckUsersOwnTheirHomeDirectories(&reason, nullptr));
+    ASSERT_NE(nullptr, reason);
+    EXPECT_NE(nullptr, strstr(reason, "User 'stranger' (54322, 54322) does not own their assigned home directory '/tmp/~homes/stranger'"));
+    EXPECT_NE(nullptr, strstr(reason, "'missing'"));
+    EXPECT_EQ(nullptr, strstr(reason, "'good'"));
+    EXPECT_EQ(nullptr, strstr(reason, "'open'"));
+    EXPECT_EQ(nullptr, strstr(reason, "'nologin'"));
+    FREE_MEMORY(reason);
+
+    EXPECT_EQ(ENOENT, CheckRestrictedUserHomeDirectories(homeModes, ARRAY_SIZE(homeModes), &reason, nullptr));
+    ASSERT_NE(nullptr, reason);
+    EXPECT_NE(nullptr, strstr(reason, "User 'open' (54323, 54323) does not have proper restricted access for their assigned home directory '/tmp/~homes/open'"));
+    EXPECT_EQ(nullptr, strstr(reason, "'good'"));
+    EXPECT_EQ(nullptr, strstr(reason, "'nologin'"));
+    FREE_MEMORY(reason);
+
+    EXPECT_EQ(ENOENT, CheckUsersRestrictedDotFiles(dotFileModes, ARRAY_SIZE(dotFileModes), &reason, nullptr));
+    ASSERT_NE(nullptr, reason);
+    EXPECT_NE(nullptr, strstr(reason, "/tmp/~homes/open/.bashrc"));
+    EXPECT_EQ(nullptr, strstr(reason, ".forward"));
+    EXPECT_EQ(nullptr, strstr(reason, ".profile"));
+    FREE_MEMORY(reason);
+
+    EXPECT_EQ(ENOENT, CheckOrEnsureUsersDontHaveDotFiles("forward", false, &reason, nullptr));
+    ASSERT_NE(nullptr, reason);
+    EXPECT_NE(nullptr, strstr(reason, "User 'open' (54323, 54323) has file '.forward' ('/tmp/~homes/open/.forward')"));
+    EXPECT_EQ(nullptr, strstr(reason, "'nologin'"));
+    FREE_MEMORY(reason);
+    EXPECT_EQ(0, CheckOrEnsureUsersDontHaveDotFiles("rhosts", false, nullptr, nullptr));
+
+    // Remediation walks the homes again and the findings are gone
+    EXPECT_EQ(0, SetRestrictedUserHomeDirectories(homeModes, ARRAY_SIZE(homeModes), 700, 700, nullptr));
+    EXPECT_EQ(0, CheckRestrictedUserHomeDirectories(homeModes, ARRAY_SIZE(homeModes), nullptr, nullptr));
+    EXPECT_EQ(0, SetUsersRestrictedDotFiles(dotFileModes, ARRAY_SIZE(dotFileModes), 600, nullptr));
+    EXPECT_EQ(0, CheckUsersRestrictedDotFiles(dotFileModes, ARRAY_SIZE(dotFileModes), nullptr, nullptr));
+    EXPECT_EQ(0, CheckOrEnsureUsersDontHaveDotFiles("forward", true, nullptr, nullptr));
+    EXPECT_FALSE(FileExists("/tmp/~homes/open/.forward"));
+    EXPECT_EQ(0, CheckOrEnsureUsersDontHaveDotFiles("forward", false, nullptr, nullptr));
+
+    // A home with many dot files and nested folders, that with no time allowed is reported as not audited instead of waited on
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "mkdir -p /tmp/~homes/deep/.a/.b/.c/.d && cd /tmp/~homes/deep && for i in $(seq 1 1000); do : > .file$i; done && "
+        "chown -R 54326:54326 /tmp/~homes/deep && chmod 700 /tmp/~homes/deep && chmod 600 /tmp/~homes/deep/.file*",
+        false, false, 0, 0, nullptr, nullptr, nullptr));
+
+    deepUser.username = (char*)"deep";
+    deepUser.home = (char*)"/tmp/~homes/deep";
+    deepUser.shell = (char*)"/bin/bash";
+    deepUser.userId = 54326;
+    deepUser.groupId = 54326;
+    deepUser.hasPassword = true;
+
+    ASSERT_EQ(0, SetHomeAuditAccounts(&deepUser, 1, 0, nullptr));
+    EXPECT_EQ(ETIMEDOUT, CheckUsersRestrictedDotFiles(dotFileModes, ARRAY_SIZE(dotFileModes), &reason, nullptr));
+    ASSERT_NE(nullptr, reason);
+    EXPECT_NE(nullptr, strstr(reason, "User 'deep' (54326, 54326) home directory '/tmp/~homes/deep' could not be audited within 0 seconds"));
+    FREE_MEMORY(reason);
+
+    // With time to walk it the same home passes
+    ASSERT_EQ(0, SetHomeAuditAccounts(&deepUser, 1, 10, nullptr));
+    EXPECT_EQ(0, CheckUsersRestrictedDotFiles(dotFileModes, ARRAY_SIZE(dotFileModes), nullptr, nullptr));
+    EXPECT_EQ(0, CheckUsersOwnTheirHomeDirectories(nullptr, nullptr));
+
+    EXPECT_EQ(0, SetHomeAuditAccounts(nullptr, 0, 0, nullptr));
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "rm -rf /tmp/~homes", false, false, 0, 0, nullptr, nullptr, nullptr));
 }
 
 TEST_F(CommonUtilsTest, CheckOrEnsureUsersDontHaveDotFiles)
@@ -1743,6 +2477,50 @@ TEST_F(CommonUtilsTest, FindTextInFolder)
     CheckTextNotFoundInFolder("/etc/modprobe.d", "~~~~ test123 ~~~~", nullptr, nullptr);
 }
 
+TEST_F(CommonUtilsTest, FindTextInLargeFolder)
+{
+    const char* folder = "/tmp/~testfolder";
+    const size_t size = 1024 * 1024;
+    char* contents = nullptr;
+    char* path = nullptr;
+    int i = 0;
+
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "rm -rf /tmp/~testfolder && mkdir -p /tmp/~testfolder/subfolder && mkfifo /tmp/~testfolder/fifo", false, false, 0, 0, nullptr, nullptr, nullptr));
+
+    // Enough files to get searched by several threads
+    for (i = 0; i < 100; i++)
+    {
+        EXPECT_NE(nullptr, path = FormatAllocateString("%s/file%d.conf", folder, i));
+        EXPECT_TRUE(CreateTestFile(path, m_dataWithEol));
+        FREE_MEMORY(path);
+    }
+
+    EXPECT_TRUE(CreateTestFile("/tmp/~testfolder/subfolder/nested.conf", "~~~~ nested ~~~~"));
+
+    EXPECT_EQ(ENOENT, FindTextInFolder(folder, "~~~~ test123 ~~~~", nullptr));
+    EXPECT_EQ(ENOENT, FindTextInFolder(folder, "~~~~ nested ~~~~", nullptr));
+    EXPECT_EQ(ENOENT, FindTextInFolder(folder, "", nullptr));
+    EXPECT_EQ(0, FindTextInFolder(folder, "qwertyuiop", nullptr));
+
+    EXPECT_TRUE(CreateTestFile("/tmp/~testfolder/file77.conf", "Test ~~~~ test123 ~~~~ Test"));
+    EXPECT_EQ(0, FindTextInFolder(folder, "~~~~ test123 ~~~~", nullptr));
+    EXPECT_EQ(0, CheckTextFoundInFolder(folder, "~~~~ test123 ~~~~", nullptr, nullptr));
+    EXPECT_EQ(ENOENT, CheckTextNotFoundInFolder(folder, "~~~~ test123 ~~~~", nullptr, nullptr));
+
+    // Large files are read in chunks, a match across two chunks is still found and the search ends at the first null character
+    EXPECT_NE(nullptr, contents = (char*)malloc(size));
+    memset(contents, 'a', size);
+    memcpy(contents + (size / 4) - 3, "~~~~ large ~~~~", strlen("~~~~ large ~~~~"));
+    contents[size / 2] = 0;
+    memcpy(contents + size - strlen("~~~~ hidden ~~~~"), "~~~~ hidden ~~~~", strlen("~~~~ hidden ~~~~"));
+    EXPECT_TRUE(SavePayloadToFile("/tmp/~testfolder/large.conf", contents, size, nullptr));
+    EXPECT_EQ(0, FindTextInFolder(folder, "~~~~ large ~~~~", nullptr));
+    EXPECT_EQ(ENOENT, FindTextInFolder(folder, "~~~~ hidden ~~~~", nullptr));
+    FREE_MEMORY(contents);
+
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "rm -rf /tmp/~testfolder", false, false, 0, 0, nullptr, nullptr, nullptr));
+}
+
 TEST_F(CommonUtilsTest, CheckLineNotFoundOrCommentedOut)
 {
     const char* testFile =
@@ -1809,6 +2587,90 @@ TEST_F(CommonUtilsTest, CheckLineNotFoundOrCommentedOut)
     EXPECT_TRUE(Cleanup(m_path));
 }
 
+TEST_F(CommonUtilsTest, SearchTextsInFile)
+{
+    const char* testFile =
+        "# Test 123 commented\n"
+        " Test 123 uncommented\n"
+        "345 Test 345 Test # 345 Test\n"
+        "ABC!DEF # Test 678 1234567890\n"
+        "she sells his shells\n";
+
+    const char* texts[] = {"Test 123", "345", "678", "he", "she", "his", "hers", "Test 123", "commented\n Test", "does-not__exist123"};
+    const char* notFound[] = {"does-not__exist123", "9876543210"};
+    const char* lines[] = {"Test 678", "Test 123 commented", "sells"};
+    const char* missing = "/foo/does_not_exist";
+    TEXT_SEARCH_RESULT results[ARRAY_SIZE(texts)];
+    TEXT_SEARCH* search = nullptr;
+    char* reason = nullptr;
+
+    EXPECT_TRUE(CreateTestFile(m_path, testFile));
+
+    EXPECT_EQ(EINVAL, SearchTextsInFile(nullptr, texts, ARRAY_SIZE(texts), '#', results, nullptr));
+    EXPECT_EQ(EINVAL, SearchTextsInFile(m_path, nullptr, ARRAY_SIZE(texts), '#', results, nullptr));
+    EXPECT_EQ(EINVAL, SearchTextsInFile(m_path, texts, 0, '#', results, nullptr));
+    EXPECT_EQ(EINVAL, SearchTextsInFile(m_path, texts, ARRAY_SIZE(texts), '#', nullptr, nullptr));
+    EXPECT_EQ(ENOENT, SearchTextsInFile(missing, texts, ARRAY_SIZE(texts), '#', results, nullptr));
+
+    EXPECT_EQ(nullptr, search = CompileTextSearch(&missing, 0, '#', nullptr));
+    EXPECT_NE(nullptr, search = CompileTextSearch(texts, ARRAY_SIZE(texts), '#', nullptr));
+    FreeTextSearch(search);
+
+    EXPECT_EQ(0, SearchTextsInFile(m_path, texts, ARRAY_SIZE(texts), '#', results, nullptr));
+
+    EXPECT_EQ(2, results[0].found);
+    EXPECT_EQ(1, results[0].foundUncommented);
+    EXPECT_EQ(1, results[0].firstLine);
+
+    EXPECT_EQ(4, results[1].found);
+    EXPECT_EQ(2, results[1].foundUncommented);
+    EXPECT_EQ(3, results[1].firstLine);
+
+    EXPECT_EQ(2, results[2].found);
+    EXPECT_EQ(0, results[2].foundUncommented);
+    EXPECT_EQ(4, results[2].firstLine);
+
+    // Overlapping matches are all reported
+    EXPECT_EQ(2, results[3].found);
+    EXPECT_EQ(5, results[3].firstLine);
+    EXPECT_EQ(2, results[4].found);
+    EXPECT_EQ(1, results[5].found);
+    EXPECT_EQ(0, results[6].found);
+
+    // Duplicates get their own results
+    EXPECT_EQ(2, results[7].found);
+    EXPECT_EQ(1, results[7].foundUncommented);
+
+    // Texts spanning lines are reported at the line where they start
+    EXPECT_EQ(1, results[8].found);
+    EXPECT_EQ(0, results[8].foundUncommented);
+    EXPECT_EQ(1, results[8].firstLine);
+
+    EXPECT_EQ(0, results[9].found);
+
+    EXPECT_EQ(0, CheckTextsAreNotFoundInFile(m_path, notFound, ARRAY_SIZE(notFound), &reason, nullptr));
+    EXPECT_NE(nullptr, strstr(reason, "'9876543210' not found in"));
+    FREE_MEMORY(reason);
+    EXPECT_EQ(ENOENT, CheckTextsAreNotFoundInFile(m_path, texts, ARRAY_SIZE(texts), nullptr, nullptr));
+    EXPECT_EQ(0, CheckTextsAreNotFoundInFile(missing, texts, ARRAY_SIZE(texts), &reason, nullptr));
+    EXPECT_STREQ("PASS'/foo/does_not_exist' not found", reason);
+    FREE_MEMORY(reason);
+
+    EXPECT_EQ(0, CheckLinesNotFoundOrCommentedOut(m_path, '#', lines, 2, nullptr, nullptr));
+    EXPECT_EQ(EEXIST, CheckLinesNotFoundOrCommentedOut(m_path, '#', lines, ARRAY_SIZE(lines), nullptr, nullptr));
+    EXPECT_EQ(0, CheckLinesNotFoundOrCommentedOut(missing, '#', lines, ARRAY_SIZE(lines), nullptr, nullptr));
+
+    // Like the string search this replaces, the contents end at the first null character
+    EXPECT_TRUE(SavePayloadToFile(m_path, "Test 123\n\0she sells\n", 20, nullptr));
+    EXPECT_EQ(0, SearchTextsInFile(m_path, texts, ARRAY_SIZE(texts), '#', results, nullptr));
+    EXPECT_EQ(1, results[0].found);
+    EXPECT_EQ(0, results[4].found);
+    EXPECT_EQ(0, CheckTextsAreNotFoundInFile(m_path, &texts[4], 1, nullptr, nullptr));
+    EXPECT_EQ(ENOENT, CheckTextsAreNotFoundInFile(m_path, texts, 1, nullptr, nullptr));
+
+    EXPECT_TRUE(Cleanup(m_path));
+}
+
 TEST_F(CommonUtilsTest, CheckTextFoundInCommandOutput)
 {
     EXPECT_EQ(EINVAL, CheckTextFoundInCommandOutput(nullptr, nullptr, nullptr, nullptr));
@@ -2053,6 +2915,71 @@ TEST_F(CommonUtilsTest, CheckInstallUninstallPackage)
     EXPECT_NE(0, CheckPackageNotInstalled("gcc", nullptr, nullptr));
 }
 
+TEST_F(CommonUtilsTest, IsPackageInDpkgStatus)
+{
+    const char* status =
+        "Package: adduser\n"
+        "Status: install ok installed\n"
+        "Priority: important\n"
+        "Description: add and remove users and groups\n"
+        " This package includes the 'adduser' and 'deluser' commands\n"
+        "\n"
+        "Package: telnetd\n"
+        "Status: deinstall ok config-files\n"
+        "Version: 0.17-44\n"
+        "\n"
+        "Package: libaudit1\n"
+        "Status: install ok installed\n"
+        "Architecture: amd64\n"
+        "\n"
+        "Package: libaudit1\n"
+        "Status: install ok installed\n"
+        "Architecture: i386\n"
+        "\n"
+        "Package: rsh-server\n"
+        "Status: hold ok installed\n"
+        "\n"
+        "Package: auditd\n"
+        "Status: install ok installed\n";
+
+    const char* addition =
+        "\n"
+        "Package: xinetd\n"
+        "Status: install ok installed\n";
+
+    EXPECT_EQ(EINVAL, IsPackageInDpkgStatus(nullptr, "adduser", nullptr));
+    EXPECT_EQ(EINVAL, IsPackageInDpkgStatus(m_path, nullptr, nullptr));
+    EXPECT_EQ(EINVAL, IsPackageInDpkgStatus(m_path, "", nullptr));
+    EXPECT_EQ(ENODATA, IsPackageInDpkgStatus("/foo/does_not_exist", "adduser", nullptr));
+
+    EXPECT_TRUE(CreateTestFile(m_path, status));
+
+    EXPECT_EQ(0, IsPackageInDpkgStatus(m_path, "adduser", nullptr));
+    EXPECT_EQ(0, IsPackageInDpkgStatus(m_path, "libaudit1", nullptr));
+    EXPECT_EQ(0, IsPackageInDpkgStatus(m_path, "auditd", nullptr));
+    EXPECT_EQ(ENOENT, IsPackageInDpkgStatus(m_path, "telnetd", nullptr));
+    EXPECT_EQ(ENOENT, IsPackageInDpkgStatus(m_path, "rsh-server", nullptr));
+    EXPECT_EQ(ENOENT, IsPackageInDpkgStatus(m_path, "audit", nullptr));
+    EXPECT_EQ(ENOENT, IsPackageInDpkgStatus(m_path, "xinetd", nullptr));
+
+    EXPECT_EQ(0, IsPackageInDpkgStatus(m_path, "*audit*", nullptr));
+    EXPECT_EQ(0, IsPackageInDpkgStatus(m_path, "libaudit?", nullptr));
+    EXPECT_EQ(ENOENT, IsPackageInDpkgStatus(m_path, "*telnetd*", nullptr));
+    EXPECT_EQ(EOPNOTSUPP, IsPackageInDpkgStatus(m_path, "^audit", nullptr));
+
+    // Changes to the status file are picked up on the next query
+    EXPECT_TRUE(AppendToFile(m_path, addition, strlen(addition), nullptr));
+    EXPECT_EQ(0, IsPackageInDpkgStatus(m_path, "xinetd", nullptr));
+    EXPECT_EQ(0, IsPackageInDpkgStatus(m_path, "auditd", nullptr));
+
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "touch -d '1 hour ago' /tmp/~test.test", false, false, 0, 0, nullptr, nullptr, nullptr));
+    EXPECT_EQ(0, IsPackageInDpkgStatus(m_path, "xinetd", nullptr));
+    EXPECT_EQ(ENOENT, IsPackageInDpkgStatus(m_path, "telnetd", nullptr));
+
+    InvalidatePackageIndex();
+    EXPECT_TRUE(Cleanup(m_path));
+}
+
 TEST_F(CommonUtilsTest, IsCurrentOs)
 {
     char* name = NULL;
@@ -2433,4 +3360,711 @@ TEST_F(CommonUtilsTest, IsValidDaemonName)
     {
         EXPECT_FALSE(IsValidDaemonName(badNames[i]));
     }
-}
\ No newline at end of file
+}
+
+TEST_F(CommonUtilsTest, ReportedWriter)
+{
+    const char* reportedFile = "/tmp/~reported.json";
+    const char* indexFile = "/tmp/~reported.json.index";
+    const char* replacementFile = "/tmp/~reported.json.replacement";
+    const char* payload = "{\n  \"DeviceInfo\": {\n    \"osName\": \"Ubuntu\",\n    \"cpuType\": \"x86_64\"\n  },\n  \"Firewall\": {\n    \"state\": 1\n  }\n}";
+    const char* updatedPayload = "{\"DeviceInfo\": {\"osName\": \"Ubuntu\", \"cpuType\": \"x86_64\"}, \"Firewall\": {\"state\": 2}}";
+    const char* compactPayload = "{\"DeviceInfo\":{\"osName\":\"Ubuntu\",\"cpuType\":\"x86_64\"},\"Firewall\":{\"state\":1}}";
+    const char* compactUpdatedPayload = "{\"DeviceInfo\":{\"osName\":\"Ubuntu\",\"cpuType\":\"x86_64\"},\"Firewall\":{\"state\":2}}";
+    REPORTED_WRITER_HANDLE writer = NULL;
+    char* contents = NULL;
+    struct stat statStruct;
+    ino_t inode = 0;
+
+    EXPECT_EQ(nullptr, OpenReportedWriter(nullptr, true, nullptr));
+    EXPECT_EQ(EINVAL, UpdateReportedPayload(nullptr, payload, nullptr));
+    EXPECT_EQ(EINVAL, SaveReportedFile(nullptr, nullptr));
+    EXPECT_EQ(nullptr, LoadReportedComponentFromFile(nullptr, "DeviceInfo", nullptr));
+
+    ASSERT_NE(nullptr, writer = OpenReportedWriter(reportedFile, true, nullptr));
+    EXPECT_EQ(EINVAL, UpdateReportedPayload(writer, "not json", nullptr));
+
+    EXPECT_EQ(0, UpdateReportedPayload(writer, payload, nullptr));
+    EXPECT_EQ(0, SaveReportedFile(writer, nullptr));
+    EXPECT_STREQ(compactPayload, contents = LoadStringFromFile(reportedFile, false, nullptr));
+    FREE_MEMORY(contents);
+    EXPECT_TRUE(FileExists(indexFile));
+    EXPECT_EQ(0, stat(reportedFile, &statStruct));
+    inode = statStruct.st_ino;
+
+    // Unchanged payload, the file is not rewritten
+    EXPECT_EQ(0, UpdateReportedPayload(writer, payload, nullptr));
+    EXPECT_EQ(0, SaveReportedFile(writer, nullptr));
+    EXPECT_EQ(0, stat(reportedFile, &statStruct));
+    EXPECT_EQ(inode, statStruct.st_ino);
+
+    // Changed payload, the file is replaced
+    EXPECT_EQ(0, UpdateReportedPayload(writer, updatedPayload, nullptr));
+    EXPECT_EQ(0, SaveReportedFile(writer, nullptr));
+    EXPECT_STREQ(compactUpdatedPayload, contents = LoadStringFromFile(reportedFile, false, nullptr));
+    FREE_MEMORY(contents);
+
+    // Per component reads through the index
+    EXPECT_STREQ("{\"state\":2}", contents = LoadReportedComponentFromFile(reportedFile, "Firewall", nullptr));
+    FREE_MEMORY(contents);
+    EXPECT_STREQ("{\"osName\":\"Ubuntu\",\"cpuType\":\"x86_64\"}", contents = LoadReportedComponentFromFile(reportedFile, "DeviceInfo", nullptr));
+    FREE_MEMORY(contents);
+    EXPECT_EQ(nullptr, LoadReportedComponentFromFile(reportedFile, "Missing", nullptr));
+
+    // Per component change sets and removals
+    EXPECT_EQ(0, UpdateReportedComponent(writer, "Firewall", nullptr, nullptr));
+    EXPECT_EQ(0, UpdateReportedComponent(writer, "Hostname", "{\"name\":\"test\"}", nullptr));
+    EXPECT_EQ(0, SaveReportedFile(writer, nullptr));
+    EXPECT_STREQ("{\"DeviceInfo\":{\"osName\":\"Ubuntu\",\"cpuType\":\"x86_64\"},\"Hostname\":{\"name\":\"test\"}}", contents = LoadStringFromFile(reportedFile, false, nullptr));
+    FREE_MEMORY(contents);
+    EXPECT_STREQ("{\"name\":\"test\"}", contents = LoadReportedComponentFromFile(reportedFile, "Hostname", nullptr));
+    FREE_MEMORY(contents);
+
+    // Without a valid index the whole file is parsed
+    EXPECT_TRUE(Cleanup(indexFile));
+    EXPECT_STREQ("{\"name\":\"test\"}", contents = LoadReportedComponentFromFile(reportedFile, "Hostname", nullptr));
+    FREE_MEMORY(contents);
+    EXPECT_TRUE(CreateTestFile(indexFile, "{\"size\":1,\"components\":{\"Hostname\":{\"offset\":3,\"length\":5}}}"));
+    EXPECT_STREQ("{\"name\":\"test\"}", contents = LoadReportedComponentFromFile(reportedFile, "Hostname", nullptr));
+    FREE_MEMORY(contents);
+
+    // Replaced by someone else with the same size, the stale index is not used
+    EXPECT_EQ(0, UpdateReportedComponent(writer, "Hostname", "{\"name\":\"next\"}", nullptr));
+    EXPECT_EQ(0, SaveReportedFile(writer, nullptr));
+    EXPECT_STREQ("{\"name\":\"next\"}", contents = LoadReportedComponentFromFile(reportedFile, "Hostname", nullptr));
+    FREE_MEMORY(contents);
+    EXPECT_TRUE(CreateTestFile(replacementFile, "{\"DeviceInfo\":{\"osName\":\"Ubuntu\",\"cpuType\":\"x86_64\"},\"Hostname\":{\"name\":\"x\"}   }"));
+    EXPECT_EQ(0, rename(replacementFile, reportedFile));
+    EXPECT_STREQ("{\"name\":\"x\"}", contents = LoadReportedComponentFromFile(reportedFile, "Hostname", nullptr));
+    FREE_MEMORY(contents);
+
+    // A component changed directly is written again when the payload brings back its previous value
+    EXPECT_EQ(0, UpdateReportedPayload(writer, compactPayload, nullptr));
+    EXPECT_EQ(0, UpdateReportedComponent(writer, "DeviceInfo", "{\"osName\":\"Debian\"}", nullptr));
+    EXPECT_EQ(0, UpdateReportedPayload(writer, compactPayload, nullptr));
+    EXPECT_EQ(0, SaveReportedFile(writer, nullptr));
+    EXPECT_STREQ(compactPayload, contents = LoadStringFromFile(reportedFile, false, nullptr));
+    FREE_MEMORY(contents);
+    EXPECT_STREQ("{\"state\":1}", contents = LoadReportedComponentFromFile(reportedFile, "Firewall", nullptr));
+    FREE_MEMORY(contents);
+
+    CloseReportedWriter(writer);
+    EXPECT_TRUE(Cleanup(indexFile));
+    EXPECT_TRUE(Cleanup(reportedFile));
+}
+
+TEST_F(CommonUtilsTest, GitClone)
+{
+    const char* repository = "file:///tmp/~gitrepo";
+    const char* clone = "/tmp/~gitclone";
+    const char* commitTemplate = "cd /tmp/~gitwork && echo %s > desired.json && echo %s > other.json && git add . && "
+        "git -c user.name=test -c user.email=test@test -c commit.gpgsign=false commit -q -m %s && git push -q /tmp/~gitrepo HEAD:refs/heads/main && git rev-parse HEAD";
+    char commitId[GIT_COMMIT_ID_MAX_LENGTH + 1] = {0};
+    char* command = nullptr;
+    char* textResult = nullptr;
+    char* contents = nullptr;
+    bool updated = false;
+
+    EXPECT_EQ(EINVAL, CloneGitBranch(nullptr, "main", clone, "desired.json", commitId, nullptr));
+    EXPECT_EQ(EINVAL, CloneGitBranch(repository, "main", clone, "", commitId, nullptr));
+    EXPECT_EQ(ENOENT, CloneGitBranch("", "main", clone, "desired.json", commitId, nullptr));
+    EXPECT_EQ(EINVAL, UpdateGitClone("main", clone, commitId, nullptr, nullptr));
+
+    // A local bare repository with two commits on the branch, each touching the file to check out and another one
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "rm -rf /tmp/~gitrepo /tmp/~gitwork /tmp/~gitclone && git init -q --bare /tmp/~gitrepo && "
+        "git -C /tmp/~gitrepo config uploadpack.allowFilter true && git init -q /tmp/~gitwork", false, false, 0, 0, nullptr, nullptr, nullptr));
+    EXPECT_NE(nullptr, command = FormatAllocateString(commitTemplate, "first", "first", "first"));
+    EXPECT_EQ(0, ExecuteCommand(nullptr, command, false, false, 0, 0, nullptr, nullptr, nullptr));
+    FREE_MEMORY(command);
+    EXPECT_NE(nullptr, command = FormatAllocateString(commitTemplate, "second", "second", "second"));
+    EXPECT_EQ(0, ExecuteCommand(nullptr, command, false, false, 0, 0, &textResult, nullptr, nullptr));
+    FREE_MEMORY(command);
+
+    // Only the tip of the branch is cloned and only the requested file is checked out
+    EXPECT_EQ(0, CloneGitBranch(repository, "main", clone, "desired.json", commitId, nullptr));
+    ASSERT_NE(nullptr, textResult);
+    EXPECT_EQ(0, strncmp(textResult, commitId, strlen(commitId)));
+    EXPECT_EQ((size_t)40, strlen(commitId));
+    FREE_MEMORY(textResult);
+    EXPECT_STREQ("second\n", contents = LoadStringFromFile("/tmp/~gitclone/desired.json", false, nullptr));
+    FREE_MEMORY(contents);
+    EXPECT_FALSE(FileExists("/tmp/~gitclone/other.json"));
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "git -C /tmp/~gitclone rev-list --count HEAD", true, false, 0, 0, &textResult, nullptr, nullptr));
+    EXPECT_STREQ("1 ", textResult);
+    FREE_MEMORY(textResult);
+
+    // Nothing to do while the branch does not move
+    EXPECT_EQ(0, UpdateGitClone("main", clone, commitId, &updated, nullptr));
+    EXPECT_FALSE(updated);
+
+    // A new commit on the branch is fetched and checked out, still only for the requested file
+    EXPECT_NE(nullptr, command = FormatAllocateString(commitTemplate, "third", "third", "third"));
+    EXPECT_EQ(0, ExecuteCommand(nullptr, command, false, false, 0, 0, &textResult, nullptr, nullptr));
+    FREE_MEMORY(command);
+    EXPECT_EQ(0, UpdateGitClone("main", clone, commitId, &updated, nullptr));
+    EXPECT_TRUE(updated);
+    ASSERT_NE(nullptr, textResult);
+    EXPECT_EQ(0, strncmp(textResult, commitId, strlen(commitId)));
+    FREE_MEMORY(textResult);
+    EXPECT_STREQ("third\n", contents = LoadStringFromFile("/tmp/~gitclone/desired.json", false, nullptr));
+    FREE_MEMORY(contents);
+    EXPECT_FALSE(FileExists("/tmp/~gitclone/other.json"));
+
+    EXPECT_EQ(0, DeleteGitClone(clone, nullptr));
+    EXPECT_FALSE(DirectoryExists(clone));
+
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "rm -rf /tmp/~gitrepo /tmp/~gitwork; git config --global --unset-all safe.directory '^/tmp/~gitclone$'; true",
+        false, false, 0, 0, nullptr, nullptr, nullptr));
+}
+
+TEST_F(CommonUtilsTest, SysctlValues)
+{
+    const char* root = "/tmp/~testsysctl";
+    const char* dropIn = "/tmp/~testsysctl.conf";
+    SYSCTL_SETTING settings[] = {
+        {"net.ipv4.conf.all.send_redirects", "0", 0},
+        {"net.ipv4.tcp_syncookies", "1", 0},
+        {"net.ipv4.conf.default.missing", "1", 0}};
+    char* value = nullptr;
+    char* reason = nullptr;
+
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "mkdir -p /tmp/~testsysctl/net/ipv4/conf/all", false, false, 0, 0, nullptr, nullptr, nullptr));
+    EXPECT_TRUE(CreateTestFile("/tmp/~testsysctl/net/ipv4/conf/all/send_redirects", "1\n"));
+    EXPECT_TRUE(CreateTestFile("/tmp/~testsysctl/net/ipv4/tcp_syncookies", "0\n"));
+    EXPECT_TRUE(CreateTestFile("/tmp/~testsysctl/net/ipv4/tcp_rmem", "4096\t131072\t6291456\n"));
+    EXPECT_TRUE(CreateTestFile(dropIn, "# Test\nnet.ipv4.tcp_syncookies = 0\nkernel.randomize_va_space = 2\nnet.ipv4.conf.default.missing = 0\n"));
+
+    EXPECT_EQ(nullptr, GetSysctlValue(root, nullptr, nullptr));
+    EXPECT_EQ(nullptr, GetSysctlValue(root, "net.ipv4.conf.default.missing", nullptr));
+    EXPECT_STREQ("1", value = GetSysctlValue(root, "net.ipv4.conf.all.send_redirects", nullptr));
+    FREE_MEMORY(value);
+    EXPECT_STREQ("0", value = GetSysctlValue(root, "net/ipv4/tcp_syncookies", nullptr));
+    FREE_MEMORY(value);
+    EXPECT_STREQ("4096 131072 6291456", value = GetSysctlValue(root, "net.ipv4.tcp_rmem", nullptr));
+    FREE_MEMORY(value);
+
+    EXPECT_EQ(0, CheckSysctlValue(root, "net.ipv4.tcp_rmem", "4096 131072  6291456", &reason, nullptr));
+    FREE_MEMORY(reason);
+    EXPECT_EQ(ENOENT, CheckSysctlValue(root, "net.ipv4.conf.all.send_redirects", "0", &reason, nullptr));
+    EXPECT_NE(nullptr, strstr(reason, "instead of"));
+    FREE_MEMORY(reason);
+    EXPECT_EQ(ENOENT, CheckSysctlValue(root, "net.ipv4.conf.default.missing", "0", &reason, nullptr));
+    FREE_MEMORY(reason);
+
+    EXPECT_EQ(EINVAL, SetSysctlValues(root, nullptr, 0, dropIn, nullptr));
+    EXPECT_EQ(ENOENT, SetSysctlValues(root, settings, ARRAY_SIZE(settings), dropIn, nullptr));
+    EXPECT_EQ(0, settings[0].result);
+    EXPECT_EQ(0, settings[1].result);
+    EXPECT_EQ(ENOENT, settings[2].result);
+
+    EXPECT_EQ(0, CheckSysctlValue(root, "net.ipv4.conf.all.send_redirects", "0", &reason, nullptr));
+    FREE_MEMORY(reason);
+    EXPECT_EQ(0, CheckSysctlValue(root, "net.ipv4.tcp_syncookies", "1", &reason, nullptr));
+    FREE_MEMORY(reason);
+
+    // The drop-in keeps its other lines and gets each applied setting once, the one that failed is not persisted
+    EXPECT_STREQ("# Test\nkernel.randomize_va_space = 2\nnet.ipv4.conf.default.missing = 0\nnet.ipv4.conf.all.send_redirects = 0\nnet.ipv4.tcp_syncookies = 1\n",
+        value = LoadStringFromFile(dropIn, false, nullptr));
+    FREE_MEMORY(value);
+
+    // Nothing applied, nothing persisted
+    EXPECT_EQ(ENOENT, SetSysctlValues(root, &settings[2], 1, dropIn, nullptr));
+    EXPECT_STREQ("# Test\nkernel.randomize_va_space = 2\nnet.ipv4.conf.default.missing = 0\nnet.ipv4.conf.all.send_redirects = 0\nnet.ipv4.tcp_syncookies = 1\n",
+        value = LoadStringFromFile(dropIn, false, nullptr));
+    FREE_MEMORY(value);
+
+    EXPECT_TRUE(Cleanup(dropIn));
+    EXPECT_EQ(0, ExecuteCommand(nullptr, "rm -rf /tmp/~testsysctl", false, false, 0, 0, nullptr, nullptr, nullptr));
+}
+
+TEST_F(CommonUtilsTest, SetShadowAgingValues)
+{
+    const char* shadow = "/tmp/~testshadow";
+    const char* fixture =
+        "root:*:19000:0:99999:7:::\n"
+        "alice:$6$salt$hash:19100:0:99999:7:::\n"
+        "bob:$6$salt$hash:19200:1:365:7:30::\n"
+        "\n"
+        "broken:$6$salt$hash:19300\n";
+    SHADOW_AGING_CHANGE changes[] = {
+        {"bob", ShadowWarningPeriod, 14, 0},
+        {"alice", ShadowMinimumAge, 7, 0},
+        {"alice", ShadowMaximumAge, 90, 0},
+        {"bob", ShadowInactivityPeriod, -1, 0},
+        {"nobody", ShadowMinimumAge, 7, 0},
+        {"broken", ShadowMinimumAge, 7, 0}};
+    SHADOW_AGING_CHANGE invalid[] = {{"alice", ShadowLastChange, 1, 0}, {"al:ice", ShadowMinimumAge, 7, 0}};
+    struct stat statStruct = {};
+    char* contents = nullptr;
+
+    EXPECT_TRUE(CreateTestFile(shadow, fixture));
+    EXPECT_EQ(0, chmod(shadow, 0640));
+
+    EXPECT_EQ(EINVAL, SetShadowAgingValues(shadow, nullptr, 0, nullptr));
+    EXPECT_EQ(EINVAL, SetShadowAgingValues(shadow, invalid, ARRAY_SIZE(invalid), nullptr));
+
+    EXPECT_EQ(0, SetShadowAgingValues(shadow, changes, ARRAY_SIZE(changes), nullptr));
+    EXPECT_EQ(0, changes[0].result);
+    EXPECT_EQ(0, changes[1].result);
+    EXPECT_EQ(0, changes[2].result);
+    EXPECT_EQ(0, changes[3].result);
+    EXPECT_EQ(ENOENT, changes[4].result);
+    EXPECT_EQ(EINVAL, changes[5].result);
+
+    // All changes land in one rewrite that keeps every other line and the access of the file
+    EXPECT_STREQ("root:*:19000:0:99999:7:::\n"
+        "alice:$6$salt$hash:19100:7:90:7:::\n"
+        "bob:$6$salt$hash:19200:1:365:14:::\n"
+        "\n"
+        "broken:$6$salt$hash:19300\n",
+        contents = LoadStringFromFile(shadow, false, nullptr));
+    FREE_MEMORY(contents);
+    EXPECT_EQ(0, stat(shadow, &statStruct));
+    EXPECT_EQ((mode_t)0640, statStruct.st_mode & 07777);
+    EXPECT_FALSE(FileExists("/tmp/~testshadow+"));
+
+    EXPECT_TRUE(Cleanup(shadow));
+}
+
+static int numberOfUnitListings = 0;
+
+static int TestDaemonStateProvider(char** units, char** unitFiles, void* log)
+{
+    UNUSED(log);
+
+    numberOfUnitListings += 1;
+
+    *units = DuplicateString(
+        "cron.service loaded active running Regular background program processing daemon\n"
+        "\xe2\x97\x8f rsyslog.service loaded failed failed System Logging Service\n"
+        "rcp.socket loaded inactive dead RCP socket\n"
+        "nginx.service loaded reloading reload A high performance web server\n"
+        "getty@tty1.service loaded active running Getty on tty1\n");
+    *unitFiles = DuplicateString(
+        "cron.service enabled enabled\n"
+        "cups.service disabled enabled\n"
+        "rsyslog.service enabled enabled\n"
+        "telnet.socket masked enabled\n");
+
+    return ((nullptr != *units) && (nullptr != *unitFiles)) ? 0 : ENOMEM;
+}
+
+TEST_F(CommonUtilsTest, DaemonStateSnapshot)
+{
+    char* reason = nullptr;
+
+    numberOfUnitListings = 0;
+    SetDaemonStateProvider(TestDaemonStateProvider);
+
+    EXPECT_TRUE(IsDaemonActive("cron", nullptr));
+    EXPECT_TRUE(IsDaemonActive("cron.service", nullptr));
+    EXPECT_TRUE(IsDaemonActive("nginx", nullptr));
+    EXPECT_FALSE(IsDaemonActive("rsyslog", nullptr));
+    EXPECT_FALSE(IsDaemonActive("rcp.socket", nullptr));
+    EXPECT_FALSE(IsDaemonActive("cups", nullptr));
+    EXPECT_FALSE(IsDaemonActive("telnet.socket", nullptr));
+    EXPECT_FALSE(IsDaemonActive("avahi-daemon", nullptr));
+    EXPECT_FALSE(IsDaemonActive("cr*n", nullptr));
+    EXPECT_FALSE(IsDaemonActive(nullptr, nullptr));
+
+    EXPECT_TRUE(CheckDaemonActive("cron", &reason, nullptr));
+    FREE_MEMORY(reason);
+    EXPECT_TRUE(CheckDaemonNotActive("cups", &reason, nullptr));
+    FREE_MEMORY(reason);
+    EXPECT_FALSE(CheckDaemonNotActive("cron", &reason, nullptr));
+    FREE_MEMORY(reason);
+
+    // All of the above were answered from a single listing
+    EXPECT_EQ(1, numberOfUnitListings);
+
+    InvalidateDaemonState();
+    EXPECT_TRUE(IsDaemonActive("cron", nullptr));
+    EXPECT_EQ(2, numberOfUnitListings);
+
+    SetDaemonStateProvider(nullptr);
+}
+
+static int numberOfSshServerReports = 0;
+static bool sshServerMissing = false;
+
+static int TestSshServerStateProvider(char** response, void* log)
+{
+    UNUSED(log);
+
+    numberOfSshServerReports += 1;
+
+    // What the shell reports when sshd is not installed
+    if (sshServerMissing)
+    {
+        *response = DuplicateString("/bin/sh: 1: sshd: not found\n");
+        return 127;
+    }
+
+    *response = DuplicateString(
+        "port 22\n"
+        "permitrootlogin no\n"
+        "PermitEmptyPasswords no\n"
+        "allowusers alice\n"
+        "allowusers bob\n"
+        "allowusers carol@10.0.0.*\n"
+        "ciphers aes256-ctr,aes192-ctr,aes128-ctr\n"
+        "banner /etc/azsec/banner.txt\n");
+
+    return (nullptr != *response) ? 0 : ENOMEM;
+}
+
+TEST_F(CommonUtilsTest, SshServerStateSnapshot)
+{
+    const char* sshdConfig = "/tmp/~sshd_config";
+    const char* includeDirectory = "/tmp/~sshd_config.d";
+    const char* includedFile = "/tmp/~sshd_config.d/50-extra.conf";
+    char* value = nullptr;
+
+    EXPECT_TRUE(CreateTestFile(sshdConfig, "Port 22\nInclude /tmp/~sshd_config.d/*.conf\n"));
+    EXPECT_EQ(0, mkdir(includeDirectory, 0700));
+
+    numberOfSshServerReports = 0;
+    sshServerMissing = false;
+    SetSshServerStateProvider(TestSshServerStateProvider, sshdConfig, 60);
+
+    // Option names are matched regardless of case, values are returned as reported
+    EXPECT_STREQ("no", value = GetSshServerState("PermitRootLogin", nullptr));
+    FREE_MEMORY(value);
+    EXPECT_STREQ("no", value = GetSshServerState("permitemptypasswords", nullptr));
+    FREE_MEMORY(value);
+    EXPECT_STREQ("aes256-ctr,aes192-ctr,aes128-ctr", value = GetSshServerState("Ciphers", nullptr));
+    FREE_MEMORY(value);
+    EXPECT_EQ(nullptr, value = GetSshServerState("MaxAuthTries", nullptr));
+    EXPECT_EQ(nullptr, value = GetSshServerState("permit", nullptr));
+
+    // Options reported more than once keep all of their values, the first one is returned
+    EXPECT_STREQ("alice", value = GetSshServerState("AllowUsers", nullptr));
+    FREE_MEMORY(value);
+    EXPECT_TRUE(IsSshServerStateValue("AllowUsers", "alice", nullptr));
+    EXPECT_TRUE(IsSshServerStateValue("allowusers", "bob", nullptr));
+    EXPECT_TRUE(IsSshServerStateValue("ALLOWUSERS", "carol@10.0.0.*", nullptr));
+    EXPECT_FALSE(IsSshServerStateValue("AllowUsers", "dave", nullptr));
+    EXPECT_FALSE(IsSshServerStateValue("DenyUsers", "alice", nullptr));
+
+    // All of the above were answered from a single report
+    EXPECT_EQ(1, numberOfSshServerReports);
+
+    // A file newly matched by the Include glob changes the configuration stamp
+    EXPECT_TRUE(CreateTestFile(includedFile, "PermitRootLogin no\n"));
+    EXPECT_STREQ("22", value = GetSshServerState("Port", nullptr));
+    FREE_MEMORY(value);
+    EXPECT_EQ(2, numberOfSshServerReports);
+    EXPECT_STREQ("22", value = GetSshServerState("Port", nullptr));
+    FREE_MEMORY(value);
+    EXPECT_EQ(2, numberOfSshServerReports);
+
+    // So does an edit of an included file and its removal
+    EXPECT_TRUE(CreateTestFile(includedFile, "PermitRootLogin no\nMaxAuthTries 4\n"));
+    EXPECT_TRUE(IsSshServerStateValue("Port", "22", nullptr));
+    EXPECT_EQ(3, numberOfSshServerReports);
+    EXPECT_TRUE(Cleanup(includedFile));
+    EXPECT_TRUE(IsSshServerStateValue("Port", "22", nullptr));
+    EXPECT_EQ(4, numberOfSshServerReports);
+
+    // With no time to live every query reads the configuration again
+    SetSshServerStateProvider(TestSshServerStateProvider, sshdConfig, 0);
+    EXPECT_TRUE(IsSshServerStateValue("Port", "22", nullptr));
+    EXPECT_TRUE(IsSshServerStateValue("Port", "22", nullptr));
+    EXPECT_EQ(6, numberOfSshServerReports);
+
+    // Without sshd there is no state to report and nothing is cached
+    SetSshServerStateProvider(TestSshServerStateProvider, sshdConfig, 60);
+    sshServerMissing = true;
+    EXPECT_EQ(nullptr, value = GetSshServerState("Port", nullptr));
+    EXPECT_FALSE(IsSshServerStateValue("Port", "22", nullptr));
+    EXPECT_EQ(8, numberOfSshServerReports);
+
+    sshServerMissing = false;
+    SetSshServerStateProvider(nullptr, nullptr, 0);
+
+    EXPECT_EQ(0, rmdir(includeDirectory));
+    EXPECT_TRUE(Cleanup(sshdConfig));
+}
+
+TEST_F(CommonUtilsTest, CheckFileSystemMountingOptionAfterChanges)
+{
+    const char* testFstab = 
+        "/dev/scd0  /media/cdrom0  udf,iso9660  user,noauto,noexecute,utf8,nosuid  0  0\n"
+        "tmpfs /dev/shm tmpfs defaults,mode=1777,nodev 0 0\n";
+    const char* updatedTestFstab = 
+        "/dev/scd0  /media/cdrom0  udf,iso9660  user,noauto,noexec,utf8,nosuid  0  0\n"
+        "tmpfs /dev/shm tmpfs defaults,mode=1777,nodev 0 0\n";
+
+    EXPECT_TRUE(CreateTestFile(m_path, testFstab));
+
+    // Options are matched as whole tokens, with or without a value
+    EXPECT_EQ(ENOENT, CheckFileSystemMountingOption(m_path, "/media", nullptr, "noexec", nullptr, nullptr));
+    EXPECT_EQ(0, CheckFileSystemMountingOption(m_path, "/media", nullptr, "noexecute", nullptr, nullptr));
+    EXPECT_EQ(0, CheckFileSystemMountingOption(m_path, "/dev/shm", nullptr, "mode", nullptr, nullptr));
+    EXPECT_EQ(0, CheckFileSystemMountingOption(m_path, "/dev/shm", nullptr, "mode=1777", nullptr, nullptr));
+    EXPECT_EQ(ENOENT, CheckFileSystemMountingOption(m_path, "/dev/shm", nullptr, "mode=17", nullptr, nullptr));
+    EXPECT_EQ(ENOENT, CheckFileSystemMountingOption(m_path, nullptr, "tmpfs", "nodevice", nullptr, nullptr));
+
+    // The changed file is parsed again
+    EXPECT_TRUE(CreateTestFile(m_path, updatedTestFstab));
+    EXPECT_EQ(0, CheckFileSystemMountingOption(m_path, "/media", nullptr, "noexec", nullptr, nullptr));
+    EXPECT_EQ(ENOENT, CheckFileSystemMountingOption(m_path, "/media", nullptr, "noexecute", nullptr, nullptr));
+
+    EXPECT_TRUE(Cleanup(m_path));
+
+    // The live mount table of this process
+    EXPECT_EQ(ENOENT, CheckFileSystemMountingOption("/proc/self/mounts", "/", nullptr, "not_an_option", nullptr, nullptr));
+}
+
+TEST_F(CommonUtilsTest, AsyncLogging)
+{
+    const char* logFile = "/tmp/~testasync.log";
+    OSCONFIG_LOG_HANDLE log = nullptr;
+    string longText(2000, 'x');
+    string line;
+    int lines = 0;
+
+    // All records come from the same call site
+    SetLogRateLimit(0, 0);
+
+    remove(logFile);
+    ASSERT_NE(nullptr, log = OpenLog(logFile, nullptr));
+    EXPECT_FALSE(IsAsyncLoggingEnabled(log));
+    EXPECT_EQ(0, EnableAsyncLogging(log));
+    EXPECT_TRUE(IsAsyncLoggingEnabled(log));
+
+    for (int i = 0; i < 100; i++)
+    {
+        OsConfigLogInfo(log, "Record %d", i);
+    }
+
+    // Larger than a ring slot, written directly after the queued records
+    OsConfigLogInfo(log, "Long %s", longText.c_str());
+    OsConfigLogError(log, "Last record");
+
+    FlushLog(log);
+    EXPECT_EQ(0, (int)GetDroppedLogRecords(log));
+
+    ifstream contents(logFile);
+    while (getline(contents, line))
+    {
+        if (lines < 100)
+        {
+            EXPECT_NE(string::npos, line.find("Record " + to_string(lines)));
+        }
+        else if (100 == lines)
+        {
+            EXPECT_NE(string::npos, line.find("Long " + longText));
+        }
+        else
+        {
+            EXPECT_NE(string::npos, line.find("[ERROR] Last record"));
+        }
+        lines++;
+    }
+    EXPECT_EQ(102, lines);
+
+    // Closing writes what is still queued
+    OsConfigLogInfo(log, "Closing");
+    CloseLog(&log);
+    contents.close();
+    contents.open(logFile);
+    for (lines = 0; getline(contents, line); lines++)
+    {
+        if (102 == lines)
+        {
+            EXPECT_NE(string::npos, line.find("Closing"));
+        }
+    }
+    EXPECT_EQ(103, lines);
+
+    SetLogRateLimit(LOG_SITE_BURST, LOG_SITE_RECORDS_PER_MINUTE);
+    EXPECT_TRUE(Cleanup(logFile));
+}
+
+TEST_F(CommonUtilsTest, AsyncLoggingOverflow)
+{
+    const char* logFile = "/tmp/~testasyncoverflow.log";
+    OSCONFIG_LOG_HANDLE log = nullptr;
+    string line;
+    int queued = 0, dropped = 0, pending = 0, lines = 0;
+    pid_t child = 0;
+    int childStatus = 0;
+
+    // All records come from the same call site
+    SetLogRateLimit(0, 0);
+
+    remove(logFile);
+    ASSERT_NE(nullptr, log = OpenLog(logFile, nullptr));
+    EXPECT_EQ(0, EnableAsyncLogging(log));
+
+    // With the writer stalled the ring fills up with the first 1024 records and the rest are dropped
+    SuspendLogWriter(log, true);
+    for (int i = 0; i < 1500; i++)
+    {
+        OsConfigLogInfo(log, "Queued %d", i);
+    }
+    EXPECT_EQ(476, (int)GetDroppedLogRecords(log));
+
+    // Once resumed the writer writes the queued records and then reports the drops
+    SuspendLogWriter(log, false);
+    FlushLog(log);
+
+    ifstream contents(logFile);
+    while (getline(contents, line))
+    {
+        if (string::npos != line.find("Queued " + to_string(queued)))
+        {
+            queued++;
+        }
+        else if (string::npos != line.find("[ERROR] 476 log records dropped"))
+        {
+            dropped++;
+        }
+        lines++;
+    }
+    EXPECT_EQ(1024, queued);
+    EXPECT_EQ(1, dropped);
+    EXPECT_EQ(1025, lines);
+    contents.close();
+
+    // What the writer did not get to is written straight to the file from a fatal signal handler. That leaves the ring
+    // taken over for good, so it happens in a child process, where no writer thread runs after the fork
+    ASSERT_NE(-1, child = fork());
+    if (0 == child)
+    {
+        for (int i = 0; i < 10; i++)
+        {
+            OsConfigLogError(log, "Pending %d", i);
+        }
+        FlushLogFromSignal(log);
+        _exit(0);
+    }
+    EXPECT_EQ(child, waitpid(child, &childStatus, 0));
+    EXPECT_TRUE(WIFEXITED(childStatus));
+
+    contents.open(logFile);
+    for (lines = 0; getline(contents, line); lines++)
+    {
+        if ((1025 <= lines) && (string::npos != line.find("[ERROR] Pending " + to_string(pending))))
+        {
+            pending++;
+        }
+    }
+    EXPECT_EQ(10, pending);
+    EXPECT_EQ(1035, lines);
+
+    // No more drops were reported
+    EXPECT_EQ(476, (int)GetDroppedLogRecords(log));
+
+    CloseLog(&log);
+    SetLogRateLimit(LOG_SITE_BURST, LOG_SITE_RECORDS_PER_MINUTE);
+    EXPECT_TRUE(Cleanup(logFile));
+}
+
+TEST_F(CommonUtilsTest, LogRotationGenerations)
+{
+    const char* logFile = "/tmp/~testrotation.log";
+    const char* backLogFile = "/tmp/~testrotation.bak";
+    const char* generations[] = {"/tmp/~testrotation.bak.2", "/tmp/~testrotation.bak.3", "/tmp/~testrotation.bak.4"};
+    OSCONFIG_LOG_HANDLE log = nullptr;
+    string text(1000, 'x');
+    string name;
+
+    remove(logFile);
+    remove(backLogFile);
+    for (auto generation : generations)
+    {
+        remove(generation);
+        remove((string(generation) + ".gz").c_str());
+    }
+
+    // Five times the maximum log size with three generations kept
+    ASSERT_NE(nullptr, log = OpenLog(logFile, backLogFile));
+    SetLogRotation(log, 3, 0);
+    for (int i = 0; i < (5 * MAX_LOG_SIZE / 1000); i++)
+    {
+        WriteToLog(log, __SHORT_FILE__, __LINE__, __INFO__, "%d %s", i, text.c_str());
+    }
+
+    EXPECT_TRUE(FileExists(logFile));
+    EXPECT_TRUE(FileExists(backLogFile));
+    EXPECT_TRUE(FileExists(generations[0]) || FileExists((string(generations[0]) + ".gz").c_str()));
+    EXPECT_TRUE(FileExists(generations[1]) || FileExists((string(generations[1]) + ".gz").c_str()));
+    EXPECT_FALSE(FileExists(generations[2]) || FileExists((string(generations[2]) + ".gz").c_str()));
+
+    // A budget that fits only the current log and the backup log
+    SetLogRotation(log, 3, 2 * MAX_LOG_SIZE + 100000);
+    for (int i = 0; i < (2 * MAX_LOG_SIZE / 1000); i++)
+    {
+        WriteToLog(log, __SHORT_FILE__, __LINE__, __INFO__, "%d %s", i, text.c_str());
+    }
+
+    EXPECT_TRUE(FileExists(backLogFile));
+    EXPECT_FALSE(FileExists(generations[0]) || FileExists((string(generations[0]) + ".gz").c_str()));
+    EXPECT_FALSE(FileExists(generations[1]) || FileExists((string(generations[1]) + ".gz").c_str()));
+
+    CloseLog(&log);
+
+    remove(backLogFile);
+    for (auto generation : generations)
+    {
+        remove(generation);
+        remove((string(generation) + ".gz").c_str());
+    }
+    EXPECT_TRUE(Cleanup(logFile));
+}
+
+TEST_F(CommonUtilsTest, LogRateLimit)
+{
+    const char* logFile = "/tmp/~testratelimit.log";
+    OSCONFIG_LOG_HANDLE log = nullptr;
+    unsigned long long suppressed = GetSuppressedLogRecords();
+    string line;
+    int lines = 0;
+
+    // A burst of 5, then one record every 100 milliseconds
+    SetLogRateLimit(5, 600);
+
+    remove(logFile);
+    ASSERT_NE(nullptr, log = OpenLog(logFile, nullptr));
+
+    auto fail = [&](int i) { OsConfigLogError(log, "Same failure %d", i); };
+
+    for (int i = 0; i < 50; i++)
+    {
+        fail(i);
+    }
+
+    // Another call site has its own limit
+    OsConfigLogInfo(log, "Other site");
+
+    EXPECT_LE(45ULL, GetSuppressedLogRecords() - suppressed);
+
+    // The site logs again after the pause, first with the summary
+    usleep(200000);
+    fail(50);
+
+    CloseLog(&log);
+
+    ifstream contents(logFile);
+    bool summary = false;
+    while (getline(contents, line))
+    {
+        if (line.find("Same failure") != string::npos)
+        {
+            lines++;
+        }
+        else if (line.find("Suppressed ") != string::npos)
+        {
+            summary = true;
+        }
+    }
+
+    EXPECT_LE(6, lines);
+    EXPECT_GE(10, lines);
+    EXPECT_TRUE(summary);
+
+    SetLogRateLimit(LOG_SITE_BURST, LOG_SITE_RECORDS_PER_MINUTE);
+    EXPECT_TRUE(Cleanup(logFile));
+}
@@ -46,6 +46,9 @@ const char g_targetDrop[] = "DROP";
 const char g_chainInput[] = "INPUT";
 const char g_chainOutput[] = "OUTPUT";
 
+// The state and default policies reported together come from one listing of the rules, until the rules get changed
+const char g_listRulesCommand[] = "iptables -S";
+
 OSCONFIG_LOG_HANDLE FirewallLog::m_logHandle = nullptr;
 
 int FirewallModuleBase::GetInfo(const char* clientName, MMI_JSON_STRING* payload, int* payloadSizeBytes)
@@ -480,27 +483,25 @@ std::string IpTablesRule::Specification() const
 
 IpTables::State IpTables::Detect() const
 {
-    const char* command = "iptables -S | grep -E \"^-A (INPUT|OUTPUT)\" | wc -l";
+    static const std::regex ruleRegex("^-A (INPUT|OUTPUT).*$");
 
-    State state = State::Unknown;
+    State state = State::Disabled;
     char* textResult = nullptr;
 
-    if ((0 == ExecuteCommand(nullptr, command, false, false, 0, 0, &textResult, nullptr, FirewallLog::Get())))
+    if ((0 == ExecuteCachedCommand(nullptr, g_listRulesCommand, false, false, 0, 0, COMMAND_CACHE_SHORT_SECONDS, &textResult, FirewallLog::Get())) && textResult)
     {
-        if (textResult && (strlen(textResult) > 0))
-        {
-            int ruleCount = atoi(textResult);
-            state = (ruleCount > 0) ? State::Enabled : State::Disabled;
-        }
-        else
+        std::istringstream iss(textResult);
+        std::string line;
+
+        while (std::getline(iss, line, '\n'))
         {
-            state = State::Disabled;
+            if (std::regex_match(line, ruleRegex))
+            {
+                state = State::Enabled;
+                break;
+            }
         }
     }
-    else
-    {
-        state = State::Disabled;
-    }
 
     FREE_MEMORY(textResult);
 
@@ -509,12 +510,10 @@ IpTables::State IpTables::Detect() const
 
 std::string IpTables::Fingerprint() const
 {
-    const char* command = "iptables -S";
-
     std::string hash;
     char* textResult = nullptr;
 
-    if (nullptr != (textResult = HashCommand(command, FirewallLog::Get())))
+    if (nullptr != (textResult = HashCommand(g_listRulesCommand, FirewallLog::Get())))
     {
         hash = textResult;
     }
@@ -603,6 +602,8 @@ int IpTables::SetDefaultPolicies(const std::vector<IpTablesPolicy> policies)
 
     m_policyStatusMessage = errorMessage;
 
+    InvalidateCommandCache();
+
     return status;
 }
 
@@ -747,6 +748,8 @@ int IpTables::SetRules(const std::vector<IpTables::Rule>& rules)
         m_ruleStatusMessage = "";
     }
 
+    InvalidateCommandCache();
+
     return status;
 }
 
@@ -794,13 +797,12 @@ int IpTablesPolicy::SetDirectionFromChain(const std::string& str)
 
 std::vector<IpTablesPolicy> IpTables::GetDefaultPolicies() const
 {
-    const char* command = "iptables -S | grep -E '^-P (INPUT|OUTPUT)'";
-    static const std::regex policyRegex("^-P\\s+(\\S+)\\s+(\\S+)$");
+    static const std::regex policyRegex("^-P\\s+(INPUT|OUTPUT)\\s+(\\S+)$");
 
     std::vector<IpTablesPolicy> policies;
     char* textResult = nullptr;
 
-    if (0 == ExecuteCommand(nullptr, command, false, false, 0, 0, &textResult, nullptr, FirewallLog::Get()))
+    if (0 == ExecuteCachedCommand(nullptr, g_listRulesCommand, false, false, 0, 0, COMMAND_CACHE_SHORT_SECONDS, &textResult, FirewallLog::Get()))
     {
         if (textResult && (strlen(textResult) > 0))
         {
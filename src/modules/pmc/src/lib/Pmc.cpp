@@ -13,6 +13,9 @@ constexpr const char* g_commandCheckToolPresence = "command -v $value";
 constexpr const char* g_commandGetInstalledPackages = "dpkg-query --showformat='${Package} (=${Version})\n' --show";
 constexpr const char* g_commandGetSourcesContent = "find $value -type f -name '*.list' -exec cat {} \\;";
 
+// Maximum number of independent commands run at the same time
+constexpr unsigned int g_maxParallelCommands = 4;
+
 Pmc::Pmc(unsigned int maxPayloadSizeBytes)
     : PmcBase(maxPayloadSizeBytes)
 {
@@ -38,6 +41,38 @@ int Pmc::RunCommand(const char* command, std::string* textResult, bool isLongRun
     return status;
 }
 
+void Pmc::RunCommands(const std::vector<std::string>& commands, std::vector<int>& statuses, std::vector<std::string>& textResults)
+{
+    std::vector<const char*> commandStrings;
+    std::vector<char*> buffers(commands.size(), nullptr);
+    const bool replaceEol = true;
+    const bool forJson = false;
+
+    statuses.assign(commands.size(), PMC_0K);
+    textResults.assign(commands.size(), "");
+
+    if (commands.empty())
+    {
+        return;
+    }
+
+    for (auto& command : commands)
+    {
+        commandStrings.push_back(command.c_str());
+    }
+
+    ExecuteCommandBatch(commandStrings.data(), (unsigned int)commandStrings.size(), replaceEol, forJson, 0, 0, g_maxParallelCommands, statuses.data(), buffers.data(), PmcLog::Get());
+
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        if ((statuses[i] == PMC_0K) && buffers[i])
+        {
+            textResults[i] = buffers[i];
+        }
+        FREE_MEMORY(buffers[i]);
+    }
+}
+
 std::string Pmc::GetPackagesFingerprint()
 {
     char* hash = HashCommand(g_commandGetInstalledPackages, PmcLog::Get());
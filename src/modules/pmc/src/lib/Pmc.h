@@ -10,6 +10,7 @@ public:
     ~Pmc() = default;
 private:
     int RunCommand(const char* command, std::string* textResult, bool isLongRunning = false) override;
+    void RunCommands(const std::vector<std::string>& commands, std::vector<int>& statuses, std::vector<std::string>& textResults) override;
     std::string GetPackagesFingerprint() override;
     std::string GetSourcesFingerprint(const char* sourcesDirectory) override;
     bool CanRunOnThisPlatform() override;
@@ -592,39 +592,58 @@ int PmcBase::ValidateAndGetPackagesNames(const std::vector<std::string>& package
     return 0;
 }
 
+void PmcBase::RunCommands(const std::vector<std::string>& commands, std::vector<int>& statuses, std::vector<std::string>& textResults)
+{
+    statuses.assign(commands.size(), PMC_0K);
+    textResults.assign(commands.size(), "");
+
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+        statuses[i] = RunCommand(commands[i].c_str(), &textResults[i]);
+    }
+}
+
 std::vector<std::string> PmcBase::GetReportedPackages(const std::vector<std::string>& packages)
 {
     std::vector<std::string> result;
+    std::vector<std::string> packageNames;
+    std::vector<std::string> commands;
+    std::vector<std::string> rawVersions;
+    std::vector<int> statuses;
     std::set<std::string> uniquePackages;
 
-    int status = PMC_0K;
     for (auto& packageName : packages)
     {
         if (uniquePackages.insert(packageName).second)
         {
-            std::string command = std::regex_replace(g_commandGetInstalledPackageVersion, std::regex("\\$value"), packageName);
+            packageNames.push_back(packageName);
+            commands.push_back(std::regex_replace(g_commandGetInstalledPackageVersion, std::regex("\\$value"), packageName));
+        }
+    }
 
-            std::string rawVersion = "";
-            status = RunCommand(command.c_str(), &rawVersion);
-            if (status != PMC_0K && IsFullLoggingEnabled())
-            {
-                OsConfigLogError(PmcLog::Get(), "Get the installed version of package %s failed with status %d", packageName.c_str(), status);
-            }
+    // The package versions are independent of each other, query them together
+    RunCommands(commands, statuses, rawVersions);
 
-            std::string version;
-            if (!rawVersion.empty())
-            {
-                size_t pos = rawVersion.find_first_of(':') + 1;
-                version = rawVersion.substr(pos);
-            }
-            else
-            {
-                version = "(failed)";
-            }
+    for (size_t i = 0; i < packageNames.size(); i++)
+    {
+        if (statuses[i] != PMC_0K && IsFullLoggingEnabled())
+        {
+            OsConfigLogError(PmcLog::Get(), "Get the installed version of package %s failed with status %d", packageNames[i].c_str(), statuses[i]);
+        }
 
-            std::string packageElement = packageName + "=" + Trim(version, " ");
-            result.push_back(packageElement);
+        std::string version;
+        if (!rawVersions[i].empty())
+        {
+            size_t pos = rawVersions[i].find_first_of(':') + 1;
+            version = rawVersions[i].substr(pos);
+        }
+        else
+        {
+            version = "(failed)";
         }
+
+        std::string packageElement = packageNames[i] + "=" + Trim(version, " ");
+        result.push_back(packageElement);
     }
 
   return result;
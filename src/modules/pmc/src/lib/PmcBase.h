@@ -71,6 +71,7 @@ public:
 
 protected:
     virtual int RunCommand(const char* command, std::string* textResult, bool isLongRunning = false) = 0;
+    virtual void RunCommands(const std::vector<std::string>& commands, std::vector<int>& statuses, std::vector<std::string>& textResults);
     virtual std::string GetPackagesFingerprint() = 0;
     virtual std::string GetSourcesFingerprint(const char* sourcesDirectory) = 0;
     static bool ValidateAndUpdatePackageSource(std::string& packageSource, const std::map<std::string, std::string>& gpgKeys);
@@ -1,6 +1,7 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT License.
 
+#include <limits.h>
 #include <PlatformCommon.h>
 #include <MpiServer.h>
 
@@ -19,6 +20,10 @@
 
 #define COMMAND_LOGGING "CommandLogging"
 #define FULL_LOGGING "FullLogging"
+#define ASYNC_LOGGING "AsyncLogging"
+#define LOG_GENERATIONS "LogGenerations"
+#define LOG_RETENTION_BYTES "LogRetentionBytes"
+#define COMMAND_HELPER "CommandHelper"
 
 static unsigned int g_lastTime = 0;
 
@@ -90,6 +95,9 @@ static void SignalInterrupt(int signal)
 
     if (NULL != errorMessage)
     {
+        // Records still queued for the log go in ahead of the crash message
+        FlushLogFromSignal(g_platformLog);
+
         if (0 < (logDescriptor = open(LOG_FILE, O_APPEND | O_WRONLY | O_NONBLOCK)))
         {
             if (0 < (writeResult = write(logDescriptor, (const void*)errorMessage, strlen(errorMessage))))
@@ -191,6 +199,45 @@ bool IsFullLoggingEnabledInJsonConfig(const char* jsonString)
     return IsLoggingEnabledInJsonConfig(jsonString, FULL_LOGGING);
 }
 
+// Returns the integer setting when present and non zero, clamped to the range, otherwise the default
+static int GetSettingFromJsonConfig(const char* jsonString, const char* setting, int defaultValue, int minValue, int maxValue)
+{
+    JSON_Value* rootValue = NULL;
+    JSON_Object* rootObject = NULL;
+    int value = defaultValue;
+
+    if (NULL != jsonString)
+    {
+        if (NULL != (rootValue = json_parse_string(jsonString)))
+        {
+            if (NULL != (rootObject = json_value_get_object(rootValue)))
+            {
+                if (0 == (value = (int)json_object_get_number(rootObject, setting)))
+                {
+                    value = defaultValue;
+                }
+                else if (value < minValue)
+                {
+                    value = minValue;
+                }
+                else if (value > maxValue)
+                {
+                    value = maxValue;
+                }
+            }
+            json_value_free(rootValue);
+        }
+    }
+
+    return value;
+}
+
+// For the on/off settings that are not logging switches, enabled when present and non zero
+static bool IsSettingEnabledInJsonConfig(const char* jsonString, const char* setting)
+{
+    return (0 != GetSettingFromJsonConfig(jsonString, setting, 0, INT_MIN, INT_MAX)) ? true : false;
+}
+
 int main(int argc, char* argv[])
 {
     UNUSED(argc);
@@ -198,18 +245,38 @@ int main(int argc, char* argv[])
 
     pid_t pid = 0;
     int stopSignalsCount = ARRAY_SIZE(g_stopSignals);
+    bool commandHelper = false;
+    bool asyncLogging = false;
+    int logGenerations = 1;
+    int logRetentionBytes = 0;
 
     char* jsonConfiguration = LoadStringFromFile(CONFIG_FILE, false, GetPlatformLog());
     if (NULL != jsonConfiguration)
     {
         SetCommandLogging(IsCommandLoggingEnabledInJsonConfig(jsonConfiguration));
         SetFullLogging(IsFullLoggingEnabledInJsonConfig(jsonConfiguration));
+        commandHelper = IsSettingEnabledInJsonConfig(jsonConfiguration, COMMAND_HELPER);
+        asyncLogging = IsSettingEnabledInJsonConfig(jsonConfiguration, ASYNC_LOGGING);
+        logGenerations = GetSettingFromJsonConfig(jsonConfiguration, LOG_GENERATIONS, 1, 1, MAX_LOG_GENERATIONS);
+        logRetentionBytes = GetSettingFromJsonConfig(jsonConfiguration, LOG_RETENTION_BYTES, 0, 2 * MAX_LOG_SIZE, INT_MAX);
         FREE_MEMORY(jsonConfiguration);
     }
 
     RestrictFileAccessToCurrentAccountOnly(CONFIG_FILE);
 
     g_platformLog = OpenLog(LOG_FILE, ROLLED_LOG_FILE);
+    SetLogRotation(g_platformLog, (unsigned int)logGenerations, logRetentionBytes);
+
+    // The command helper goes first, before this process starts any thread of its own such as the log writer
+    if (commandHelper)
+    {
+        StartCommandHelper(GetPlatformLog());
+    }
+
+    if (asyncLogging && (0 != EnableAsyncLogging(g_platformLog)))
+    {
+        OsConfigLogError(GetPlatformLog(), "Failed to start asynchronous logging, logging synchronously");
+    }
 
     OsConfigLogInfo(GetPlatformLog(), "OSConfig Platform starting (PID: %d, PPID: %d)", pid = getpid(), getppid());
     OsConfigLogInfo(GetPlatformLog(), "OSConfig version: %s", OSCONFIG_VERSION);
@@ -241,8 +308,11 @@ int main(int argc, char* argv[])
     }
 
     OsConfigLogInfo(GetPlatformLog(), "OSConfig Platform (PID: %d) exiting with %d", pid, g_stopSignal);
+    OsConfigLogInfo(GetPlatformLog(), "Log records suppressed by the per call site limit: %llu, dropped by asynchronous logging: %llu",
+        GetSuppressedLogRecords(), GetDroppedLogRecords(GetPlatformLog()));
 
     TerminatePlatform();
+    StopCommandHelper(GetPlatformLog());
     CloseLog(&g_platformLog);
 
     return 0;
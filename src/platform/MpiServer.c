@@ -34,6 +34,9 @@ static socklen_t g_socketlen = 0;
 static pthread_t g_mpiServerWorker = 0;
 static bool g_serverActive = false;
 
+// Serializes the MPI calls made over the socket with the in-process ones when colocated with the Agent
+static pthread_mutex_t g_mpiCallLock = PTHREAD_MUTEX_INITIALIZER;
+
 char g_mpiCall[MPI_CALL_MESSAGE_LENGTH] = {0};
 static const char g_mpiCallObjectTemplate[] = " during %s to %s.%s\n";
 static const char g_mpiCallModelTemplate[] = " during %s\n";
@@ -492,7 +495,9 @@ static void* MpiServerWorker(void* arguments)
 
         if (0 <= (socketHandle = accept(g_socketfd, (struct sockaddr*)&g_socketaddr, &g_socketlen)))
         {
+            pthread_mutex_lock(&g_mpiCallLock);
             AreModulesLoadedAndLoadIfNot(MODULES_BIN_PATH, CONFIG_JSON_PATH);
+            pthread_mutex_unlock(&g_mpiCallLock);
 
             if (IsFullLoggingEnabled())
             {
@@ -529,7 +534,9 @@ static void* MpiServerWorker(void* arguments)
                     OsConfigLogInfo(GetPlatformLog(), "%s: content-length %d, body, '%s'", uri, contentLength, requestBody);
                 }
 
+                pthread_mutex_lock(&g_mpiCallLock);
                 status = HandleMpiCall(uri, requestBody, &responseBody, &responseSize, mpiCalls);
+                pthread_mutex_unlock(&g_mpiCallLock);
             }
 
             httpReason = HttpReasonAsString(status);
@@ -580,6 +587,111 @@ static void* MpiServerWorker(void* arguments)
     return NULL;
 }
 
+static MPI_HANDLE CallMpiOpenInProcess(const char* clientName, const unsigned int maxPayloadSizeBytes)
+{
+    MPI_HANDLE handle = NULL;
+
+    pthread_mutex_lock(&g_mpiCallLock);
+    AreModulesLoadedAndLoadIfNot(MODULES_BIN_PATH, CONFIG_JSON_PATH);
+    handle = CallMpiOpen(clientName, maxPayloadSizeBytes);
+    pthread_mutex_unlock(&g_mpiCallLock);
+
+    return handle;
+}
+
+static void CallMpiCloseInProcess(MPI_HANDLE handle)
+{
+    pthread_mutex_lock(&g_mpiCallLock);
+    CallMpiClose(handle);
+    pthread_mutex_unlock(&g_mpiCallLock);
+}
+
+static int CallMpiSetInProcess(MPI_HANDLE handle, const char* componentName, const char* objectName, MPI_JSON_STRING payload, const int payloadSize)
+{
+    int status = MPI_OK;
+
+    pthread_mutex_lock(&g_mpiCallLock);
+    status = CallMpiSet(handle, componentName, objectName, payload, payloadSize);
+    pthread_mutex_unlock(&g_mpiCallLock);
+
+    return status;
+}
+
+static int CallMpiGetInProcess(MPI_HANDLE handle, const char* componentName, const char* objectName, MPI_JSON_STRING* payload, int* payloadSize)
+{
+    MPI_JSON_STRING modulePayload = NULL;
+    int modulePayloadSize = 0;
+    int status = MPI_OK;
+
+    if ((NULL == payload) || (NULL == payloadSize))
+    {
+        return EINVAL;
+    }
+
+    *payload = NULL;
+    *payloadSize = 0;
+
+    pthread_mutex_lock(&g_mpiCallLock);
+    status = CallMpiGet(handle, componentName, objectName, &modulePayload, &modulePayloadSize);
+    pthread_mutex_unlock(&g_mpiCallLock);
+
+    // Module payloads are not null terminated, return a null terminated copy like the socket server does
+    if ((MPI_OK == status) && (NULL != modulePayload) && (modulePayloadSize > 0))
+    {
+        if (NULL != (*payload = (MPI_JSON_STRING)malloc(modulePayloadSize + 1)))
+        {
+            memcpy(*payload, modulePayload, modulePayloadSize);
+            (*payload)[modulePayloadSize] = 0;
+            *payloadSize = modulePayloadSize;
+        }
+        else
+        {
+            OsConfigLogError(GetPlatformLog(), "MpiGet(%s, %s): failed to allocate memory for payload", componentName, objectName);
+            status = ENOMEM;
+        }
+    }
+
+    FREE_MEMORY(modulePayload);
+
+    return status;
+}
+
+static int CallMpiSetDesiredInProcess(MPI_HANDLE handle, const MPI_JSON_STRING payload, const int payloadSize)
+{
+    int status = MPI_OK;
+
+    pthread_mutex_lock(&g_mpiCallLock);
+    status = CallMpiSetDesired(handle, payload, payloadSize);
+    pthread_mutex_unlock(&g_mpiCallLock);
+
+    return status;
+}
+
+static int CallMpiGetReportedInProcess(MPI_HANDLE handle, MPI_JSON_STRING* payload, int* payloadSize)
+{
+    int status = MPI_OK;
+
+    pthread_mutex_lock(&g_mpiCallLock);
+    status = CallMpiGetReported(handle, payload, payloadSize);
+    pthread_mutex_unlock(&g_mpiCallLock);
+
+    return status;
+}
+
+MPI_CALLS GetInProcessMpiCalls(void)
+{
+    MPI_CALLS mpiCalls = {
+        CallMpiOpenInProcess,
+        CallMpiCloseInProcess,
+        CallMpiSetInProcess,
+        CallMpiGetInProcess,
+        CallMpiSetDesiredInProcess,
+        CallMpiGetReportedInProcess
+    };
+
+    return mpiCalls;
+}
+
 void MpiInitialize(void)
 {
     struct stat st;
@@ -640,7 +752,9 @@ void MpiShutdown(void)
         pthread_join(g_mpiServerWorker, NULL);
     }
 
+    pthread_mutex_lock(&g_mpiCallLock);
     UnloadModules();
+    pthread_mutex_unlock(&g_mpiCallLock);
 
     close(g_socketfd);
     unlink(g_mpiSocket);
@@ -45,6 +45,9 @@ typedef struct MPI_CALLS
 
 HTTP_STATUS HandleMpiCall(const char* uri, const char* requestBody, char** response, int* responseSize, MPI_CALLS handlers);
 
+// Direct (no socket) MPI calls for an Agent that runs the platform in-process, serialized with the socket server
+MPI_CALLS GetInProcessMpiCalls(void);
+
 #ifdef __cplusplus
 }
 #endif